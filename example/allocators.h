@@ -39,10 +39,11 @@ class arena_allocator : public kvr::allocator
 {
 public:
 
-  // allocate: return memory if available
+  // allocate: return memory if available (8-byte aligned)
   void *allocate (size_t sz)
   {
     void *p = NULL;
+    sz = (sz + 7u) & ~((size_t) 7u);
     if ((m_ptr + sz) <= MAX_MEMORY_SZ)
     {
       p = &m_memory [m_ptr];
@@ -86,6 +87,7 @@ public:
   {
     m_alloc_count++;
     m_bytes_allocated += sz;
+    this->track_peak ();
     return std::malloc (sz);
   }
 
@@ -96,9 +98,27 @@ public:
     m_free_count++;
     m_bytes_freed += sz;
   }
+
+  // reallocate (counted as an allocation and a deallocation)
+  void *reallocate (void *p, size_t old_sz, size_t new_sz)
+  {
+    void *np = std::realloc (p, new_sz);
+    if (np)
+    {
+      m_alloc_count++;
+      m_bytes_allocated += new_sz;
+      if (p)
+      {
+        m_free_count++;
+        m_bytes_freed += old_sz;
+      }
+      this->track_peak ();
+    }
+    return np;
+  }
   
   // constructor
-  memtrack_allocator () : m_alloc_count (0), m_free_count (0), m_bytes_allocated (0), m_bytes_freed (0) {}
+  memtrack_allocator () : m_alloc_count (0), m_free_count (0), m_bytes_allocated (0), m_bytes_freed (0), m_peak (0) {}
 
   // stats
   size_t get_allocation_count ()    { return m_alloc_count; }
@@ -111,12 +131,22 @@ public:
     return (int64_t) m_bytes_allocated - (int64_t) m_bytes_freed;
   }
 
+  int64_t get_memory_peak () { return m_peak; }
+  void    reset_memory_peak () { m_peak = this->get_memory_usage (); }
+
 private:
 
-  size_t m_alloc_count;
-  size_t m_free_count;
-  size_t m_bytes_allocated;
-  size_t m_bytes_freed;
+  void track_peak ()
+  {
+    int64_t usage = this->get_memory_usage ();
+    if (usage > m_peak) { m_peak = usage; }
+  }
+
+  size_t  m_alloc_count;
+  size_t  m_free_count;
+  size_t  m_bytes_allocated;
+  size_t  m_bytes_freed;
+  int64_t m_peak;
 };
 
 
@@ -125,6 +155,7 @@ private:
 ////////////////////////////////////////////////////////////////////////////////////////////////
 #ifdef KVR_EXAMPLE_HAVE_BOOST
 // a pool allocator optimized for kvr::value and kvr::key dynamic allocations
+// (kvr::pool_allocator is a built-in alternative that pools every size kvr asks for)
 ////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////
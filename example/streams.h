@@ -23,11 +23,11 @@
 #include "../src/kvr.h"
 #include <cstdio>
 #include <cassert>
+#include <algorithm>
 #ifdef KVR_EXAMPLE_HAVE_OPENSSL
 #include <openssl/sha.h>
 #endif
 #ifdef KVR_EXAMPLE_HAVE_ZLIB
-#include <algorithm>
 #include <zlib.h>
 #endif
 #ifdef KVR_EXAMPLE_HAVE_LZ4
@@ -238,6 +238,22 @@ public:
     return true;
   }
 
+  size_t read_some (uint8_t *bytes, size_t count)
+  {
+    assert (m_fp);
+#ifdef _MSC_VER
+    return fread_s (bytes, count, sizeof (uint8_t), count, m_fp);
+#else
+    return fread (bytes, sizeof (uint8_t), count, m_fp);
+#endif
+  }
+
+  bool unread (size_t count)
+  {
+    assert (m_fp);
+    return (count == 0) || (fseek (m_fp, -static_cast<long>(count), SEEK_CUR) == 0);
+  }
+
   size_t tell ()
   {
     assert (m_fp);
@@ -438,6 +454,35 @@ public:
     return true;
   }
 
+  size_t read_some (uint8_t *bytes, size_t count)
+  {
+    if (m_pos >= m_sz)
+    {
+#ifdef _MSC_VER
+      m_sz = fread_s (m_buf, MAX_BUF_SZ, sizeof (uint8_t), MAX_BUF_SZ, m_fp);
+#else
+      m_sz = fread (m_buf, sizeof (uint8_t), MAX_BUF_SZ, m_fp);
+#endif
+      m_pos = 0;
+    }
+
+    size_t copy = std::min (count, m_sz - m_pos);
+    memcpy (bytes, &m_buf [m_pos], copy);
+    m_pos += copy;
+    return copy;
+  }
+
+  bool unread (size_t count)
+  {
+    // read_some copies out of one buffer, so its last bytes are still there
+    if (count > m_pos)
+    {
+      return false;
+    }
+    m_pos -= count;
+    return true;
+  }
+
   size_t tell ()
   {
     if (m_pos >= m_sz)
@@ -765,6 +810,31 @@ public:
     return false;
   }
 
+  size_t read_some (uint8_t *bytes, size_t count)
+  {
+    if (m_pos >= m_sz)
+    {
+      this->reset_buf ();
+      m_sz = this->decompress_buf (m_buf, MAX_BLOCK_SZ);
+    }
+
+    size_t copy = std::min (count, m_sz - m_pos);
+    memcpy (bytes, &m_buf [m_pos], copy);
+    m_pos += copy;
+    return copy;
+  }
+
+  bool unread (size_t count)
+  {
+    // read_some copies out of one buffer, so its last bytes are still there
+    if (count > m_pos)
+    {
+      return false;
+    }
+    m_pos -= count;
+    return true;
+  }
+
   size_t tell ()
   {
     assert (m_fp);    
@@ -1060,6 +1130,31 @@ public:
     return false;
   }
 
+  size_t read_some (uint8_t *bytes, size_t count)
+  {
+    if (m_pos >= m_sz)
+    {
+      this->reset_buf ();
+      m_sz = this->decompress_buf (m_buf, MAX_BLOCK_SZ);
+    }
+
+    size_t copy = std::min (count, m_sz - m_pos);
+    memcpy (bytes, &m_buf [m_pos], copy);
+    m_pos += copy;
+    return copy;
+  }
+
+  bool unread (size_t count)
+  {
+    // read_some copies out of one buffer, so its last bytes are still there
+    if (count > m_pos)
+    {
+      return false;
+    }
+    m_pos -= count;
+    return true;
+  }
+
   size_t tell ()
   {
     return m_tlp + m_pos;
@@ -1308,6 +1403,31 @@ public:
     return false;
   }
 
+  size_t read_some (uint8_t *bytes, size_t count)
+  {
+    if (m_pos >= m_sz)
+    {
+      this->swap_buf ();
+      m_sz = this->decompress_buf (m_buf [m_idx], MAX_BLOCK_SZ);
+    }
+
+    size_t copy = std::min (count, m_sz - m_pos);
+    memcpy (bytes, &m_buf [m_idx] [m_pos], copy);
+    m_pos += copy;
+    return copy;
+  }
+
+  bool unread (size_t count)
+  {
+    // read_some copies out of one buffer, so its last bytes are still there
+    if (count > m_pos)
+    {
+      return false;
+    }
+    m_pos -= count;
+    return true;
+  }
+
   size_t tell ()
   {
     return m_tlp += m_pos;
@@ -20,7 +20,6 @@
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 
-#define KVR_CBOR_READ_KEY_SPECIALIZATION    0
 #define KVR_CBOR_WRITE_COMPACT_FP_OVERRIDE  0
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
@@ -45,11 +44,11 @@ namespace kvr
             
             static const uint8_t CBOR_MAJOR_TYPE_0 = 0x00;  // unsigned integer
             static const uint8_t CBOR_MAJOR_TYPE_1 = 0x20;  // negative integer
-            static const uint8_t CBOR_MAJOR_TYPE_2 = 0x40;  // byte string - unused
+            static const uint8_t CBOR_MAJOR_TYPE_2 = 0x40;  // byte string - typed array payloads only
             static const uint8_t CBOR_MAJOR_TYPE_3 = 0x60;  // text string
             static const uint8_t CBOR_MAJOR_TYPE_4 = 0x80;  // array
             static const uint8_t CBOR_MAJOR_TYPE_5 = 0xa0;  // map
-            static const uint8_t CBOR_MAJOR_TYPE_6 = 0xc0;  // semantic tagging - unused
+            static const uint8_t CBOR_MAJOR_TYPE_6 = 0xc0;  // semantic tagging - typed array tags only
             static const uint8_t CBOR_MAJOR_TYPE_7 = 0xe0;  // floating point and no content simple data types
             
             /////////////////////////////////////////////////////////////////////////////////////////////
@@ -71,11 +70,33 @@ namespace kvr
             /////////////////////////////////////////////////////////////////////////////////////////////
             /////////////////////////////////////////////////////////////////////////////////////////////
             
+            // typed arrays (https://tools.ietf.org/html/rfc8746): tag 0b010fsell over a byte string.
+            // packed arrays are written with the native endian tag so both ends are a memcpy.
+            
+            static const uint8_t CBOR_TAG_TYPED_ARRAY_MIN       = 64;
+            static const uint8_t CBOR_TAG_TYPED_ARRAY_MAX       = 87;
+            static const uint8_t CBOR_TAG_TYPED_ARRAY_RESERVED  = 76;
+            static const uint8_t CBOR_TAG_TYPED_ARRAY_FLOAT     = 0x10;
+            static const uint8_t CBOR_TAG_TYPED_ARRAY_SIGNED    = 0x08;
+            static const uint8_t CBOR_TAG_TYPED_ARRAY_LE        = 0x04;
+            static const uint8_t CBOR_TAG_TYPED_ARRAY_LL        = 0x03;
+#ifdef KVR_LITTLE_ENDIAN
+            static const uint8_t CBOR_TAG_TYPED_ARRAY_SINT64    = 79;
+            static const uint8_t CBOR_TAG_TYPED_ARRAY_FLOAT64   = 86;
+#else
+            static const uint8_t CBOR_TAG_TYPED_ARRAY_SINT64    = 75;
+            static const uint8_t CBOR_TAG_TYPED_ARRAY_FLOAT64   = 82;
+#endif
+            
+            /////////////////////////////////////////////////////////////////////////////////////////////
+            /////////////////////////////////////////////////////////////////////////////////////////////
+            /////////////////////////////////////////////////////////////////////////////////////////////
+            
             struct read_ctx
             {
                 ////////////////////////////////////////////////////////////
                 
-                read_ctx (kvr::value *value) : m_root (value), m_temp (NULL), m_depth (0)
+                read_ctx (kvr::value *value, bool borrow = false, bool pack = false, bool insitu = false) : m_root (value), m_temp (NULL), m_depth (0), m_borrow (borrow), m_insitu (insitu), m_pack (pack)
                 {
                     memset (m_stack, 0, sizeof (m_stack));
                 }
@@ -129,7 +150,14 @@ namespace kvr
                     }
                     else if (node->is_array ())
                     {
-                        node->push (b);
+                        if (m_pack)
+                        {
+                            node->push_n (&b, 1);
+                        }
+                        else
+                        {
+                            node->push (b);
+                        }
                         success = true;
                     }
                     
@@ -159,7 +187,14 @@ namespace kvr
                     }
                     else if (node->is_array ())
                     {
-                        node->push (i);
+                        if (m_pack)
+                        {
+                            node->push_n (&i, 1);
+                        }
+                        else
+                        {
+                            node->push (i);
+                        }
                         success = true;
                     }
                     
@@ -199,7 +234,14 @@ namespace kvr
                     }
                     else if (node->is_array ())
                     {
-                        node->push (d);
+                        if (m_pack)
+                        {
+                            node->push_n (&d, 1);
+                        }
+                        else
+                        {
+                            node->push (d);
+                        }
                         success = true;
                     }
                     
@@ -208,6 +250,51 @@ namespace kvr
                 
                 ////////////////////////////////////////////////////////////
                 
+                template<typename T>
+                bool read_packed (const T *src, kvr::sz_t count)
+                {
+                    KVR_ASSERT_SAFE (m_depth != 0, false);
+                    kvr::value *node = m_stack [m_depth - 1];
+                    KVR_ASSERT_SAFE (node && node->is_array (), false);
+                    
+                    if (m_pack)
+                    {
+                        return node->push_n (src, count);
+                    }
+                    
+                    bool ok = true;
+                    for (kvr::sz_t i = 0; ok && (i < count); ++i)
+                    {
+                        ok = (node->push (src [i]) != NULL);
+                    }
+                    return ok;
+                }
+                
+                ////////////////////////////////////////////////////////////
+                
+                void set_string (kvr::value *v, const char *str, kvr::sz_t length)
+                {
+                    if (m_borrow && m_insitu)
+                    {
+                        // every string follows at least one header byte (already read), so
+                        // sliding it back by one leaves room to terminate it in place
+                        char *term = const_cast<char *>(str) - 1;
+                        memmove (term, str, length);
+                        term [length] = 0;
+                        v->_string_borrow (term, length, true);
+                    }
+                    else if (m_borrow)
+                    {
+                        v->_string_borrow (str, length);
+                    }
+                    else
+                    {
+                        v->set_string (str, length);
+                    }
+                }
+                
+                ////////////////////////////////////////////////////////////
+                
                 bool read_string (const char *str, kvr::sz_t length)
                 {
                     bool success = false;
@@ -224,7 +311,7 @@ namespace kvr
 #if KVR_FLAG_DISABLE_IMPLICIT_TYPE_CONVERSION
                         m_temp = m_temp->as_string ();
 #endif
-                        m_temp->set_string (str, length);
+                        this->set_string (m_temp, str, length);
                         m_temp = NULL;
                         success = true;
                     }
@@ -234,7 +321,7 @@ namespace kvr
 #if KVR_FLAG_DISABLE_IMPLICIT_TYPE_CONVERSION
                         vstr = vstr->as_string ();
 #endif
-                        vstr->set_string (str, length);
+                        this->set_string (vstr, str, length);
                         success = true;
                     }
                     
@@ -288,15 +375,7 @@ namespace kvr
                     KVR_ASSERT_SAFE (node && node->is_map (), false);
                     
                     KVR_ASSERT (!m_temp);
-#if KVR_CBOR_READ_KEY_SPECIALIZATION
-                    char key [256];
-                    KVR_ASSERT (length < 256);
-                    kvr_strncpy (key, 256, str, length);
-                    m_temp = node->insert_null (key);
-#else
-                    KVR_REF_UNUSED (length);
-                    m_temp = node->insert_null (str);
-#endif
+                    m_temp = node->insert_null (str, length);
                     return (m_temp != NULL);
                 }
                 
@@ -368,6 +447,9 @@ namespace kvr
                 kvr::value  * m_root;
                 kvr::value  * m_temp;
                 kvr::sz_t     m_depth;
+                bool          m_borrow; // strings point into the input (mem_istream only)
+                bool          m_insitu; // with m_borrow: the input may be written to
+                bool          m_pack;   // numeric and boolean arrays are packed
             };
             
             /////////////////////////////////////////////////////////////////////////////////////////////
@@ -523,9 +605,18 @@ namespace kvr
                                 
                             case CBOR_MAJOR_TYPE_6: // semantic tagging
                             {
-                                KVR_ASSERT (false && "unsupported major type (6): semantic tagging");
-                                // maybe skip bytes? no. client stream interface can't cope atm.
-                                success = false;
+                                uint8_t tag = 0;
+                                if ((value_type == CBOR_VALUE_TYPE_UINT8) && is->get (&tag) &&
+                                    (tag >= CBOR_TAG_TYPED_ARRAY_MIN) && (tag <= CBOR_TAG_TYPED_ARRAY_MAX))
+                                {
+                                    success = parse_typed_array (is, ctx, tag);
+                                }
+                                else
+                                {
+                                    KVR_ASSERT (false && "unsupported major type (6): semantic tagging");
+                                    // maybe skip bytes? no. client stream interface can't cope atm.
+                                    success = false;
+                                }
                                 break;
                             }
                                 
@@ -777,15 +868,13 @@ namespace kvr
                 
                 bool parse_array5 (istr *is, read_ctx &ctx, uint8_t data)
                 {
-                    uint8_t alen = (data & 0x0f);
+                    uint8_t alen = (data & 0x1f);
                     bool ok = ctx.read_array_start (alen);
                     for (uint8_t i = 0; ok && (i < alen); ++i)
                     {
                         ok &= parse (is, ctx);
                     }
-#if KVR_DEBUG
                     ok = ok && ctx.read_array_end (alen);
-#endif
                     return ok;
                 }
                 
@@ -802,9 +891,7 @@ namespace kvr
                         {
                             ok &= parse (is, ctx);
                         }
-#if KVR_DEBUG
-                        ok &= ctx.read_array_end (alen);
-#endif
+                        ok = ok && ctx.read_array_end (alen);
                     }
                     return ok;
                 }
@@ -823,9 +910,7 @@ namespace kvr
                         {
                             ok &= parse (is, ctx);
                         }
-#if KVR_DEBUG
-                        ok &= ctx.read_array_end (static_cast<kvr::sz_t>(alen));
-#endif
+                        ok = ok && ctx.read_array_end (static_cast<kvr::sz_t>(alen));
                     }
                     return ok;
                 }
@@ -844,27 +929,211 @@ namespace kvr
                         {
                             ok &= parse (is, ctx);
                         }
-#if KVR_DEBUG
-                        ok &= ctx.read_array_end (static_cast<kvr::sz_t>(alen));
-#endif
+                        ok = ok && ctx.read_array_end (static_cast<kvr::sz_t>(alen));
+                    }
+                    return ok;
+                }
+                
+                ////////////////////////////////////////////////////////////
+                
+                bool parse_typed_array (istr *is, read_ctx &ctx, uint8_t tag)
+                {
+                    bool ok = false;
+                    uint8_t curr = 0;
+                    uint64_t size = 0;
+                    
+                    if (is->get (&curr) && ((curr & 0xe0) == CBOR_MAJOR_TYPE_2) && parse_length (is, (curr & 0x1f), &size))
+                    {
+                        const bool flt = (tag & CBOR_TAG_TYPED_ARRAY_FLOAT) != 0;
+                        const uint8_t ll = (tag & CBOR_TAG_TYPED_ARRAY_LL);
+                        const size_t esz = flt ? (size_t) (2u << ll) : (size_t) (1u << ll);
+                        const uint64_t count = size / esz;
+                        
+                        // reserved tag, float128 and partial elements are unsupported
+                        if ((tag == CBOR_TAG_TYPED_ARRAY_RESERVED) || (flt && (ll == 3)) || ((size % esz) != 0) ||
+                            (count != (uint64_t) (kvr::sz_t) count))
+                        {
+                            return false;
+                        }
+                        
+                        ok = ctx.read_array_start (0);
+                        
+                        // read whole elements in chunks into an aligned buffer
+                        const uint64_t chunk = 64;
+                        union { uint64_t u [chunk]; int64_t i [chunk]; double d [chunk]; } buf;
+                        int64_t ivals [chunk];
+                        double fvals [chunk];
+                        uint64_t rem = count;
+                        
+                        while (ok && (rem > 0))
+                        {
+                            const kvr::sz_t n = (kvr::sz_t) ((rem < chunk) ? rem : chunk);
+                            const uint8_t *bytes = (const uint8_t *) buf.u;
+                            ok = is->read ((uint8_t *) buf.u, n * esz);
+                            
+                            if (!ok)
+                            {
+                                break;
+                            }
+                            
+                            if (tag == CBOR_TAG_TYPED_ARRAY_SINT64)
+                            {
+                                ok = ctx.read_packed (buf.i, n);
+                            }
+                            else if (tag == CBOR_TAG_TYPED_ARRAY_FLOAT64)
+                            {
+                                ok = ctx.read_packed (buf.d, n);
+                            }
+                            else if (flt)
+                            {
+                                for (kvr::sz_t i = 0; ok && (i < n); ++i)
+                                {
+                                    ok = typed_array_float (bytes + (i * esz), tag, &fvals [i]);
+                                }
+                                ok = ok && ctx.read_packed (fvals, n);
+                            }
+                            else
+                            {
+                                for (kvr::sz_t i = 0; ok && (i < n); ++i)
+                                {
+                                    ok = typed_array_integer (bytes + (i * esz), tag, &ivals [i]);
+                                }
+                                ok = ok && ctx.read_packed (ivals, n);
+                            }
+                            
+                            rem -= n;
+                        }
+                        
+                        ok = ok && ctx.read_array_end ((kvr::sz_t) count);
                     }
+                    
                     return ok;
                 }
                 
                 ////////////////////////////////////////////////////////////
                 
+                bool parse_length (istr *is, uint8_t value_type, uint64_t *len)
+                {
+                    bool ok = true;
+                    
+                    if (value_type < CBOR_VALUE_TYPE_UINT8)
+                    {
+                        *len = value_type;
+                    }
+                    else if (value_type == CBOR_VALUE_TYPE_UINT8)
+                    {
+                        uint8_t u8 = 0;
+                        ok = is->get (&u8);
+                        *len = u8;
+                    }
+                    else if (value_type == CBOR_VALUE_TYPE_UINT16)
+                    {
+                        uint16_t u16 = 0;
+                        ok = is->read ((uint8_t *) &u16, 2);
+                        *len = kvr_bigendian16 (u16);
+                    }
+                    else if (value_type == CBOR_VALUE_TYPE_UINT32)
+                    {
+                        uint32_t u32 = 0;
+                        ok = is->read ((uint8_t *) &u32, 4);
+                        *len = kvr_bigendian32 (u32);
+                    }
+                    else if (value_type == CBOR_VALUE_TYPE_UINT64)
+                    {
+                        uint64_t u64 = 0;
+                        ok = is->read ((uint8_t *) &u64, 8);
+                        *len = kvr_bigendian64 (u64);
+                    }
+                    else
+                    {
+                        ok = false;
+                    }
+                    
+                    return ok;
+                }
+                
+                ////////////////////////////////////////////////////////////
+                
+                static uint64_t typed_array_bits (const uint8_t *bytes, size_t esz, uint8_t tag)
+                {
+                    uint64_t u = 0;
+                    if (tag & CBOR_TAG_TYPED_ARRAY_LE)
+                    {
+                        for (size_t k = esz; k > 0; --k) { u = (u << 8) | bytes [k - 1]; }
+                    }
+                    else
+                    {
+                        for (size_t k = 0; k < esz; ++k) { u = (u << 8) | bytes [k]; }
+                    }
+                    return u;
+                }
+                
+                ////////////////////////////////////////////////////////////
+                
+                static bool typed_array_integer (const uint8_t *bytes, uint8_t tag, int64_t *i)
+                {
+                    const size_t esz = (size_t) 1u << (tag & CBOR_TAG_TYPED_ARRAY_LL);
+                    uint64_t u = typed_array_bits (bytes, esz, tag);
+                    
+                    if (tag & CBOR_TAG_TYPED_ARRAY_SIGNED)
+                    {
+                        if ((esz < 8) && ((u >> ((esz * 8) - 1)) & 1))
+                        {
+                            u |= ~((uint64_t) 0) << (esz * 8); // sign extend
+                        }
+                    }
+                    else if (u > (uint64_t) std::numeric_limits<int64_t>::max ())
+                    {
+                        KVR_ASSERT (false && "not supported");
+                        return false;
+                    }
+                    
+                    *i = (int64_t) u;
+                    return true;
+                }
+                
+                ////////////////////////////////////////////////////////////
+                
+                static bool typed_array_float (const uint8_t *bytes, uint8_t tag, double *d)
+                {
+                    const size_t esz = (size_t) 2u << (tag & CBOR_TAG_TYPED_ARRAY_LL);
+                    uint64_t u = typed_array_bits (bytes, esz, tag);
+                    
+                    if (esz == 2)
+                    {
+                        float f = 0.0f;
+                        if (!kvr::internal::fp_half_to_single ((uint16_t) u, &f))
+                        {
+                            return false;
+                        }
+                        *d = f;
+                    }
+                    else if (esz == 4)
+                    {
+                        float f = 0.0f;
+                        uint32_t u32 = (uint32_t) u;
+                        memcpy (&f, &u32, sizeof (u32));
+                        *d = f;
+                    }
+                    else
+                    {
+                        memcpy (d, &u, sizeof (u));
+                    }
+                    
+                    return true;
+                }
+                
+                ////////////////////////////////////////////////////////////
+                
                 bool parse_map5 (istr *is, read_ctx &ctx, uint8_t data)
                 {
-                    uint8_t msz = (data & 0x0f);
+                    uint8_t msz = (data & 0x1f);
                     bool ok = ctx.read_map_start (msz);
                     for (uint8_t i = 0; ok && (i < msz); ++i)
                     {
-                        ok &= parse_key (is, ctx);
-                        ok &= parse (is, ctx);
+                        ok = parse_key (is, ctx) && parse (is, ctx);
                     }
-#if KVR_DEBUG
-                    ok &= ctx.read_map_end (msz);
-#endif
+                    ok = ok && ctx.read_map_end (msz);
                     return ok;
                 }
                 
@@ -879,12 +1148,9 @@ namespace kvr
                         ok = ctx.read_map_start (msz);
                         for (uint8_t i = 0; ok && (i < msz); ++i)
                         {
-                            ok &= parse_key (is, ctx);
-                            ok &= parse (is, ctx);
+                            ok = parse_key (is, ctx) && parse (is, ctx);
                         }
-#if KVR_DEBUG
-                        ok &= ctx.read_map_end (msz);
-#endif
+                        ok = ok && ctx.read_map_end (msz);
                     }
                     return ok;
                 }
@@ -901,12 +1167,9 @@ namespace kvr
                         ok = ctx.read_map_start (static_cast<kvr::sz_t>(msz));
                         for (uint16_t i = 0; ok && (i < msz); ++i)
                         {
-                            ok &= parse_key (is, ctx);
-                            ok &= parse (is, ctx);
+                            ok = parse_key (is, ctx) && parse (is, ctx);
                         }
-#if KVR_DEBUG
-                        ok &= ctx.read_map_end (static_cast<kvr::sz_t>(msz));
-#endif
+                        ok = ok && ctx.read_map_end (static_cast<kvr::sz_t>(msz));
                     }
                     return ok;
                 }
@@ -923,12 +1186,9 @@ namespace kvr
                         ok = ctx.read_map_start (static_cast<kvr::sz_t>(msz));
                         for (uint32_t i = 0; ok && (i < msz); ++i)
                         {
-                            ok &= parse_key (is, ctx);
-                            ok &= parse (is, ctx);
+                            ok = parse_key (is, ctx) && parse (is, ctx);
                         }
-#if KVR_DEBUG
-                        ok &= ctx.read_map_end (static_cast<kvr::sz_t>(msz));
-#endif
+                        ok = ok && ctx.read_map_end (static_cast<kvr::sz_t>(msz));
                     }
                     return ok;
                 }
@@ -1184,11 +1444,11 @@ namespace kvr
                 {
                     uint32_t slen = kvr_bigendian32 (len);
                     const char *str = (const char *) is->push (slen);
-                    return str ? ctx.read_key (str, static_cast<kvr::sz_t>(slen)) : false;
+                    return str ? ctx.read_string (str, static_cast<kvr::sz_t>(slen)) : false;
                 }
                 return false;
             }
-#if KVR_CBOR_READ_KEY_SPECIALIZATION
+            
             template<>
             bool reader<kvr::mem_istream>::parse_key5 (kvr::mem_istream *is, read_ctx &ctx, uint8_t data)
             {
@@ -1234,7 +1494,6 @@ namespace kvr
                 }
                 return false;
             }
-#endif
             /////////////////////////////////////////////////////////////////////////////////////////////
             /////////////////////////////////////////////////////////////////////////////////////////////
             /////////////////////////////////////////////////////////////////////////////////////////////
@@ -1500,6 +1759,48 @@ namespace kvr
                 
                 ////////////////////////////////////////////////////////////
                 
+                bool write_typed_array (uint8_t tag, const void *data, size_t size)
+                {
+                    m_os->put (CBOR_MAJOR_TYPE_6 | CBOR_VALUE_TYPE_UINT8);
+                    m_os->put (tag);
+                    
+                    if (size < CBOR_VALUE_TYPE_UINT8)
+                    {
+                        uint8_t len = (uint8_t) size;
+                        m_os->put (CBOR_MAJOR_TYPE_2 | len);
+                    }
+                    else if (size <= 0xff)
+                    {
+                        uint8_t len = (uint8_t) size;
+                        m_os->put (CBOR_MAJOR_TYPE_2 | CBOR_VALUE_TYPE_UINT8);
+                        m_os->put (len);
+                    }
+                    else if (size <= 0xffff)
+                    {
+                        uint16_t len = kvr_bigendian16 (size);
+                        m_os->put (CBOR_MAJOR_TYPE_2 | CBOR_VALUE_TYPE_UINT16);
+                        m_os->write ((uint8_t *) &len, 2);
+                    }
+                    else if (size <= 0xffffffff)
+                    {
+                        uint32_t len = kvr_bigendian32 (size);
+                        m_os->put (CBOR_MAJOR_TYPE_2 | CBOR_VALUE_TYPE_UINT32);
+                        m_os->write ((uint8_t *) &len, 4);
+                    }
+                    else
+                    {
+                        uint64_t len = kvr_bigendian64 (size);
+                        m_os->put (CBOR_MAJOR_TYPE_2 | CBOR_VALUE_TYPE_UINT64);
+                        m_os->write ((uint8_t *) &len, 8);
+                    }
+                    
+                    m_os->write ((uint8_t *) data, size);
+                    
+                    return true;
+                }
+                
+                ////////////////////////////////////////////////////////////
+                
                 ostr *m_os;
             };
             
@@ -1520,7 +1821,7 @@ namespace kvr
                     {
                         kvr::sz_t msz = val->size ();
                         bool ok = ctx.write_map (msz);
-                        kvr::value::cursor c (val);
+                        kvr::value::cursor c = kvr::internal::view::cursor (val);
                         kvr::pair p;
                         while (ok && c.get (&p))
                         {
@@ -1536,13 +1837,37 @@ namespace kvr
                     else if (val->is_array ())
                     {
                         kvr::sz_t alen = val->length ();
-                        bool ok = ctx.write_array (alen);
-                        for (kvr::sz_t i = 0; (i < alen) && ok; ++i)
+                        const int64_t *pi = val->packed_integers ();
+                        const double *pf = val->packed_floats ();
+                        const bool *pb = val->packed_booleans ();
+                        
+                        if (pi)
                         {
-                            kvr::value *v = val->element (i);
-                            ok &= print (v, ctx);
+                            success = ctx.write_typed_array (CBOR_TAG_TYPED_ARRAY_SINT64, pi, alen * sizeof (int64_t));
+                        }
+                        else if (pf)
+                        {
+                            success = ctx.write_typed_array (CBOR_TAG_TYPED_ARRAY_FLOAT64, pf, alen * sizeof (double));
+                        }
+                        else
+                        {
+                            bool ok = ctx.write_array (alen);
+                            
+                            if (pb)
+                            {
+                                for (kvr::sz_t i = 0; (i < alen) && ok; ++i) { ok &= ctx.write_boolean (pb [i]); }
+                            }
+                            else
+                            {
+                                for (kvr::sz_t i = 0; (i < alen) && ok; ++i)
+                                {
+                                    kvr::value *v = kvr::internal::view::element (val, i);
+                                    ok &= print (v, ctx);
+                                }
+                            }
+                            
+                            success = ok;
                         }
-                        success = ok;
                     }
                     
                     else if (val->is_string ())
@@ -1583,13 +1908,14 @@ namespace kvr
             /////////////////////////////////////////////////////////////////////////////////////////////
             /////////////////////////////////////////////////////////////////////////////////////////////
             
-            bool read (kvr::value *dest, kvr::istream &istr)
+            bool read (kvr::value *dest, kvr::istream &istr, bool pack = false)
             {
                 KVR_ASSERT (dest);
                 
-                reader<kvr::istream> reader;
-                read_ctx ctx (dest);
-                return reader.parse (&istr, ctx);
+                kvr::internal::istream_block bis (&istr);
+                reader<kvr::internal::istream_block> reader;
+                read_ctx ctx (dest, false, pack);
+                return reader.parse (&bis, ctx);
             }
             
             ////////////////////////////////////////////////////////////
@@ -1599,12 +1925,13 @@ namespace kvr
                 KVR_ASSERT (src);
                 KVR_ASSERT (ostr);
                 
-                write_ctx<kvr::ostream> ctx (ostr);
-                writer<kvr::ostream> wrt;
+                kvr::internal::ostream_block bos (ostr);
+                write_ctx<kvr::internal::ostream_block> ctx (&bos);
+                writer<kvr::internal::ostream_block> wrt;
                 
                 if (wrt.print (src, ctx))
                 {
-                    ostr->flush ();
+                    bos.flush ();
                     return true;
                 }
                 
@@ -1613,12 +1940,12 @@ namespace kvr
             
             ////////////////////////////////////////////////////////////
             
-            bool read (kvr::value *dest, kvr::mem_istream &istr)
+            bool read (kvr::value *dest, kvr::mem_istream &istr, bool borrow = false, bool pack = false, bool insitu = false)
             {
                 KVR_ASSERT (dest);
                 
                 reader<kvr::mem_istream> reader;
-                read_ctx ctx (dest);
+                read_ctx ctx (dest, borrow, pack, insitu);
                 return reader.parse (&istr, ctx);
             }
             
@@ -1668,7 +1995,7 @@ namespace kvr
                         size += 5;
                     }
                     
-                    kvr::value::cursor c (val);
+                    kvr::value::cursor c = kvr::internal::view::cursor (val);
                     kvr::pair p;
                     while (c.get (&p))
                     {
@@ -1719,10 +2046,24 @@ namespace kvr
                         size += 5;
                     }
                     
-                    for (kvr::sz_t i = 0, c = val->length (); i < c; ++i)
+                    const int64_t *pi = val->packed_integers ();
+                    const double *pf = val->packed_floats ();
+                    
+                    if (pi || pf)
                     {
-                        kvr::value *v = val->element (i);
-                        size += write_approx_size (v);
+                        size += 2 + 9 + (size_t) alen * 8; // tag + byte string header + payload
+                    }
+                    else if (val->is_packed ())
+                    {
+                        size += alen; // booleans
+                    }
+                    else
+                    {
+                        for (kvr::sz_t i = 0, c = val->length (); i < c; ++i)
+                        {
+                            kvr::value *v = kvr::internal::view::element (val, i);
+                            size += write_approx_size (v);
+                        }
                     }
                 }
                 
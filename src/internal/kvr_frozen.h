@@ -0,0 +1,388 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Copyright (c) 2015 Ubaka Onyechi
+ *
+ * kvr is free software distributed under the MIT license.
+ * See https://raw.githubusercontent.com/uonyx/kvr/master/LICENSE for details.
+ */
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef KVR_FROZEN_H
+#define KVR_FROZEN_H
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace kvr
+{
+    namespace internal
+    {
+        namespace frozen
+        {
+            /////////////////////////////////////////////////////////////////////////////////////////////
+            /////////////////////////////////////////////////////////////////////////////////////////////
+            /////////////////////////////////////////////////////////////////////////////////////////////
+
+            // block layout: root node | element and member blocks (depth-first) | keys | strings.
+            // every offset runs forward from the node holding it, so the block is position
+            // independent and needs no fix-ups when it is read
+
+            /////////////////////////////////////////////////////////////////////////////////////////////
+            /////////////////////////////////////////////////////////////////////////////////////////////
+            /////////////////////////////////////////////////////////////////////////////////////////////
+
+            struct build_ctx
+            {
+                typedef kvr::frozen_doc::node node;
+                typedef kvr::frozen_doc::node::mkey mkey;
+                typedef kvr::frozen_doc::node::islot islot;
+
+                struct slot // distinct keys (by handle) and their place in the key pool
+                {
+                    const kvr::key *  k;
+                    uint32_t          off;
+                };
+
+                ////////////////////////////////////////////////////////////
+
+                build_ctx (kvr::frozen_doc *doc) : m_slots (NULL), m_cap (0), m_count (0), m_nodesz (0), m_keysz (0),
+                    m_strsz (0), m_next (NULL), m_keys (NULL), m_strs (NULL), m_doc (doc), m_alloc (doc->m_alloc)
+                {
+                }
+
+                ////////////////////////////////////////////////////////////
+
+                ~build_ctx ()
+                {
+                    if (m_slots)
+                    {
+                        m_alloc->deallocate (m_slots, sizeof (slot) * m_cap);
+                    }
+                }
+
+                ////////////////////////////////////////////////////////////
+
+                static size_t map_size (sz_t count)
+                {
+                    return ((sizeof (node) + sizeof (mkey)) * count) + (sizeof (islot) * node::_index_size (count));
+                }
+
+                ////////////////////////////////////////////////////////////
+
+                static uint32_t offset (const node *n, const void *p)
+                {
+                    KVR_ASSERT ((const uint8_t *) p >= (const uint8_t *) n);
+                    return static_cast<uint32_t>((const uint8_t *) p - (const uint8_t *) n);
+                }
+
+                ////////////////////////////////////////////////////////////
+
+                slot * find_slot (slot *slots, size_t cap, const kvr::key *k) const
+                {
+                    size_t mask = cap - 1;
+                    size_t i = (((size_t) k) >> 3) * 2654435761u;
+
+                    for (i &= mask; slots [i].k && (slots [i].k != k); i = (i + 1) & mask)
+                    {
+                    }
+
+                    return &slots [i];
+                }
+
+                ////////////////////////////////////////////////////////////
+
+                void add_key (const kvr::key *k)
+                {
+                    if (((m_count + 1) * 2) > m_cap)
+                    {
+                        size_t cap = (m_cap > 0) ? (m_cap * 2) : 64u;
+                        slot *slots = (slot *) m_alloc->allocate (sizeof (slot) * cap); KVR_ASSERT (slots);
+                        memset (slots, 0, sizeof (slot) * cap);
+
+                        for (size_t i = 0; i < m_cap; ++i)
+                        {
+                            if (m_slots [i].k)
+                            {
+                                *this->find_slot (slots, cap, m_slots [i].k) = m_slots [i];
+                            }
+                        }
+
+                        if (m_slots)
+                        {
+                            m_alloc->deallocate (m_slots, sizeof (slot) * m_cap);
+                        }
+
+                        m_slots = slots;
+                        m_cap = cap;
+                    }
+
+                    slot *s = this->find_slot (m_slots, m_cap, k);
+                    if (!s->k)
+                    {
+                        s->k = k;
+                        s->off = static_cast<uint32_t>(m_keysz);
+                        m_keysz += k->get_length () + 1;
+                        ++m_count;
+                    }
+                }
+
+                ////////////////////////////////////////////////////////////
+
+                void measure (const kvr::value *val)
+                {
+                    if (val->is_map ())
+                    {
+                        m_nodesz += map_size (val->size ());
+
+                        kvr::value::cursor c = kvr::internal::view::cursor (val);
+                        kvr::pair p;
+                        while (c.get (&p))
+                        {
+                            this->add_key (p.get_key ());
+                            this->measure (p.get_value ());
+                        }
+                    }
+                    else if (val->is_array ())
+                    {
+                        sz_t len = val->length ();
+                        m_nodesz += sizeof (node) * len;
+
+                        if (!val->is_packed ())
+                        {
+                            for (sz_t i = 0; i < len; ++i)
+                            {
+                                this->measure (kvr::internal::view::element (val, i));
+                            }
+                        }
+                    }
+                    else if (val->is_string ())
+                    {
+                        sz_t len = 0;
+                        val->get_string (&len);
+                        if (len >= sizeof (node::data))
+                        {
+                            m_strsz += len + 1;
+                        }
+                    }
+                }
+
+                ////////////////////////////////////////////////////////////
+
+                void index_keys (const node *map, const mkey *keys, islot *index, sz_t count) const
+                {
+                    uint32_t isz = node::_index_size (count);
+                    if (isz == 0)
+                    {
+                        return;
+                    }
+
+                    memset (index, 0, sizeof (islot) * isz);
+
+                    for (sz_t i = 0; i < count; ++i)
+                    {
+                        uint32_t h = kvr::internal::hash ((const char *) map + keys [i].off, keys [i].len);
+                        uint32_t s = h & (isz - 1);
+                        while (index [s].idx)
+                        {
+                            s = (s + 1) & (isz - 1);
+                        }
+                        index [s].hash = h;
+                        index [s].idx = i + 1;
+                    }
+                }
+
+                ////////////////////////////////////////////////////////////
+
+                void write_packed (node *elems, const kvr::value *arr, sz_t len)
+                {
+                    const int64_t *pi = arr->packed_integers ();
+                    const double *pf = arr->packed_floats ();
+                    const bool *pb = arr->packed_booleans ();
+
+                    for (sz_t i = 0; i < len; ++i)
+                    {
+                        node *e = &elems [i];
+                        memset ((void *) e, 0, sizeof (node));
+
+                        if (pi)
+                        {
+                            e->m_type = node::TYPE_INTEGER;
+                            e->m_data.i = pi [i];
+                        }
+                        else if (pf)
+                        {
+                            e->m_type = node::TYPE_FLOAT;
+                            e->m_data.f = pf [i];
+                        }
+                        else
+                        {
+                            KVR_ASSERT (pb);
+                            e->m_type = node::TYPE_BOOLEAN;
+                            e->m_data.b = pb [i];
+                        }
+                    }
+                }
+
+                ////////////////////////////////////////////////////////////
+
+                void write (node *n, const kvr::value *val)
+                {
+                    memset ((void *) n, 0, sizeof (node));
+
+                    if (val->is_map ())
+                    {
+                        sz_t count = val->size ();
+                        node *members = reinterpret_cast<node *>(m_next);
+                        mkey *keys = reinterpret_cast<mkey *>(members + count);
+                        islot *index = reinterpret_cast<islot *>(keys + count);
+                        m_next += map_size (count);
+
+                        n->m_type = node::TYPE_MAP;
+                        n->m_len = count;
+                        n->m_data.off = offset (n, members);
+
+                        kvr::value::cursor c = kvr::internal::view::cursor (val);
+                        kvr::pair p;
+                        sz_t i = 0;
+                        while (c.get (&p))
+                        {
+                            const kvr::key *k = p.get_key ();
+                            const slot *s = this->find_slot (m_slots, m_cap, k); KVR_ASSERT (s->k == k);
+                            keys [i].off = offset (n, m_keys + s->off);
+                            keys [i].len = k->get_length ();
+                            this->write (&members [i], p.get_value ());
+                            ++i;
+                        }
+                        KVR_ASSERT (i == count);
+
+                        this->index_keys (n, keys, index, count);
+                    }
+                    else if (val->is_array ())
+                    {
+                        sz_t len = val->length ();
+                        node *elems = reinterpret_cast<node *>(m_next);
+                        m_next += sizeof (node) * len;
+
+                        n->m_type = node::TYPE_ARRAY;
+                        n->m_len = len;
+                        n->m_data.off = offset (n, elems);
+
+                        if (val->is_packed ())
+                        {
+                            this->write_packed (elems, val, len);
+                        }
+                        else
+                        {
+                            for (sz_t i = 0; i < len; ++i)
+                            {
+                                this->write (&elems [i], kvr::internal::view::element (val, i));
+                            }
+                        }
+                    }
+                    else if (val->is_string ())
+                    {
+                        sz_t len = 0;
+                        const char *str = val->get_string (&len);
+                        char *dst = n->m_data.s;
+
+                        if (len >= sizeof (node::data))
+                        {
+                            dst = m_strs;
+                            m_strs += len + 1;
+                            n->m_data.off = offset (n, dst);
+                        }
+
+                        memcpy (dst, str, len);
+                        dst [len] = 0;
+                        n->m_type = node::TYPE_STRING;
+                        n->m_len = len;
+                    }
+                    else if (val->is_integer ())
+                    {
+                        n->m_type = node::TYPE_INTEGER;
+                        n->m_data.i = val->get_integer ();
+                    }
+                    else if (val->is_float ())
+                    {
+                        n->m_type = node::TYPE_FLOAT;
+                        n->m_data.f = val->get_float ();
+                    }
+                    else if (val->is_boolean ())
+                    {
+                        n->m_type = node::TYPE_BOOLEAN;
+                        n->m_data.b = val->get_boolean ();
+                    }
+                    else
+                    {
+                        n->m_type = node::TYPE_NULL;
+                    }
+                }
+
+                ////////////////////////////////////////////////////////////
+
+                bool build (const kvr::value *val)
+                {
+                    this->measure (val);
+
+                    size_t size = sizeof (node) + m_nodesz + m_keysz + m_strsz;
+                    KVR_ASSERT_SAFE ((size <= 0xffffffffu) && "frozen block offsets are 32-bit", false);
+
+                    uint8_t *block = (uint8_t *) m_alloc->allocate (size); KVR_ASSERT_SAFE (block, false);
+
+                    m_next = block + sizeof (node);
+                    m_keys = (char *) m_next + m_nodesz;
+                    m_strs = m_keys + m_keysz;
+
+                    for (size_t i = 0; i < m_cap; ++i)
+                    {
+                        const slot &s = m_slots [i];
+                        if (s.k)
+                        {
+                            memcpy (m_keys + s.off, s.k->get_string (), s.k->get_length () + 1);
+                        }
+                    }
+
+                    this->write (reinterpret_cast<node *>(block), val);
+                    KVR_ASSERT (m_next == (block + sizeof (node) + m_nodesz));
+                    KVR_ASSERT (m_strs == (char *) (block + size));
+
+                    m_doc->_release ();
+                    m_doc->m_block = block;
+                    m_doc->m_size = size;
+                    return true;
+                }
+
+                ////////////////////////////////////////////////////////////
+
+                slot *            m_slots;
+                size_t            m_cap;
+                size_t            m_count;
+                size_t            m_nodesz;
+                size_t            m_keysz;
+                size_t            m_strsz;
+                uint8_t *         m_next;
+                char *            m_keys;
+                char *            m_strs;
+                kvr::frozen_doc * m_doc;
+                kvr::allocator *  m_alloc;
+            };
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,108 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Copyright (c) 2015 Ubaka Onyechi
+ *
+ * kvr is free software distributed under the MIT license.
+ * See https://raw.githubusercontent.com/uonyx/kvr/master/LICENSE for details.
+ */
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef KVR_HASH_H
+#define KVR_HASH_H
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "../kvr.h"
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace kvr
+{
+    namespace internal
+    {
+        //////////////////////////////////////////////////////////////////////////
+        //////////////////////////////////////////////////////////////////////////
+        //////////////////////////////////////////////////////////////////////////
+        
+        inline uint32_t djb_hash (const char *str, uint32_t seed = 5381) // djbx33x
+        {
+            uint32_t hash = seed;
+            char c;
+            while ((c = *str++) != 0)
+            {
+                hash = ((hash << 5) + hash) ^ c;
+            }
+            return hash;
+        }
+        
+        //////////////////////////////////////////////////////////////////////////
+        //////////////////////////////////////////////////////////////////////////
+        //////////////////////////////////////////////////////////////////////////
+        
+        inline uint32_t hash (const char *str, size_t len, uint32_t seed = 5381) // murmur64a
+        {
+            // consumes 8 bytes per step; byte order of the words follows the host,
+            // which is fine as hashes are never persisted
+            
+            const uint64_t m = 0xc6a4a7935bd1e995ULL;
+            const int r = 47;
+            
+            uint64_t h = seed ^ (len * m);
+            
+            const char *p = str;
+            const char *end = str + (len & ~((size_t) 7));
+            
+            while (p != end)
+            {
+                uint64_t k;
+                memcpy (&k, p, 8);
+                p += 8;
+                
+                k *= m;
+                k ^= k >> r;
+                k *= m;
+                
+                h ^= k;
+                h *= m;
+            }
+            
+            size_t rem = len & 7;
+            if (rem)
+            {
+                uint64_t k = 0;
+                for (size_t i = rem; i > 0; --i)
+                {
+                    k = (k << 8) | static_cast<uint8_t>(p [i - 1]);
+                }
+                h ^= k;
+                h *= m;
+            }
+            
+            h ^= h >> r;
+            h *= m;
+            h ^= h >> r;
+            
+            return static_cast<uint32_t>(h ^ (h >> 32));
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////
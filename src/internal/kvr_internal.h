@@ -23,6 +23,7 @@
 #include <cstdio>
 #include <cmath>
 #include <limits>
+#include <new>
 #if KVR_CPP11
 #include <random>
 #else
@@ -30,6 +31,7 @@
 #endif
 
 #include "../kvr.h"
+#include "kvr_hash.h"
 #include "rapidjson/internal/itoa.h"
 #include "rapidjson/internal/dtoa.h"
 
@@ -39,7 +41,6 @@
 
 #define KVR_INTERNAL_FLAG_DEBUG_CTX_KEY_STORE_RAND_OFF  (KVR_DEBUG && 0)
 #define KVR_INTERNAL_FLAG_REALLOC_TYPE_FIXED            0
-#define KVR_INTERNAL_FLAG_EXPERIMENTAL_FAST_MAP_SIZE    (KVR_DEBUG || 0) && KVR_INTERNAL_FLAG_REALLOC_TYPE_FIXED
 #define KVR_INTERNAL_FLAG_DEBUG_TYPE_PUNNING_ON         0 // TODO: check compiler?
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
@@ -61,6 +62,12 @@
 
 #define KVR_REF_UNUSED(X) (void)(X)
 
+#if defined (_MSC_VER)
+#include <intrin.h>
+#else
+#include <sched.h>
+#endif
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////////////////////////
@@ -195,6 +202,65 @@ namespace kvr
         //////////////////////////////////////////////////////////////////////////
         //////////////////////////////////////////////////////////////////////////
         
+        inline bool cas_ptr (void * volatile *dst, void *expected, void *desired)
+        {
+            // atomic compare-and-swap of a pointer (ctx registry lock)
+#if defined (_MSC_VER)
+            return (_InterlockedCompareExchangePointer (dst, desired, expected) == expected);
+#else
+            return __sync_bool_compare_and_swap (dst, expected, desired);
+#endif
+        }
+        
+        //////////////////////////////////////////////////////////////////////////
+        //////////////////////////////////////////////////////////////////////////
+        //////////////////////////////////////////////////////////////////////////
+        
+        inline void spin_lock (void * volatile *lock, void *owner)
+        {
+            // takes a cas_ptr lock: pause hints, doubling per failed attempt, then the
+            // thread yields (so a preempted owner gets to run)
+            for (uint32_t spins = 1; !cas_ptr (lock, NULL, owner); )
+            {
+                if (spins <= 64)
+                {
+                    for (uint32_t i = 0; i < spins; ++i)
+                    {
+#if defined (_MSC_VER)
+                        _mm_pause ();
+#elif defined (__i386__) || defined (__x86_64__)
+                        __builtin_ia32_pause ();
+#elif defined (__aarch64__) || defined (__arm__)
+                        __asm__ __volatile__ ("yield");
+#endif
+                    }
+                    spins += spins;
+                }
+                else
+                {
+#if defined (_MSC_VER)
+                    _mm_pause ();
+#else
+                    sched_yield ();
+#endif
+                }
+            }
+        }
+        
+        //////////////////////////////////////////////////////////////////////////
+        //////////////////////////////////////////////////////////////////////////
+        //////////////////////////////////////////////////////////////////////////
+        
+        inline void spin_unlock (void * volatile *lock, void *owner)
+        {
+            bool ok = cas_ptr (lock, owner, NULL); KVR_ASSERT (ok);
+            KVR_REF_UNUSED (ok);
+        }
+        
+        //////////////////////////////////////////////////////////////////////////
+        //////////////////////////////////////////////////////////////////////////
+        //////////////////////////////////////////////////////////////////////////
+        
         inline uint16_t byteswap16 (uint16_t val)
         {
             uint16_t swap = (uint16_t) ((val >> 8) | (val << 8));
@@ -235,23 +301,6 @@ namespace kvr
         //////////////////////////////////////////////////////////////////////////
         //////////////////////////////////////////////////////////////////////////
         
-        uint32_t djb_hash (const char *str, uint32_t seed = 5381) // djbx33x
-        {
-            KVR_ASSERT (str);
-            
-            uint32_t hash = seed;
-            char c;
-            while ((c = *str++) != 0)
-            {
-                hash = ((hash << 5) + hash) ^ c;
-            }
-            return hash;
-        }
-        
-        //////////////////////////////////////////////////////////////////////////
-        //////////////////////////////////////////////////////////////////////////
-        //////////////////////////////////////////////////////////////////////////
-        
         template<typename T>
         inline const T& min (const T& a, const T& b)
         {
@@ -283,6 +332,20 @@ namespace kvr
         //////////////////////////////////////////////////////////////////////////
         //////////////////////////////////////////////////////////////////////////
         
+        inline sz_t pow2_size (sz_t s)
+        {
+            sz_t ps = 1;
+            while (ps < s)
+            {
+                ps <<= 1;
+            }
+            return ps;
+        }
+        
+        //////////////////////////////////////////////////////////////////////////
+        //////////////////////////////////////////////////////////////////////////
+        //////////////////////////////////////////////////////////////////////////
+        
         inline bool isnan (double f)
         {
 #if KVR_CPP11
@@ -393,6 +456,258 @@ namespace kvr
         //////////////////////////////////////////////////////////////////////////
         //////////////////////////////////////////////////////////////////////////
         //////////////////////////////////////////////////////////////////////////
+        
+        struct view
+        {
+            // read-only traversal (encoders, lookups): leaves snapshot maps and arrays shared
+            
+            static kvr::value::cursor cursor (const kvr::value *map)
+            {
+                return kvr::value::cursor (map);
+            }
+            
+            static kvr::value *element (const kvr::value *arr, kvr::sz_t index)
+            {
+                return arr->_peek (index);
+            }
+        };
+        
+        //////////////////////////////////////////////////////////////////////////
+        //////////////////////////////////////////////////////////////////////////
+        //////////////////////////////////////////////////////////////////////////
+        
+        class istream_block
+        {
+            // block buffer between a custom istream and the decoders: bytes are taken inline
+            // from the block, which is refilled with istream::read_some. what is left of it
+            // goes back with istream::unread once decoding ends, so the stream stays at the end
+            // of the value. long reads skip the block, and a stream without bulk reads or
+            // unread (read_some gives nothing at first) is read directly
+            
+        public:
+            
+            static const size_t BLOCK_SZ = KVR_CONSTANT_ISTREAM_BLOCK_SZ;
+            
+            istream_block (kvr::istream *src) : m_src (src), m_cur (m_buf), m_end (m_buf), m_base (0), m_probed (false), m_direct (false)
+            {
+                KVR_ASSERT (src);
+            }
+            
+            ~istream_block ()
+            {
+                if (m_cur < m_end)
+                {
+                    bool ok = m_src->unread ((size_t) (m_end - m_cur)); KVR_ASSERT (ok);
+                    KVR_REF_UNUSED (ok);
+                }
+            }
+            
+            bool get (uint8_t *byte)
+            {
+                if (m_cur < m_end)
+                {
+                    *byte = *m_cur++;
+                    return true;
+                }
+                return this->get_slow (byte);
+            }
+            
+            uint8_t peek ()
+            {
+                return (m_cur < m_end) ? *m_cur : this->peek_slow ();
+            }
+            
+            bool read (uint8_t *bytes, size_t count)
+            {
+                if (count <= (size_t) (m_end - m_cur))
+                {
+                    memcpy (bytes, m_cur, count);
+                    m_cur += count;
+                    return true;
+                }
+                return this->read_slow (bytes, count);
+            }
+            
+            size_t tell ()
+            {
+                return m_direct ? m_src->tell () : (m_base + (size_t) (m_cur - m_buf));
+            }
+            
+            bool buffered ()
+            {
+                if (!m_probed)
+                {
+                    this->refill ();
+                }
+                return !m_direct;
+            }
+            
+        private:
+            
+            bool refill ()
+            {
+                if (m_direct)
+                {
+                    return false;
+                }
+                
+                m_base += (size_t) (m_end - m_buf);
+                size_t n = (m_probed || m_src->unread (0)) ? m_src->read_some (m_buf, BLOCK_SZ) : 0u;
+                KVR_ASSERT (n <= BLOCK_SZ);
+                m_cur = m_buf;
+                m_end = m_buf + n;
+                m_direct = !m_probed && (n == 0);
+                m_probed = true;
+                return (n > 0);
+            }
+            
+            bool get_slow (uint8_t *byte)
+            {
+                if (this->refill ())
+                {
+                    *byte = *m_cur++;
+                    return true;
+                }
+                return m_direct && m_src->get (byte);
+            }
+            
+            uint8_t peek_slow ()
+            {
+                if (this->refill ())
+                {
+                    return *m_cur;
+                }
+                return m_direct ? m_src->peek () : 0u;
+            }
+            
+            bool read_slow (uint8_t *bytes, size_t count)
+            {
+                size_t avail = (size_t) (m_end - m_cur);
+                memcpy (bytes, m_cur, avail);
+                m_cur += avail;
+                bytes += avail;
+                count -= avail;
+                
+                while (count > 0)
+                {
+                    if ((count < BLOCK_SZ) && this->refill ())
+                    {
+                        size_t n = kvr::internal::min (count, (size_t) (m_end - m_cur));
+                        memcpy (bytes, m_cur, n);
+                        m_cur += n;
+                        bytes += n;
+                        count -= n;
+                    }
+                    else if ((count < BLOCK_SZ) && !m_direct)
+                    {
+                        return false;
+                    }
+                    else
+                    {
+                        // straight into the destination (exact, no read ahead)
+                        m_base += count;
+                        return m_src->read (bytes, count);
+                    }
+                }
+                return true;
+            }
+            
+            istream_block (const istream_block &);
+            istream_block &operator=(const istream_block &);
+            
+            kvr::istream *  m_src;
+            uint8_t *       m_cur;
+            uint8_t *       m_end;
+            size_t          m_base;
+            bool            m_probed;
+            bool            m_direct;
+            uint8_t         m_buf [BLOCK_SZ];
+        };
+        
+        //////////////////////////////////////////////////////////////////////////
+        //////////////////////////////////////////////////////////////////////////
+        //////////////////////////////////////////////////////////////////////////
+        
+        class ostream_block
+        {
+            // staging block between the encoders and a custom ostream: bytes are put inline
+            // into the block, which is handed over with ostream::write when full and on flush.
+            // long writes skip the block
+            
+        public:
+            
+            static const size_t BLOCK_SZ = KVR_CONSTANT_OSTREAM_BLOCK_SZ;
+            
+            ostream_block (kvr::ostream *dst) : m_dst (dst), m_cur (m_buf)
+            {
+                KVR_ASSERT (dst);
+            }
+            
+            void put (uint8_t byte)
+            {
+                if (m_cur == (m_buf + BLOCK_SZ))
+                {
+                    this->drain ();
+                }
+                *m_cur++ = byte;
+            }
+            
+            void write (uint8_t *bytes, size_t count)
+            {
+                if (count <= (size_t) ((m_buf + BLOCK_SZ) - m_cur))
+                {
+                    memcpy (m_cur, bytes, count);
+                    m_cur += count;
+                }
+                else
+                {
+                    this->write_slow (bytes, count);
+                }
+            }
+            
+            void flush ()
+            {
+                this->drain ();
+                m_dst->flush ();
+            }
+            
+        private:
+            
+            void drain ()
+            {
+                if (m_cur > m_buf)
+                {
+                    m_dst->write (m_buf, (size_t) (m_cur - m_buf));
+                    m_cur = m_buf;
+                }
+            }
+            
+            void write_slow (uint8_t *bytes, size_t count)
+            {
+                this->drain ();
+                
+                if (count < (BLOCK_SZ / 2))
+                {
+                    memcpy (m_cur, bytes, count);
+                    m_cur += count;
+                }
+                else
+                {
+                    m_dst->write (bytes, count);
+                }
+            }
+            
+            ostream_block (const ostream_block &);
+            ostream_block &operator=(const ostream_block &);
+            
+            kvr::ostream *  m_dst;
+            uint8_t *       m_cur;
+            uint8_t         m_buf [BLOCK_SZ];
+        };
+        
+        //////////////////////////////////////////////////////////////////////////
+        //////////////////////////////////////////////////////////////////////////
+        //////////////////////////////////////////////////////////////////////////
     }
 }
 
@@ -415,8 +730,10 @@ namespace kvr
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 
 #include "kvr_json.h"
+#include "kvr_json_index.h"
 #include "kvr_msgpack.h"
 #include "kvr_cbor.h"
+#include "kvr_frozen.h"
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////////////////////////
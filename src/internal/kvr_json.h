@@ -32,33 +32,98 @@ namespace kvr
     {
         namespace json
         {
-            // optimized output memory stream interface wrapper
+            // output memory stream sink: the writer fills a region pushed onto the stream (at
+            // first all of its free capacity, e.g. as sized by encode_bound) and the unused
+            // tail is popped off when done or when a larger region is needed
             struct ostream_memory
             {
                 ostream_memory (kvr::mem_ostream *mem_ostream) : m_stream (mem_ostream) {}
-                void  Put (char ch) { m_stream->put (ch); }
-                char *Push (size_t count) { return (char *) m_stream->push (count); }
-                char *Pop (size_t count) { return (char *) m_stream->pop (count); }
-                void  Flush () { m_stream->flush (); }
+                
+                void refill (char **cur, char **end, size_t count)
+                {
+                    m_stream->pop ((size_t) (*end - *cur));
+                    size_t avail = m_stream->size () - m_stream->tell ();
+                    size_t sz = (avail > count) ? (avail - 1) : kvr::internal::max (count, m_stream->size ()); // - 1 for flush
+                    *cur = (char *) m_stream->push (sz);
+                    *end = *cur + sz;
+                }
+                
+                void write (char **cur, char **end, const char *str, size_t count)
+                {
+                    this->refill (cur, end, count);
+                    memcpy (*cur, str, count);
+                    *cur += count;
+                }
+                
+                void finish (char *cur, char *end, bool flush)
+                {
+                    m_stream->pop ((size_t) (end - cur));
+                    if (flush)
+                    {
+                        m_stream->push (1); // room for the terminator
+                        m_stream->pop (1);
+                        m_stream->flush ();
+                    }
+                }
                 
                 kvr::mem_ostream *m_stream;
             };
             
-            // custom output stream interface wrapper
+            // custom output stream sink: output is staged in a block and handed over with write
+            // (as kvr::internal::ostream_block does for the other codecs, but filled in place)
             struct ostream_custom
             {
-                ostream_custom (kvr::ostream *mem_ostream) : m_stream (mem_ostream) {}
-                void Put (char ch) { m_stream->put (ch); }
-                void Flush () { m_stream->flush (); }
+                static const size_t BLOCK_SIZE = KVR_CONSTANT_OSTREAM_BLOCK_SZ;
+                
+                ostream_custom (kvr::ostream *ostream) : m_stream (ostream) {}
+                
+                void drain (char *cur)
+                {
+                    if (cur > m_block) { m_stream->write ((uint8_t *) m_block, (size_t) (cur - m_block)); }
+                }
+                
+                void refill (char **cur, char **end, size_t count)
+                {
+                    KVR_ASSERT (count <= BLOCK_SIZE); KVR_REF_UNUSED (count);
+                    this->drain (*cur);
+                    *cur = m_block;
+                    *end = m_block + BLOCK_SIZE;
+                }
+                
+                void write (char **cur, char **end, const char *str, size_t count)
+                {
+                    if (count < (BLOCK_SIZE / 2))
+                    {
+                        this->refill (cur, end, count);
+                        memcpy (*cur, str, count);
+                        *cur += count;
+                    }
+                    else
+                    {
+                        // long runs skip the block
+                        this->drain (*cur);
+                        m_stream->write ((uint8_t *) str, count);
+                        *cur = m_block;
+                        *end = m_block + BLOCK_SIZE;
+                    }
+                }
+                
+                void finish (char *cur, char *, bool flush)
+                {
+                    this->drain (cur);
+                    if (flush) { m_stream->flush (); }
+                }
                 
                 kvr::ostream *m_stream;
+                char          m_block [BLOCK_SIZE];
             };
             
-            // custom input stream interface wrapper
+            // custom input stream interface wrapper (over the stream or its istream_block)
+            template<typename istr>
             struct istream_custom
             {
                 typedef char Ch;
-                istream_custom (kvr::istream *mem_istream) : m_stream (mem_istream) {}
+                istream_custom (istr *istream) : m_stream (istream) {}
                 char    Peek () { return (char) m_stream->peek (); }
                 char    Take () { uint8_t byte = 0;  m_stream->get (&byte); return (char) byte; }
                 size_t  Tell () { return m_stream->tell (); }
@@ -66,7 +131,44 @@ namespace kvr
                 size_t  PutEnd (char *) { return 0u; }
                 void    Put (char) { KVR_ASSERT (false); } // ?!
                 
-                kvr::istream *m_stream;
+                istr *m_stream;
+            };
+            
+            // bounded input memory stream wrapper (reads '\0' past the end, so the buffer
+            // can be a slice of a larger one and needs no terminator)
+            struct istream_memory
+            {
+                typedef char Ch;
+                istream_memory (const char *buf, size_t sz) : m_src (buf), m_head (buf), m_end (buf + sz) {}
+                char    Peek () const { return (m_src < m_end) ? *m_src : '\0'; }
+                char    Take () { return (m_src < m_end) ? *m_src++ : '\0'; }
+                size_t  Tell () const { return (size_t) (m_src - m_head); }
+                char *  PutBegin () { KVR_ASSERT (false); return NULL; }
+                size_t  PutEnd (char *) { KVR_ASSERT (false); return 0u; }
+                void    Put (char) { KVR_ASSERT (false); }
+                
+                const char *m_src;
+                const char *m_head;
+                const char *m_end;
+            };
+            
+            // bounded insitu memory stream wrapper (strings are unescaped over their own
+            // source text, which is never shorter, and null-terminated on the closing quote)
+            struct istream_insitu
+            {
+                typedef char Ch;
+                istream_insitu (char *buf, size_t sz) : m_src (buf), m_dst (NULL), m_head (buf), m_end (buf + sz) {}
+                char    Peek () const { return (m_src < m_end) ? *m_src : '\0'; }
+                char    Take () { return (m_src < m_end) ? *m_src++ : '\0'; }
+                size_t  Tell () const { return (size_t) (m_src - m_head); }
+                char *  PutBegin () { return m_dst = m_src; }
+                size_t  PutEnd (char *begin) { return (size_t) (m_dst - begin); }
+                void    Put (char c) { KVR_ASSERT (m_dst && (m_dst < m_src)); *m_dst++ = c; }
+                
+                char *m_src;
+                char *m_dst;
+                char *m_head;
+                char *m_end;
             };
         }
     }
@@ -77,9 +179,15 @@ namespace kvr
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 
 #include "rapidjson/reader.h"
-#include "rapidjson/writer.h"
 #include "rapidjson/error/en.h"
 
+#if defined (__SSE2__) || defined (_M_X64) || (defined (_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define KVR_JSON_SSE2 1
+#include <emmintrin.h>
+#else
+#define KVR_JSON_SSE2 0
+#endif
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////////////////////////
@@ -118,7 +226,7 @@ namespace kvr
             {
                 ////////////////////////////////////////////////////////////
                 
-                read_ctx (kvr::value *value) : m_root (value), m_temp (NULL), m_depth (0)
+                read_ctx (kvr::value *value, bool borrow = false, bool pack = false) : m_root (value), m_temp (NULL), m_depth (0), m_borrow (borrow), m_pack (pack)
                 {
                     memset (m_stack, 0, sizeof (m_stack));
                 }
@@ -169,7 +277,14 @@ namespace kvr
                     }
                     else if (node->is_array ())
                     {
-                        node->push (b);
+                        if (m_pack)
+                        {
+                            node->push_n (&b, 1);
+                        }
+                        else
+                        {
+                            node->push (b);
+                        }
                     }
                     else
                     {
@@ -213,7 +328,14 @@ namespace kvr
                     }
                     else if (node->is_array ())
                     {
-                        node->push (i);
+                        if (m_pack)
+                        {
+                            node->push_n (&i, 1);
+                        }
+                        else
+                        {
+                            node->push (i);
+                        }
                     }
                     else
                     {
@@ -227,9 +349,14 @@ namespace kvr
                 
                 bool Uint64 (uint64_t u)
                 {
+                    // rapidjson reports every positive integer above 32 bits here
+                    const uint64_t imax = std::numeric_limits<int64_t>::max ();
+                    if (u <= imax)
+                    {
+                        return this->Int64 ((int64_t) u);
+                    }
                     KVR_ASSERT (m_depth != 0);
                     KVR_ASSERT (false && "not supported");
-                    KVR_REF_UNUSED (u);
                     return false;
                 }
                 
@@ -253,7 +380,14 @@ namespace kvr
                     }
                     else if (node->is_array ())
                     {
-                        node->push (d);
+                        if (m_pack)
+                        {
+                            node->push_n (&d, 1);
+                        }
+                        else
+                        {
+                            node->push (d);
+                        }
                     }
                     else
                     {
@@ -268,7 +402,9 @@ namespace kvr
                 bool String (const char *str, kvr_rapidjson::SizeType length, bool copy)
                 {
                     KVR_ASSERT_SAFE (m_depth != 0, false);
-                    KVR_REF_UNUSED (copy);
+                    
+                    // insitu strings (copy == false) live in the input buffer, terminated, and can be borrowed
+                    bool borrow = m_borrow && !copy;
                     
                     kvr::value *node = m_stack [m_depth - 1];
                     KVR_ASSERT (node);
@@ -280,7 +416,7 @@ namespace kvr
 #if KVR_FLAG_DISABLE_IMPLICIT_TYPE_CONVERSION
                         m_temp = m_temp->as_string ();
 #endif
-                        m_temp->set_string (str, (kvr::sz_t) length);
+                        if (borrow) { m_temp->_string_borrow (str, (kvr::sz_t) length, true); } else { m_temp->set_string (str, (kvr::sz_t) length); }
                         m_temp = NULL;
                     }
                     else if (node->is_array ())
@@ -289,7 +425,7 @@ namespace kvr
 #if KVR_FLAG_DISABLE_IMPLICIT_TYPE_CONVERSION
                         vstr = vstr->as_string ();
 #endif
-                        vstr->set_string (str, (kvr::sz_t) length);
+                        if (borrow) { vstr->_string_borrow (str, (kvr::sz_t) length, true); } else { vstr->set_string (str, (kvr::sz_t) length); }
                     }
                     else
                     {
@@ -339,11 +475,10 @@ namespace kvr
                     kvr::value *node = m_stack [m_depth - 1];
                     KVR_ASSERT_SAFE (node && node->is_map (), false);
                     
-                    KVR_REF_UNUSED (length);
                     KVR_REF_UNUSED (copy);
                     
                     KVR_ASSERT (!m_temp);
-                    m_temp = node->insert_null (str);
+                    m_temp = node->insert_null (str, static_cast<kvr::sz_t>(length));
                     return (m_temp != NULL);
                 }
                 
@@ -407,20 +542,213 @@ namespace kvr
                 
                 ////////////////////////////////////////////////////////////
                 
+                void reset ()
+                {
+                    // drops a partly built tree (see indexed::read_indexed)
+                    m_root->_conv_null ();
+                    m_temp = NULL;
+                    m_depth = 0;
+                    memset (m_stack, 0, sizeof (m_stack));
+                }
+                
+                ////////////////////////////////////////////////////////////
+                
                 kvr::value  * m_stack [KVR_CONSTANT_MAX_TREE_DEPTH];
                 kvr::value  * m_root;
                 kvr::value  * m_temp;
                 kvr::sz_t     m_depth;
+                bool          m_borrow;
+                bool          m_pack;   // numeric and boolean arrays are packed
             };
             
             /////////////////////////////////////////////////////////////////////////////////////////////
             /////////////////////////////////////////////////////////////////////////////////////////////
             /////////////////////////////////////////////////////////////////////////////////////////////
             
-            template<typename ostr>
+            inline uint64_t swar_zero (uint64_t v)
+            {
+                // 0x80 in every zero byte of v (exact, no carries between bytes)
+                const uint64_t lo7 = 0x7f7f7f7f7f7f7f7full;
+                return ~(((v & lo7) + lo7) | v | lo7);
+            }
+            
+            ////////////////////////////////////////////////////////////
+            
+            inline const char * scan_escape (const char *str, const char *end)
+            {
+                // first character that needs escaping (quote, backslash, below 0x20), or end
+#if KVR_JSON_SSE2
+                const __m128i quote = _mm_set1_epi8 ('"');
+                const __m128i bslash = _mm_set1_epi8 ('\\');
+                const __m128i ctrl = _mm_set1_epi8 (0x1f);
+                
+                for (; (end - str) >= 16; str += 16)
+                {
+                    __m128i v = _mm_loadu_si128 ((const __m128i *) str);
+                    __m128i e = _mm_or_si128 (_mm_or_si128 (_mm_cmpeq_epi8 (v, quote), _mm_cmpeq_epi8 (v, bslash)),
+                                              _mm_cmpeq_epi8 (_mm_max_epu8 (v, ctrl), ctrl));
+                    int mask = _mm_movemask_epi8 (e);
+                    if (mask)
+                    {
+#if defined (_MSC_VER)
+                        unsigned long i = 0;
+                        _BitScanForward (&i, (unsigned long) mask);
+                        return str + i;
+#else
+                        return str + __builtin_ctz ((unsigned) mask);
+#endif
+                    }
+                }
+#else
+                const uint64_t ones = 0x0101010101010101ull;
+                
+                for (; (end - str) >= 8; str += 8)
+                {
+                    uint64_t v = 0;
+                    memcpy (&v, str, 8);
+                    if (swar_zero (v ^ (ones * '"')) | swar_zero (v ^ (ones * '\\')) | swar_zero (v & (ones * 0xe0)))
+                    {
+                        break; // found below
+                    }
+                }
+#endif
+                for (; str < end; ++str)
+                {
+                    uint8_t c = (uint8_t) *str;
+                    if ((c < 0x20) || (c == '"') || (c == '\\'))
+                    {
+                        break;
+                    }
+                }
+                
+                return str;
+            }
+            
+            /////////////////////////////////////////////////////////////////////////////////////////////
+            /////////////////////////////////////////////////////////////////////////////////////////////
+            /////////////////////////////////////////////////////////////////////////////////////////////
+            
+            // compact json text, written into a window [m_cur, m_end) the sink refills. numbers
+            // are formatted as rapidjson does (same output as kvr_rapidjson::Writer)
+            template<typename sink>
             struct writer
             {
-                writer (ostr &os) : m_wrt (os) {}
+                writer (sink &s) : m_sink (s), m_cur (NULL), m_end (NULL) {}
+                
+                ////////////////////////////////////////////////////////////
+                
+                char * reserve (size_t count)
+                {
+                    if ((size_t) (m_end - m_cur) < count)
+                    {
+                        m_sink.refill (&m_cur, &m_end, count);
+                    }
+                    return m_cur;
+                }
+                
+                ////////////////////////////////////////////////////////////
+                
+                void put (char c)
+                {
+                    *this->reserve (1) = c;
+                    ++m_cur;
+                }
+                
+                ////////////////////////////////////////////////////////////
+                
+                void write (const char *str, size_t count)
+                {
+                    if ((size_t) (m_end - m_cur) >= count)
+                    {
+                        memcpy (m_cur, str, count);
+                        m_cur += count;
+                    }
+                    else
+                    {
+                        m_sink.write (&m_cur, &m_end, str, count);
+                    }
+                }
+                
+                ////////////////////////////////////////////////////////////
+                
+                void string (const char *str, size_t len)
+                {
+                    static const char hex [16] = { '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F' };
+                    static const char esc [32] = { 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'b', 't', 'n', 'u', 'f', 'r', 'u', 'u',
+                                                   'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u' };
+                    
+                    const char *end = str + len;
+                    this->put ('"');
+                    
+                    for (;;)
+                    {
+                        // clean runs are copied whole
+                        const char *e = scan_escape (str, end);
+                        this->write (str, (size_t) (e - str));
+                        if (e == end)
+                        {
+                            break;
+                        }
+                        
+                        uint8_t c = (uint8_t) *e;
+                        char *p = this->reserve (6);
+                        p [0] = '\\';
+                        if (c >= 0x20)
+                        {
+                            p [1] = (char) c; // quote or backslash
+                            m_cur += 2;
+                        }
+                        else if (esc [c] != 'u')
+                        {
+                            p [1] = esc [c];
+                            m_cur += 2;
+                        }
+                        else
+                        {
+                            p [1] = 'u';
+                            p [2] = '0';
+                            p [3] = '0';
+                            p [4] = hex [c >> 4];
+                            p [5] = hex [c & 15];
+                            m_cur += 6;
+                        }
+                        str = e + 1;
+                    }
+                    
+                    this->put ('"');
+                }
+                
+                ////////////////////////////////////////////////////////////
+                
+                void integer (int64_t n)
+                {
+                    m_cur = kvr_rapidjson::internal::i64toa (n, this->reserve (21));
+                }
+                
+                ////////////////////////////////////////////////////////////
+                
+                void floating (double n)
+                {
+                    m_cur = kvr_rapidjson::internal::dtoa (n, this->reserve (25));
+                }
+                
+                ////////////////////////////////////////////////////////////
+                
+                void boolean (bool b)
+                {
+                    if (b) { this->write ("true", 4); } else { this->write ("false", 5); }
+                }
+                
+                ////////////////////////////////////////////////////////////
+                
+                bool write_root (const kvr::value *val)
+                {
+                    bool success = this->print (val);
+                    m_sink.finish (m_cur, m_end, success && (val->is_map () || val->is_array ()));
+                    return success;
+                }
+                
+                ////////////////////////////////////////////////////////////
                 
                 bool print (const kvr::value *val)
                 {
@@ -430,77 +758,106 @@ namespace kvr
                     
                     if (val->is_map ())
                     {
-                        bool ok = m_wrt.StartObject ();
-                        kvr::value::cursor c (val);
+                        bool ok = true;
+                        kvr::value::cursor c = kvr::internal::view::cursor (val);
                         kvr::pair p;
-                        while (ok && c.get (&p))
+                        this->put ('{');
+                        for (bool first = true; ok && c.get (&p); first = false)
                         {
+                            if (!first) { this->put (','); }
                             kvr::key *k = p.get_key ();
-                            ok = m_wrt.Key (k->get_string (), k->get_length ());
+                            this->string (k->get_string (), k->get_length ());
+                            this->put (':');
                             
                             kvr::value *v = p.get_value ();
-                            ok = ok && print (v);
+                            ok = print (v);
                         }
-                        success = ok && m_wrt.EndObject ();
+                        if (ok) { this->put ('}'); }
+                        success = ok;
                     }
                     
                     else if (val->is_array ())
                     {
-                        bool ok = m_wrt.StartArray ();
-                        for (kvr::sz_t i = 0, c = val->length (); (i < c) && ok; ++i)
+                        bool ok = true;
+                        kvr::sz_t c = val->length ();
+                        this->put ('[');
+                        
+                        if (val->is_packed ())
                         {
-                            kvr::value *v = val->element (i);
-                            ok = print (v);
+                            const int64_t *pi = val->packed_integers ();
+                            const double *pf = val->packed_floats ();
+                            const bool *pb = val->packed_booleans ();
+                            
+                            for (kvr::sz_t i = 0; i < c; ++i)
+                            {
+                                if (i > 0) { this->put (','); }
+                                if (pi) { this->integer (pi [i]); } else if (pf) { this->floating (pf [i]); } else if (pb) { this->boolean (pb [i]); }
+                            }
                         }
-                        success = ok && m_wrt.EndArray ();
+                        else
+                        {
+                            for (kvr::sz_t i = 0; (i < c) && ok; ++i)
+                            {
+                                if (i > 0) { this->put (','); }
+                                kvr::value *v = kvr::internal::view::element (val, i);
+                                ok = print (v);
+                            }
+                        }
+                        
+                        if (ok) { this->put (']'); }
+                        success = ok;
                     }
                     
                     else if (val->is_string ())
                     {
                         kvr::sz_t slen = 0;
                         const char *str = val->get_string (&slen);
-                        success = m_wrt.String (str, slen);
+                        this->string (str, slen);
+                        success = true;
                     }
                     
                     else if (val->is_integer ())
                     {
-                        int64_t n = val->get_integer ();
-                        success = m_wrt.Int64 (n);
+                        this->integer (val->get_integer ());
+                        success = true;
                     }
                     
                     else if (val->is_float ())
                     {
-                        double n = val->get_float ();
-                        success = m_wrt.Double (n);
+                        this->floating (val->get_float ());
+                        success = true;
                     }
                     
                     else if (val->is_boolean ())
                     {
-                        bool b = val->get_boolean ();
-                        success = m_wrt.Bool (b);
+                        this->boolean (val->get_boolean ());
+                        success = true;
                     }
                     
                     else if (val->is_null ())
                     {
-                        success = m_wrt.Null ();
+                        this->write ("null", 4);
+                        success = true;
                     }
                     
                     return success;
                 }
                 
-                kvr_rapidjson::Writer<ostr> m_wrt;
+                ////////////////////////////////////////////////////////////
+                
+                sink &  m_sink;
+                char *  m_cur;
+                char *  m_end;
             };
             
             /////////////////////////////////////////////////////////////////////////////////////////////
             /////////////////////////////////////////////////////////////////////////////////////////////
             /////////////////////////////////////////////////////////////////////////////////////////////
             
-            bool read (kvr::value *dest, kvr::istream &istr)
+            template<typename istr>
+            bool read_custom (read_ctx &rctx, istr *is)
             {
-                KVR_ASSERT (dest);
-                
-                read_ctx rctx (dest);
-                istream_custom ss (&istr);
+                istream_custom<istr> ss (is);
                 
                 kvr_rapidjson::Reader reader;
                 kvr_rapidjson::ParseResult ok = reader.Parse<KVR_JSON_PARSE_FLAGS> (ss, rctx);
@@ -512,6 +869,20 @@ namespace kvr
             
             ////////////////////////////////////////////////////////////
             
+            bool read (kvr::value *dest, kvr::istream &istr, bool pack = false)
+            {
+                KVR_ASSERT (dest);
+                
+                read_ctx rctx (dest, false, pack);
+                kvr::internal::istream_block bis (&istr);
+                
+                // streams without bulk reads are parsed directly (every byte is a virtual call
+                // either way, and the block would only add its branches to each)
+                return bis.buffered () ? read_custom (rctx, &bis) : read_custom (rctx, &istr);
+            }
+            
+            ////////////////////////////////////////////////////////////
+            
             bool write (const kvr::value *src, kvr::ostream *ostr)
             {
                 KVR_ASSERT (src);
@@ -519,25 +890,20 @@ namespace kvr
                 
                 ostream_custom wostr (ostr);
                 writer<ostream_custom> wrt (wostr);
-                return wrt.print (src);
+                return wrt.write_root (src);
             }
             
             ////////////////////////////////////////////////////////////
             
-            bool read (kvr::value *dest, kvr::mem_istream &istr)
+            bool read (kvr::value *dest, kvr::mem_istream &istr, bool pack = false)
             {
                 KVR_ASSERT (dest);
                 
                 const char *str = (const char *) istr.buffer ();
                 KVR_ASSERT (str);
                 
-#if KVR_DEBUG
-                size_t len = istr.size ();
-                KVR_REF_UNUSED (len);
-                KVR_ASSERT (len > 0);
-#endif
-                read_ctx rctx (dest);
-                kvr_rapidjson::StringStream ss (str);
+                read_ctx rctx (dest, false, pack);
+                istream_memory ss (str, istr.size ());
                 kvr_rapidjson::Reader reader;
                 kvr_rapidjson::ParseResult ok = reader.Parse<KVR_JSON_PARSE_FLAGS> (ss, rctx);
 #if KVR_DEBUG        
@@ -548,6 +914,23 @@ namespace kvr
             
             ////////////////////////////////////////////////////////////
             
+            bool read_insitu (kvr::value *dest, char *buf, size_t sz, bool borrow = false, bool pack = false)
+            {
+                KVR_ASSERT (dest);
+                KVR_ASSERT (buf);
+                
+                read_ctx rctx (dest, borrow, pack);
+                istream_insitu ss (buf, sz);
+                kvr_rapidjson::Reader reader;
+                kvr_rapidjson::ParseResult ok = reader.Parse<KVR_JSON_PARSE_FLAGS | kvr_rapidjson::kParseInsituFlag> (ss, rctx);
+#if KVR_DEBUG        
+                if (ok.IsError ()) { std::fprintf (stderr, "JSON parse error: %s (%zu)", kvr_rapidjson::GetParseError_En (ok.Code ()), ok.Offset ()); }
+#endif
+                return ok && (rctx.m_depth == 0);
+            }
+            
+            ////////////////////////////////////////////////////////////
+            
             bool write (const kvr::value *src, kvr::mem_ostream *ostr)
             {
                 KVR_ASSERT (src);
@@ -555,7 +938,7 @@ namespace kvr
                 
                 ostream_memory wostr (ostr);
                 writer<ostream_memory> wrt (wostr);
-                return wrt.print (src);
+                return wrt.write_root (src);
             }
             
             ////////////////////////////////////////////////////////////
@@ -567,7 +950,7 @@ namespace kvr
                 if (val->is_map ())
                 {
                     size += 2; // brackets
-                    kvr::value::cursor c (val);
+                    kvr::value::cursor c = kvr::internal::view::cursor (val);
                     kvr::pair p;
                     while (c.get (&p))
                     {
@@ -580,12 +963,26 @@ namespace kvr
                     }
                 }
                 
+                else if (val->is_packed ())
+                {
+                    size += 2; // brackets
+                    kvr::sz_t c = val->length ();
+                    const int64_t *pi = val->packed_integers ();
+                    const bool *pb = val->packed_booleans ();
+                    for (kvr::sz_t i = 0; i < c; ++i)
+                    {
+                        size += kvr::internal::ndigitsu32 (i);
+                        size += pi ? kvr::internal::ndigitsi64 (pi [i]) : (pb ? (pb [i] ? 4 : 5) : 25);
+                        size += 1; // comma
+                    }
+                }
+                
                 else if (val->is_array ())
                 {
                     size += 2; // brackets
                     for (kvr::sz_t i = 0, c = val->length (); i < c; ++i)
                     {
-                        kvr::value *v = val->element (i);
+                        kvr::value *v = kvr::internal::view::element (val, i);
                         size += kvr::internal::ndigitsu32 (i);
                         size += write_approx_size (v);
                         size += 1; // comma
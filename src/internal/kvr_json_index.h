@@ -0,0 +1,778 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Copyright (c) 2015 Ubaka Onyechi
+ *
+ * kvr is free software distributed under the MIT license.
+ * See https://raw.githubusercontent.com/uonyx/kvr/master/LICENSE for details.
+ */
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef KVR_JSON_INDEX_H
+#define KVR_JSON_INDEX_H
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+// x86 simd block classifiers (sse2 and avx2 are compiled per function and picked at runtime)
+#ifndef KVR_JSON_INDEX_SIMD
+#if (defined (__GNUC__) || defined (__clang__)) && (defined (__x86_64__) || defined (__i386__))
+#define KVR_JSON_INDEX_SIMD 1
+#elif defined (_MSC_VER) && (defined (_M_X64) || defined (_M_IX86))
+#define KVR_JSON_INDEX_SIMD 1
+#else
+#define KVR_JSON_INDEX_SIMD 0
+#endif
+#endif
+
+#if KVR_JSON_INDEX_SIMD
+#include <immintrin.h>
+#if defined (_MSC_VER)
+#include <intrin.h>
+#define KVR_JSON_INDEX_TARGET_SSE2
+#define KVR_JSON_INDEX_TARGET_AVX2
+#else
+#define KVR_JSON_INDEX_TARGET_SSE2 __attribute__ ((target ("sse2")))
+#define KVR_JSON_INDEX_TARGET_AVX2 __attribute__ ((target ("avx2")))
+#endif
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace kvr
+{
+    namespace internal
+    {
+        namespace json
+        {
+            namespace indexed
+            {
+                /////////////////////////////////////////////////////////////////////////////////////////
+                /////////////////////////////////////////////////////////////////////////////////////////
+                /////////////////////////////////////////////////////////////////////////////////////////
+
+                // two stage decode of a json buffer:
+                // 1. classify 64 byte blocks into bit masks (quotes, backslashes, structural and
+                //    whitespace characters), resolve escapes and string spans with bit arithmetic
+                //    and list the offsets of structural characters, quotes and scalar starts.
+                // 2. walk those offsets and build the tree through json::read_ctx, exactly as
+                //    the rapidjson reader would. escaped strings and non-integer numbers are
+                //    handed to rapidjson one token at a time.
+                // anything unexpected (malformed input, control characters in strings, nesting
+                // too deep) starts over with the rapidjson reader, so results are always the same
+
+                /////////////////////////////////////////////////////////////////////////////////////////
+                /////////////////////////////////////////////////////////////////////////////////////////
+                /////////////////////////////////////////////////////////////////////////////////////////
+
+                enum isa_t
+                {
+                    ISA_SCALAR,
+                    ISA_SSE2,
+                    ISA_AVX2,
+                };
+
+                /////////////////////////////////////////////////////////////////////////////////////////
+                /////////////////////////////////////////////////////////////////////////////////////////
+                /////////////////////////////////////////////////////////////////////////////////////////
+
+                struct masks
+                {
+                    uint64_t quote;
+                    uint64_t bslash;
+                    uint64_t op;      // { } [ ] : ,
+                    uint64_t ws;      // space, tab, line feed, carriage return
+                    uint64_t ctrl;    // below 0x20
+                };
+
+                typedef void (*classify_fn) (const uint8_t *block, masks *m);
+
+                /////////////////////////////////////////////////////////////////////////////////////////
+                /////////////////////////////////////////////////////////////////////////////////////////
+                /////////////////////////////////////////////////////////////////////////////////////////
+
+                inline uint32_t ctz64 (uint64_t x)
+                {
+                    KVR_ASSERT (x != 0);
+#if defined (_MSC_VER) && defined (_M_X64)
+                    unsigned long i = 0;
+                    _BitScanForward64 (&i, x);
+                    return (uint32_t) i;
+#elif defined (_MSC_VER)
+                    unsigned long i = 0;
+                    if (_BitScanForward (&i, (unsigned long) x)) { return (uint32_t) i; }
+                    _BitScanForward (&i, (unsigned long) (x >> 32));
+                    return (uint32_t) i + 32;
+#else
+                    return (uint32_t) __builtin_ctzll (x);
+#endif
+                }
+
+                /////////////////////////////////////////////////////////////////////////////////////////
+                /////////////////////////////////////////////////////////////////////////////////////////
+                /////////////////////////////////////////////////////////////////////////////////////////
+
+                inline uint64_t prefix_xor (uint64_t x)
+                {
+                    // bit i = xor of bits 0..i (1 from an opening quote up to its closing quote)
+                    x ^= x << 1;
+                    x ^= x << 2;
+                    x ^= x << 4;
+                    x ^= x << 8;
+                    x ^= x << 16;
+                    x ^= x << 32;
+                    return x;
+                }
+
+                /////////////////////////////////////////////////////////////////////////////////////////
+                /////////////////////////////////////////////////////////////////////////////////////////
+                /////////////////////////////////////////////////////////////////////////////////////////
+
+                inline uint64_t swar_bits (uint64_t m)
+                {
+                    // byte high bits (0x80) of m gathered into the low 8 bits, byte 0 first
+                    return (((m >> 7) * 0x0102040810204080ull) >> 56) & 0xff;
+                }
+
+                /////////////////////////////////////////////////////////////////////////////////////////
+                /////////////////////////////////////////////////////////////////////////////////////////
+                /////////////////////////////////////////////////////////////////////////////////////////
+
+                inline void classify_scalar (const uint8_t *block, masks *m)
+                {
+                    // eight bytes at a time in a 64-bit word
+                    const uint64_t ones = 0x0101010101010101ull;
+
+                    uint64_t q = 0, b = 0, o = 0, w = 0, c = 0;
+                    for (uint32_t i = 0; i < 8; ++i)
+                    {
+                        const uint8_t *p = block + (i * 8);
+                        uint64_t v = (uint64_t) p [0] | ((uint64_t) p [1] << 8) | ((uint64_t) p [2] << 16) | ((uint64_t) p [3] << 24) |
+                                     ((uint64_t) p [4] << 32) | ((uint64_t) p [5] << 40) | ((uint64_t) p [6] << 48) | ((uint64_t) p [7] << 56);
+                        uint64_t vl = v | (ones * 0x20);
+
+                        uint64_t mq = swar_zero (v ^ (ones * '"'));
+                        uint64_t mb = swar_zero (v ^ (ones * '\\'));
+                        uint64_t mo = swar_zero (vl ^ (ones * '{')) | swar_zero (vl ^ (ones * '}')) |
+                                      swar_zero (v ^ (ones * ':')) | swar_zero (v ^ (ones * ','));
+                        uint64_t mw = swar_zero (v ^ (ones * ' ')) | swar_zero (v ^ (ones * '\t')) |
+                                      swar_zero (v ^ (ones * '\n')) | swar_zero (v ^ (ones * '\r'));
+                        uint64_t mc = swar_zero (v & (ones * 0xe0));
+
+                        uint32_t s = i * 8;
+                        q |= swar_bits (mq) << s;
+                        b |= swar_bits (mb) << s;
+                        o |= swar_bits (mo) << s;
+                        w |= swar_bits (mw) << s;
+                        c |= swar_bits (mc) << s;
+                    }
+
+                    m->quote = q;
+                    m->bslash = b;
+                    m->op = o;
+                    m->ws = w;
+                    m->ctrl = c;
+                }
+
+                /////////////////////////////////////////////////////////////////////////////////////////
+                /////////////////////////////////////////////////////////////////////////////////////////
+                /////////////////////////////////////////////////////////////////////////////////////////
+
+#if KVR_JSON_INDEX_SIMD
+                KVR_JSON_INDEX_TARGET_SSE2 inline void classify_sse2 (const uint8_t *block, masks *m)
+                {
+                    const __m128i quote = _mm_set1_epi8 ('"');
+                    const __m128i bslash = _mm_set1_epi8 ('\\');
+                    const __m128i lower = _mm_set1_epi8 (0x20);
+                    const __m128i lbrace = _mm_set1_epi8 ('{');   // '{' and '[' once or'd with 0x20
+                    const __m128i rbrace = _mm_set1_epi8 ('}');   // '}' and ']' likewise
+                    const __m128i colon = _mm_set1_epi8 (':');
+                    const __m128i comma = _mm_set1_epi8 (',');
+                    const __m128i space = _mm_set1_epi8 (' ');
+                    const __m128i tab = _mm_set1_epi8 ('\t');
+                    const __m128i lf = _mm_set1_epi8 ('\n');
+                    const __m128i cr = _mm_set1_epi8 ('\r');
+                    const __m128i ctrl = _mm_set1_epi8 (0x1f);
+
+                    uint64_t q = 0, b = 0, o = 0, w = 0, c = 0;
+                    for (uint32_t i = 0; i < 4; ++i)
+                    {
+                        __m128i v = _mm_loadu_si128 ((const __m128i *) (block + (i * 16)));
+                        __m128i vl = _mm_or_si128 (v, lower);
+                        __m128i vo = _mm_or_si128 (_mm_or_si128 (_mm_cmpeq_epi8 (vl, lbrace), _mm_cmpeq_epi8 (vl, rbrace)),
+                                                   _mm_or_si128 (_mm_cmpeq_epi8 (v, colon), _mm_cmpeq_epi8 (v, comma)));
+                        __m128i vw = _mm_or_si128 (_mm_or_si128 (_mm_cmpeq_epi8 (v, space), _mm_cmpeq_epi8 (v, tab)),
+                                                   _mm_or_si128 (_mm_cmpeq_epi8 (v, lf), _mm_cmpeq_epi8 (v, cr)));
+                        __m128i vc = _mm_cmpeq_epi8 (_mm_max_epu8 (v, ctrl), ctrl);
+
+                        uint32_t s = i * 16;
+                        q |= ((uint64_t) (uint32_t) _mm_movemask_epi8 (_mm_cmpeq_epi8 (v, quote))) << s;
+                        b |= ((uint64_t) (uint32_t) _mm_movemask_epi8 (_mm_cmpeq_epi8 (v, bslash))) << s;
+                        o |= ((uint64_t) (uint32_t) _mm_movemask_epi8 (vo)) << s;
+                        w |= ((uint64_t) (uint32_t) _mm_movemask_epi8 (vw)) << s;
+                        c |= ((uint64_t) (uint32_t) _mm_movemask_epi8 (vc)) << s;
+                    }
+
+                    m->quote = q;
+                    m->bslash = b;
+                    m->op = o;
+                    m->ws = w;
+                    m->ctrl = c;
+                }
+
+                /////////////////////////////////////////////////////////////////////////////////////////
+                /////////////////////////////////////////////////////////////////////////////////////////
+                /////////////////////////////////////////////////////////////////////////////////////////
+
+                KVR_JSON_INDEX_TARGET_AVX2 inline void classify_avx2 (const uint8_t *block, masks *m)
+                {
+                    const __m256i quote = _mm256_set1_epi8 ('"');
+                    const __m256i bslash = _mm256_set1_epi8 ('\\');
+                    const __m256i lower = _mm256_set1_epi8 (0x20);
+                    const __m256i lbrace = _mm256_set1_epi8 ('{');
+                    const __m256i rbrace = _mm256_set1_epi8 ('}');
+                    const __m256i colon = _mm256_set1_epi8 (':');
+                    const __m256i comma = _mm256_set1_epi8 (',');
+                    const __m256i space = _mm256_set1_epi8 (' ');
+                    const __m256i tab = _mm256_set1_epi8 ('\t');
+                    const __m256i lf = _mm256_set1_epi8 ('\n');
+                    const __m256i cr = _mm256_set1_epi8 ('\r');
+                    const __m256i ctrl = _mm256_set1_epi8 (0x1f);
+
+                    uint64_t q = 0, b = 0, o = 0, w = 0, c = 0;
+                    for (uint32_t i = 0; i < 2; ++i)
+                    {
+                        __m256i v = _mm256_loadu_si256 ((const __m256i *) (block + (i * 32)));
+                        __m256i vl = _mm256_or_si256 (v, lower);
+                        __m256i vo = _mm256_or_si256 (_mm256_or_si256 (_mm256_cmpeq_epi8 (vl, lbrace), _mm256_cmpeq_epi8 (vl, rbrace)),
+                                                      _mm256_or_si256 (_mm256_cmpeq_epi8 (v, colon), _mm256_cmpeq_epi8 (v, comma)));
+                        __m256i vw = _mm256_or_si256 (_mm256_or_si256 (_mm256_cmpeq_epi8 (v, space), _mm256_cmpeq_epi8 (v, tab)),
+                                                      _mm256_or_si256 (_mm256_cmpeq_epi8 (v, lf), _mm256_cmpeq_epi8 (v, cr)));
+                        __m256i vc = _mm256_cmpeq_epi8 (_mm256_max_epu8 (v, ctrl), ctrl);
+
+                        uint32_t s = i * 32;
+                        q |= ((uint64_t) (uint32_t) _mm256_movemask_epi8 (_mm256_cmpeq_epi8 (v, quote))) << s;
+                        b |= ((uint64_t) (uint32_t) _mm256_movemask_epi8 (_mm256_cmpeq_epi8 (v, bslash))) << s;
+                        o |= ((uint64_t) (uint32_t) _mm256_movemask_epi8 (vo)) << s;
+                        w |= ((uint64_t) (uint32_t) _mm256_movemask_epi8 (vw)) << s;
+                        c |= ((uint64_t) (uint32_t) _mm256_movemask_epi8 (vc)) << s;
+                    }
+
+                    m->quote = q;
+                    m->bslash = b;
+                    m->op = o;
+                    m->ws = w;
+                    m->ctrl = c;
+                }
+#endif
+
+                /////////////////////////////////////////////////////////////////////////////////////////
+                /////////////////////////////////////////////////////////////////////////////////////////
+                /////////////////////////////////////////////////////////////////////////////////////////
+
+                inline isa_t detect_isa ()
+                {
+                    isa_t isa = ISA_SCALAR;
+#if KVR_JSON_INDEX_SIMD && defined (_MSC_VER)
+                    int info [4] = { 0, 0, 0, 0 };
+                    __cpuid (info, 0);
+                    int leaves = info [0];
+                    __cpuid (info, 1);
+                    bool sse2 = (info [3] & (1 << 26)) != 0;
+                    bool osavx = ((info [2] & (1 << 27)) != 0) && ((info [2] & (1 << 28)) != 0) && ((_xgetbv (0) & 6) == 6);
+                    bool avx2 = false;
+                    if (osavx && (leaves >= 7))
+                    {
+                        __cpuidex (info, 7, 0);
+                        avx2 = (info [1] & (1 << 5)) != 0;
+                    }
+                    isa = avx2 ? ISA_AVX2 : (sse2 ? ISA_SSE2 : ISA_SCALAR);
+#elif KVR_JSON_INDEX_SIMD
+                    __builtin_cpu_init ();
+                    isa = __builtin_cpu_supports ("avx2") ? ISA_AVX2 : (__builtin_cpu_supports ("sse2") ? ISA_SSE2 : ISA_SCALAR);
+#endif
+                    return isa;
+                }
+
+                /////////////////////////////////////////////////////////////////////////////////////////
+                /////////////////////////////////////////////////////////////////////////////////////////
+                /////////////////////////////////////////////////////////////////////////////////////////
+
+                inline classify_fn select_classifier (isa_t max_isa)
+                {
+                    static int cpu = -1;
+                    if (cpu < 0)
+                    {
+                        cpu = (int) detect_isa ();
+                    }
+
+                    isa_t isa = ((int) max_isa < cpu) ? max_isa : (isa_t) cpu;
+                    KVR_REF_UNUSED (isa);
+#if KVR_JSON_INDEX_SIMD
+                    if (isa == ISA_AVX2) { return classify_avx2; }
+                    if (isa == ISA_SSE2) { return classify_sse2; }
+#endif
+                    return classify_scalar;
+                }
+
+                /////////////////////////////////////////////////////////////////////////////////////////
+                /////////////////////////////////////////////////////////////////////////////////////////
+                /////////////////////////////////////////////////////////////////////////////////////////
+
+                // stage 1: structural offsets, a window of the input at a time
+                struct scanner
+                {
+                    static const uint32_t WINDOW = 64u * 64u; // bytes (and at most as many offsets)
+
+                    ////////////////////////////////////////////////////////////
+
+                    scanner (const uint8_t *buf, size_t len, classify_fn classify) : m_buf (buf), m_len (len), m_base (0),
+                        m_scanned (0), m_count (0), m_cur (0), m_escaped (0), m_in_string (0), m_scalar (0), m_error (false),
+                        m_classify (classify)
+                    {
+                    }
+
+                    ////////////////////////////////////////////////////////////
+
+                    bool next (size_t *pos)
+                    {
+                        if ((m_cur == m_count) && !this->fill ())
+                        {
+                            return false;
+                        }
+
+                        *pos = m_base + m_offs [m_cur++];
+                        return true;
+                    }
+
+                    ////////////////////////////////////////////////////////////
+
+                    size_t peek ()
+                    {
+                        if ((m_cur == m_count) && !this->fill ())
+                        {
+                            return m_len;
+                        }
+
+                        return m_base + m_offs [m_cur];
+                    }
+
+                    ////////////////////////////////////////////////////////////
+
+                    bool fill ()
+                    {
+                        m_cur = 0;
+                        m_count = 0;
+
+                        while ((m_count == 0) && (m_scanned < m_len))
+                        {
+                            m_base = m_scanned;
+                            size_t end = ((m_len - m_base) > WINDOW) ? (m_base + WINDOW) : m_len;
+
+                            for (size_t b = m_base; b < end; b += 64)
+                            {
+                                masks m;
+                                if ((end - b) >= 64)
+                                {
+                                    m_classify (m_buf + b, &m);
+                                }
+                                else
+                                {
+                                    // the last partial block is padded with whitespace
+                                    uint8_t tail [64];
+                                    memset (tail, ' ', sizeof (tail));
+                                    memcpy (tail, m_buf + b, end - b);
+                                    m_classify (tail, &m);
+                                }
+
+                                this->index (m, (uint32_t) (b - m_base));
+                            }
+
+                            m_scanned = end;
+                        }
+
+                        return (m_count > 0);
+                    }
+
+                    ////////////////////////////////////////////////////////////
+
+                    void index (const masks &m, uint32_t off)
+                    {
+                        // characters escaped by an odd run of backslashes (runs carry across blocks)
+                        const uint64_t even = 0x5555555555555555ull;
+                        uint64_t bs = m.bslash & ~m_escaped;
+                        uint64_t follows = (bs << 1) | m_escaped;
+                        uint64_t odd_starts = bs & ~even & ~follows;
+                        uint64_t even_starts = odd_starts + bs;
+                        m_escaped = (even_starts < odd_starts) ? 1u : 0u;
+                        uint64_t escaped = (even ^ (even_starts << 1)) & follows;
+
+                        // string spans (opening quote inclusive, closing quote exclusive)
+                        uint64_t quote = m.quote & ~escaped;
+                        uint64_t in_string = prefix_xor (quote) ^ m_in_string;
+                        m_in_string = (uint64_t) ((int64_t) in_string >> 63);
+
+                        // rapidjson rejects raw control characters in strings
+                        m_error = m_error || ((m.ctrl & in_string & ~quote) != 0);
+
+                        // scalars (numbers and literals) start after whitespace or structure
+                        uint64_t scalar = ~(m.op | m.ws | quote);
+                        uint64_t scalar_start = scalar & ~((scalar << 1) | m_scalar);
+                        m_scalar = scalar >> 63;
+
+                        uint64_t s = ((m.op | scalar_start) & ~in_string) | quote;
+                        while (s)
+                        {
+                            m_offs [m_count++] = off + ctz64 (s);
+                            s &= (s - 1);
+                        }
+                    }
+
+                    ////////////////////////////////////////////////////////////
+
+                    const uint8_t * m_buf;
+                    size_t          m_len;
+                    size_t          m_base;
+                    size_t          m_scanned;
+                    uint32_t        m_count;
+                    uint32_t        m_cur;
+                    uint64_t        m_escaped;
+                    uint64_t        m_in_string;
+                    uint64_t        m_scalar;
+                    bool            m_error;
+                    classify_fn     m_classify;
+                    uint32_t        m_offs [WINDOW];
+                };
+
+                /////////////////////////////////////////////////////////////////////////////////////////
+                /////////////////////////////////////////////////////////////////////////////////////////
+                /////////////////////////////////////////////////////////////////////////////////////////
+
+                // rapidjson handler for a single string or number token
+                struct token_handler
+                {
+                    token_handler (read_ctx *rctx, bool key) : m_rctx (rctx), m_key (key) {}
+
+                    bool Null () { return false; }
+                    bool Bool (bool) { return false; }
+                    bool Int (int i) { return !m_key && m_rctx->Int (i); }
+                    bool Uint (unsigned u) { return !m_key && m_rctx->Uint (u); }
+                    bool Int64 (int64_t i) { return !m_key && m_rctx->Int64 (i); }
+                    bool Uint64 (uint64_t u) { return !m_key && m_rctx->Uint64 (u); }
+                    bool Double (double d) { return !m_key && m_rctx->Double (d); }
+                    bool String (const char *str, kvr_rapidjson::SizeType length, bool copy)
+                    {
+                        return m_key ? m_rctx->Key (str, length, copy) : m_rctx->String (str, length, copy);
+                    }
+                    bool StartObject () { return false; }
+                    bool Key (const char *, kvr_rapidjson::SizeType, bool) { return false; }
+                    bool EndObject (kvr_rapidjson::SizeType) { return false; }
+                    bool StartArray () { return false; }
+                    bool EndArray (kvr_rapidjson::SizeType) { return false; }
+
+                    read_ctx *  m_rctx;
+                    bool        m_key;
+                };
+
+                /////////////////////////////////////////////////////////////////////////////////////////
+                /////////////////////////////////////////////////////////////////////////////////////////
+                /////////////////////////////////////////////////////////////////////////////////////////
+
+                // stage 2: tree building
+                struct builder
+                {
+                    struct frame
+                    {
+                        bool                      object;
+                        kvr_rapidjson::SizeType   count;
+                    };
+
+                    ////////////////////////////////////////////////////////////
+
+                    builder (scanner *sc, read_ctx *rctx) : m_sc (sc), m_rctx (rctx), m_buf (sc->m_buf)
+                    {
+                    }
+
+                    ////////////////////////////////////////////////////////////
+
+                    static bool is_ws (uint8_t c)
+                    {
+                        return (c == ' ') || (c == '\t') || (c == '\n') || (c == '\r');
+                    }
+
+                    ////////////////////////////////////////////////////////////
+
+                    bool only_ws (size_t begin, size_t end) const
+                    {
+                        for (size_t i = begin; i < end; ++i)
+                        {
+                            if (!is_ws (m_buf [i])) { return false; }
+                        }
+                        return true;
+                    }
+
+                    ////////////////////////////////////////////////////////////
+
+                    bool delegate (size_t begin, size_t end, bool key)
+                    {
+                        // rapidjson parses the token (escapes, floats), which must be used up
+                        istream_memory ss ((const char *) m_buf + begin, end - begin);
+                        token_handler th (m_rctx, key);
+                        kvr_rapidjson::ParseResult ok = m_reader.Parse<KVR_JSON_PARSE_FLAGS> (ss, th);
+                        return ok && this->only_ws (begin + ss.Tell (), end);
+                    }
+
+                    ////////////////////////////////////////////////////////////
+
+                    bool string (size_t pos, bool key)
+                    {
+                        KVR_ASSERT (m_buf [pos] == '"');
+
+                        size_t end = 0;
+                        if (!m_sc->next (&end) || (m_buf [end] != '"'))
+                        {
+                            return false;
+                        }
+
+                        const char *str = (const char *) m_buf + pos + 1;
+                        size_t len = end - pos - 1;
+                        bool plain = (memchr (str, '\\', len) == NULL);
+#if KVR_DEBUG
+                        // debug builds validate utf-8 (see KVR_JSON_DEBUG_PARSE_FLAGS)
+                        for (size_t i = 0; plain && (i < len); ++i)
+                        {
+                            plain = ((uint8_t) str [i] < 0x80);
+                        }
+#endif
+                        if (!plain)
+                        {
+                            return this->delegate (pos, end + 1, key);
+                        }
+
+                        kvr_rapidjson::SizeType sz = (kvr_rapidjson::SizeType) len;
+                        return key ? m_rctx->Key (str, sz, true) : m_rctx->String (str, sz, true);
+                    }
+
+                    ////////////////////////////////////////////////////////////
+
+                    bool number (size_t pos)
+                    {
+                        size_t end = m_sc->peek ();
+
+                        // plain integers of up to 18 digits cannot overflow, the rest go to rapidjson
+                        size_t i = pos;
+                        bool minus = (m_buf [i] == '-');
+                        i += minus ? 1 : 0;
+                        size_t digits = i;
+                        uint64_t n = 0;
+                        while ((i < end) && (m_buf [i] >= '0') && (m_buf [i] <= '9'))
+                        {
+                            n = (n * 10) + (m_buf [i++] - '0');
+                        }
+                        digits = i - digits;
+
+                        bool plain = (digits > 0) && (digits <= 18) && ((m_buf [i - digits] != '0') || (digits == 1)) &&
+                                     this->only_ws (i, end);
+                        if (!plain)
+                        {
+                            return this->delegate (pos, end, false);
+                        }
+
+                        return m_rctx->Int64 (minus ? -(int64_t) n : (int64_t) n);
+                    }
+
+                    ////////////////////////////////////////////////////////////
+
+                    bool literal (size_t pos)
+                    {
+                        size_t end = m_sc->peek ();
+                        size_t avail = end - pos;
+
+                        if ((avail >= 4) && (memcmp (m_buf + pos, "true", 4) == 0) && this->only_ws (pos + 4, end))
+                        {
+                            return m_rctx->Bool (true);
+                        }
+                        if ((avail >= 5) && (memcmp (m_buf + pos, "false", 5) == 0) && this->only_ws (pos + 5, end))
+                        {
+                            return m_rctx->Bool (false);
+                        }
+                        if ((avail >= 4) && (memcmp (m_buf + pos, "null", 4) == 0) && this->only_ws (pos + 4, end))
+                        {
+                            return m_rctx->Null ();
+                        }
+                        return false;
+                    }
+
+                    ////////////////////////////////////////////////////////////
+
+                    bool scalar (size_t pos)
+                    {
+                        uint8_t c = m_buf [pos];
+                        if (c == '"')
+                        {
+                            return this->string (pos, false);
+                        }
+                        if ((c == '-') || ((c >= '0') && (c <= '9')))
+                        {
+                            return this->number (pos);
+                        }
+                        if ((c == 't') || (c == 'f') || (c == 'n'))
+                        {
+                            return this->literal (pos);
+                        }
+                        return false;
+                    }
+
+                    ////////////////////////////////////////////////////////////
+
+                    bool key (size_t *pos)
+                    {
+                        // key, colon and the offset of the member value
+                        return (m_buf [*pos] == '"') && this->string (*pos, true) && m_sc->next (pos) &&
+                               (m_buf [*pos] == ':') && m_sc->next (pos);
+                    }
+
+                    ////////////////////////////////////////////////////////////
+
+                    bool build ()
+                    {
+                        frame stack [KVR_CONSTANT_MAX_TREE_DEPTH];
+                        kvr::sz_t depth = 0;
+                        size_t pos = 0;
+
+                        if (!m_sc->next (&pos))
+                        {
+                            return false;
+                        }
+
+                        for (;;)
+                        {
+                            // a value at pos
+                            uint8_t c = m_buf [pos];
+                            if ((c == '{') || (c == '['))
+                            {
+                                bool obj = (c == '{');
+                                if ((depth >= (KVR_CONSTANT_MAX_TREE_DEPTH - 1)) || !(obj ? m_rctx->StartObject () : m_rctx->StartArray ()) ||
+                                    !m_sc->next (&pos))
+                                {
+                                    return false;
+                                }
+
+                                if (m_buf [pos] == (obj ? '}' : ']'))
+                                {
+                                    if (!(obj ? m_rctx->EndObject (0) : m_rctx->EndArray (0)))
+                                    {
+                                        return false;
+                                    }
+                                }
+                                else
+                                {
+                                    stack [depth].object = obj;
+                                    stack [depth].count = 0;
+                                    ++depth;
+
+                                    if (obj && !this->key (&pos))
+                                    {
+                                        return false;
+                                    }
+                                    continue;
+                                }
+                            }
+                            else if (!this->scalar (pos))
+                            {
+                                return false;
+                            }
+
+                            // the value is done: close scopes up to the next comma
+                            for (;;)
+                            {
+                                if (depth == 0)
+                                {
+                                    // root done (rapidjson stops here too, see kParseStopWhenDoneFlag)
+                                    return !m_sc->m_error;
+                                }
+
+                                frame &f = stack [depth - 1];
+                                ++f.count;
+
+                                if (!m_sc->next (&pos))
+                                {
+                                    return false;
+                                }
+
+                                c = m_buf [pos];
+                                if (c == ',')
+                                {
+                                    if (!m_sc->next (&pos) || (f.object && !this->key (&pos)))
+                                    {
+                                        return false;
+                                    }
+                                    break;
+                                }
+
+                                if ((c != (f.object ? '}' : ']')) || !(f.object ? m_rctx->EndObject (f.count) : m_rctx->EndArray (f.count)))
+                                {
+                                    return false;
+                                }
+                                --depth;
+                            }
+                        }
+                    }
+
+                    ////////////////////////////////////////////////////////////
+
+                    scanner *             m_sc;
+                    read_ctx *            m_rctx;
+                    const uint8_t *       m_buf;
+                    kvr_rapidjson::Reader m_reader;
+                };
+            }
+
+            /////////////////////////////////////////////////////////////////////////////////////////////
+            /////////////////////////////////////////////////////////////////////////////////////////////
+            /////////////////////////////////////////////////////////////////////////////////////////////
+
+            bool read_indexed (kvr::value *dest, kvr::mem_istream &istr, indexed::isa_t max_isa, bool pack = false)
+            {
+                KVR_ASSERT (dest);
+
+                const uint8_t *buf = istr.buffer ();
+                KVR_ASSERT (buf);
+
+                bool ok = false;
+                {
+                    read_ctx rctx (dest, false, pack);
+                    indexed::scanner sc (buf, istr.size (), indexed::select_classifier (max_isa));
+                    indexed::builder bld (&sc, &rctx);
+                    ok = bld.build () && (rctx.m_depth == 0);
+
+                    if (!ok)
+                    {
+                        rctx.reset ();
+                    }
+                }
+
+                // start over with the rapidjson reader (same result or error)
+                return ok || read (dest, istr);
+            }
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////
@@ -20,7 +20,6 @@
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 
-#define KVR_MSGPACK_READ_KEY_SPECIALIZATION     0
 #define KVR_MSGPACK_WRITE_COMPACT_FP_OVERRIDE   0
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
@@ -77,7 +76,7 @@ namespace kvr
             {
                 ////////////////////////////////////////////////////////////
                 
-                read_ctx (kvr::value *value) : m_root (value), m_temp (NULL), m_depth (0)
+                read_ctx (kvr::value *value, bool borrow = false, bool pack = false, bool insitu = false) : m_root (value), m_temp (NULL), m_depth (0), m_borrow (borrow), m_insitu (insitu), m_pack (pack)
                 {
                     memset (m_stack, 0, sizeof (m_stack));
                 }
@@ -131,7 +130,14 @@ namespace kvr
                     }
                     else if (node->is_array ())
                     {
-                        node->push (b);
+                        if (m_pack)
+                        {
+                            node->push_n (&b, 1);
+                        }
+                        else
+                        {
+                            node->push (b);
+                        }
                         success = true;
                     }
                     
@@ -161,7 +167,14 @@ namespace kvr
                     }
                     else if (node->is_array ())
                     {
-                        node->push (i);
+                        if (m_pack)
+                        {
+                            node->push_n (&i, 1);
+                        }
+                        else
+                        {
+                            node->push (i);
+                        }
                         success = true;
                     }
                     
@@ -201,7 +214,14 @@ namespace kvr
                     }
                     else if (node->is_array ())
                     {
-                        node->push (d);
+                        if (m_pack)
+                        {
+                            node->push_n (&d, 1);
+                        }
+                        else
+                        {
+                            node->push (d);
+                        }
                         success = true;
                     }
                     
@@ -210,6 +230,29 @@ namespace kvr
                 
                 ////////////////////////////////////////////////////////////
                 
+                void set_string (kvr::value *v, const char *str, kvr::sz_t length)
+                {
+                    if (m_borrow && m_insitu)
+                    {
+                        // every string follows at least one header byte (already read), so
+                        // sliding it back by one leaves room to terminate it in place
+                        char *term = const_cast<char *>(str) - 1;
+                        memmove (term, str, length);
+                        term [length] = 0;
+                        v->_string_borrow (term, length, true);
+                    }
+                    else if (m_borrow)
+                    {
+                        v->_string_borrow (str, length);
+                    }
+                    else
+                    {
+                        v->set_string (str, length);
+                    }
+                }
+                
+                ////////////////////////////////////////////////////////////
+                
                 bool read_string (const char *str, kvr::sz_t length)
                 {
                     bool success = false;
@@ -227,7 +270,7 @@ namespace kvr
 #if KVR_FLAG_DISABLE_IMPLICIT_TYPE_CONVERSION
                         m_temp = m_temp->as_string ();
 #endif
-                        m_temp->set_string (str, length);
+                        this->set_string (m_temp, str, length);
                         m_temp = NULL;
                         success = true;
                     }
@@ -237,7 +280,7 @@ namespace kvr
 #if KVR_FLAG_DISABLE_IMPLICIT_TYPE_CONVERSION
                         vstr = vstr->as_string ();
 #endif
-                        vstr->set_string (str, length);
+                        this->set_string (vstr, str, length);
                         success = true;
                     }
                     
@@ -291,15 +334,7 @@ namespace kvr
                     KVR_ASSERT_SAFE (node && node->is_map (), false);
                     
                     KVR_ASSERT (!m_temp);
-#if KVR_MSGPACK_READ_KEY_SPECIALIZATION
-                    char key [256];
-                    KVR_ASSERT (length < 256);
-                    kvr_strncpy (key, 256, str, length);
-                    m_temp = node->insert_null (key);
-#else
-                    KVR_REF_UNUSED (length);
-                    m_temp = node->insert_null (str);
-#endif
+                    m_temp = node->insert_null (str, length);
                     return (m_temp != NULL);
                 }
                 
@@ -371,6 +406,9 @@ namespace kvr
                 kvr::value  * m_root;
                 kvr::value  * m_temp;
                 kvr::sz_t     m_depth;
+                bool          m_borrow; // strings point into the input (mem_istream only)
+                bool          m_insitu; // with m_borrow: the input may be written to
+                bool          m_pack;   // numeric and boolean arrays are packed
             };
             
             /////////////////////////////////////////////////////////////////////////////////////////////
@@ -607,9 +645,7 @@ namespace kvr
                     {
                         ok &= parse (is, ctx);
                     }
-#if KVR_DEBUG
                     ok = ok && ctx.read_array_end (alen);
-#endif
                     return ok;
                 }
                 
@@ -627,9 +663,7 @@ namespace kvr
                         {
                             ok &= parse (is, ctx);
                         }
-#if KVR_DEBUG
-                        ok &= ctx.read_array_end (static_cast<kvr::sz_t>(alen));
-#endif
+                        ok = ok && ctx.read_array_end (static_cast<kvr::sz_t>(alen));
                     }
                     return ok;
                 }
@@ -648,9 +682,7 @@ namespace kvr
                         {
                             ok &= parse (is, ctx);
                         }
-#if KVR_DEBUG
-                        ok &= ctx.read_array_end (static_cast<kvr::sz_t>(alen));
-#endif
+                        ok = ok && ctx.read_array_end (static_cast<kvr::sz_t>(alen));
                     }
                     return ok;
                 }
@@ -663,12 +695,9 @@ namespace kvr
                     bool ok = ctx.read_map_start (msz);
                     for (uint8_t i = 0; ok && (i < msz); ++i)
                     {
-                        ok &= parse_key (is, ctx);
-                        ok &= parse (is, ctx);
+                        ok = parse_key (is, ctx) && parse (is, ctx);
                     }
-#if KVR_DEBUG
-                    ok &= ctx.read_map_end (msz);
-#endif
+                    ok = ok && ctx.read_map_end (msz);
                     return ok;
                 }
                 
@@ -684,12 +713,9 @@ namespace kvr
                         ok = ctx.read_map_start (static_cast<kvr::sz_t>(msz));
                         for (uint16_t i = 0; ok && (i < msz); ++i)
                         {
-                            ok &= parse_key (is, ctx);
-                            ok &= parse (is, ctx);
+                            ok = parse_key (is, ctx) && parse (is, ctx);
                         }
-#if KVR_DEBUG
-                        ok &= ctx.read_map_end (static_cast<kvr::sz_t>(msz));
-#endif
+                        ok = ok && ctx.read_map_end (static_cast<kvr::sz_t>(msz));
                     }
                     return ok;
                 }
@@ -706,12 +732,9 @@ namespace kvr
                         ok = ctx.read_map_start (static_cast<kvr::sz_t>(msz));
                         for (uint32_t i = 0; ok && (i < msz); ++i)
                         {
-                            ok &= parse_key (is, ctx);
-                            ok &= parse (is, ctx);
+                            ok = parse_key (is, ctx) && parse (is, ctx);
                         }
-#if KVR_DEBUG
-                        ok &= ctx.read_map_end (static_cast<kvr::sz_t>(msz));
-#endif
+                        ok = ok && ctx.read_map_end (static_cast<kvr::sz_t>(msz));
                     }
                     return ok;
                 }
@@ -967,11 +990,11 @@ namespace kvr
                 {
                     uint32_t slen = kvr_bigendian32 (len);
                     const char *str = (const char *) is->push (slen);
-                    return str ? ctx.read_key (str, static_cast<kvr::sz_t>(slen)) : false;
+                    return str ? ctx.read_string (str, static_cast<kvr::sz_t>(slen)) : false;
                 }
                 return false;
             }
-#if KVR_MSGPACK_READ_KEY_SPECIALIZATION
+            
             template<>
             bool reader<kvr::mem_istream>::parse_key5 (kvr::mem_istream *is, read_ctx &ctx, uint8_t data)
             {
@@ -1017,7 +1040,6 @@ namespace kvr
                 }
                 return false;
             }
-#endif
             /////////////////////////////////////////////////////////////////////////////////////////////
             /////////////////////////////////////////////////////////////////////////////////////////////
             /////////////////////////////////////////////////////////////////////////////////////////////
@@ -1277,7 +1299,7 @@ namespace kvr
                     {
                         kvr::sz_t msz = val->size ();
                         bool ok = ctx.write_map (msz);
-                        kvr::value::cursor c (val);
+                        kvr::value::cursor c = kvr::internal::view::cursor (val);
                         kvr::pair p;
                         while (ok && c.get (&p))
                         {
@@ -1294,11 +1316,35 @@ namespace kvr
                     {
                         kvr::sz_t alen = val->length ();
                         bool ok = ctx.write_array (alen);
-                        for (kvr::sz_t i = 0; (i < alen) && ok; ++i)
+                        
+                        if (val->is_packed ())
                         {
-                            kvr::value *v = val->element (i);
-                            ok &= print (v, ctx);
+                            const int64_t *pi = val->packed_integers ();
+                            const double *pf = val->packed_floats ();
+                            const bool *pb = val->packed_booleans ();
+                            
+                            if (pi)
+                            {
+                                for (kvr::sz_t i = 0; (i < alen) && ok; ++i) { ok &= ctx.write_integer (pi [i]); }
+                            }
+                            else if (pf)
+                            {
+                                for (kvr::sz_t i = 0; (i < alen) && ok; ++i) { ok &= ctx.write_float (pf [i]); }
+                            }
+                            else if (pb)
+                            {
+                                for (kvr::sz_t i = 0; (i < alen) && ok; ++i) { ok &= ctx.write_boolean (pb [i]); }
+                            }
+                        }
+                        else
+                        {
+                            for (kvr::sz_t i = 0; (i < alen) && ok; ++i)
+                            {
+                                kvr::value *v = kvr::internal::view::element (val, i);
+                                ok &= print (v, ctx);
+                            }
                         }
+                        
                         success = ok;
                     }
                     
@@ -1340,13 +1386,14 @@ namespace kvr
             /////////////////////////////////////////////////////////////////////////////////////////////
             /////////////////////////////////////////////////////////////////////////////////////////////
             
-            bool read (kvr::value *dest, kvr::istream &istr)
+            bool read (kvr::value *dest, kvr::istream &istr, bool pack = false)
             {
                 KVR_ASSERT (dest);
                 
-                reader<kvr::istream> reader;
-                read_ctx ctx (dest);
-                return reader.parse (&istr, ctx);
+                kvr::internal::istream_block bis (&istr);
+                reader<kvr::internal::istream_block> reader;
+                read_ctx ctx (dest, false, pack);
+                return reader.parse (&bis, ctx);
             }
             
             ////////////////////////////////////////////////////////////
@@ -1356,12 +1403,13 @@ namespace kvr
                 KVR_ASSERT (src);
                 KVR_ASSERT (ostr);
                 
-                write_ctx<kvr::ostream> ctx (ostr);
-                writer<kvr::ostream> wrt;
+                kvr::internal::ostream_block bos (ostr);
+                write_ctx<kvr::internal::ostream_block> ctx (&bos);
+                writer<kvr::internal::ostream_block> wrt;
                 
                 if (wrt.print (src, ctx))
                 {
-                    ostr->flush ();
+                    bos.flush ();
                     return true;
                 }
                 
@@ -1370,12 +1418,12 @@ namespace kvr
             
             ////////////////////////////////////////////////////////////
             
-            bool read (kvr::value *dest, kvr::mem_istream &istr)
+            bool read (kvr::value *dest, kvr::mem_istream &istr, bool borrow = false, bool pack = false, bool insitu = false)
             {
                 KVR_ASSERT (dest);
                 
                 reader<kvr::mem_istream> reader;
-                read_ctx ctx (dest);
+                read_ctx ctx (dest, borrow, pack, insitu);
                 return reader.parse (&istr, ctx);
             }
             
@@ -1400,6 +1448,91 @@ namespace kvr
             
             ////////////////////////////////////////////////////////////
             
+            size_t write_approx_size_integer (int64_t n)
+            {
+                size_t size = 0;
+                
+                if (n >= 0) // unsigned
+                {
+                    if (n <= 127)
+                    {
+                        size += 1;
+                    }
+                    else if (n <= 0xff)
+                    {
+                        size += 2;
+                    }
+                    else if (n <= 0xffff)
+                    {
+                        size += 3;
+                    }
+                    else if (n <= 0xffffffff)
+                    {
+                        size += 5;
+                    }
+                    else
+                    {
+                        size += 9;
+                    }
+                }
+                else // signed
+                {
+                    const int64_t nint5 = -((1 << 5) - 1);
+                    const int64_t nint8 = -((1 << 7) - 1);
+                    const int64_t nint16 = -((1 << 15) - 1);
+                    const int64_t nint32 = -((1LL << 31) - 1);
+                    
+                    if (n >= nint5)
+                    {
+                        size += 1;
+                    }
+                    else if (n >= nint8)
+                    {
+                        size += 2;
+                    }
+                    else if (n >= nint16)
+                    {
+                        size += 3;
+                    }
+                    else if (n >= nint32)
+                    {
+                        size += 5;
+                    }
+                    else
+                    {
+                        size += 9;
+                    }
+                }
+                
+                return size;
+            }
+            
+            ////////////////////////////////////////////////////////////
+            
+            size_t write_approx_size_float (double n)
+            {
+                KVR_REF_UNUSED (n);
+                size_t size = 0;
+                
+#if KVR_FLAG_ENCODE_COMPACT_FP_PRECISION || KVR_MSGPACK_WRITE_COMPACT_FP_OVERRIDE
+                const double fmin = std::numeric_limits<float>::min ();
+                const double fmax = std::numeric_limits<float>::max ();
+                
+                if ((n >= fmin) && (n <= fmax))
+                {
+                    size += 5;
+                }
+                else
+#endif
+                {
+                    size += 9;
+                }
+                
+                return size;
+            }
+            
+            ////////////////////////////////////////////////////////////
+            
             size_t write_approx_size (const kvr::value *val)
             {
                 size_t size = 0;
@@ -1421,7 +1554,7 @@ namespace kvr
                         size += 5;
                     }
                     
-                    kvr::value::cursor c (val);
+                    kvr::value::cursor c = kvr::internal::view::cursor (val);
                     kvr::pair p;
                     while (c.get (&p))
                     {
@@ -1468,10 +1601,28 @@ namespace kvr
                         size += 5;
                     }
                     
-                    for (kvr::sz_t i = 0, c = val->length (); i < c; ++i)
+                    const int64_t *pi = val->packed_integers ();
+                    const double *pf = val->packed_floats ();
+                    
+                    if (pi)
                     {
-                        kvr::value *v = val->element (i);
-                        size += write_approx_size (v);
+                        for (kvr::sz_t i = 0; i < alen; ++i) { size += write_approx_size_integer (pi [i]); }
+                    }
+                    else if (pf)
+                    {
+                        for (kvr::sz_t i = 0; i < alen; ++i) { size += write_approx_size_float (pf [i]); }
+                    }
+                    else if (val->is_packed ())
+                    {
+                        size += alen; // booleans
+                    }
+                    else
+                    {
+                        for (kvr::sz_t i = 0, c = val->length (); i < c; ++i)
+                        {
+                            kvr::value *v = kvr::internal::view::element (val, i);
+                            size += write_approx_size (v);
+                        }
                     }
                 }
                 
@@ -1503,77 +1654,12 @@ namespace kvr
                 
                 else if (val->is_integer ())
                 {
-                    int64_t n = val->get_integer ();
-                    
-                    if (n >= 0) // unsigned
-                    {
-                        if (n <= 127)
-                        {
-                            size += 1;
-                        }
-                        else if (n <= 0xff)
-                        {
-                            size += 2;
-                        }
-                        else if (n <= 0xffff)
-                        {
-                            size += 3;
-                        }
-                        else if (n <= 0xffffffff)
-                        {
-                            size += 5;
-                        }
-                        else
-                        {
-                            size += 9;
-                        }
-                    }
-                    else // signed
-                    {
-                        const int64_t nint5 = -((1 << 5) - 1);
-                        const int64_t nint8 = -((1 << 7) - 1);
-                        const int64_t nint16 = -((1 << 15) - 1);
-                        const int64_t nint32 = -((1LL << 31) - 1);
-                        
-                        if (n >= nint5)
-                        {
-                            size += 1;
-                        }
-                        else if (n >= nint8)
-                        {
-                            size += 2;
-                        }
-                        else if (n >= nint16)
-                        {
-                            size += 3;
-                        }
-                        else if (n >= nint32)
-                        {
-                            size += 5;
-                        }
-                        else
-                        {
-                            size += 9;
-                        }
-                    }
+                    size += write_approx_size_integer (val->get_integer ());
                 }
                 
                 else if (val->is_float ())
                 {
-#if KVR_FLAG_ENCODE_COMPACT_FP_PRECISION || KVR_MSGPACK_WRITE_COMPACT_FP_OVERRIDE
-                    const double fmin = std::numeric_limits<float>::min ();
-                    const double fmax = std::numeric_limits<float>::max ();
-                    
-                    double n = val->get_float ();
-                    if ((n >= fmin) && (n <= fmax))
-                    {
-                        size += 5;
-                    }
-                    else
-#endif
-                    {
-                        size += 9;
-                    }
+                    size += write_approx_size_float (val->get_float ());
                 }
                 
                 else if (val->is_boolean ())
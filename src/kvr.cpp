@@ -31,13 +31,66 @@ static const char * const kvr_const_str_rem   = "rem";
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-// type mask for kvr::m_flags
-static const uint32_t KVR_VALUE_TYPE_MASK = 0x000000ff;
 // delimiter token for path expressions
 static const char     KVR_TOKEN_DELIMITER = '/';
 // token for search grep expression
 static const char     KVR_TOKEN_MAP_GREP  = '@';
 
+#if KVR_64
+// kvr::value layout check (8 bytes data, 4 bytes length, 4 bytes flags and ctx index)
+typedef char kvr_static_assert_value_size [(sizeof (kvr::value) == 16) ? 1 : -1];
+#endif
+
+// kvr::frozen_doc::node layout check (8 bytes data, 4 bytes length, 4 bytes type)
+typedef char kvr_static_assert_frozen_node_size [(sizeof (kvr::frozen_doc::node) == 16) ? 1 : -1];
+
+// stream block sizes (the json writer reserves up to 25 bytes of its output block at a time)
+typedef char kvr_static_assert_stream_block_sz [((KVR_CONSTANT_ISTREAM_BLOCK_SZ >= 64u) && (KVR_CONSTANT_OSTREAM_BLOCK_SZ >= 64u)) ? 1 : -1];
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// kvr::allocator
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void * kvr::allocator::reallocate (void *p, size_t old_sz, size_t new_sz)
+{
+    void *np = this->allocate (new_sz);
+    if (np && p)
+    {
+        memcpy (np, p, (old_sz < new_sz) ? old_sz : new_sz);
+        this->deallocate (p, old_sz);
+    }
+    return np;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// kvr::istream
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t kvr::istream::read_some (uint8_t *bytes, size_t count)
+{
+    KVR_REF_UNUSED (bytes);
+    KVR_REF_UNUSED (count);
+    return 0u;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool kvr::istream::unread (size_t count)
+{
+    KVR_REF_UNUSED (count);
+    return false;
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
@@ -67,8 +120,18 @@ static kvr::allocator * get_default_allocator ()
     class kvr_default_allocator kvr_final : public kvr::allocator
     {
     public:
-        void * allocate (size_t sz)            { kvr_memory_track_ctr_incr (m_ctr, sz); return ::operator new (sz, std::nothrow); }
-        void   deallocate (void *p, size_t sz) { kvr_memory_track_ctr_decr (m_ctr, sz); return ::operator delete (p, std::nothrow); KVR_REF_UNUSED (sz); }
+        // malloc rather than operator new, so blocks can grow with realloc (in place, or
+        // by remapping pages for large ones) instead of allocate, copy and deallocate
+        void * allocate (size_t sz)            { kvr_memory_track_ctr_incr (m_ctr, sz); return malloc (sz); }
+        void   deallocate (void *p, size_t sz) { kvr_memory_track_ctr_decr (m_ctr, sz); free (p); KVR_REF_UNUSED (sz); }
+        void * reallocate (void *p, size_t old_sz, size_t new_sz)
+        {
+            if (!p) { return this->allocate (new_sz); }
+            void *np = realloc (p, new_sz);
+            if (np) { kvr_memory_track_ctr_decr (m_ctr, old_sz); kvr_memory_track_ctr_incr (m_ctr, new_sz); }
+            KVR_REF_UNUSED (old_sz);
+            return np;
+        }
         
         kvr_memory_track_ctr_decl (kvr_default_allocator, m_ctr);
     };
@@ -80,264 +143,692 @@ static kvr::allocator * get_default_allocator ()
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
-// kvr::ctx
+// kvr::pool_allocator
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::ctx * kvr::ctx::create (size_t ks_size, size_t vs_size, allocator *alloc)
+kvr::pool_allocator::pool_allocator (allocator *backing, size_t chunk_size) : 
+    m_chunks (NULL), m_ptr (NULL), m_end (NULL), m_chunk_sz (chunk_size), m_reserved (0), 
+    m_backing (backing ? backing : get_default_allocator ())
 {
-    KVR_ASSERT_SAFE ((ks_size > 0) && (vs_size > 0), NULL);
-    
-    allocator *a = alloc ? alloc : get_default_allocator ();
-    void *p = a->allocate (sizeof (kvr::ctx)); KVR_ASSERT (p);
-    kvr::ctx *ctx = p ? (new (p) kvr::ctx (ks_size, vs_size, a)) : NULL;
-    
-#if KVR_DEBUG && 0
-    uintptr_t ctxptr = reinterpret_cast<uintptr_t>(ctx);
-#if KVR_64
-    KVR_ASSERT ((ctxptr & 0x07) == 0);
-#else
-    KVR_ASSERT ((ctxptr & 0x03) == 0);
-#endif
-#endif
+    KVR_ASSERT (chunk_size >= (MAX_SIZE + sizeof (chunk)));
     
-    return ctx;
+    for (size_t i = 0; i < CLASS_COUNT; ++i)
+    {
+        m_free [i] = NULL;
+    }
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::ctx * kvr::ctx::create (allocator *alloc)
+kvr::pool_allocator::~pool_allocator ()
 {
-    return ctx::create (32, 8, alloc);
+    chunk *c = m_chunks;
+    while (c)
+    {
+        chunk *next = c->next;
+        m_backing->deallocate (c, c->size);
+        c = next;
+    }
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-void kvr::ctx::destroy (kvr::ctx *ctx)
+void * kvr::pool_allocator::allocate (size_t sz)
 {
-    KVR_ASSERT_SAFE (ctx, (void) 0);
-    allocator *a = ctx->m_allocator;
-    ctx->~ctx ();
-    a->deallocate (ctx, sizeof (kvr::ctx));
+    if (sz > MAX_SIZE)
+    {
+        return m_backing->allocate (sz);
+    }
+    
+    size_t csz = 0;
+    size_t ci = _class (sz, &csz);
+    
+    node *n = m_free [ci];
+    if (n)
+    {
+        m_free [ci] = n->next;
+        return n;
+    }
+    
+    return this->_carve (csz);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::ctx::ctx (size_t ks_size, size_t vs_size, allocator *a) : m_allocator (a)
+void kvr::pool_allocator::deallocate (void *p, size_t sz)
 {
-    KVR_ASSERT (a);
-    m_vstore.init (vs_size, m_allocator);
-    m_kstore.init (ks_size, this->_get_rand (), m_allocator);
+    if (!p)
+    {
+        return;
+    }
+    
+    if (sz > MAX_SIZE)
+    {
+        m_backing->deallocate (p, sz);
+        return;
+    }
+    
+    size_t csz = 0;
+    size_t ci = _class (sz, &csz);
+    
+    node *n = static_cast<node *>(p);
+    n->next = m_free [ci];
+    m_free [ci] = n;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::ctx::~ctx ()
+void * kvr::pool_allocator::reallocate (void *p, size_t old_sz, size_t new_sz)
 {
-    // clean up left-over values
-    for (size_t i = 0, c = m_vstore.used (); i < c; ++i)
+    if (p && (old_sz > MAX_SIZE) && (new_sz > MAX_SIZE))
     {
-        kvr::value *v = m_vstore.at (i);
-#if 1
-        KVR_ASSERT ((v->m_flags & kvr::value::FLAG_PARENT_CTX) != 0);
-        this->_destroy_value (kvr::value::FLAG_PARENT_CTX, v);
-#else
-        this->destroy_value (v);
-#endif
+        return m_backing->reallocate (p, old_sz, new_sz);
     }
     
-    // check all keys should have been cleaned up as well
-    KVR_ASSERT (m_kstore.used () == 0);
+    if (p && (old_sz <= MAX_SIZE) && (new_sz <= MAX_SIZE))
+    {
+        // same size class, same block
+        size_t ocsz = 0, ncsz = 0;
+        if (_class (old_sz, &ocsz) == _class (new_sz, &ncsz))
+        {
+            return p;
+        }
+    }
     
-    // destroy stores
-    m_vstore.deinit (m_allocator);
-    m_kstore.deinit (m_allocator);
+    return allocator::reallocate (p, old_sz, new_sz);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::value * kvr::ctx::create_value ()
+size_t kvr::pool_allocator::get_memory_reserved () const
 {
-    kvr::value *v = this->_create_value_null (kvr::value::FLAG_PARENT_CTX);
-    m_vstore.push_back (v, m_allocator);
-    return v;
+    return m_reserved;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-void kvr::ctx::destroy_value (value *v)
+size_t kvr::pool_allocator::_class (size_t sz, size_t *csz)
 {
-    if (this->_destroy_value (kvr::value::FLAG_PARENT_CTX, v))
+    KVR_ASSERT (sz <= MAX_SIZE);
+    KVR_ASSERT (csz);
+    
+    if (sz <= 256)
     {
-        m_vstore.remove (v);
+        size_t ci = (sz > 0) ? ((sz - 1) >> 4) : 0;
+        *csz = (ci + 1) << 4;
+        return ci;
     }
+    
+    // sz in (2^k, 2^(k+1)], k >= 8, split into 4 steps of 2^(k-2)
+    size_t k = 8;
+    while ((sz - 1) >> (k + 1))
+    {
+        ++k;
+    }
+    
+    size_t sub = (sz - 1 - (((size_t) 1) << k)) >> (k - 2);
+    *csz = (((size_t) 1) << k) + ((sub + 1) << (k - 2));
+    
+    size_t ci = 16 + ((k - 8) << 2) + sub;
+    KVR_ASSERT (ci < CLASS_COUNT);
+    return ci;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-size_t kvr::ctx::get_key_count ()
+void * kvr::pool_allocator::_carve (size_t csz)
 {
-    return m_kstore.used ();
+    if (csz > (size_t) (m_end - m_ptr))
+    {
+        // the tail of the current chunk is dropped (it's under MAX_SIZE)
+        chunk *c = (chunk *) m_backing->allocate (m_chunk_sz); KVR_ASSERT (c);
+        if (!c)
+        {
+            return NULL;
+        }
+        
+        c->next = m_chunks;
+        c->size = m_chunk_sz;
+        m_chunks = c;
+        m_reserved += m_chunk_sz;
+        
+        // class sizes are multiples of 16 so blocks stay 16-byte aligned
+        m_ptr = reinterpret_cast<uint8_t *>(c) + kvr::internal::align_size (sizeof (chunk), 16);
+        m_end = reinterpret_cast<uint8_t *>(c) + m_chunk_sz;
+    }
+    
+    void *p = m_ptr;
+    m_ptr += csz;
+    return p;
 }
 
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// kvr::ctx
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-size_t kvr::ctx::get_value_count ()
-{
-    return m_vstore.used ();
-}
+kvr::ctx **          kvr::ctx::s_registry [kvr::ctx::REGISTRY_SLOT_COUNT >> kvr::ctx::REGISTRY_PAGE_SHIFT];
+uint32_t             kvr::ctx::s_registry_top;
+uint32_t             kvr::ctx::s_registry_free;
+void * volatile      kvr::ctx::s_registry_lock;
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-void kvr::ctx::dump (int id) const
+kvr::ctx * kvr::ctx::create (size_t ks_size, size_t vs_size, allocator *alloc)
 {
-#if KVR_DEBUG
-    std::fprintf (stderr, "\n--------------------------------\n");
-    std::fprintf (stderr, "kvr ctx state debug dump [%02d]\n", id);
-    std::fprintf (stderr, "--------------------------------\n");
+    KVR_ASSERT_SAFE ((ks_size > 0) && (vs_size > 0), NULL);
     
-    m_vstore.dump ();
-    m_kstore.dump ();
+    allocator *a = alloc ? alloc : get_default_allocator ();
+    void *p = a->allocate (sizeof (kvr::ctx)); KVR_ASSERT (p);
+    kvr::ctx *ctx = p ? (new (p) kvr::ctx (ks_size, vs_size, a)) : NULL;
+    
+    if (ctx && !ctx->_register ())
+    {
+        ctx->~ctx ();
+        a->deallocate (ctx, sizeof (kvr::ctx));
+        ctx = NULL;
+    }
+    
+#if KVR_DEBUG && 0
+    uintptr_t ctxptr = reinterpret_cast<uintptr_t>(ctx);
+#if KVR_64
+    KVR_ASSERT ((ctxptr & 0x07) == 0);
 #else
-    KVR_REF_UNUSED (id);
+    KVR_ASSERT ((ctxptr & 0x03) == 0);
 #endif
+#endif
+    
+    return ctx;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::value * kvr::ctx::_create_value_null (uint32_t parentType)
+kvr::ctx * kvr::ctx::create (allocator *alloc)
 {
-    value *v = _create_value (parentType);
-    v->_conv_null ();
-    return v;
+    return ctx::create (32, 8, alloc);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::value * kvr::ctx::_create_value_map (uint32_t parentType)
+kvr::ctx * kvr::ctx::create_arena (size_t block_size, allocator *alloc)
 {
-    value *v = _create_value (parentType);
-    v->_conv_map ();
-    return v;
+    KVR_ASSERT_SAFE (block_size > sizeof (region::block), NULL);
+    
+    allocator *a = alloc ? alloc : get_default_allocator ();
+    void *p = a->allocate (sizeof (kvr::ctx)); KVR_ASSERT (p);
+    kvr::ctx *ctx = p ? (new (p) kvr::ctx (32, 8, a, block_size)) : NULL;
+    
+    if (ctx && !ctx->_register ())
+    {
+        ctx->~ctx ();
+        a->deallocate (ctx, sizeof (kvr::ctx));
+        ctx = NULL;
+    }
+    
+    return ctx;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::value * kvr::ctx::_create_value_array (uint32_t parentType)
+void kvr::ctx::destroy (kvr::ctx *ctx)
 {
-    value *v = _create_value (parentType);
-    v->_conv_array ();
-    return v;
+    KVR_ASSERT_SAFE (ctx, (void) 0);
+    allocator *a = ctx->m_region.m_backing;
+    ctx->~ctx ();
+    a->deallocate (ctx, sizeof (kvr::ctx));
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::value * kvr::ctx::_create_value_integer (uint32_t parentType, int64_t number)
+kvr::ctx::ctx (size_t ks_size, size_t vs_size, allocator *a, size_t region_block_sz) : m_allocator (a), m_borrowed (0), m_id (REGISTRY_SLOT_COUNT), m_intern (false)
 {
-    value *v = _create_value (parentType);
-#if KVR_FLAG_DISABLE_IMPLICIT_TYPE_CONVERSION
-    v->_conv_integer ();
-#endif
-    v->set_integer (number);
-    return v;
+    KVR_ASSERT (a);
+    memset ((void *) &m_sstore, 0, sizeof (m_sstore)); // created by intern_strings
+    m_region.init (region_block_sz, a);
+    if (region_block_sz > 0)
+    {
+        m_allocator = &m_region;
+    }
+    m_vstore.init (vs_size, m_allocator);
+    m_kstore.init (ks_size, this->_get_rand (), m_allocator);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::value * kvr::ctx::_create_value_float (uint32_t parentType, double number)
+kvr::ctx::~ctx ()
 {
-    value *v = _create_value (parentType);
-#if KVR_FLAG_DISABLE_IMPLICIT_TYPE_CONVERSION
-    v->_conv_float ();
+    if (m_allocator == &m_region)
+    {
+        // values, keys and stores all live in the region
+        m_region.deinit ();
+    }
+    else
+    {
+        // clean up left-over values
+        this->_destroy_values ();
+        
+        // check all keys should have been cleaned up as well (pinned keys live until now)
+#if KVR_DEBUG
+        for (size_t i = 0, c = m_kstore.m_size; i < c; ++i)
+        {
+            key *k = m_kstore.m_slots [i].k;
+            KVR_ASSERT (!k || k->is_pinned ());
+        }
+        KVR_ASSERT (!m_sstore.m_slots || (m_sstore.used () == 0));
 #endif
-    v->set_float (number);
-    return v;
+        
+        // destroy stores
+        m_vstore.deinit (m_allocator);
+        m_kstore.deinit (m_allocator);
+        if (m_sstore.m_slots)
+        {
+            m_sstore.deinit (m_allocator);
+        }
+    }
+    
+    // last: values look their ctx up while being destroyed (a failed create never registered)
+    if (m_id < REGISTRY_SLOT_COUNT)
+    {
+        this->_unregister ();
+    }
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::value * kvr::ctx::_create_value_boolean (uint32_t parentType, bool boolean)
+void kvr::ctx::reset ()
 {
-    value *v = _create_value (parentType);
-#if KVR_FLAG_DISABLE_IMPLICIT_TYPE_CONVERSION
-    v->_conv_boolean ();
-#endif
-    v->set_boolean (boolean);
-    return v;
+    // every value and key goes, including interned and pinned keys
+    size_t kssz = m_kstore.m_min;
+    size_t sssz = m_sstore.m_min;
+    size_t vssz = m_vstore.m_size;
+    uint32_t seed = m_kstore.m_seed;
+    
+    if (m_allocator == &m_region)
+    {
+        m_region.reset ();
+    }
+    else
+    {
+        this->_destroy_values ();
+        m_vstore.deinit (m_allocator);
+        m_kstore.deinit (m_allocator);
+        if (m_sstore.m_slots)
+        {
+            m_sstore.deinit (m_allocator);
+        }
+    }
+    
+    m_vstore.init (vssz, m_allocator);
+    m_kstore.init (kssz, seed, m_allocator);
+    if (m_sstore.m_slots)
+    {
+        m_sstore.init (sssz, m_sstore.m_seed, m_allocator);
+    }
+    
+    // arena values go without being destroyed, so nothing counted their borrowed strings down
+    m_borrowed = 0;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::value * kvr::ctx::_create_value_string (uint32_t parentType, const char *str, sz_t len)
+bool kvr::ctx::_register ()
 {
-    KVR_ASSERT (str);
+    // values store a slot index instead of a ctx pointer. released slots are reused first
+    // (each holds the next free slot, tagged in the low bit), then pages are added as needed
+    kvr::internal::spin_lock (&s_registry_lock, this);
     
-    value *v = _create_value (parentType);
-#if KVR_FLAG_DISABLE_IMPLICIT_TYPE_CONVERSION
-    v->_conv_string ();
-#endif
-    v->set_string (str, len);
-    return v;
+    uint32_t id = REGISTRY_SLOT_COUNT;
+    if (s_registry_free)
+    {
+        id = s_registry_free - 1;
+        uintptr_t next = (uintptr_t) s_registry [id >> REGISTRY_PAGE_SHIFT][id & REGISTRY_PAGE_MASK];
+        KVR_ASSERT (next & 1);
+        s_registry_free = (uint32_t) (next >> 1);
+    }
+    else if (s_registry_top < REGISTRY_SLOT_COUNT)
+    {
+        ctx **&page = s_registry [s_registry_top >> REGISTRY_PAGE_SHIFT];
+        if (!page)
+        {
+            // pages are shared by every ctx and outlive them, so they come straight from the heap
+            page = (ctx **) calloc (REGISTRY_PAGE_MASK + 1, sizeof (ctx *));
+        }
+        id = page ? s_registry_top++ : REGISTRY_SLOT_COUNT;
+    }
+    
+    if (id < REGISTRY_SLOT_COUNT)
+    {
+        s_registry [id >> REGISTRY_PAGE_SHIFT][id & REGISTRY_PAGE_MASK] = this;
+        m_id = id;
+    }
+    
+    kvr::internal::spin_unlock (&s_registry_lock, this);
+    
+    KVR_ASSERT ((id < REGISTRY_SLOT_COUNT) && "out of ctx registry slots");
+    return (id < REGISTRY_SLOT_COUNT);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::value * kvr::ctx::_create_value (uint32_t parentType)
+void kvr::ctx::_unregister ()
 {
-    KVR_ASSERT (m_allocator);
+    KVR_ASSERT (m_id < s_registry_top);
+    KVR_ASSERT (s_registry [m_id >> REGISTRY_PAGE_SHIFT][m_id & REGISTRY_PAGE_MASK] == this);
     
-    void *p = m_allocator->allocate (sizeof (kvr::value)); KVR_ASSERT (p);
-    kvr::value *v = p ? (new (p) kvr::value (this, parentType)) : NULL;
-    return v;
+    kvr::internal::spin_lock (&s_registry_lock, this);
+    
+    uintptr_t next = ((uintptr_t) s_registry_free << 1) | 1;
+    s_registry [m_id >> REGISTRY_PAGE_SHIFT][m_id & REGISTRY_PAGE_MASK] = (ctx *) next;
+    s_registry_free = m_id + 1;
+    
+    kvr::internal::spin_unlock (&s_registry_lock, this);
+    
+    m_id = REGISTRY_SLOT_COUNT;
 }
 
-/////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-bool kvr::ctx::_destroy_value (uint32_t parentType, value *v)
+kvr::value * kvr::ctx::create_value ()
 {
-    KVR_ASSERT (v);
-    
-    if (v && ((v->m_flags & parentType) != 0))
+    void *p = m_vstore.push_back (m_allocator); KVR_ASSERT (p);
+    kvr::value *v = p ? (new (p) kvr::value (this, kvr::value::FLAG_PARENT_CTX)) : NULL;
+    if (v)
     {
-        v->_destruct ();
-        m_allocator->deallocate (v, sizeof (kvr::value));
+        v->_conv_null ();
+    }
+    return v;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void kvr::ctx::destroy_value (value *v)
+{
+    KVR_ASSERT (v);
+    
+    if (v && ((v->m_flags & kvr::value::FLAG_PARENT_MASK) == kvr::value::FLAG_PARENT_CTX))
+    {
+        v->_destruct ();
+        m_vstore.remove (v, m_allocator);
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t kvr::ctx::get_key_count ()
+{
+    return m_kstore.used ();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void kvr::ctx::intern_strings (bool enable)
+{
+    // strings set from now on are pooled (or not); existing values keep their storage
+    if (enable && !m_sstore.m_slots)
+    {
+        m_sstore.init (32, this->_get_rand (), m_allocator);
+    }
+    m_intern = enable;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t kvr::ctx::get_string_count ()
+{
+    return m_sstore.m_slots ? m_sstore.used () : 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::key * kvr::ctx::intern (const char *str)
+{
+    KVR_ASSERT (str);
+    return this->intern (str, (sz_t) strlen (str));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::key * kvr::ctx::intern (const char *str, sz_t len)
+{
+    KVR_ASSERT (str);
+    
+    // the handle holds its own reference, so the key outlives any map entries using it
+    return this->_create_key (str, len);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::key * kvr::ctx::pin (const char *str)
+{
+    KVR_ASSERT (str);
+    return this->pin (str, (sz_t) strlen (str));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::key * kvr::ctx::pin (const char *str, sz_t len)
+{
+    KVR_ASSERT (str);
+    
+    // pinned keys skip reference counting and stay in the store until the ctx is destroyed
+    key *k = this->_create_key (str, len);
+    k->m_ref = key::REF_PINNED;
+    return k;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void kvr::ctx::release (key *k)
+{
+    KVR_ASSERT (k);
+    KVR_ASSERT_SAFE (m_kstore.owns (k) && "key handle from another ctx", (void) 0);
+    
+    this->_destroy_key (k);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t kvr::ctx::get_value_count ()
+{
+    return m_vstore.used ();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void kvr::ctx::dump (int id) const
+{
+#if KVR_DEBUG
+    std::fprintf (stderr, "\n--------------------------------\n");
+    std::fprintf (stderr, "kvr ctx state debug dump [%02d]\n", id);
+    std::fprintf (stderr, "--------------------------------\n");
+    
+    m_vstore.dump ();
+    m_kstore.dump ();
+    if (m_sstore.m_slots)
+    {
+        m_sstore.dump ();
+    }
+#else
+    KVR_REF_UNUSED (id);
+#endif
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::ctx::_create_value_null (uint32_t parentType)
+{
+    value *v = _create_value (parentType);
+    v->_conv_null ();
+    return v;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::ctx::_create_value_map (uint32_t parentType)
+{
+    value *v = _create_value (parentType);
+    v->_conv_map ();
+    return v;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::ctx::_create_value_array (uint32_t parentType)
+{
+    value *v = _create_value (parentType);
+    v->_conv_array ();
+    return v;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::ctx::_create_value_integer (uint32_t parentType, int64_t number)
+{
+    value *v = _create_value (parentType);
+#if KVR_FLAG_DISABLE_IMPLICIT_TYPE_CONVERSION
+    v->_conv_integer ();
+#endif
+    v->set_integer (number);
+    return v;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::ctx::_create_value_float (uint32_t parentType, double number)
+{
+    value *v = _create_value (parentType);
+#if KVR_FLAG_DISABLE_IMPLICIT_TYPE_CONVERSION
+    v->_conv_float ();
+#endif
+    v->set_float (number);
+    return v;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::ctx::_create_value_boolean (uint32_t parentType, bool boolean)
+{
+    value *v = _create_value (parentType);
+#if KVR_FLAG_DISABLE_IMPLICIT_TYPE_CONVERSION
+    v->_conv_boolean ();
+#endif
+    v->set_boolean (boolean);
+    return v;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::ctx::_create_value_string (uint32_t parentType, const char *str, sz_t len)
+{
+    KVR_ASSERT (str);
+    
+    value *v = _create_value (parentType);
+#if KVR_FLAG_DISABLE_IMPLICIT_TYPE_CONVERSION
+    v->_conv_string ();
+#endif
+    v->set_string (str, len);
+    return v;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::ctx::_create_value (uint32_t parentType)
+{
+    KVR_ASSERT (m_allocator);
+    
+    void *p = m_allocator->allocate (sizeof (kvr::value)); KVR_ASSERT (p);
+    kvr::value *v = p ? (new (p) kvr::value (this, parentType)) : NULL;
+    return v;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool kvr::ctx::_destroy_value (uint32_t parentType, value *v)
+{
+    KVR_ASSERT (v);
+    
+    if (v && ((v->m_flags & kvr::value::FLAG_PARENT_MASK) == parentType))
+    {
+        v->_destruct ();
+        m_allocator->deallocate (v, sizeof (kvr::value));
         return true;
     }
     
@@ -360,6 +851,18 @@ kvr::key * kvr::ctx::_find_key (const char *str)
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
+kvr::key * kvr::ctx::_find_key (const char *str, sz_t len)
+{
+    KVR_ASSERT (str);
+    
+    key *k = m_kstore.find (str, len);
+    return k;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
 kvr::key *kvr::ctx::_create_key (const char *str)
 {
     KVR_ASSERT (str);
@@ -372,10 +875,9 @@ kvr::key *kvr::ctx::_create_key (const char *str)
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::key * kvr::ctx::_create_key (char *str, sz_t len)
+kvr::key *kvr::ctx::_create_key (const char *str, sz_t len)
 {
     KVR_ASSERT (str);
-    KVR_ASSERT (len > 0);
     
     key *k = m_kstore.insert (str, len, m_allocator);
     return k;
@@ -385,6 +887,19 @@ kvr::key * kvr::ctx::_create_key (char *str, sz_t len)
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
+kvr::key * kvr::ctx::_create_key_move (char *str, sz_t len)
+{
+    KVR_ASSERT (str);
+    KVR_ASSERT (len > 0);
+    
+    key *k = m_kstore.insert_move (str, len, m_allocator);
+    return k;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
 void kvr::ctx::_destroy_key (kvr::key *k)
 {
     KVR_ASSERT (k);
@@ -463,11 +978,26 @@ void kvr::ctx::_destroy_path_expr (char *expr, sz_t exprsz)
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-uint32_t kvr::ctx::_get_rand ()
+void kvr::ctx::_destroy_values ()
 {
-#if KVR_INTERNAL_FLAG_DEBUG_CTX_KEY_STORE_RAND_OFF
-    return 5381;
-#elif KVR_CPP11
+    for (size_t i = 0, c = m_vstore.used (); i < c; ++i)
+    {
+        kvr::value *v = m_vstore.at (i);
+        KVR_ASSERT ((v->m_flags & kvr::value::FLAG_PARENT_MASK) == kvr::value::FLAG_PARENT_CTX);
+        v->_destruct ();
+    }
+    m_vstore.clear (m_allocator);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t kvr::ctx::_get_rand ()
+{
+#if KVR_INTERNAL_FLAG_DEBUG_CTX_KEY_STORE_RAND_OFF
+    return 5381;
+#elif KVR_CPP11
     std::random_device rd;
     std::mt19937 mt (rd ());
     uint32_t r = mt ();
@@ -502,11 +1032,16 @@ uint32_t kvr::ctx::_get_rand ()
 void kvr::ctx::key_store::init (size_t cap, uint32_t hfseed, allocator *a)
 {
     KVR_ASSERT (a);
+    KVR_ASSERT (cap > 0);
     
-    m_keys = (key **) a->allocate (sizeof (key *) * cap); KVR_ASSERT (m_keys);
-    memset (m_keys, 0, sizeof (key *) * cap);
-    m_size = cap;
+    size_t size = 1;
+    while (size < cap) { size <<= 1; }
+    
+    m_slots = (slot *) a->allocate (sizeof (slot) * size); KVR_ASSERT (m_slots);
+    memset ((void *) m_slots, 0, sizeof (slot) * size);
+    m_size = size;
     m_used = 0;
+    m_min = size;
     m_seed = hfseed;
 }
 
@@ -520,16 +1055,15 @@ void kvr::ctx::key_store::deinit (allocator *a)
     
     for (size_t i = 0, c = m_size; i < c; ++i)
     {
-        key *k = m_keys [i];
+        key *k = m_slots [i].k;
         if (k)
         {
-            if (k->m_str) { a->deallocate (k->m_str, k->m_len + 1); }
+            a->deallocate (k->m_str, k->m_len + 1);
             a->deallocate (k, sizeof (key));
-            k = NULL;
         }
     }
     
-    a->deallocate (m_keys, sizeof (key *) * m_size);
+    a->deallocate (m_slots, sizeof (slot) * m_size);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
@@ -539,48 +1073,27 @@ void kvr::ctx::key_store::deinit (allocator *a)
 void kvr::ctx::key_store::resize (size_t new_sz, allocator *a)
 {
     KVR_ASSERT (a);
+    KVR_ASSERT ((new_sz & (new_sz - 1)) == 0);
+    KVR_ASSERT (new_sz > m_used);
+    
+    slot *old_slots = m_slots;
+    size_t old_sz = m_size;
     
     // create new buffer
-    key ** new_keys = (key **) a->allocate (sizeof (key *) * new_sz); KVR_ASSERT (new_keys);
-    memset (new_keys, 0, sizeof (key *) * new_sz);
+    m_slots = (slot *) a->allocate (sizeof (slot) * new_sz); KVR_ASSERT (m_slots);
+    memset ((void *) m_slots, 0, sizeof (slot) * new_sz);
+    m_size = new_sz;
     
-    // rehash and copy to new buffer
-#if KVR_DEBUG
-    size_t new_used = 0;
-#endif
-    for (size_t i = 0, c = m_size; i < c; ++i)
+    // rehash into new buffer
+    for (size_t i = 0; i < old_sz; ++i)
     {
-        key *k = m_keys [i];
-        if (k)
+        if (old_slots [i].k)
         {
-            if (!k->m_str) // free erased keys
-            {
-                a->deallocate (k, sizeof (key));
-            }
-            else
-            {
-                uint32_t ni = k->m_hash % new_sz;
-                key *nk = new_keys [ni];
-                while (nk)
-                {
-                    ni = (ni + 1) % new_sz;
-                    nk = new_keys [ni];
-                }
-                new_keys [ni] = k;
-#if KVR_DEBUG
-                new_used++;
-#endif
-            }
+            this->_place (old_slots [i]);
         }
     }
-#if KVR_DEBUG
-    KVR_ASSERT (m_used == new_used);
-#endif
     
-    // set new buffer
-    a->deallocate (m_keys, sizeof (key *) * m_size);
-    m_keys = new_keys;
-    m_size = new_sz;
+    a->deallocate (old_slots, sizeof (slot) * old_sz);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
@@ -590,105 +1103,57 @@ void kvr::ctx::key_store::resize (size_t new_sz, allocator *a)
 kvr::key * kvr::ctx::key_store::insert (const char *str, allocator *a)
 {
     KVR_ASSERT (str);
-    KVR_ASSERT (a);
-    
-    if (m_used > (m_size * 2 / 3))
-    {
-        this->resize (m_size + m_size, a);
-    }
     
-    uint32_t h = kvr::internal::djb_hash (str, m_seed);
-    uint32_t i = h % m_size;
-    key *k = m_keys [i];
+    return this->insert (str, strlen (str), a);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::key * kvr::ctx::key_store::insert (const char *str, size_t len, allocator *a)
+{
+    KVR_ASSERT (str);
+    KVR_ASSERT (a);
     
-    while (k)
-    {
-        if (!k->m_str) // erased
-        {
-            break;
-        }
-        
-        if ((k->m_hash == h) && (std::strcmp (k->m_str, str) == 0))
-        {
-            ++(k->m_ref);
-            return k;
-        }
-        
-        i = (i + 1) % m_size;
-        k = m_keys [i];
-    }
+    uint32_t h = kvr::internal::hash (str, len, m_seed);
+    size_t i = this->_probe (str, len, h);
     
-    if (k == NULL)
+    if (i < m_size)
     {
-        k = (key *) a->allocate (sizeof (key)); KVR_ASSERT (k);
+        key *k = m_slots [i].k;
+        k->_retain ();
+        return k;
     }
-    // else re-use erased key
     
-    size_t len = strlen (str);
+    // str need not be null-terminated
     char *cstr = (char *) a->allocate (len + 1); KVR_ASSERT (cstr);
-    kvr_strcpy (cstr, len + 1, str);
-    
-    k->m_str = cstr;
-    k->m_len = static_cast<uint16_t>(len);
-    k->m_hash = h;
-    k->m_ref = 1;
+    memcpy (cstr, str, len);
+    cstr [len] = 0;
     
-    m_keys [i] = k;
-    m_used++;
-    
-    return k;
+    return this->_insert (cstr, len, h, a);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::key * kvr::ctx::key_store::insert (char *str, sz_t len, allocator *a)
+kvr::key * kvr::ctx::key_store::insert_move (char *str, sz_t len, allocator *a)
 {
     KVR_ASSERT (str);
     KVR_ASSERT (a);
     
-    if (m_used > (m_size * 2 / 3))
-    {
-        this->resize (m_size + m_size, a);
-    }
-    
-    uint32_t h = kvr::internal::djb_hash (str, m_seed);
-    uint32_t i = h % m_size;
-    key *k = m_keys [i];
-    
-    while (k)
-    {
-        if (!k->m_str) // erased
-        {
-            break;
-        }
-        
-        if ((k->m_hash == h) && (std::strcmp (k->m_str, str) == 0))
-        {
-            ++(k->m_ref);
-            return k;
-        }
-        
-        i = (i + 1) % m_size;
-        k = m_keys [i];
-    }
+    uint32_t h = kvr::internal::hash (str, len, m_seed);
+    size_t i = this->_probe (str, len, h);
     
-    if (k == NULL)
+    if (i < m_size)
     {
-        k = (key *) a->allocate (sizeof (key)); KVR_ASSERT (k);
+        key *k = m_slots [i].k;
+        k->_retain (); // caller keeps ownership of str (see m_ref > 1)
+        return k;
     }
-    // else re-use erased key
-    
-    k->m_str = str;
-    k->m_len = static_cast<uint16_t>(len);
-    k->m_hash = h;
-    k->m_ref = 1;
-    
-    m_keys [i] = k;
-    m_used++;
     
-    return k;
+    return this->_insert (str, len, h, a);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
@@ -699,87 +1164,90 @@ kvr::key * kvr::ctx::key_store::find (const char *str) const
 {
     KVR_ASSERT (str);
     
-    uint32_t h = kvr::internal::djb_hash (str, m_seed);
-    uint32_t i = h % m_size;
-    key *k = m_keys [i];
+    return this->find (str, strlen (str));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::key * kvr::ctx::key_store::find (const char *str, size_t len) const
+{
+    KVR_ASSERT (str);
     
-    while (k)
-    {
-        if (k->m_str && (k->m_hash == h) && (std::strcmp (k->m_str, str) == 0))
-        {
-            return k;
-        }
-        
-        i = (i + 1) % m_size;
-        k = m_keys [i];
-    }
+    uint32_t h = kvr::internal::hash (str, len, m_seed);
+    size_t i = this->_probe (str, len, h);
     
-    return k;
+    return (i < m_size) ? m_slots [i].k : NULL;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-void kvr::ctx::key_store::erase (key *k, allocator *a)
+bool kvr::ctx::key_store::owns (const key *k) const
 {
     KVR_ASSERT (k);
-    KVR_ASSERT (a);
     
-    if (k->m_str)
+    // by address, probing from the key's home slot (its hash is seeded per store, so a
+    // foreign key ends up somewhere else and is never matched)
+    const size_t mask = m_size - 1;
+    size_t i = k->m_hash & mask;
+    
+    for (size_t d = 0; m_slots [i].k && (d <= this->_dist (i)); ++d)
     {
-        if ((--k->m_ref) == 0)
+        if (m_slots [i].k == k)
         {
-            a->deallocate (k->m_str, k->m_len + 1);
-            
-            k->m_str = NULL;
-            k->m_len = 0;
-            k->m_hash = 0;
-            
-            m_used--;
-            
-#if 0
-            if ((m_size > 32) && m_used < (m_size * 1 / 3))
-            {
-                this->resize (m_size / 2, a);
-            }
-#endif
+            return true;
         }
+        i = (i + 1) & mask;
     }
+    
+    return false;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-void kvr::ctx::key_store::erase (const char *str, allocator *a)
+void kvr::ctx::key_store::erase (key *k, allocator *a)
 {
+    KVR_ASSERT (k);
+    KVR_ASSERT (k->m_str);
     KVR_ASSERT (a);
     
-    uint32_t h = kvr::internal::djb_hash (str, m_seed);
-    uint32_t i = h % m_size;
-    key *k = m_keys [i];
-    
-    while (k)
+    if (k->_release ())
     {
-        if (k->m_str && (k->m_hash == h) && (std::strcmp (k->m_str, str) == 0))
+        const size_t mask = m_size - 1;
+        size_t i = k->m_hash & mask;
+        
+        while (m_slots [i].k != k)
         {
-            if ((--k->m_ref) == 0)
-            {
-                a->deallocate (k->m_str, k->m_len + 1);
-                
-                k->m_str = NULL;
-                k->m_len = 0;
-                k->m_hash = 0;
-                
-                m_used--;
-            }
-            
-            return;
+            KVR_ASSERT (m_slots [i].k);
+            i = (i + 1) & mask;
         }
         
-        i = (i + 1) % m_size;
-        k = m_keys [i];
+        // backward shift deletion: pull displaced slots one step closer to home
+        size_t j = (i + 1) & mask;
+        while (m_slots [j].k && (this->_dist (j) > 0))
+        {
+            m_slots [i] = m_slots [j];
+            i = j;
+            j = (j + 1) & mask;
+        }
+        
+        m_slots [i].k = NULL;
+        m_slots [i].hash = 0;
+        m_slots [i].len = 0;
+        
+        a->deallocate (k->m_str, k->m_len + 1);
+        a->deallocate (k, sizeof (key));
+        m_used--;
+        
+        if ((m_size > m_min) && (m_used < (size_t) (m_size * KVR_CONSTANT_KEY_STORE_SHRINK_LOAD)))
+        {
+            this->resize (m_size / 2, a);
+        }
     }
 }
 
@@ -808,22 +1276,128 @@ float kvr::ctx::key_store::load_factor () const
 void kvr::ctx::key_store::dump () const
 {
 #if KVR_DEBUG
+    size_t plsum = 0, plmax = 0;
+    for (size_t i = 0, c = m_size; i < c; ++i)
+    {
+        if (m_slots [i].k)
+        {
+            size_t d = this->_dist (i);
+            plsum += d;
+            plmax = (d > plmax) ? d : plmax;
+        }
+    }
+    
     std::fprintf (stderr, "key_store size: %zu\n", m_size);
     std::fprintf (stderr, "key_store used: %zu\n", m_used);
     std::fprintf (stderr, "key_store load_factor: %f\n", this->load_factor ());
+    std::fprintf (stderr, "key_store probe length: %f avg, %zu max\n", m_used ? ((double) plsum / (double) m_used) : 0.0, plmax);
     
     std::fprintf (stderr, "key_store keys: \n");
     for (size_t i = 0, c = m_size; i < c; ++i)
     {
-        key *k = m_keys [i];
-        if (k && k->m_str)
+        key *k = m_slots [i].k;
+        if (k)
         {
-            std::fprintf (stderr, "\t%zu: %s [%u]\n", i, k->m_str, k->m_ref);
+            std::fprintf (stderr, "\t%zu: %s [%u]\n", i, k->m_str, (unsigned) k->m_ref);
         }
     }
 #endif
 }
 
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t kvr::ctx::key_store::_dist (size_t i) const
+{
+    // probe distance of slot i from its home slot
+    KVR_ASSERT (m_slots [i].k);
+    return (i - (m_slots [i].hash & (m_size - 1))) & (m_size - 1);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t kvr::ctx::key_store::_probe (const char *str, size_t len, uint32_t h) const
+{
+    const size_t mask = m_size - 1;
+    size_t i = h & mask;
+    
+    // robin hood invariant: stop once the probe is further from home than the slot
+    for (size_t d = 0; m_slots [i].k && (d <= this->_dist (i)); ++d)
+    {
+        const slot &s = m_slots [i];
+        if ((s.hash == h) && (s.len == len) && (memcmp (s.k->m_str, str, len) == 0))
+        {
+            return i;
+        }
+        i = (i + 1) & mask;
+    }
+    
+    return m_size;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::key * kvr::ctx::key_store::_insert (char *str, size_t len, uint32_t h, allocator *a)
+{
+    KVR_ASSERT (str);
+    KVR_ASSERT (a);
+    
+    if (((m_used + 1) * 3) > (m_size * 2))
+    {
+        this->resize (m_size + m_size, a);
+    }
+    
+    key *k = (key *) a->allocate (sizeof (key)); KVR_ASSERT (k);
+    k->m_str = str;
+    KVR_ASSERT ((uint64_t) len <= SZ_T_MAX);
+    k->m_len = static_cast<sz_t>(len);
+    k->m_hash = h;
+    k->m_ref = 1;
+    
+    slot s;
+    s.k = k;
+    s.hash = h;
+    s.len = static_cast<uint32_t>(len);
+    
+    this->_place (s);
+    m_used++;
+    
+    return k;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void kvr::ctx::key_store::_place (slot s)
+{
+    const size_t mask = m_size - 1;
+    size_t i = s.hash & mask;
+    size_t d = 0;
+    
+    // robin hood: take the slot of any entry closer to its home than we are
+    while (m_slots [i].k)
+    {
+        size_t sd = this->_dist (i);
+        if (sd < d)
+        {
+            slot tmp = m_slots [i];
+            m_slots [i] = s;
+            s = tmp;
+            d = sd;
+        }
+        i = (i + 1) & mask;
+        ++d;
+    }
+    
+    m_slots [i] = s;
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
@@ -856,44 +1430,53 @@ void kvr::ctx::val_store::deinit (allocator *a)
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-void kvr::ctx::val_store::push_back (value *v, allocator *a)
+void *kvr::ctx::val_store::push_back (allocator *a)
 {
     KVR_ASSERT (a);
     
+    // root values are allocated with their store slot in front
+    slot *s = (slot *) a->allocate (sizeof (slot) + sizeof (value)); KVR_ASSERT (s);
+    if (!s)
+    {
+        return NULL;
+    }
+    
     if (m_used >= m_size)
     {
         size_t new_sz = m_size + m_size;
-        value **new_data = (value **) a->allocate (sizeof (value *) * new_sz); KVR_ASSERT (new_data);
-        memcpy (new_data, m_data, sizeof (value *) * m_size);
-        a->deallocate (m_data, sizeof (value *) * m_size);
+        value **new_data = (value **) a->reallocate (m_data, sizeof (value *) * m_size, sizeof (value *) * new_sz); KVR_ASSERT (new_data);
         m_data = new_data;
         m_size = new_sz;
     }
     
+    s->index = m_used;
+    value *v = reinterpret_cast<value *>(s + 1);
     m_data [m_used++] = v;
+    
+    return v;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-void kvr::ctx::val_store::remove (value *v)
+void kvr::ctx::val_store::remove (value *v, allocator *a)
 {
     KVR_ASSERT (v);
+    KVR_ASSERT (a);
+    KVR_ASSERT (m_used > 0);
     
-    for (size_t i = m_used; i >= 1; --i)
-    {
-        size_t idx = i - 1;
-        if (m_data [idx] == v)
-        {
-            for (size_t j = idx + 1; j < m_used; ++j)
-            {
-                m_data [j - 1] = m_data [j];
-            }
-            m_data [--m_used] = NULL;
-            break;
-        }
-    }
+    slot *s = reinterpret_cast<slot *>(v) - 1;
+    size_t idx = s->index;
+    KVR_ASSERT ((idx < m_used) && (m_data [idx] == v));
+    
+    // move last value into the vacated slot
+    value *last = m_data [--m_used];
+    m_data [idx] = last;
+    (reinterpret_cast<slot *>(last) - 1)->index = idx;
+    m_data [m_used] = NULL;
+    
+    a->deallocate (s, sizeof (slot) + sizeof (value));
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
@@ -918,8 +1501,16 @@ kvr::value * kvr::ctx::val_store::at (size_t index)
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-void kvr::ctx::val_store::clear ()
+void kvr::ctx::val_store::clear (allocator *a)
 {
+    KVR_ASSERT (a);
+    
+    for (size_t i = 0; i < m_used; ++i)
+    {
+        slot *s = reinterpret_cast<slot *>(m_data [i]) - 1;
+        a->deallocate (s, sizeof (slot) + sizeof (value));
+    }
+    
     memset (m_data, 0, sizeof (value *) * m_size);
     m_used = 0;
 }
@@ -939,67 +1530,232 @@ void kvr::ctx::val_store::dump () const
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
-// kvr::value
+// kvr::ctx::region
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::value * kvr::value::as_map (sz_t sz)
+void kvr::ctx::region::init (size_t block_sz, allocator *a)
 {
-    this->_conv_map(sz);
-    return this;
+    KVR_ASSERT (a);
+    
+    m_head = NULL;
+    m_ptr = NULL;
+    m_end = NULL;
+    m_block_sz = block_sz;
+    m_backing = a;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::value * kvr::value::as_array (sz_t sz)
+void kvr::ctx::region::deinit ()
 {
-    this->_conv_array(sz);
-    return this;
+    block *b = m_head;
+    while (b)
+    {
+        block *next = b->next;
+        m_backing->deallocate (b, b->size);
+        b = next;
+    }
+    
+    m_head = NULL;
+    m_ptr = NULL;
+    m_end = NULL;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::value * kvr::value::as_string ()
+void kvr::ctx::region::reset ()
 {
-    this->_conv_string();
-    return this;
+    // keep the most recent full-sized block for reuse, release the rest
+    block *keep = (m_head && (m_head->size == m_block_sz)) ? m_head : NULL;
+    block *b = keep ? keep->next : m_head;
+    while (b)
+    {
+        block *next = b->next;
+        m_backing->deallocate (b, b->size);
+        b = next;
+    }
+    
+    m_head = keep;
+    m_ptr = keep ? reinterpret_cast<uint8_t *>(keep + 1) : NULL;
+    m_end = keep ? (reinterpret_cast<uint8_t *>(keep) + keep->size) : NULL;
+    if (keep)
+    {
+        keep->next = NULL;
+    }
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::value * kvr::value::as_boolean ()
+void * kvr::ctx::region::allocate (size_t sz)
 {
-    this->_conv_boolean();
-    return this;
+    // 8-byte alignment covers every kvr allocation (pointers, int64_t, double)
+    sz = (sz + 7u) & ~((size_t) 7u);
+    
+    if (sz > (size_t) (m_end - m_ptr))
+    {
+        const size_t hdr = sizeof (block);
+        if (sz > ((m_block_sz - hdr) >> 2))
+        {
+            // oversized: gets a block to itself, current block stays in use
+            block *b = this->_grow (hdr + sz, false);
+            return b ? (b + 1) : NULL;
+        }
+        
+        if (!this->_grow (m_block_sz, true))
+        {
+            return NULL;
+        }
+    }
+    
+    void *p = m_ptr;
+    m_ptr += sz;
+    return p;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::value * kvr::value::as_integer ()
+void kvr::ctx::region::deallocate (void *p, size_t sz)
 {
-    this->_conv_integer();
-    return this;
+    // memory is only reclaimed by reset/deinit
+    KVR_REF_UNUSED (p);
+    KVR_REF_UNUSED (sz);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::value * kvr::value::as_float ()
+void * kvr::ctx::region::reallocate (void *p, size_t old_sz, size_t new_sz)
 {
-    this->_conv_float();
-    return this;
-}
-
+    // the most recent allocation grows in place while its block has room
+    size_t osz = (old_sz + 7u) & ~((size_t) 7u);
+    size_t nsz = (new_sz + 7u) & ~((size_t) 7u);
+    
+    if (p && (nsz <= osz))
+    {
+        return p;
+    }
+    
+    if (p && ((static_cast<uint8_t *>(p) + osz) == m_ptr) && ((nsz - osz) <= (size_t) (m_end - m_ptr)))
+    {
+        m_ptr += (nsz - osz);
+        return p;
+    }
+    
+    return allocator::reallocate (p, old_sz, new_sz);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::ctx::region::block * kvr::ctx::region::_grow (size_t size, bool current)
+{
+    KVR_ASSERT (m_backing);
+    KVR_ASSERT (size > sizeof (block));
+    
+    block *b = (block *) m_backing->allocate (size); KVR_ASSERT (b);
+    if (!b)
+    {
+        return NULL;
+    }
+    
+    b->size = size;
+    
+    if (!current && m_head)
+    {
+        b->next = m_head->next;
+        m_head->next = b;
+    }
+    else
+    {
+        b->next = m_head;
+        m_head = b;
+    }
+    
+    if (current)
+    {
+        m_ptr = reinterpret_cast<uint8_t *>(b + 1);
+        m_end = reinterpret_cast<uint8_t *>(b) + size;
+    }
+    
+    return b;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// kvr::value
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::as_map (sz_t sz)
+{
+    this->_conv_map(sz);
+    return this;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::as_array (sz_t sz)
+{
+    this->_conv_array(sz);
+    return this;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::as_string ()
+{
+    this->_conv_string();
+    return this;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::as_boolean ()
+{
+    this->_conv_boolean();
+    return this;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::as_integer ()
+{
+    this->_conv_integer();
+    return this;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::as_float ()
+{
+    this->_conv_float();
+    return this;
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
@@ -1097,7 +1853,10 @@ const char * kvr::value::get_string () const
 {
     KVR_ASSERT_SAFE (is_string (), NULL);
     
-    const char *str = this->_is_string_dynamic () ? m_data.s.m_dyn.get () : m_data.s.m_stt.get ();
+    // strings borrowed from a const buffer end where the input does (see terminate_string)
+    KVR_ASSERT_SAFE (((m_flags & FLAG_STRING_MASK) != FLAG_STRING_BORROWED) && "use get_string (&len)", NULL);
+    
+    const char *str = this->_is_string_dynamic () ? this->_string_dynamic () : this->_string_static ();
     return str;
 }
 
@@ -1105,6 +1864,22 @@ const char * kvr::value::get_string () const
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
+const char * kvr::value::terminate_string ()
+{
+    KVR_ASSERT_SAFE (is_string (), NULL);
+    
+    if ((m_flags & FLAG_STRING_MASK) == FLAG_STRING_BORROWED)
+    {
+        this->_string_set (m_data.s.m_dyn, m_len);
+    }
+    
+    return this->get_string ();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
 const char * kvr::value::get_string (sz_t *len) const
 {
     KVR_ASSERT_SAFE (len, get_string ());
@@ -1113,13 +1888,13 @@ const char * kvr::value::get_string (sz_t *len) const
     
     if (this->_is_string_dynamic ())
     {
-        *len = m_data.s.m_dyn.length ();
-        str = m_data.s.m_dyn.get ();
+        *len = m_len;
+        str = this->_string_dynamic ();
     }
     else
     {
-        *len = m_data.s.m_stt.length ();
-        str = m_data.s.m_stt.get ();
+        str = this->_string_static ();
+        *len = static_cast<sz_t>(strlen (str));
     }
     
     return str;
@@ -1179,8 +1954,17 @@ kvr::value * kvr::value::push (int64_t num)
     this->_conv_array ();
 #endif
     
-    kvr::value *v = m_ctx->_create_value_integer (FLAG_PARENT_ARRAY, num);
-    this->m_data.a.push (v, m_ctx->m_allocator);
+    if ((m_flags & FLAG_ARRAY_PACKED) == FLAG_ARRAY_PACKED_INTEGER)
+    {
+        // appended in place: there is no element value to hand out
+        return this->_push_packed (FLAG_ARRAY_PACKED_INTEGER, &num, 1) ? this : NULL;
+    }
+    
+    kvr::value *v = this->_push ();
+#if KVR_FLAG_DISABLE_IMPLICIT_TYPE_CONVERSION
+    v->_conv_integer ();
+#endif
+    v->set_integer (num);
     return v;
 }
 
@@ -1197,8 +1981,17 @@ kvr::value * kvr::value::push (double num)
     this->_conv_array ();
 #endif
     
-    kvr::value *v = m_ctx->_create_value_float (FLAG_PARENT_ARRAY, num);
-    this->m_data.a.push (v, m_ctx->m_allocator);
+    if ((m_flags & FLAG_ARRAY_PACKED) == FLAG_ARRAY_PACKED_FLOAT)
+    {
+        // appended in place: there is no element value to hand out
+        return this->_push_packed (FLAG_ARRAY_PACKED_FLOAT, &num, 1) ? this : NULL;
+    }
+    
+    kvr::value *v = this->_push ();
+#if KVR_FLAG_DISABLE_IMPLICIT_TYPE_CONVERSION
+    v->_conv_float ();
+#endif
+    v->set_float (num);
     return v;
 }
 
@@ -1214,8 +2007,17 @@ kvr::value * kvr::value::push (bool b)
     this->_conv_array ();
 #endif
     
-    kvr::value *v = m_ctx->_create_value_boolean (FLAG_PARENT_ARRAY, b);
-    this->m_data.a.push (v, m_ctx->m_allocator);
+    if ((m_flags & FLAG_ARRAY_PACKED) == FLAG_ARRAY_PACKED_BOOLEAN)
+    {
+        // appended in place: there is no element value to hand out
+        return this->_push_packed (FLAG_ARRAY_PACKED_BOOLEAN, &b, 1) ? this : NULL;
+    }
+    
+    kvr::value *v = this->_push ();
+#if KVR_FLAG_DISABLE_IMPLICIT_TYPE_CONVERSION
+    v->_conv_boolean ();
+#endif
+    v->set_boolean (b);
     return v;
 }
 
@@ -1233,8 +2035,11 @@ kvr::value * kvr::value::push (const char *str)
     this->_conv_array ();
 #endif
     
-    kvr::value *v = m_ctx->_create_value_string (FLAG_PARENT_ARRAY, str, static_cast<sz_t>(strlen (str)));
-    this->m_data.a.push (v, m_ctx->m_allocator);
+    kvr::value *v = this->_push ();
+#if KVR_FLAG_DISABLE_IMPLICIT_TYPE_CONVERSION
+    v->_conv_string ();
+#endif
+    v->set_string (str, static_cast<sz_t>(strlen (str)));
     return v;
 }
 
@@ -1250,8 +2055,8 @@ kvr::value * kvr::value::push_map ()
     this->_conv_array ();
 #endif
     
-    kvr::value *v = m_ctx->_create_value_map (FLAG_PARENT_ARRAY);
-    this->m_data.a.push (v, m_ctx->m_allocator);
+    kvr::value *v = this->_push ();
+    v->_conv_map ();
     return v;
 }
 
@@ -1267,8 +2072,8 @@ kvr::value * kvr::value::push_array ()
     this->_conv_array ();
 #endif
     
-    kvr::value *v = m_ctx->_create_value_array (FLAG_PARENT_ARRAY);
-    this->m_data.a.push (v, m_ctx->m_allocator);
+    kvr::value *v = this->_push ();
+    v->_conv_array ();
     return v;
 }
 
@@ -1284,8 +2089,8 @@ kvr::value * kvr::value::push_null ()
     this->_conv_array ();
 #endif
     
-    kvr::value *v = m_ctx->_create_value_null (FLAG_PARENT_ARRAY);
-    this->m_data.a.push (v, m_ctx->m_allocator);
+    kvr::value *v = this->_push ();
+    v->_conv_null ();
     return v;
 }
 
@@ -1296,8 +2101,12 @@ kvr::value * kvr::value::push_null ()
 bool kvr::value::pop ()
 {
     KVR_ASSERT_SAFE (is_array (), false);
-    kvr::value *v = this->m_data.a.pop ();
-    return v ? m_ctx->_destroy_value (FLAG_PARENT_ARRAY, v) : false;
+    this->_unshare ();
+    if (this->is_packed ())
+    {
+        return this->m_data.a.pop_packed (this->m_data.a.length () - 1, this->_packed_size ());
+    }
+    return this->m_data.a.pop ();
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
@@ -1307,341 +2116,399 @@ bool kvr::value::pop ()
 bool kvr::value::pop (sz_t index)
 {
     KVR_ASSERT_SAFE (is_array (), false);
-    kvr::value *v = this->m_data.a.pop (index);
-    return v ? m_ctx->_destroy_value (FLAG_PARENT_ARRAY, v) : false;
-}
-
-/////////////////////////////////////////////////////////////////////////////////////////////////
-/////////////////////////////////////////////////////////////////////////////////////////////////
-/////////////////////////////////////////////////////////////////////////////////////////////////
-
-kvr::value * kvr::value::element (kvr::sz_t index) const
-{
-    KVR_ASSERT_SAFE (is_array (), NULL);
-    kvr::value *v = this->m_data.a.elem (index);
-    return v;
+    this->_unshare ();
+    if (this->is_packed ())
+    {
+        return this->m_data.a.pop_packed (index, this->_packed_size ());
+    }
+    return this->m_data.a.pop (index);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::sz_t kvr::value::length () const
+bool kvr::value::reserve (sz_t cap)
 {
-    KVR_ASSERT_SAFE (is_array (), 0);
-    sz_t len = this->m_data.a.m_len;
-    return len;
+    KVR_ASSERT_SAFE (is_array (), false);
+    
+    this->_unshare ();
+    size_t esz = this->is_packed () ? this->_packed_size () : sizeof (kvr::value);
+    this->m_data.a.reserve (cap, esz, this->_ctx ()->m_allocator);
+    return true;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::value * kvr::value::insert (const char *keystr, int32_t num)
+kvr::value * kvr::value::insert_at (sz_t index, sz_t count)
 {
-    return this->insert (keystr, static_cast<int64_t>(num));
+    KVR_ASSERT_SAFE (is_array (), NULL);
+    
+    if ((count == 0) || (index > this->m_data.a.length ()))
+    {
+        return NULL;
+    }
+    
+    this->_unshare ();
+    if (this->is_packed ())
+    {
+        this->_unpack ();
+    }
+    
+    kvr::ctx *ctx = this->_ctx ();
+    kvr::value *v = this->m_data.a.insert (index, count, ctx, ctx->m_allocator);
+    for (sz_t i = 0; i < count; ++i)
+    {
+        v [i]._conv_null ();
+    }
+    return v;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::value * kvr::value::insert (const char *keystr, int64_t num)
+bool kvr::value::swap_remove (sz_t index)
 {
-    KVR_ASSERT (keystr && "invalid input");
-    
-#if KVR_FLAG_DISABLE_IMPLICIT_TYPE_CONVERSION
-    KVR_ASSERT (is_map ());
-#else
-    this->_conv_map ();
-#endif
+    KVR_ASSERT_SAFE (is_array (), false);
     
-    map::node *n = NULL;
-    key *k = m_ctx->_create_key (keystr);
-    KVR_ASSERT (k);
+    if (index >= this->m_data.a.length ())
+    {
+        return false;
+    }
     
-#if !KVR_FLAG_ALLOW_DUPLICATE_MAP_KEYS
-    n = (k->m_ref <= 1) ? NULL : m_data.m.find (k);
-    if (n)
+    this->_unshare ();
+    if (this->is_packed ())
     {
-#if KVR_FLAG_DISABLE_IMPLICIT_TYPE_CONVERSION
-        n->v->_conv_integer ();
-#endif
-        n->v->set_integer (num);
-        m_ctx->_destroy_key (k);
+        this->m_data.a.swap_remove (index, this->_packed_size ());
     }
     else
-#endif
     {
-        n = m_data.m.insert (k, m_ctx->_create_value_integer (FLAG_PARENT_MAP, num), m_ctx->m_allocator);
-        KVR_ASSERT (n);
+        this->m_data.a.elem (index)->_destruct ();
+        this->m_data.a.swap_remove (index, sizeof (kvr::value));
     }
-    
-    return n ? n->v : NULL;
+    return true;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::value * kvr::value::insert (const char *keystr, double num)
+bool kvr::value::erase_range (sz_t first, sz_t last)
 {
-    KVR_ASSERT (keystr && "invalid input");
-    KVR_ASSERT_SAFE ((!kvr::internal::isnan (num) && !kvr::internal::isinf (num) && "num is invalid"), NULL);
-    
-#if KVR_FLAG_DISABLE_IMPLICIT_TYPE_CONVERSION
-    KVR_ASSERT (is_map ());
-#else
-    this->_conv_map ();
-#endif
+    KVR_ASSERT_SAFE (is_array (), false);
     
-    map::node *n = NULL;
-    key *k = m_ctx->_create_key (keystr);
-    KVR_ASSERT (k);
+    if ((first > last) || (last > this->m_data.a.length ()))
+    {
+        return false;
+    }
     
-#if !KVR_FLAG_ALLOW_DUPLICATE_MAP_KEYS
-    n = (k->m_ref <= 1) ? NULL : m_data.m.find (k);
-    if (n)
+    this->_unshare ();
+    if (this->is_packed ())
     {
-#if KVR_FLAG_DISABLE_IMPLICIT_TYPE_CONVERSION
-        n->v->_conv_float ();
-#endif
-        n->v->set_float (num);
-        m_ctx->_destroy_key (k);
+        this->m_data.a.erase (first, last, this->_packed_size ());
     }
     else
-#endif
     {
-        n = m_data.m.insert (k, m_ctx->_create_value_float (FLAG_PARENT_MAP, num), m_ctx->m_allocator);
-        KVR_ASSERT (n);
+        for (sz_t i = first; i < last; ++i)
+        {
+            this->m_data.a.elem (i)->_destruct ();
+        }
+        this->m_data.a.erase (first, last, sizeof (kvr::value));
     }
-    
-    return n ? n->v : NULL;
+    return true;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::value * kvr::value::insert (const char *keystr, bool b)
+bool kvr::value::resize (sz_t len)
 {
-    KVR_ASSERT (keystr && "invalid input");
-    
-#if KVR_FLAG_DISABLE_IMPLICIT_TYPE_CONVERSION
-    KVR_ASSERT (is_map ());
-#else
-    this->_conv_map ();
-#endif
+    KVR_ASSERT_SAFE (is_array (), false);
     
-    map::node *n = NULL;
-    key *k = m_ctx->_create_key (keystr);
-    KVR_ASSERT (k);
+    sz_t cur = this->m_data.a.length ();
     
-#if !KVR_FLAG_ALLOW_DUPLICATE_MAP_KEYS
-    n = (k->m_ref <= 1) ? NULL : m_data.m.find (k);
-    if (n)
+    if (len < cur)
     {
-#if KVR_FLAG_DISABLE_IMPLICIT_TYPE_CONVERSION
-        n->v->_conv_boolean ();
-#endif
-        n->v->set_boolean (b);
-        m_ctx->_destroy_key (k);
+        return this->erase_range (len, cur);
     }
-    else
-#endif
+    
+    if (len > cur)
     {
-        n = m_data.m.insert (k, m_ctx->_create_value_boolean (FLAG_PARENT_MAP, b), m_ctx->m_allocator);
-        KVR_ASSERT (n);
+        this->_unshare ();
+        if (this->is_packed ())
+        {
+            size_t esz = this->_packed_size ();
+            void *p = this->m_data.a.push_packed (len - cur, esz, this->_ctx ()->m_allocator);
+            memset (p, 0, esz * (len - cur));
+        }
+        else
+        {
+            this->insert_at (cur, len - cur);
+        }
     }
     
-    return n ? n->v : NULL;
+    return true;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::value * kvr::value::insert (const char *keystr, const char *str)
+kvr::value * kvr::value::element (kvr::sz_t index) const
 {
-    KVR_ASSERT (keystr && "invalid input");
-    KVR_ASSERT (str && "invalid input");
-    
-#if KVR_FLAG_DISABLE_IMPLICIT_TYPE_CONVERSION
-    KVR_ASSERT (is_map ());
-#else
-    this->_conv_map ();
-#endif
-    
-    map::node *n = NULL;
-    key *k = m_ctx->_create_key (keystr);
-    KVR_ASSERT (k);
-    
-#if !KVR_FLAG_ALLOW_DUPLICATE_MAP_KEYS
-    n = (k->m_ref <= 1) ? NULL : m_data.m.find (k);
-    if (n)
+    KVR_ASSERT_SAFE (is_array (), NULL);
+    KVR_ASSERT_SAFE (!this->is_packed () && "packed elements have no value, use get_*_at", NULL);
+    return this->_peek (index);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::element (kvr::sz_t index)
+{
+    KVR_ASSERT_SAFE (is_array (), NULL);
+    // the element may be written: a shared or packed array gets its own element values first
+    this->_unshare ();
+    if (this->is_packed ())
     {
+        this->_unpack ();
+    }
+    return this->_peek (index);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::sz_t kvr::value::length () const
+{
+    KVR_ASSERT_SAFE (is_array (), 0);
+    sz_t len = this->m_data.a.length ();
+    return len;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool kvr::value::push_n (const int64_t *n, sz_t count)
+{
+    KVR_ASSERT_SAFE (n || (count == 0), false);
 #if KVR_FLAG_DISABLE_IMPLICIT_TYPE_CONVERSION
-        n->v->_conv_string ();
-#endif
-        n->v->set_string (str);
-        m_ctx->_destroy_key (k);
+    KVR_ASSERT (is_array ());
+#else
+    if (!this->is_array ())
+    {
+        this->_pack (FLAG_ARRAY_PACKED_INTEGER, count);
     }
-    else
 #endif
+    
+    if (!this->_push_packed (FLAG_ARRAY_PACKED_INTEGER, n, count))
     {
-        n = m_data.m.insert (k, m_ctx->_create_value_string (FLAG_PARENT_MAP, str, (sz_t) strlen (str)), m_ctx->m_allocator);
-        KVR_ASSERT (n);
+        // mixed element types, push one by one
+        for (sz_t i = 0; i < count; ++i)
+        {
+            this->push (n [i]);
+        }
     }
     
-    return n ? n->v : NULL;
+    return true;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::value * kvr::value::insert_map (const char *keystr)
+bool kvr::value::push_n (const double *n, sz_t count)
 {
-    KVR_ASSERT (keystr && "invalid input");
-    
+    KVR_ASSERT_SAFE (n || (count == 0), false);
+    for (sz_t i = 0; i < count; ++i)
+    {
+        // as push (double): nothing is pushed if any element is invalid
+        KVR_ASSERT_SAFE ((!kvr::internal::isnan (n [i]) && !kvr::internal::isinf (n [i]) && "n is invalid"), false);
+    }
 #if KVR_FLAG_DISABLE_IMPLICIT_TYPE_CONVERSION
-    KVR_ASSERT (is_map ());
+    KVR_ASSERT (is_array ());
 #else
-    this->_conv_map ();
+    if (!this->is_array ())
+    {
+        this->_pack (FLAG_ARRAY_PACKED_FLOAT, count);
+    }
 #endif
     
-    map::node *n = NULL;
-    key *k = m_ctx->_create_key (keystr);
-    KVR_ASSERT (k);
+    if (!this->_push_packed (FLAG_ARRAY_PACKED_FLOAT, n, count))
+    {
+        // mixed element types, push one by one
+        for (sz_t i = 0; i < count; ++i)
+        {
+            this->push (n [i]);
+        }
+    }
     
-#if !KVR_FLAG_ALLOW_DUPLICATE_MAP_KEYS
-    n = (k->m_ref <= 1) ? NULL : m_data.m.find (k);
-    if (n)
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool kvr::value::push_n (const bool *b, sz_t count)
+{
+    KVR_ASSERT_SAFE (b || (count == 0), false);
+#if KVR_FLAG_DISABLE_IMPLICIT_TYPE_CONVERSION
+    KVR_ASSERT (is_array ());
+#else
+    if (!this->is_array ())
     {
-        n->v->_conv_map ();
-        m_ctx->_destroy_key (k);
+        this->_pack (FLAG_ARRAY_PACKED_BOOLEAN, count);
     }
-    else
 #endif
+    
+    if (!this->_push_packed (FLAG_ARRAY_PACKED_BOOLEAN, b, count))
     {
-        n = m_data.m.insert (k, m_ctx->_create_value_map (FLAG_PARENT_MAP), m_ctx->m_allocator);
-        KVR_ASSERT (n);
+        // mixed element types, push one by one
+        for (sz_t i = 0; i < count; ++i)
+        {
+            this->push (b [i]);
+        }
     }
     
-    return n ? n->v : NULL;
+    return true;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::value * kvr::value::insert_array (const char *keystr)
+kvr::sz_t kvr::value::get_n (int64_t *n, sz_t count) const
 {
-    KVR_ASSERT (keystr && "invalid input");
+    KVR_ASSERT_SAFE (is_array (), 0);
+    KVR_ASSERT_SAFE (n || (count == 0), 0);
     
-#if KVR_FLAG_DISABLE_IMPLICIT_TYPE_CONVERSION
-    KVR_ASSERT (is_map ());
-#else
-    this->_conv_map ();
-#endif
+    sz_t len = this->m_data.a.length ();
+    sz_t c = (count < len) ? count : len;
     
-    map::node *n = NULL;
-    key *k = m_ctx->_create_key (keystr);
-    KVR_ASSERT (k);
+    const int64_t *p = this->packed_integers ();
+    if (p)
+    {
+        memcpy (n, p, sizeof (int64_t) * c);
+        return c;
+    }
     
-#if !KVR_FLAG_ALLOW_DUPLICATE_MAP_KEYS
-    n = (k->m_ref <= 1) ? NULL : m_data.m.find (k);
-    if (n)
+    if (this->is_packed ())
     {
-        n->v->_conv_array ();
-        m_ctx->_destroy_key (k);
+        return 0;
     }
-    else
-#endif
+    
+    // regular array: copy up to the first element of another type
+    for (sz_t i = 0; i < c; ++i)
     {
-        n = m_data.m.insert (k, m_ctx->_create_value_array (FLAG_PARENT_MAP), m_ctx->m_allocator);
-        KVR_ASSERT (n);
+        const value &e = this->m_data.a.m_ptr [i];
+        if (!e.is_integer ())
+        {
+            return i;
+        }
+        n [i] = e.m_data.n.i;
     }
     
-    return n ? n->v : NULL;
+    return c;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::value * kvr::value::insert_null (const char *keystr)
+kvr::sz_t kvr::value::get_n (double *n, sz_t count) const
 {
-    KVR_ASSERT (keystr && "invalid input");
+    KVR_ASSERT_SAFE (is_array (), 0);
+    KVR_ASSERT_SAFE (n || (count == 0), 0);
     
-#if KVR_FLAG_DISABLE_IMPLICIT_TYPE_CONVERSION
-    KVR_ASSERT (is_map ());
-#else
-    this->_conv_map ();
-#endif
+    sz_t len = this->m_data.a.length ();
+    sz_t c = (count < len) ? count : len;
     
-    map::node *n = NULL;
-    key *k = m_ctx->_create_key (keystr);
-    KVR_ASSERT (k);
+    const double *p = this->packed_floats ();
+    if (p)
+    {
+        memcpy (n, p, sizeof (double) * c);
+        return c;
+    }
     
-#if !KVR_FLAG_ALLOW_DUPLICATE_MAP_KEYS
-    n = (k->m_ref <= 1) ? NULL : m_data.m.find (k);
-    if (n)
+    if (this->is_packed ())
     {
-        n->v->_conv_null ();
-        m_ctx->_destroy_key (k);
+        return 0;
     }
-    else
-#endif
+    
+    // regular array: copy up to the first element of another type
+    for (sz_t i = 0; i < c; ++i)
     {
-        n = m_data.m.insert (k, m_ctx->_create_value_null (FLAG_PARENT_MAP), m_ctx->m_allocator);
-        KVR_ASSERT (n);
+        const value &e = this->m_data.a.m_ptr [i];
+        if (!e.is_float ())
+        {
+            return i;
+        }
+        n [i] = e.m_data.n.f;
     }
     
-    return n ? n->v : NULL;
+    return c;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::value * kvr::value::find (const char *keystr) const
+kvr::sz_t kvr::value::get_n (bool *b, sz_t count) const
 {
-    KVR_ASSERT (keystr);
-    KVR_ASSERT_SAFE (is_map (), NULL);
+    KVR_ASSERT_SAFE (is_array (), 0);
+    KVR_ASSERT_SAFE (b || (count == 0), 0);
     
-    key *k = m_ctx->_find_key (keystr);
-    if (k)
+    sz_t len = this->m_data.a.length ();
+    sz_t c = (count < len) ? count : len;
+    
+    const bool *p = this->packed_booleans ();
+    if (p)
+    {
+        memcpy (b, p, sizeof (bool) * c);
+        return c;
+    }
+    
+    if (this->is_packed ())
+    {
+        return 0;
+    }
+    
+    // regular array: copy up to the first element of another type
+    for (sz_t i = 0; i < c; ++i)
     {
-        map::node *n = this->m_data.m.find (k);
-        if (n)
+        const value &e = this->m_data.a.m_ptr [i];
+        if (!e.is_boolean ())
         {
-            return n->v;
+            return i;
         }
+        b [i] = e.m_data.b;
     }
     
-    return NULL;
+    return c;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-void kvr::value::remove (const char *keystr)
+int64_t kvr::value::get_integer_at (sz_t index) const
 {
-    KVR_ASSERT (keystr);
-    KVR_ASSERT_SAFE (is_map (), (void) 0);
+    KVR_ASSERT_SAFE (is_array () && (index < this->m_data.a.length ()), 0);
+    KVR_ASSERT_SAFE (((m_flags & FLAG_ARRAY_PACKED) != FLAG_ARRAY_PACKED_BOOLEAN) && "not a number", 0);
     
-    key *k = m_ctx->_find_key (keystr);
-    if (k)
+    switch (m_flags & FLAG_ARRAY_PACKED)
     {
-        map::node *n = this->m_data.m.find (k);
-        if (n)
-        {
-            m_ctx->_destroy_key (n->k);
-            m_ctx->_destroy_value (FLAG_PARENT_MAP, n->v);
-            m_data.m.remove (n);
-        }
+        case FLAG_ARRAY_PACKED_INTEGER: { return static_cast<const int64_t *>(m_data.a.m_raw) [index]; }
+        case FLAG_ARRAY_PACKED_FLOAT:   { return static_cast<int64_t>(static_cast<const double *>(m_data.a.m_raw) [index]); }
+        default:                        { return m_data.a.m_ptr [index].get_integer (); }
     }
 }
 
@@ -1649,1012 +2516,720 @@ void kvr::value::remove (const char *keystr)
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::sz_t kvr::value::size () const
+double kvr::value::get_float_at (sz_t index) const
 {
-    KVR_ASSERT_SAFE (is_map (), 0);
+    KVR_ASSERT_SAFE (is_array () && (index < this->m_data.a.length ()), 0.0);
+    KVR_ASSERT_SAFE (((m_flags & FLAG_ARRAY_PACKED) != FLAG_ARRAY_PACKED_BOOLEAN) && "not a number", 0.0);
     
-#if KVR_INTERNAL_FLAG_EXPERIMENTAL_FAST_MAP_SIZE
-    sz_t sz2 = this->m_data.m.size_c ();
-#if KVR_DEBUG
-    sz_t sz1 = this->m_data.m.size_l ();
-    KVR_ASSERT (sz1 == sz2);
-#endif
-    return sz2;
-#else
-    return this->m_data.m.size_l ();
-#endif
+    switch (m_flags & FLAG_ARRAY_PACKED)
+    {
+        case FLAG_ARRAY_PACKED_INTEGER: { return static_cast<double>(static_cast<const int64_t *>(m_data.a.m_raw) [index]); }
+        case FLAG_ARRAY_PACKED_FLOAT:   { return static_cast<const double *>(m_data.a.m_raw) [index]; }
+        default:                        { return m_data.a.m_ptr [index].get_float (); }
+    }
 }
+
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::value * kvr::value::search (const char *pathexpr) const
+bool kvr::value::get_boolean_at (sz_t index) const
 {
-    KVR_ASSERT_SAFE ((is_map () || is_array ()), NULL);
-    KVR_ASSERT_SAFE ((pathexpr && (pathexpr [0] != 0)), NULL);
+    KVR_ASSERT_SAFE (is_array () && (index < this->m_data.a.length ()), false);
+    KVR_ASSERT_SAFE ((!this->is_packed () || ((m_flags & FLAG_ARRAY_PACKED) == FLAG_ARRAY_PACKED_BOOLEAN)) && "not a boolean", false);
     
-    value *v = this->_search_path_expr (pathexpr);
-    return v;
+    return this->is_packed () ? static_cast<const bool *>(m_data.a.m_raw) [index] : m_data.a.m_ptr [index].get_boolean ();
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::value * kvr::value::search (const char **path, sz_t pathsz) const
+kvr::value * kvr::value::insert (const char *keystr, int32_t num)
 {
-    KVR_ASSERT (is_map () || is_array ());
-    KVR_ASSERT_SAFE (path, NULL);
+    return this->insert (keystr, static_cast<int64_t>(num));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::insert (const char *keystr, sz_t keylen, int32_t num)
+{
+    return this->insert (keystr, keylen, static_cast<int64_t>(num));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::insert (const key *k, int32_t num)
+{
+    return this->insert (k, static_cast<int64_t>(num));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::insert (const char *keystr, int64_t num)
+{
+    KVR_ASSERT (keystr && "invalid input");
+    return this->insert (keystr, (sz_t) strlen (keystr), num);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::insert (const char *keystr, sz_t keylen, int64_t num)
+{
+    KVR_ASSERT (keystr && "invalid input");
     
-    value *v = (value *) this;
+    key *k = this->_ctx ()->_create_key (keystr, keylen);
+    KVR_ASSERT (k);
     
-    sz_t pc = 0;
-    while (v && (pc < pathsz))
+    return this->_insert (k, num);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::insert (const key *k, int64_t num)
+{
+    KVR_ASSERT (k && "invalid input");
+    KVR_ASSERT (this->_ctx ()->m_kstore.owns (k) && "key handle from another ctx");
+    
+    // the map's reference (handed back if the key is already present)
+    key *hk = const_cast<key *> (k);
+    hk->_retain ();
+    
+    return this->_insert (hk, num);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::_insert (key *k, int64_t num)
+{
+    KVR_ASSERT (k);
+    KVR_ASSERT (k->m_ref > 0);
+    
+#if KVR_FLAG_DISABLE_IMPLICIT_TYPE_CONVERSION
+    KVR_ASSERT (is_map ());
+#else
+    this->_conv_map ();
+#endif
+    this->_unshare ();
+    
+    // k carries the map's reference: if it's the only one, k can't be in the map yet
+    map::node *n = NULL;
+    
+#if !KVR_FLAG_ALLOW_DUPLICATE_MAP_KEYS
+    n = (k->m_ref <= 1) ? NULL : m_data.m.find (k);
+    if (n)
     {
-        const char *key = path [pc++];
-        v = v->_search_key (key);
+#if KVR_FLAG_DISABLE_IMPLICIT_TYPE_CONVERSION
+        n->v->_conv_integer ();
+#endif
+        n->v->set_integer (num);
+        this->_ctx ()->_destroy_key (k);
+    }
+    else
+#endif
+    {
+        kvr::ctx *ctx = this->_ctx ();
+        n = m_data.m.insert (k, ctx->_create_value_integer (FLAG_PARENT_MAP, num), ctx->m_allocator);
+        KVR_ASSERT (n);
     }
     
-    return v;
+    return n ? n->v : NULL;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::value * kvr::value::copy (const value *rhs)
+kvr::value * kvr::value::insert (const char *keystr, double num)
 {
-    KVR_ASSERT (rhs);
-    KVR_ASSERT (this != rhs);
+    KVR_ASSERT (keystr && "invalid input");
+    return this->insert (keystr, (sz_t) strlen (keystr), num);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::insert (const char *keystr, sz_t keylen, double num)
+{
+    KVR_ASSERT (keystr && "invalid input");
+    KVR_ASSERT_SAFE ((!kvr::internal::isnan (num) && !kvr::internal::isinf (num) && "num is invalid"), NULL);
+    
+    key *k = this->_ctx ()->_create_key (keystr, keylen);
+    KVR_ASSERT (k);
+    
+    return this->_insert (k, num);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::insert (const key *k, double num)
+{
+    KVR_ASSERT (k && "invalid input");
+    KVR_ASSERT (this->_ctx ()->m_kstore.owns (k) && "key handle from another ctx");
+    KVR_ASSERT_SAFE ((!kvr::internal::isnan (num) && !kvr::internal::isinf (num) && "num is invalid"), NULL);
+    
+    key *hk = const_cast<key *> (k);
+    hk->_retain ();
+    
+    return this->_insert (hk, num);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::_insert (key *k, double num)
+{
+    KVR_ASSERT (k);
+    KVR_ASSERT (k->m_ref > 0);
     
-    if (rhs && (this != rhs))
-    {
-        //////////////////////////////////
-        if (rhs->is_map ())
-            //////////////////////////////////
-        {
-            this->_clear ();
-            this->_conv_map (rhs->size ());
-            
-            cursor c (rhs);
-            pair rp;
-            while (c.get (&rp))
-            {
-                value *rv = rp.get_value ();
-                if (rhs->m_ctx == this->m_ctx)
-                {
-                    KVR_ASSERT (m_ctx->_find_key (rp.get_key ()->get_string ()));
-                    key *k = rp.get_key (); k->m_ref++;
-                    value *lv = m_ctx->_create_value_null (FLAG_PARENT_MAP)->copy (rv);
-                    this->_insert_kv (k, lv);
-                }
-                else
-                {
-                    const char *rk = rp.get_key ()->get_string ();
-                    value *lv = this->insert_null (rk);
-                    lv->copy (rv);
-                }
-            }
-        }
-        
-        //////////////////////////////////
-        else if (rhs->is_array ())
-            //////////////////////////////////
-        {
-            this->_clear ();
-            sz_t rlen = rhs->length ();
-            this->_conv_array (rlen);
-            
-            for (sz_t i = 0; i < rlen; ++i)
-            {
-                value *rv = rhs->element (i);
-                value *lv = this->push_null ();
-                lv->copy (rv);
-            }
-        }
-        
-        //////////////////////////////////
-        else if (rhs->is_string ())
-            //////////////////////////////////
-        {
-#if KVR_FLAG_DISABLE_IMPLICIT_TYPE_CONVERSION
-            this->_conv_string ();
-#endif
-            const char *str = rhs->get_string ();
-            this->set_string (str);
-        }
-        
-        //////////////////////////////////
-        else if (rhs->is_integer ())
-            //////////////////////////////////
-        {
 #if KVR_FLAG_DISABLE_IMPLICIT_TYPE_CONVERSION
-            this->_conv_integer ();
+    KVR_ASSERT (is_map ());
+#else
+    this->_conv_map ();
 #endif
-            int64_t n = rhs->get_integer ();
-            this->set_integer (n);
-        }
-        
-        //////////////////////////////////
-        else if (rhs->is_float ())
-            //////////////////////////////////
-        {
+    this->_unshare ();
+    
+    map::node *n = NULL;
+    
+#if !KVR_FLAG_ALLOW_DUPLICATE_MAP_KEYS
+    n = (k->m_ref <= 1) ? NULL : m_data.m.find (k);
+    if (n)
+    {
 #if KVR_FLAG_DISABLE_IMPLICIT_TYPE_CONVERSION
-            this->_conv_float ();
+        n->v->_conv_float ();
 #endif
-            double n = rhs->get_float ();
-            this->set_float (n);
-        }
-        
-        //////////////////////////////////
-        else if (rhs->is_boolean ())
-            //////////////////////////////////
-        {
-#if KVR_FLAG_DISABLE_IMPLICIT_TYPE_CONVERSION
-            this->_conv_boolean ();
+        n->v->set_float (num);
+        this->_ctx ()->_destroy_key (k);
+    }
+    else
 #endif
-            bool b = rhs->get_boolean ();
-            this->set_boolean (b);
-        }
-        
-        //////////////////////////////////
-        else if (rhs->is_null ())
-            //////////////////////////////////
-        {
-            this->_conv_null ();
-        }
+    {
+        kvr::ctx *ctx = this->_ctx ();
+        n = m_data.m.insert (k, ctx->_create_value_float (FLAG_PARENT_MAP, num), ctx->m_allocator);
+        KVR_ASSERT (n);
     }
     
-    return this;
+    return n ? n->v : NULL;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::value * kvr::value::merge (const value *rhs)
+kvr::value * kvr::value::insert (const char *keystr, bool b)
 {
-    KVR_ASSERT (rhs);
-    KVR_ASSERT (this != rhs);
+    KVR_ASSERT (keystr && "invalid input");
+    return this->insert (keystr, (sz_t) strlen (keystr), b);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::insert (const char *keystr, sz_t keylen, bool b)
+{
+    KVR_ASSERT (keystr && "invalid input");
     
-    if (rhs && (this != rhs) && this->_type_equiv (rhs))
-    {
-        //////////////////////////////////
-        if (this->is_map ())
-            //////////////////////////////////
-        {
-            // merge top level pairs
-            // if pair from [rhs] does not exist in [this], add to [this]
-            // if pair.key from [rhs] exists in [this], move to [this]
-            
-            value::cursor c (rhs);
-            pair rp;
-            
-            while (c.get (&rp))
-            {
-                key *rk = rp.get_key ();
-                value *rv = rp.get_value ();
-                
-                KVR_ASSERT (rk);
-                KVR_ASSERT (rv);
-                
-                const char *k = rk->get_string ();
-                value *lv = this->find (k);
-                
-                if (lv == NULL)
-                {
-                    key *lk = NULL;
-                    if (m_ctx == rv->m_ctx) // same ctx so simple increment reference count
-                    {
-                        lk = rk;
-                        lk->m_ref++;
-                    }
-                    else
-                    {
-                        lk = m_ctx->_create_key (k);
-                    }
-                    lv = m_ctx->_create_value_null (FLAG_PARENT_MAP)->copy (rv);
-                    this->_insert_kv (lk, lv);
-                }
-                else
-                {
-                    lv->copy (rv);
-                }
-            }
-        }
-        //////////////////////////////////
-        else if (this->is_array ())
-            //////////////////////////////////
-        {
-            // append
-            for (sz_t i = 0, c = rhs->length (); i < c; ++i)
-            {
-                value *re = rhs->element (i);
-                KVR_ASSERT (re);
-                this->push_null ()->copy (re);
-            }
-        }
-        //////////////////////////////////
-        else if (this->is_string ())
-            //////////////////////////////////
-        {
-            // append
-            sz_t lvlen = 0, rvlen = 0;
-            const char *lv = this->get_string (&lvlen);
-            const char *rv = rhs->get_string (&rvlen);
-            
-            sz_t bufsize = lvlen + rvlen + 1;
-            char *buf = (char *) m_ctx->m_allocator->allocate (bufsize); KVR_ASSERT (buf);
-            kvr_strcpy (buf, bufsize, lv);
-            kvr_strcpy ((buf + lvlen), (bufsize - lvlen), rv);
-            
-            this->_string_move (buf, bufsize);
-        }
-        //////////////////////////////////
-        else if (this->is_integer ())
-            //////////////////////////////////
-        {
-            // sum
-            int64_t lv = this->get_integer ();
-            int64_t rv = rhs->get_integer ();
-            this->set_integer (lv + rv);
-        }
-        //////////////////////////////////
-        else if (this->is_float ())
-            //////////////////////////////////
-        {
-            // sum
-            double lv = this->get_float ();
-            double rv = rhs->get_float ();
-            this->set_float (lv + rv);
-        }
-        //////////////////////////////////
-        else if (this->is_boolean ())
-            //////////////////////////////////
-        {
-            // copy
-            bool rv = rhs->get_boolean ();
-            this->set_boolean (rv);
-        }
-    }
+    key *k = this->_ctx ()->_create_key (keystr, keylen);
+    KVR_ASSERT (k);
     
-    return this;
+    return this->_insert (k, b);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::value * kvr::value::diff (const value *original, const value *modified)
+kvr::value * kvr::value::insert (const key *k, bool b)
 {
-    KVR_ASSERT (original);
-    KVR_ASSERT (modified);
-    KVR_ASSERT (original != modified);
+    KVR_ASSERT (k && "invalid input");
+    KVR_ASSERT (this->_ctx ()->m_kstore.owns (k) && "key handle from another ctx");
     
-    value *diff = this;
+    key *hk = const_cast<key *> (k);
+    hk->_retain ();
     
-    const value *og = original;
-    const value *md = modified;
+    return this->_insert (hk, b);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::_insert (key *k, bool b)
+{
+    KVR_ASSERT (k);
+    KVR_ASSERT (k->m_ref > 0);
     
-    if (og && md && (og != md) && og->_type_equiv (md))
+#if KVR_FLAG_DISABLE_IMPLICIT_TYPE_CONVERSION
+    KVR_ASSERT (is_map ());
+#else
+    this->_conv_map ();
+#endif
+    this->_unshare ();
+    
+    map::node *n = NULL;
+    
+#if !KVR_FLAG_ALLOW_DUPLICATE_MAP_KEYS
+    n = (k->m_ref <= 1) ? NULL : m_data.m.find (k);
+    if (n)
     {
-        //////////////////////////////////
-        if (og->is_map () || og->is_array ())
-            //////////////////////////////////
-        {
-            diff->_conv_map ();
-            
-            value *set = diff->insert_map (kvr_const_str_set);
-            value *add = diff->insert_map (kvr_const_str_add);
-            value *rem = diff->insert_array (kvr_const_str_rem);
-            
-            KVR_ASSERT (set);
-            KVR_ASSERT (add);
-            KVR_ASSERT (rem);
-            
-            const char * path [KVR_CONSTANT_MAX_TREE_DEPTH];
-#if KVR_DEBUG
-            memset (path, 0, sizeof (path));
+#if KVR_FLAG_DISABLE_IMPLICIT_TYPE_CONVERSION
+        n->v->_conv_boolean ();
 #endif
-            diff->_diff_set_rem (set, rem, og, md, path, KVR_CONSTANT_MAX_TREE_DEPTH, 0);
-#if KVR_DEBUG
-            memset (path, 0, sizeof (path));
+        n->v->set_boolean (b);
+        this->_ctx ()->_destroy_key (k);
+    }
+    else
 #endif
-            diff->_diff_add (add, og, md, path, KVR_CONSTANT_MAX_TREE_DEPTH, 0);
-        }
-        
-        //////////////////////////////////
-        else if (og->is_string ())
-            //////////////////////////////////
-        {
-            const char *ogstr = og->get_string ();
-            const char *mdstr = md->get_string ();
-            if (strcmp (ogstr, mdstr) != 0)
-            {
-                diff->copy (md);
-            }
-        }
-        
-        //////////////////////////////////
-        else if (og->is_integer ())
-            //////////////////////////////////
-        {
-            KVR_ASSERT (md->_is_number ());
-            
-            if (md->is_integer ())
-            {
-                int64_t ogn = og->get_integer ();
-                int64_t mdn = md->get_integer ();
-                if (ogn != mdn)
-                {
-                    diff->copy (md);
-                }
-            }
-            else if (md->is_float ())
-            {
-                double ogn = og->get_float ();
-                double mdn = md->get_float ();
-                if (!kvr::internal::fp_equal (ogn, mdn, KVR_CONSTANT_DIFF_FP_EQ_EPSILON))
-                {
-                    diff->copy (md);
-                }
-            }
-        }
-        
-        //////////////////////////////////
-        else if (og->is_float ())
-            //////////////////////////////////
-        {
-            double ogn = og->get_float ();
-            double mdn = md->get_float ();
-            if (!kvr::internal::fp_equal (ogn, mdn, KVR_CONSTANT_DIFF_FP_EQ_EPSILON))
-            {
-                diff->copy (md);
-            }
-        }
-        
-        //////////////////////////////////
-        else if (og->is_boolean ())
-            //////////////////////////////////
-        {
-            bool ogb = og->get_boolean ();
-            bool mdb = md->get_boolean ();
-            if (ogb != mdb)
-            {
-                diff->copy (md);
-            }
-        }
+    {
+        kvr::ctx *ctx = this->_ctx ();
+        n = m_data.m.insert (k, ctx->_create_value_boolean (FLAG_PARENT_MAP, b), ctx->m_allocator);
+        KVR_ASSERT (n);
     }
     
-    return diff;
+    return n ? n->v : NULL;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::value * kvr::value::patch (const value *diff)
+kvr::value * kvr::value::insert (const char *keystr, const char *str)
 {
-    KVR_ASSERT (diff);
+    KVR_ASSERT (keystr && "invalid input");
+    return this->insert (keystr, (sz_t) strlen (keystr), str);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::insert (const char *keystr, sz_t keylen, const char *str)
+{
+    KVR_ASSERT (keystr && "invalid input");
+    KVR_ASSERT (str && "invalid input");
     
-    if (diff && diff->is_map () && (this->is_map () || this->is_array ()))
-    {
-        // patch
-        value *set = diff->find (kvr_const_str_set);
-        value *add = diff->find (kvr_const_str_add);
-        value *rem = diff->find (kvr_const_str_rem);
-        
-        KVR_ASSERT (set);
-        KVR_ASSERT (add);
-        KVR_ASSERT (rem);
-        
-        this->_patch_set (set);
-        this->_patch_add (add);
-        this->_patch_rem (rem);
-    }
-    else if (diff->is_array ())
-    {
-        // do nothing.
-    }
-    else if (diff->_type_equiv (this))
-    {
-        this->copy (diff);
-    }
+    key *k = this->_ctx ()->_create_key (keystr, keylen);
+    KVR_ASSERT (k);
     
-    return this;
+    return this->_insert (k, str);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-uint32_t kvr::value::hash (uint32_t seed) const
+kvr::value * kvr::value::insert (const key *k, const char *str)
 {
-    uint32_t hc = seed;
-    
-    //////////////////////////////////
-    if (this->is_map ())
-        //////////////////////////////////
-    {
-        hc += (FLAG_TYPE_MAP);
-        uint32_t mhc = 0;
-        cursor c (this);
-        
-        pair p;
-        while (c.get (&p))
-        {
-            const char *k = p.get_key ()->get_string ();
-            value *v = p.get_value ();
-            uint32_t kh = kvr::internal::djb_hash (k);
-            uint32_t vh = v->hash ();
-            mhc ^= (kh * vh);
-        }
-        hc += mhc;
-    }
+    KVR_ASSERT (k && "invalid input");
+    KVR_ASSERT (this->_ctx ()->m_kstore.owns (k) && "key handle from another ctx");
+    KVR_ASSERT (str && "invalid input");
     
-    //////////////////////////////////
-    else if (this->is_array ())
-        //////////////////////////////////
-    {
-        hc += (FLAG_TYPE_ARRAY);
-        uint32_t ahc = 0;
-        for (sz_t i = 0, c = this->length (); i < c; ++i)
-        {
-            value *v = this->element (i);
-            uint32_t kh = i;
-            uint32_t vh = v->hash ();
-            ahc += (kh * vh);
-        }
-        hc += ahc;
-    }
+    key *hk = const_cast<key *> (k);
+    hk->_retain ();
     
-    //////////////////////////////////
-    else if (this->is_string ())
-        //////////////////////////////////
-    {
-        hc += (FLAG_TYPE_STRING_STATIC + FLAG_TYPE_STRING_DYNAMIC);
-        const char *str = this->get_string ();
-        hc += kvr::internal::djb_hash (str);
-    }
+    return this->_insert (hk, str);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::_insert (key *k, const char *str)
+{
+    KVR_ASSERT (k);
+    KVR_ASSERT (k->m_ref > 0);
     
-    //////////////////////////////////
-    else if (this->is_integer ())
-        //////////////////////////////////
-    {
-        hc += (FLAG_TYPE_NUMBER_INTEGER);
-        uint64_t i = static_cast<uint64_t>(this->get_integer ());
-        uint32_t hv = static_cast<uint32_t>((i & 0x00000000ffffffff) ^ (i >> 32));
-        hc += hv;
-    }
+#if KVR_FLAG_DISABLE_IMPLICIT_TYPE_CONVERSION
+    KVR_ASSERT (is_map ());
+#else
+    this->_conv_map ();
+#endif
+    this->_unshare ();
     
-    //////////////////////////////////
-    else if (this->is_float ())
-        //////////////////////////////////
-    {
-        hc += (FLAG_TYPE_NUMBER_FLOAT);
-        double f = this->get_float ();
-        uint32_t hv = static_cast<uint32_t>(std::floor (f));
-        hc += hv;
-    }
+    map::node *n = NULL;
     
-    //////////////////////////////////
-    else if (this->is_boolean ())
-        //////////////////////////////////
+#if !KVR_FLAG_ALLOW_DUPLICATE_MAP_KEYS
+    n = (k->m_ref <= 1) ? NULL : m_data.m.find (k);
+    if (n)
     {
-        hc += (FLAG_TYPE_BOOLEAN);
-        bool b = this->get_boolean ();
-        uint32_t hv = b ? 4u : 5u;
-        hc += hv;
+#if KVR_FLAG_DISABLE_IMPLICIT_TYPE_CONVERSION
+        n->v->_conv_string ();
+#endif
+        n->v->set_string (str);
+        this->_ctx ()->_destroy_key (k);
     }
-    
-    //////////////////////////////////
-    else if (this->is_null ())
-        //////////////////////////////////
+    else
+#endif
     {
-        hc += (FLAG_TYPE_NULL);
+        kvr::ctx *ctx = this->_ctx ();
+        n = m_data.m.insert (k, ctx->_create_value_string (FLAG_PARENT_MAP, str, (sz_t) strlen (str)), ctx->m_allocator);
+        KVR_ASSERT (n);
     }
     
-    return hc;
+    return n ? n->v : NULL;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-bool kvr::value::encode (codec_t codec, obuffer *obuf)
+kvr::value * kvr::value::insert_map (const char *keystr)
 {
-    KVR_ASSERT_SAFE (obuf, false);
-    
-    bool success = false;
-    
-    obuf->m_stream.seek (0);
-    
-    switch (codec)
-    {
-        case kvr::CODEC_JSON:
-        {
-            success = kvr::internal::json::write (this, &obuf->m_stream);
-            break;
-        }
-            
-        case kvr::CODEC_MSGPACK:
-        {
-            success = kvr::internal::msgpack::write (this, &obuf->m_stream);
-            break;
-        }
-            
-        case kvr::CODEC_CBOR:
-        {
-            success = kvr::internal::cbor::write (this, &obuf->m_stream);
-            break;
-        }
-            
-        default:
-        {
-            break;
-        }
-    }
-    
-    return success;
+    KVR_ASSERT (keystr && "invalid input");
+    return this->insert_map (keystr, (sz_t) strlen (keystr));
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-bool kvr::value::decode (codec_t codec, const uint8_t *data, size_t size)
+kvr::value * kvr::value::insert_map (const char *keystr, sz_t keylen)
 {
-    bool success = false;
+    KVR_ASSERT (keystr && "invalid input");
     
-    this->_conv_null ();
+    key *k = this->_ctx ()->_create_key (keystr, keylen);
+    KVR_ASSERT (k);
     
-    mem_istream istr (data, size);
-    
-    switch (codec)
-    {
-        case kvr::CODEC_JSON:
-        {
-            success = kvr::internal::json::read (this, istr);
-            break;
-        }
-            
-        case kvr::CODEC_MSGPACK:
-        {
-            success = kvr::internal::msgpack::read (this, istr);
-            break;
-        }
-            
-        case kvr::CODEC_CBOR:
-        {
-            success = kvr::internal::cbor::read (this, istr);
-            break;
-        }
-            
-        default:
-        {
-            break;
-        }
-    }
-    
-    return success;
+    return this->_insert_map (k);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-bool kvr::value::encode (codec_t codec, ostream *ostr)
+kvr::value * kvr::value::insert_map (const key *k)
 {
-    KVR_ASSERT_SAFE (ostr, false);
-    
-    bool success = false;
+    KVR_ASSERT (k && "invalid input");
+    KVR_ASSERT (this->_ctx ()->m_kstore.owns (k) && "key handle from another ctx");
     
-    switch (codec)
-    {
-        case kvr::CODEC_JSON:
-        {
-            success = kvr::internal::json::write (this, ostr);
-            break;
-        }
-            
-        case kvr::CODEC_MSGPACK:
-        {
-            success = kvr::internal::msgpack::write (this, ostr);
-            break;
-        }
-            
-        case kvr::CODEC_CBOR:
-        {
-            success = kvr::internal::cbor::write (this, ostr);
-            break;
-        }
-            
-        default:
-        {
-            break;
-        }
-    }
+    key *hk = const_cast<key *> (k);
+    hk->_retain ();
     
-    return success;
+    return this->_insert_map (hk);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-bool kvr::value::decode (codec_t codec, istream &istr)
+kvr::value * kvr::value::_insert_map (key *k)
 {
-    bool success = false;
+    KVR_ASSERT (k);
+    KVR_ASSERT (k->m_ref > 0);
     
-    this->_conv_null ();
+#if KVR_FLAG_DISABLE_IMPLICIT_TYPE_CONVERSION
+    KVR_ASSERT (is_map ());
+#else
+    this->_conv_map ();
+#endif
+    this->_unshare ();
     
-    switch (codec)
+    map::node *n = NULL;
+    
+#if !KVR_FLAG_ALLOW_DUPLICATE_MAP_KEYS
+    n = (k->m_ref <= 1) ? NULL : m_data.m.find (k);
+    if (n)
     {
-        case kvr::CODEC_JSON:
-        {
-            success = kvr::internal::json::read (this, istr);
-            break;
-        }
-            
-        case kvr::CODEC_MSGPACK:
-        {
-            success = kvr::internal::msgpack::read (this, istr);
-            break;
-        }
-            
-        case kvr::CODEC_CBOR:
-        {
-            success = kvr::internal::cbor::read (this, istr);
-            break;
-        }
-            
-        default:
-        {
-            break;
-        }
+        n->v->_conv_map ();
+        this->_ctx ()->_destroy_key (k);
+    }
+    else
+#endif
+    {
+        kvr::ctx *ctx = this->_ctx ();
+        n = m_data.m.insert (k, ctx->_create_value_map (FLAG_PARENT_MAP), ctx->m_allocator);
+        KVR_ASSERT (n);
     }
     
-    return success;
+    return n ? n->v : NULL;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-size_t kvr::value::encode_bound (codec_t codec) const
+kvr::value * kvr::value::insert_array (const char *keystr)
 {
-    size_t size = 0;
-    
-    switch (codec)
-    {
-        case kvr::CODEC_JSON:
-        {
-            size = kvr::internal::json::write_approx_size (this);
-            break;
-        }
-            
-        case kvr::CODEC_MSGPACK:
-        {
-            size = kvr::internal::msgpack::write_approx_size (this);
-            break;
-        }
-            
-        case kvr::CODEC_CBOR:
-        {
-            size = kvr::internal::cbor::write_approx_size (this);
-            break;
-        }
-            
-        default:
-        {
-            break;
-        }
-    }
+    KVR_ASSERT (keystr && "invalid input");
+    return this->insert_array (keystr, (sz_t) strlen (keystr));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::insert_array (const char *keystr, sz_t keylen)
+{
+    KVR_ASSERT (keystr && "invalid input");
     
-    size = ((size + 7u) & ~7u);
+    key *k = this->_ctx ()->_create_key (keystr, keylen);
+    KVR_ASSERT (k);
     
-    return size;
+    return this->_insert_array (k);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-void kvr::value::dump () const
+kvr::value * kvr::value::insert_array (const key *k)
 {
-#if KVR_DEBUG
-    this->_dump (0, NULL);
-    std::fprintf (stderr, "\n");
-#endif
+    KVR_ASSERT (k && "invalid input");
+    KVR_ASSERT (this->_ctx ()->m_kstore.owns (k) && "key handle from another ctx");
+    
+    key *hk = const_cast<key *> (k);
+    hk->_retain ();
+    
+    return this->_insert_array (hk);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-void kvr::value::_string_set (const char *str, sz_t len)
+kvr::value * kvr::value::_insert_array (key *k)
 {
-    KVR_ASSERT (str);
-    KVR_ASSERT (is_string ());
+    KVR_ASSERT (k);
+    KVR_ASSERT (k->m_ref > 0);
     
-    if (this->_is_string_static () && (len >= string::stt_str::CAP))
-    {
-        this->_clear ();
-        m_flags |= FLAG_TYPE_STRING_DYNAMIC;
-    }
+#if KVR_FLAG_DISABLE_IMPLICIT_TYPE_CONVERSION
+    KVR_ASSERT (is_map ());
+#else
+    this->_conv_map ();
+#endif
+    this->_unshare ();
     
-    if (this->_is_string_dynamic ())
+    map::node *n = NULL;
+    
+#if !KVR_FLAG_ALLOW_DUPLICATE_MAP_KEYS
+    n = (k->m_ref <= 1) ? NULL : m_data.m.find (k);
+    if (n)
     {
-        this->m_data.s.m_dyn.set (str, len, m_ctx->m_allocator);
+        n->v->_conv_array ();
+        this->_ctx ()->_destroy_key (k);
     }
     else
+#endif
     {
-        this->m_data.s.m_stt.set (str, len);
+        kvr::ctx *ctx = this->_ctx ();
+        n = m_data.m.insert (k, ctx->_create_value_array (FLAG_PARENT_MAP), ctx->m_allocator);
+        KVR_ASSERT (n);
     }
+    
+    return n ? n->v : NULL;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-void kvr::value::_string_move (char *str, sz_t size)
+kvr::value * kvr::value::insert_null (const char *keystr)
 {
-    KVR_ASSERT (str);
-    KVR_ASSERT (size > 0);
-    KVR_ASSERT (is_string ());
+    KVR_ASSERT (keystr && "invalid input");
+    return this->insert_null (keystr, (sz_t) strlen (keystr));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::insert_null (const char *keystr, sz_t keylen)
+{
+    KVR_ASSERT (keystr && "invalid input");
     
-    this->_clear ();
-    m_flags |= FLAG_TYPE_STRING_DYNAMIC;
+    key *k = this->_ctx ()->_create_key (keystr, keylen);
+    KVR_ASSERT (k);
     
-    m_data.s.m_dyn.m_data = str;
-    m_data.s.m_dyn.m_size = size;
-    m_data.s.m_dyn.m_len = size - 1;
+    return this->_insert_null (k);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::value * kvr::value::_search_path_expr (const char *expr, const char **lastkey, value **lastparent) const
+kvr::value * kvr::value::insert_null (const key *k)
 {
-    KVR_ASSERT (expr);
-    KVR_ASSERT (expr [0] != 0);
-    
-    value *v = (value *) this;
+    KVR_ASSERT (k && "invalid input");
+    KVR_ASSERT (this->_ctx ()->m_kstore.owns (k) && "key handle from another ctx");
     
-    const char delim = KVR_TOKEN_DELIMITER;
-    const char *e1 = expr;
-    const char *e2 = strchr (e1, delim);
+    key *hk = const_cast<key *> (k);
+    hk->_retain ();
     
-    uint8_t kbuf [256];
-    kvr::mem_ostream kos (kbuf, 256);
+    return this->_insert_null (hk);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::_insert_null (key *k)
+{
+    KVR_ASSERT (k);
+    KVR_ASSERT (k->m_ref > 0);
     
-    while (v && e2)
-    {
-        size_t klen = static_cast<size_t>(e2 - e1);
-        char *k = (char *) kos.push (klen + 1);
-        kvr_strncpy (k, kos.size (), e1, klen);
-        
-        v = v->_search_key (k);
-        
-        e1 = ++e2;
-        e2 = strchr (e1, delim);
-        kos.seek (0);
-    }
+#if KVR_FLAG_DISABLE_IMPLICIT_TYPE_CONVERSION
+    KVR_ASSERT (is_map ());
+#else
+    this->_conv_map ();
+#endif
+    this->_unshare ();
     
-    if (lastparent)
-    {
-        *lastparent = v;
-    }
+    map::node *n = NULL;
     
-    if (lastkey)
+#if !KVR_FLAG_ALLOW_DUPLICATE_MAP_KEYS
+    n = (k->m_ref <= 1) ? NULL : m_data.m.find (k);
+    if (n)
     {
-        *lastkey = e1;
+        n->v->_conv_null ();
+        this->_ctx ()->_destroy_key (k);
     }
-    
-    if (v && e1 && (*e1 != 0))
+    else
+#endif
     {
-        v = v->_search_key (e1);
+        kvr::ctx *ctx = this->_ctx ();
+        n = m_data.m.insert (k, ctx->_create_value_null (FLAG_PARENT_MAP), ctx->m_allocator);
+        KVR_ASSERT (n);
     }
     
-    return v;
+    return n ? n->v : NULL;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::find (const char *keystr) const
+{
+    KVR_ASSERT (keystr);
+    return this->find (keystr, (sz_t) strlen (keystr));
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::value * kvr::value::_search_key (const char *keystr) const
+kvr::value * kvr::value::find (const char *keystr, sz_t keylen) const
 {
     KVR_ASSERT (keystr);
+    KVR_ASSERT_SAFE (is_map (), NULL);
     
-    value *v = NULL;
+    key *k = this->_ctx ()->_find_key (keystr, keylen);
+    return k ? this->find (k) : NULL;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::find (const key *k) const
+{
+    KVR_ASSERT (k);
+    KVR_ASSERT_SAFE (is_map (), NULL);
     
-    //////////////////////////////////
-    if (this->is_map ())
-        //////////////////////////////////
-    {
-        v = this->find (keystr);
-    }
+    map::node *n = this->m_data.m.find (k);
+    return n ? n->v : NULL;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::find (const char *keystr)
+{
+    KVR_ASSERT (keystr);
+    return this->find (keystr, (sz_t) strlen (keystr));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::find (const char *keystr, sz_t keylen)
+{
+    KVR_ASSERT (keystr);
+    KVR_ASSERT_SAFE (is_map (), NULL);
     
-    //////////////////////////////////
-    else if (this->is_array ())
-        //////////////////////////////////
-    {
-        char k0 = keystr [0];
-        switch (k0)
-        {
-            case KVR_TOKEN_MAP_GREP: // pattern match in array of maps
-            {
-                const char eq = '=';
-                const char *pattern = &keystr [1];
-                const char *s = strchr (pattern, eq);
-                
-                if (s)
-                {
-                    sz_t sklen = static_cast<sz_t>(s - pattern);
-                    const char *sk = pattern;
-                    const char *sv = s + 1;
-                    
-                    for (sz_t i = 0, c = this->length (), f = 0; (i < c) && !f; ++i)
-                    {
-                        value *m = this->element (i);
-                        
-                        if (m && m->is_map ())
-                        {
-                            cursor cur (m);
-                            pair p;
-                            
-                            while (cur.get (&p))
-                            {
-                                key *pk = p.get_key ();
-                                const char *pks = pk->get_string ();
-                                sz_t pkslen = pk->get_length ();
-                                
-                                if (pks && (pkslen == sklen) && (strncmp (pks, sk, sklen) == 0))
-                                {
-                                    // got key (unique), now check value
-                                    value *pv = p.get_value ();
-                                    KVR_ASSERT (pv);
-                                    
-                                    if (pv->is_string ())
-                                    {
-                                        const char *pvstr = pv->get_string ();
-                                        if (strcmp (sv, pvstr) == 0)
-                                        {
-                                            v = m;
-                                            f = 1;
-                                        }
-                                    }
-                                    else if (pv->is_float ())
-                                    {
-                                        double svf = strtod (sv, NULL);
-                                        double pvf = pv->get_float ();
-                                        if (kvr::internal::fp_equal (svf, pvf))
-                                        {
-                                            v = m;
-                                            f = 1;
-                                        }
-                                    }
-                                    else if (pv->is_integer ())
-                                    {
-                                        char *end = NULL;
-                                        int64_t svi = strtoll (sv, &end, 10);
-                                        int64_t pvi = pv->get_integer ();
-                                        if (end && (!*end) && (svi == pvi))
-                                        {
-                                            v = m;
-                                            f = 1;
-                                        }
-                                    }
-                                    else if (pv->is_boolean ())
-                                    {
-                                        int valid = (strcmp (sv, kvr_const_str_false) == 0) ? 0 : (strcmp (sv, kvr_const_str_true) == 0) ? 1 : -1;
-                                        if (valid != -1)
-                                        {
-                                            bool svb = valid ? true : false;
-                                            bool pvb = pv->get_boolean ();
-                                            if (svb == pvb)
-                                            {
-                                                v = m;
-                                                f = 1;
-                                            }
-                                        }
-                                    }
-                                    else if (pv->is_null ())
-                                    {
-                                        bool svnull = (strcmp (sv, kvr_const_str_null) == 0);
-                                        if (svnull)
-                                        {
-                                            v = m;
-                                            f = 1;
-                                        }
-                                    }
-                                    
-                                    break;
-                                }
-                            }
-                        }
-                    }
-                }
-                break;
-            }
-                
-            default:
-            {
-                char *end = NULL;
-                int64_t ki64 = strtoll (keystr, &end, 10);
-                KVR_ASSERT_SAFE ((end && (!*end) && "non-integral array index"), NULL);
-                KVR_ASSERT (ki64 >= 0);
-                KVR_ASSERT ((uint64_t) ki64 <= kvr::SZ_T_MAX);
-                sz_t ki = (sz_t) ki64;
-                v = this->element (ki);
-                break;
-            }
-        }
-    }
+    key *k = this->_ctx ()->_find_key (keystr, keylen);
+    return k ? this->find (k) : NULL;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::find (const key *k)
+{
+    KVR_ASSERT (k);
+    KVR_ASSERT_SAFE (is_map (), NULL);
     
-    return v;
+    // the member found may be written: a shared map gets its own members first
+    this->_unshare ();
+    map::node *n = this->m_data.m.find (k);
+    return n ? n->v : NULL;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-uint8_t kvr::value::_type () const
+void kvr::value::remove (const char *keystr)
 {
-    uint8_t t = m_flags & KVR_VALUE_TYPE_MASK;
-    return t;
+    KVR_ASSERT (keystr);
+    this->remove (keystr, (sz_t) strlen (keystr));
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-bool kvr::value::_type_equiv (const value *rhs) const
+void kvr::value::remove (const char *keystr, sz_t keylen)
 {
-    KVR_ASSERT (rhs);
+    KVR_ASSERT (keystr);
+    KVR_ASSERT_SAFE (is_map (), (void) 0);
     
-    if ((this->_type () == rhs->_type ()) ||
-        (this->_is_number () && rhs->_is_number ()) ||
-        (this->is_string () && rhs->is_string ()))
+    key *k = this->_ctx ()->_find_key (keystr, keylen);
+    if (k)
     {
-        return true;
+        this->remove (k);
     }
-    
-    return false;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-void kvr::value::_destruct ()
+void kvr::value::remove (const key *k)
 {
-    if (this->is_map ())
-    {
-        cursor c (this);
-        pair   p;
-        while (c.get (&p))
-        {
-            m_ctx->_destroy_key (p.m_k);
-            m_ctx->_destroy_value (FLAG_PARENT_MAP, p.m_v);
-        }
-        m_data.m.deinit (m_ctx->m_allocator);
-    }
-    else if (this->is_array ())
-    {
-        sz_t c = this->length ();
-        while (c)
-        {
-            this->pop ();
-            c = this->length ();
-        }
-        m_data.a.deinit (m_ctx->m_allocator);
-    }
-    else if (this->_is_string_dynamic ())
+    KVR_ASSERT (k);
+    KVR_ASSERT_SAFE (is_map (), (void) 0);
+    
+    this->_unshare ();
+    map::node *n = this->m_data.m.find (k);
+    if (n)
     {
-        m_data.s.m_dyn.cleanup (m_ctx->m_allocator);
+        key *nk = n->k;
+        value *nv = n->v;
+        kvr::ctx *ctx = this->_ctx ();
+        m_data.m.remove (n, ctx->m_allocator);
+        ctx->_destroy_key (nk);
+        ctx->_destroy_value (FLAG_PARENT_MAP, nv);
     }
 }
 
@@ -2662,536 +3237,3140 @@ void kvr::value::_destruct ()
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-void kvr::value::_clear ()
+kvr::sz_t kvr::value::size () const
 {
-    // release memory
-    this->_destruct ();
+    KVR_ASSERT_SAFE (is_map (), 0);
     
-    // zero data
-    memset (&m_data, 0, sizeof (m_data));
+    return this->m_data.m.size ();
+}
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::search (const char *pathexpr) const
+{
+    KVR_ASSERT_SAFE ((is_map () || is_array ()), NULL);
+    KVR_ASSERT_SAFE ((pathexpr && (pathexpr [0] != 0)), NULL);
     
-    // clear type flag
-    m_flags &= ~KVR_VALUE_TYPE_MASK;
+    value *v = this->_search_path_expr (pathexpr);
+    return v;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-void kvr::value::_dump (size_t lpad, const char *key) const
+kvr::value * kvr::value::search (const char *pathexpr)
 {
-#if KVR_DEBUG
-    for (size_t t = 0; t < lpad; ++t)
-    {
-        std::fprintf (stderr, "  ");
-    }
+    KVR_ASSERT_SAFE ((is_map () || is_array ()), NULL);
+    KVR_ASSERT_SAFE ((pathexpr && (pathexpr [0] != 0)), NULL);
     
-    if (key)
-    {
-        std::fprintf (stderr, "key = %s : ", key);
-    }
+    value *v = this->_search_path_expr (pathexpr, NULL, NULL, true);
+    return v;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::search (const char **path, sz_t pathsz) const
+{
+    KVR_ASSERT (is_map () || is_array ());
+    KVR_ASSERT_SAFE (path, NULL);
     
-    //////////////////////////////////
-    if (this->is_map ())
-        //////////////////////////////////
-    {
-        std::fprintf (stderr, "value = -> [map]\n");
-        
-        cursor c (this);
-        pair   p;
-        while (c.get (&p))
-        {
-            const char *k = p.get_key ()->get_string ();
-            value *v = p.get_value ();
-            v->_dump (lpad + 1, k);
-        }
-    }
+    value *v = (value *) this;
     
-    //////////////////////////////////
-    else if (this->is_array ())
-        //////////////////////////////////
+    sz_t pc = 0;
+    while (v && (pc < pathsz))
     {
-        std::fprintf (stderr, "value = -> [array]\n");
-        
-        char k [21];
-        for (sz_t i = 0, c = this->length (); i < c; ++i)
-        {
-            size_t kl = kvr::internal::u64toa (i, k);
-            k [kl] = 0;
-            value *v = this->element (i);
-            v->_dump (lpad + 1, k);
-        }
+        const char *key = path [pc++];
+        v = v->_search_key (key);
     }
     
-    //////////////////////////////////
-    else if (this->is_string ())
-        //////////////////////////////////
-    {
-        const char *str = this->get_string ();
-        std::fprintf (stderr, "value = %s -> [string]\n", str);
-    }
-    
-    //////////////////////////////////
-    else if (this->is_integer ())
-        //////////////////////////////////
-    {
-        int64_t n = this->get_integer ();
-#if 0
-        std::fprintf (stderr, "value = %" PRId64 " -> [int]\n", n);
-#else
-        // PRId64 not supported by travis-ci
-        char ns [22];
-        size_t c = kvr::internal::i64toa (n, ns);
-        ns [c] = 0;
-        fprintf (stderr, "value = %s -> [int]\n", ns);
-#endif
-    }
+    return v;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::search (const char **path, sz_t pathsz)
+{
+    KVR_ASSERT (is_map () || is_array ());
+    KVR_ASSERT_SAFE (path, NULL);
     
-    //////////////////////////////////
-    else if (this->is_float ())
-        //////////////////////////////////
-    {
-        double n = this->get_float ();
-        std::fprintf (stderr, "value = %g -> [float]\n", n);
-    }
+    value *v = (value *) this;
     
-    //////////////////////////////////
-    else if (this->is_boolean ())
-        //////////////////////////////////
+    sz_t pc = 0;
+    while (v && (pc < pathsz))
     {
-        bool b = this->get_boolean ();
-        std::fprintf (stderr, "value = %s -> [bool]\n", b ? kvr_const_str_true : kvr_const_str_false);
+        const char *key = path [pc++];
+        v = v->_search_key (key, true);
     }
     
-    //////////////////////////////////
-    else if (this->is_null ())
-        //////////////////////////////////
-    {
-        std::fprintf (stderr, "value = %s -> [null]\n", kvr_const_str_null);
-    }
-#else
-    KVR_REF_UNUSED (lpad);
-    KVR_REF_UNUSED (key);
-#endif
+    return v;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-void kvr::value::_diff_set_rem (value *set, value *rem, const value *og, const value *md,
-                                const char **path, const sz_t pathsz, sz_t pathcnt)
+kvr::value * kvr::value::copy (const value *rhs)
 {
-    KVR_ASSERT (set);
-    KVR_ASSERT (rem);
-    
-    // find og values in md that need to be updated
-    // if missing, mark for removal
+    KVR_ASSERT (rhs);
+    KVR_ASSERT (this != rhs);
     
-    if (og)
+    if (rhs && (this != rhs))
     {
         //////////////////////////////////
-        if (md == NULL)
-        //////////////////////////////////
+        if (rhs->is_map ())
+            //////////////////////////////////
         {
-            // at this point og and md cannot be root values. therefore KVR_ASSERT (pathsz > 0)
-            KVR_ASSERT (pathcnt > 0);
-            // add og to rem list
-            kvr::ctx *ctx = m_ctx;
-            value *v = ctx->_create_value_null (FLAG_PARENT_ARRAY);
-            v->_conv_string ();
+            this->_clear ();
+            this->_conv_map (rhs->size ());
             
-            if (pathcnt == 1)
-            {
-                const char *pk = path [0];
-                v->set_string (pk);
-            }
-            else
+            cursor c (rhs);
+            pair rp;
+            while (c.get (&rp))
             {
-                sz_t pksz = 0;
-                char *pk = ctx->_create_path_expr (path, pathcnt, &pksz);
-                v->_string_move (pk, pksz);
+                value *rv = rp.get_value ();
+                if (rhs->_ctx () == this->_ctx ())
+                {
+                    KVR_ASSERT (this->_ctx ()->_find_key (rp.get_key ()->get_string ()));
+                    key *k = rp.get_key (); k->_retain ();
+                    value *lv = this->_ctx ()->_create_value_null (FLAG_PARENT_MAP)->copy (rv);
+                    this->_insert_kv (k, lv);
+                }
+                else
+                {
+                    const char *rk = rp.get_key ()->get_string ();
+                    value *lv = this->insert_null (rk);
+                    lv->copy (rv);
+                }
             }
-            
-            rem->_push_v (v);
         }
         
         //////////////////////////////////
-        else if (!og->_type_equiv (md))
-        //////////////////////////////////
+        else if (rhs->is_array ())
+            //////////////////////////////////
         {
-            // at this point og and md cannot be root values. therefore KVR_ASSERT (pathsz > 0)
-            KVR_ASSERT (pathcnt > 0);
+            this->_clear ();
+            sz_t rlen = rhs->length ();
             
-            kvr::ctx *ctx = m_ctx;
-            key *k = NULL;
-            //if ((pathcnt == 1) && (ctx == og->m_ctx)) // path key must already be in the key store
-            if (pathcnt == 1)
+            if (rhs->is_packed ())
             {
-                const char *pk = path [0];
-                k = ctx->_create_key (pk);
+                uint32_t flag = (rhs->m_flags & FLAG_ARRAY_PACKED);
+                this->_pack (flag, rlen);
+                this->_push_packed (flag, rhs->m_data.a.m_raw, rlen);
             }
             else
             {
-                sz_t pksz = 0;
-                char *pk = ctx->_create_path_expr (path, pathcnt, &pksz);
-                KVR_ASSERT (pk && pksz);
-                k = ctx->_create_key (pk, pksz - 1);
-                if (k->m_ref > 1) { ctx->_destroy_path_expr (pk, pksz); pk = NULL; }
+                this->_conv_array (rlen);
+                
+                for (sz_t i = 0; i < rlen; ++i)
+                {
+                    value *rv = rhs->_peek (i);
+                    value *lv = this->push_null ();
+                    lv->copy (rv);
+                }
             }
-            
-            value *v = ctx->_create_value_null (FLAG_PARENT_MAP);
-            v->copy (md);
-            set->_insert_kv (k, v);
         }
         
         //////////////////////////////////
-        else if (og->is_map ())
+        else if (rhs->is_string ())
+            //////////////////////////////////
+        {
+#if KVR_FLAG_DISABLE_IMPLICIT_TYPE_CONVERSION
+            this->_conv_string ();
+#endif
+            sz_t len = 0;
+            const char *str = rhs->get_string (&len);
+            this->set_string (str, len);
+        }
+        
         //////////////////////////////////
+        else if (rhs->is_integer ())
+            //////////////////////////////////
         {
-            KVR_ASSERT (md->is_map ());
-            
-            value::cursor c (og);
-            pair ogp;
-            
-            while (c.get (&ogp))
-            {
-                const char *k = ogp.get_key ()->get_string ();
-                
-                KVR_ASSERT (pathcnt < pathsz);
-                path [pathcnt++] = k;
-                
-                value *mdv = md->find (k);
-                value *ogv = ogp.get_value ();
-                
-                this->_diff_set_rem (set, rem, ogv, mdv, path, pathsz, pathcnt);
-                
-                path [--pathcnt] = NULL;
-            }
+#if KVR_FLAG_DISABLE_IMPLICIT_TYPE_CONVERSION
+            this->_conv_integer ();
+#endif
+            int64_t n = rhs->get_integer ();
+            this->set_integer (n);
         }
         
         //////////////////////////////////
-        else if (og->is_array ())
+        else if (rhs->is_float ())
+            //////////////////////////////////
+        {
+#if KVR_FLAG_DISABLE_IMPLICIT_TYPE_CONVERSION
+            this->_conv_float ();
+#endif
+            double n = rhs->get_float ();
+            this->set_float (n);
+        }
+        
         //////////////////////////////////
+        else if (rhs->is_boolean ())
+            //////////////////////////////////
         {
-            KVR_ASSERT (md->is_array ());
-            
-            char k [21];
-            for (sz_t i = 0, c = og->length (); i < c; ++i)
-            {
-                size_t kl = kvr::internal::u64toa (i, k);
-                k [kl] = 0;
-                
-                KVR_ASSERT (pathcnt < pathsz);
-                path [pathcnt++] = k;
-                
-                value *mdv = md->element (i);
-                value *ogv = og->element (i);
-                
-                this->_diff_set_rem (set, rem, ogv, mdv, path, pathsz, pathcnt);
-                
-                path [--pathcnt] = NULL;
-            }
+#if KVR_FLAG_DISABLE_IMPLICIT_TYPE_CONVERSION
+            this->_conv_boolean ();
+#endif
+            bool b = rhs->get_boolean ();
+            this->set_boolean (b);
         }
         
         //////////////////////////////////
-        else if (og->is_string ())
+        else if (rhs->is_null ())
+            //////////////////////////////////
+        {
+            this->_conv_null ();
+        }
+    }
+    
+    return this;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::snapshot (const value *rhs)
+{
+    KVR_ASSERT (rhs);
+    KVR_ASSERT (this != rhs);
+    
+    if (rhs && (this != rhs))
+    {
+        header *rh = rhs->_container ();
+        
+        if (rh && (rh->ref < SHARE_MAX) && (rhs->_ctx () == this->_ctx ()) && !this->_ctx ()->m_borrowed)
+        {
+            // share until either side is written (see _unshare)
+            this->_clear ();
+            rhs->_share (this);
+            return this;
+        }
+    }
+    
+    return this->copy (rhs);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::merge (const value *rhs)
+{
+    KVR_ASSERT (rhs);
+    KVR_ASSERT (this != rhs);
+    
+    if (rhs && (this != rhs) && this->_type_equiv (rhs))
+    {
         //////////////////////////////////
+        if (this->is_map ())
+            //////////////////////////////////
         {
-            KVR_ASSERT (pathcnt > 0);
-            KVR_ASSERT (md->is_string ());
+            // merge top level pairs
+            // if pair from [rhs] does not exist in [this], add to [this]
+            // if pair.key from [rhs] exists in [this], move to [this]
             
-            sz_t mdstrlen = 0;
-            const char *ogstr = og->get_string ();
-            const char *mdstr = md->get_string (&mdstrlen);
+            value::cursor c (rhs);
+            pair rp;
             
-            if (strcmp (ogstr, mdstr) != 0)
+            while (c.get (&rp))
             {
-                kvr::ctx *ctx = m_ctx;
-                key *k = NULL;
-                if (pathcnt == 1)
-                {
-                    const char *pk = path [0];
-                    k = ctx->_create_key (pk);
-                }
-                else
-                {
-                    sz_t pksz = 0;
-                    char *pk = ctx->_create_path_expr (path, pathcnt, &pksz);
-                    KVR_ASSERT (pk && pksz);
-                    k = ctx->_create_key (pk, pksz - 1);
-                    if (k->m_ref > 1) { ctx->_destroy_path_expr (pk, pksz); pk = NULL; }
-                }
+                key *rk = rp.get_key ();
+                value *rv = rp.get_value ();
                 
-                value *v = ctx->_create_value_string (FLAG_PARENT_MAP, mdstr, mdstrlen);
-                set->_insert_kv (k, v);
-            }
-        }
-        
-        //////////////////////////////////
-        else if (og->is_integer ())
-        //////////////////////////////////
-        {
-            KVR_ASSERT (pathcnt > 0);
-            KVR_ASSERT (md->_is_number ());
-            
-            if (md->is_integer ())
-            {
-                int64_t ogn = og->get_integer ();
-                int64_t mdn = md->get_integer ();
+                KVR_ASSERT (rk);
+                KVR_ASSERT (rv);
                 
-                if (ogn != mdn)
+                const char *k = rk->get_string ();
+                value *lv = this->find (k);
+                
+                if (lv == NULL)
                 {
-                    kvr::ctx *ctx = m_ctx;
-                    key *k = NULL;
-                    if (pathcnt == 1)
+                    key *lk = NULL;
+                    if (this->_ctx () == rv->_ctx ()) // same ctx so simple increment reference count
                     {
-                        const char *pk = path [0];
-                        k = ctx->_create_key (pk);
+                        lk = rk;
+                        lk->_retain ();
                     }
                     else
                     {
-                        sz_t pksz = 0;
-                        char *pk = ctx->_create_path_expr (path, pathcnt, &pksz);
-                        KVR_ASSERT (pk && pksz);
-                        k = ctx->_create_key (pk, pksz - 1);
-                        if (k->m_ref > 1) { ctx->_destroy_path_expr (pk, pksz); pk = NULL; }
+                        lk = this->_ctx ()->_create_key (k);
                     }
-                    
-                    value *v = ctx->_create_value_integer (FLAG_PARENT_MAP, mdn);
-                    set->_insert_kv (k, v);
+                    lv = this->_ctx ()->_create_value_null (FLAG_PARENT_MAP)->copy (rv);
+                    this->_insert_kv (lk, lv);
                 }
-            }
-            else if (md->is_float ())
-            {
-                double ogn = og->get_float ();
-                double mdn = md->get_float ();
-                
-                if (!kvr::internal::fp_equal (ogn, mdn, KVR_CONSTANT_DIFF_FP_EQ_EPSILON))
+                else
                 {
-                    kvr::ctx *ctx = m_ctx;
-                    key *k = NULL;
-                    if (pathcnt == 1)
-                    {
-                        const char *pk = path [0];
-                        k = ctx->_create_key (pk);
-                    }
-                    else
-                    {
-                        sz_t pksz = 0;
-                        char *pk = ctx->_create_path_expr (path, pathcnt, &pksz);
-                        KVR_ASSERT (pk && pksz);
-                        k = ctx->_create_key (pk, pksz - 1);
-                        if (k->m_ref > 1) { ctx->_destroy_path_expr (pk, pksz); pk = NULL; }
-                    }
-                    
-                    value *v = ctx->_create_value_float (FLAG_PARENT_MAP, mdn);
-                    set->_insert_kv (k, v);
+                    lv->copy (rv);
                 }
             }
         }
-        
-        //////////////////////////////////
-        else if (og->is_float ())
         //////////////////////////////////
+        else if (this->is_array ())
+            //////////////////////////////////
         {
-            KVR_ASSERT (pathcnt > 0);
-            KVR_ASSERT (md->_is_number ());
-            
-            double ogn = og->get_float ();
-            double mdn = md->get_float ();
-            
-            if (!kvr::internal::fp_equal (ogn, mdn, KVR_CONSTANT_DIFF_FP_EQ_EPSILON))
+            // append
+            if (rhs->is_packed ())
             {
-                kvr::ctx *ctx = m_ctx;
-                key *k = NULL;
-                if (pathcnt == 1)
+                uint32_t flag = (rhs->m_flags & FLAG_ARRAY_PACKED);
+                if (!this->_push_packed (flag, rhs->m_data.a.m_raw, rhs->length ()))
                 {
-                    const char *pk = path [0];
-                    k = ctx->_create_key (pk);
+                    for (sz_t i = 0, c = rhs->length (); i < c; ++i)
+                    {
+                        rhs->_packed_element (i, this->_push ());
+                    }
                 }
-                else
+            }
+            else
+            {
+                for (sz_t i = 0, c = rhs->length (); i < c; ++i)
                 {
-                    sz_t pksz = 0;
-                    char *pk = ctx->_create_path_expr (path, pathcnt, &pksz);
-                    KVR_ASSERT (pk && pksz);
-                    k = ctx->_create_key (pk, pksz - 1);
-                    if (k->m_ref > 1) { ctx->_destroy_path_expr (pk, pksz); pk = NULL; }
+                    value *re = rhs->_peek (i);
+                    KVR_ASSERT (re);
+                    this->push_null ()->copy (re);
                 }
-                
-                value *v = ctx->_create_value_float (FLAG_PARENT_MAP, mdn);
-                set->_insert_kv (k, v);
             }
         }
-        
-        //////////////////////////////////
-        else if (og->is_boolean ())
         //////////////////////////////////
+        else if (this->is_string ())
+            //////////////////////////////////
         {
-            KVR_ASSERT (pathcnt > 0);
-            KVR_ASSERT (md->is_boolean ());
+            // append
+            sz_t lvlen = 0, rvlen = 0;
+            const char *lv = this->get_string (&lvlen);
+            const char *rv = rhs->get_string (&rvlen);
             
-            bool ogb = og->get_boolean ();
-            bool mdb = md->get_boolean ();
+            sz_t bufsize = lvlen + rvlen + 1;
+            char *buf = (char *) this->_ctx ()->m_allocator->allocate (bufsize); KVR_ASSERT (buf);
+            memcpy (buf, lv, lvlen);
+            memcpy ((buf + lvlen), rv, rvlen);
+            buf [lvlen + rvlen] = 0;
             
-            if (ogb != mdb)
-            {
-                kvr::ctx *ctx = m_ctx;
-                key *k = NULL;
-                if (pathcnt == 1)
-                {
-                    const char *pk = path [0];
-                    k = ctx->_create_key (pk);
-                }
-                else
-                {
-                    sz_t pksz = 0;
-                    char *pk = ctx->_create_path_expr (path, pathcnt, &pksz);
-                    KVR_ASSERT (pk && pksz);
-                    k = ctx->_create_key (pk, pksz - 1);
-                    if (k->m_ref > 1) { ctx->_destroy_path_expr (pk, pksz); pk = NULL; }
-                }
-                
-                value *v = ctx->_create_value_boolean (FLAG_PARENT_MAP, mdb);
-                set->_insert_kv (k, v);
-            }
+            this->_string_move (buf, bufsize);
         }
-        
         //////////////////////////////////
-        else if (og->is_null ())
+        else if (this->is_integer ())
+            //////////////////////////////////
+        {
+            // sum
+            int64_t lv = this->get_integer ();
+            int64_t rv = rhs->get_integer ();
+            this->set_integer (lv + rv);
+        }
         //////////////////////////////////
+        else if (this->is_float ())
+            //////////////////////////////////
         {
-            KVR_ASSERT (md->is_null ());
-            // should already be taken care of in type check
+            // sum
+            double lv = this->get_float ();
+            double rv = rhs->get_float ();
+            this->set_float (lv + rv);
+        }
+        //////////////////////////////////
+        else if (this->is_boolean ())
+            //////////////////////////////////
+        {
+            // copy
+            bool rv = rhs->get_boolean ();
+            this->set_boolean (rv);
+        }
+    }
+    
+    return this;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::take (const char *keystr)
+{
+    KVR_ASSERT (keystr);
+    return this->take (keystr, (sz_t) strlen (keystr));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::take (const char *keystr, sz_t keylen)
+{
+    KVR_ASSERT (keystr);
+    KVR_ASSERT_SAFE (is_map (), NULL);
+    
+    key *k = this->_ctx ()->_find_key (keystr, keylen);
+    return k ? this->take (k) : NULL;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::take (const key *k)
+{
+    KVR_ASSERT (k);
+    KVR_ASSERT_SAFE (is_map (), NULL);
+    
+    this->_unshare ();
+    value *root = NULL;
+    map::node *n = this->m_data.m.find (k);
+    
+    if (n)
+    {
+        kvr::ctx *ctx = this->_ctx ();
+        root = ctx->create_value (); KVR_ASSERT (root);
+        
+        key *nk = n->k;
+        value *nv = n->v;
+        nv->_relocate (root);
+        m_data.m.remove (n, ctx->m_allocator);
+        ctx->m_allocator->deallocate (nv, sizeof (kvr::value));
+        ctx->_destroy_key (nk);
+    }
+    
+    return root;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::take (sz_t index)
+{
+    KVR_ASSERT_SAFE (is_array (), NULL);
+    
+    this->_unshare ();
+    value *root = NULL;
+    
+    if (index < m_data.a.length ())
+    {
+        root = this->_ctx ()->create_value (); KVR_ASSERT (root);
+        
+        if (this->is_packed ())
+        {
+            this->_packed_element (index, root);
+            m_data.a.pop_packed (index, this->_packed_size ());
+        }
+        else
+        {
+            m_data.a.elem (index)->_relocate (root);
+            m_data.a.remove (index);
         }
     }
+    
+    return root;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::splice (const char *keystr, value *root)
+{
+    KVR_ASSERT (keystr);
+    return this->splice (keystr, (sz_t) strlen (keystr), root);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::splice (const char *keystr, sz_t keylen, value *root)
+{
+    KVR_ASSERT (keystr && root && "invalid input");
+    
+    key *k = this->_ctx ()->_create_key (keystr, keylen);
+    KVR_ASSERT (k);
+    
+    return this->_splice (k, root);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::splice (const key *k, value *root)
+{
+    KVR_ASSERT (k && root && "invalid input");
+    KVR_ASSERT (this->_ctx ()->m_kstore.owns (k) && "key handle from another ctx");
+    
+    key *hk = const_cast<key *> (k);
+    hk->_retain ();
+    
+    return this->_splice (hk, root);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::splice (value *root)
+{
+    KVR_ASSERT (root && "invalid input");
+    
+#if KVR_FLAG_DISABLE_IMPLICIT_TYPE_CONVERSION
+    KVR_ASSERT (is_array ());
+#else
+    this->_conv_array ();
+#endif
+    
+    kvr::value *v = this->_push ();
+    v->_conv_null ();
+    v->_adopt (root);
+    return v;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::diff (const value *original, const value *modified)
+{
+    KVR_ASSERT (original);
+    KVR_ASSERT (modified);
+    KVR_ASSERT (original != modified);
+    
+    value *diff = this;
+    
+    const value *og = original;
+    const value *md = modified;
+    
+    if (og && md && (og != md) && og->_type_equiv (md))
+    {
+        //////////////////////////////////
+        if (og->is_map () || og->is_array ())
+            //////////////////////////////////
+        {
+            diff->_conv_map ();
+            
+            value *set = diff->insert_map (kvr_const_str_set);
+            value *add = diff->insert_map (kvr_const_str_add);
+            value *rem = diff->insert_array (kvr_const_str_rem);
+            
+            KVR_ASSERT (set);
+            KVR_ASSERT (add);
+            KVR_ASSERT (rem);
+            
+            const char * path [KVR_CONSTANT_MAX_TREE_DEPTH];
+#if KVR_DEBUG
+            memset (path, 0, sizeof (path));
+#endif
+            diff->_diff_set_rem (set, rem, og, md, path, KVR_CONSTANT_MAX_TREE_DEPTH, 0);
+#if KVR_DEBUG
+            memset (path, 0, sizeof (path));
+#endif
+            diff->_diff_add (add, og, md, path, KVR_CONSTANT_MAX_TREE_DEPTH, 0);
+        }
+        
+        //////////////////////////////////
+        else if (og->is_string ())
+            //////////////////////////////////
+        {
+            sz_t ogstrlen = 0, mdstrlen = 0;
+            const char *ogstr = og->get_string (&ogstrlen);
+            const char *mdstr = md->get_string (&mdstrlen);
+            if ((ogstrlen != mdstrlen) || (memcmp (ogstr, mdstr, ogstrlen) != 0))
+            {
+                diff->copy (md);
+            }
+        }
+        
+        //////////////////////////////////
+        else if (og->is_integer ())
+            //////////////////////////////////
+        {
+            KVR_ASSERT (md->_is_number ());
+            
+            if (md->is_integer ())
+            {
+                int64_t ogn = og->get_integer ();
+                int64_t mdn = md->get_integer ();
+                if (ogn != mdn)
+                {
+                    diff->copy (md);
+                }
+            }
+            else if (md->is_float ())
+            {
+                double ogn = og->get_float ();
+                double mdn = md->get_float ();
+                if (!kvr::internal::fp_equal (ogn, mdn, KVR_CONSTANT_DIFF_FP_EQ_EPSILON))
+                {
+                    diff->copy (md);
+                }
+            }
+        }
+        
+        //////////////////////////////////
+        else if (og->is_float ())
+            //////////////////////////////////
+        {
+            double ogn = og->get_float ();
+            double mdn = md->get_float ();
+            if (!kvr::internal::fp_equal (ogn, mdn, KVR_CONSTANT_DIFF_FP_EQ_EPSILON))
+            {
+                diff->copy (md);
+            }
+        }
+        
+        //////////////////////////////////
+        else if (og->is_boolean ())
+            //////////////////////////////////
+        {
+            bool ogb = og->get_boolean ();
+            bool mdb = md->get_boolean ();
+            if (ogb != mdb)
+            {
+                diff->copy (md);
+            }
+        }
+    }
+    
+    return diff;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::patch (const value *diff)
+{
+    KVR_ASSERT (diff);
+    
+    if (diff && diff->is_map () && (this->is_map () || this->is_array ()))
+    {
+        // patch
+        value *set = diff->find (kvr_const_str_set);
+        value *add = diff->find (kvr_const_str_add);
+        value *rem = diff->find (kvr_const_str_rem);
+        
+        KVR_ASSERT (set);
+        KVR_ASSERT (add);
+        KVR_ASSERT (rem);
+        
+        this->_patch_set (set);
+        this->_patch_add (add);
+        this->_patch_rem (rem);
+    }
+    else if (diff->is_array ())
+    {
+        // do nothing.
+    }
+    else if (diff->_type_equiv (this))
+    {
+        this->copy (diff);
+    }
+    
+    return this;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t kvr::value::hash (uint32_t seed) const
+{
+    uint32_t hc = seed;
+    
+    //////////////////////////////////
+    if (this->is_map ())
+        //////////////////////////////////
+    {
+        hc += (FLAG_TYPE_MAP);
+        uint32_t mhc = 0;
+        cursor c (this);
+        
+        pair p;
+        while (c.get (&p))
+        {
+            const key *k = p.get_key ();
+            value *v = p.get_value ();
+            uint32_t kh = kvr::internal::hash (k->get_string (), k->get_length ());
+            uint32_t vh = v->hash ();
+            mhc ^= (kh * vh);
+        }
+        hc += mhc;
+    }
+    
+    //////////////////////////////////
+    else if (this->is_array ())
+        //////////////////////////////////
+    {
+        hc += (FLAG_TYPE_ARRAY);
+        uint32_t ahc = 0;
+        if (this->is_packed ())
+        {
+            // same hash as the unpacked array
+            value e (this->_ctx (), FLAG_PARENT_ARRAY);
+            for (sz_t i = 0, c = this->length (); i < c; ++i)
+            {
+                this->_packed_element (i, &e);
+                uint32_t kh = i;
+                uint32_t vh = e.hash ();
+                ahc += (kh * vh);
+            }
+        }
+        else
+        {
+            for (sz_t i = 0, c = this->length (); i < c; ++i)
+            {
+                value *v = this->_peek (i);
+                uint32_t kh = i;
+                uint32_t vh = v->hash ();
+                ahc += (kh * vh);
+            }
+        }
+        hc += ahc;
+    }
+    
+    //////////////////////////////////
+    else if (this->is_string ())
+        //////////////////////////////////
+    {
+        hc += (FLAG_TYPE_STRING_STATIC + FLAG_TYPE_STRING_DYNAMIC);
+        sz_t len = 0;
+        const char *str = this->get_string (&len);
+        hc += kvr::internal::hash (str, len);
+    }
+    
+    //////////////////////////////////
+    else if (this->is_integer ())
+        //////////////////////////////////
+    {
+        hc += (FLAG_TYPE_NUMBER_INTEGER);
+        uint64_t i = static_cast<uint64_t>(this->get_integer ());
+        uint32_t hv = static_cast<uint32_t>((i & 0x00000000ffffffff) ^ (i >> 32));
+        hc += hv;
+    }
+    
+    //////////////////////////////////
+    else if (this->is_float ())
+        //////////////////////////////////
+    {
+        hc += (FLAG_TYPE_NUMBER_FLOAT);
+        double f = this->get_float ();
+        uint32_t hv = static_cast<uint32_t>(std::floor (f));
+        hc += hv;
+    }
+    
+    //////////////////////////////////
+    else if (this->is_boolean ())
+        //////////////////////////////////
+    {
+        hc += (FLAG_TYPE_BOOLEAN);
+        bool b = this->get_boolean ();
+        uint32_t hv = b ? 4u : 5u;
+        hc += hv;
+    }
+    
+    //////////////////////////////////
+    else if (this->is_null ())
+        //////////////////////////////////
+    {
+        hc += (FLAG_TYPE_NULL);
+    }
+    
+    return hc;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool kvr::value::freeze (frozen_doc *doc) const
+{
+    KVR_ASSERT_SAFE (doc, false);
+    
+    kvr::internal::frozen::build_ctx bctx (doc);
+    return bctx.build (this);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool kvr::value::encode (codec_t codec, obuffer *obuf)
+{
+    KVR_ASSERT_SAFE (obuf, false);
+    
+    bool success = false;
+    
+    obuf->m_stream.seek (0);
+    
+    switch (codec)
+    {
+        case kvr::CODEC_JSON:
+        {
+            success = kvr::internal::json::write (this, &obuf->m_stream);
+            break;
+        }
+            
+        case kvr::CODEC_MSGPACK:
+        {
+            success = kvr::internal::msgpack::write (this, &obuf->m_stream);
+            break;
+        }
+            
+        case kvr::CODEC_CBOR:
+        {
+            success = kvr::internal::cbor::write (this, &obuf->m_stream);
+            break;
+        }
+            
+        default:
+        {
+            break;
+        }
+    }
+    
+    return success;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool kvr::value::decode (codec_t codec, const uint8_t *data, size_t size, uint32_t flags)
+{
+    bool success = false;
+    
+    this->_conv_null ();
+    
+    mem_istream istr (data, size);
+    bool borrow = (flags & DECODE_BORROW_STRINGS) != 0;
+    bool pack = (flags & DECODE_PACK_ARRAYS) != 0;
+    
+    switch (codec)
+    {
+        case kvr::CODEC_JSON:
+        {
+            if (flags & DECODE_JSON_INDEXED)
+            {
+                kvr::internal::json::indexed::isa_t isa = kvr::internal::json::indexed::ISA_AVX2;
+                if (flags & DECODE_JSON_INDEX_NO_AVX2) { isa = kvr::internal::json::indexed::ISA_SSE2; }
+                if (flags & DECODE_JSON_INDEX_NO_SIMD) { isa = kvr::internal::json::indexed::ISA_SCALAR; }
+                success = kvr::internal::json::read_indexed (this, istr, isa, pack);
+            }
+            else
+            {
+                success = kvr::internal::json::read (this, istr, pack);
+            }
+            break;
+        }
+            
+        case kvr::CODEC_MSGPACK:
+        {
+            success = kvr::internal::msgpack::read (this, istr, borrow, pack);
+            break;
+        }
+            
+        case kvr::CODEC_CBOR:
+        {
+            success = kvr::internal::cbor::read (this, istr, borrow, pack);
+            break;
+        }
+            
+        default:
+        {
+            break;
+        }
+    }
+    
+    return success;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool kvr::value::decode_insitu (codec_t codec, uint8_t *data, size_t size, uint32_t flags)
+{
+    KVR_ASSERT_SAFE (data, false);
+    
+    bool success = false;
+    
+    this->_conv_null ();
+    
+    mem_istream istr (data, size);
+    bool borrow = (flags & DECODE_BORROW_STRINGS) != 0;
+    bool pack = (flags & DECODE_PACK_ARRAYS) != 0;
+    
+    switch (codec)
+    {
+        case kvr::CODEC_JSON:
+        {
+            success = kvr::internal::json::read_insitu (this, (char *) data, size, borrow, pack);
+            break;
+        }
+            
+        case kvr::CODEC_MSGPACK:
+        {
+            success = kvr::internal::msgpack::read (this, istr, borrow, pack, true);
+            break;
+        }
+            
+        case kvr::CODEC_CBOR:
+        {
+            success = kvr::internal::cbor::read (this, istr, borrow, pack, true);
+            break;
+        }
+            
+        default:
+        {
+            break;
+        }
+    }
+    
+    return success;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool kvr::value::encode (codec_t codec, ostream *ostr)
+{
+    KVR_ASSERT_SAFE (ostr, false);
+    
+    bool success = false;
+    
+    switch (codec)
+    {
+        case kvr::CODEC_JSON:
+        {
+            success = kvr::internal::json::write (this, ostr);
+            break;
+        }
+            
+        case kvr::CODEC_MSGPACK:
+        {
+            success = kvr::internal::msgpack::write (this, ostr);
+            break;
+        }
+            
+        case kvr::CODEC_CBOR:
+        {
+            success = kvr::internal::cbor::write (this, ostr);
+            break;
+        }
+            
+        default:
+        {
+            break;
+        }
+    }
+    
+    return success;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool kvr::value::decode (codec_t codec, istream &istr, uint32_t flags)
+{
+    bool success = false;
+    
+    this->_conv_null ();
+    
+    bool pack = (flags & DECODE_PACK_ARRAYS) != 0;
+    
+    switch (codec)
+    {
+        case kvr::CODEC_JSON:
+        {
+            success = kvr::internal::json::read (this, istr, pack);
+            break;
+        }
+            
+        case kvr::CODEC_MSGPACK:
+        {
+            success = kvr::internal::msgpack::read (this, istr, pack);
+            break;
+        }
+            
+        case kvr::CODEC_CBOR:
+        {
+            success = kvr::internal::cbor::read (this, istr, pack);
+            break;
+        }
+            
+        default:
+        {
+            break;
+        }
+    }
+    
+    return success;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t kvr::value::encode_bound (codec_t codec) const
+{
+    size_t size = 0;
+    
+    switch (codec)
+    {
+        case kvr::CODEC_JSON:
+        {
+            size = kvr::internal::json::write_approx_size (this);
+            break;
+        }
+            
+        case kvr::CODEC_MSGPACK:
+        {
+            size = kvr::internal::msgpack::write_approx_size (this);
+            break;
+        }
+            
+        case kvr::CODEC_CBOR:
+        {
+            size = kvr::internal::cbor::write_approx_size (this);
+            break;
+        }
+            
+        default:
+        {
+            break;
+        }
+    }
+    
+    size = ((size + 1u + 7u) & ~7u); // + 1 for the terminator written on flush
+    
+    return size;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void kvr::value::dump () const
+{
+#if KVR_DEBUG
+    this->_dump (0, NULL);
+    std::fprintf (stderr, "\n");
+#endif
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void kvr::value::_string_set (const char *str, sz_t len)
+{
+    KVR_ASSERT (str);
+    KVR_ASSERT (is_string ());
+    
+    if (this->_is_string_static () && (len >= STRING_STATIC_CAP))
+    {
+        this->_clear ();
+        m_flags |= FLAG_TYPE_STRING_DYNAMIC;
+    }
+    
+    if (this->_is_string_dynamic ())
+    {
+        kvr::ctx *ctx = this->_ctx ();
+        
+        if (ctx->m_intern)
+        {
+            // look up before releasing the old string (str may point into it)
+            key *k = ctx->m_sstore.insert (str, len, ctx->m_allocator);
+            this->_string_free ();
+            m_data.s.m_key = k;
+            m_flags |= FLAG_STRING_INTERNED;
+        }
+        else if ((m_flags & FLAG_STRING_MASK) || !m_data.s.m_dyn || (len != m_len))
+        {
+            // heap strings are sized exactly (len + 1), so only a length change reallocates
+            char *dyn = (char *) ctx->m_allocator->allocate (len + 1); KVR_ASSERT (dyn);
+            memcpy (dyn, str, len);
+            dyn [len] = 0;
+            this->_string_free ();
+            m_data.s.m_dyn = dyn;
+        }
+        else
+        {
+            memmove (m_data.s.m_dyn, str, len);
+        }
+        
+        m_len = len;
+    }
+    else
+    {
+        KVR_ASSERT (len < STRING_STATIC_CAP);
+        char *stt = this->_string_static ();
+        memcpy (stt, str, len);
+        stt [len] = 0;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void kvr::value::_string_move (char *str, sz_t size)
+{
+    KVR_ASSERT (str);
+    KVR_ASSERT (size > 0);
+    KVR_ASSERT (is_string ());
+    
+    this->_clear ();
+    m_flags |= FLAG_TYPE_STRING_DYNAMIC;
+    
+    KVR_ASSERT (str [size - 1] == 0);
+    kvr::ctx *ctx = this->_ctx ();
+    
+    if (ctx->m_intern)
+    {
+        // an existing entry leaves str with us
+        key *k = ctx->m_sstore.insert_move (str, size - 1, ctx->m_allocator);
+        if (k->m_str != str)
+        {
+            ctx->m_allocator->deallocate (str, size);
+        }
+        m_data.s.m_key = k;
+        m_flags |= FLAG_STRING_INTERNED;
+    }
+    else
+    {
+        m_data.s.m_dyn = str;
+    }
+    
+    m_len = size - 1;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void kvr::value::_string_borrow (const char *str, sz_t len, bool terminated)
+{
+    KVR_ASSERT (str);
+    
+    // short strings stay inline and interned strings are shared, so copy those
+    if ((len < STRING_STATIC_CAP) || this->_ctx ()->m_intern)
+    {
+        this->set_string (str, len);
+    }
+    else
+    {
+        this->_clear ();
+        m_flags |= (FLAG_TYPE_STRING_DYNAMIC | (terminated ? FLAG_STRING_BORROWED_TERM : FLAG_STRING_BORROWED));
+        m_data.s.m_dyn = const_cast<char *>(str);
+        m_len = len;
+        ++this->_ctx ()->m_borrowed;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void kvr::value::_string_free ()
+{
+    KVR_ASSERT (this->_is_string_dynamic ());
+    
+    kvr::ctx *ctx = this->_ctx ();
+    
+    if ((m_flags & FLAG_STRING_MASK) == FLAG_STRING_INTERNED)
+    {
+        ctx->m_sstore.erase (m_data.s.m_key, ctx->m_allocator);
+        m_flags &= ~FLAG_STRING_MASK;
+    }
+    else if (m_flags & FLAG_STRING_BORROWED) // terminated or not
+    {
+        KVR_ASSERT (ctx->m_borrowed > 0);
+        --ctx->m_borrowed;
+        m_flags &= ~FLAG_STRING_MASK;
+    }
+    else if (m_data.s.m_dyn)
+    {
+        ctx->m_allocator->deallocate (m_data.s.m_dyn, m_len + 1);
+    }
+    
+    m_data.s.m_dyn = NULL;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::_search_path_expr (const char *expr, const char **lastkey, value **lastparent,
+                                            bool unshare) const
+{
+    KVR_ASSERT (expr);
+    KVR_ASSERT (expr [0] != 0);
+    
+    value *v = (value *) this;
+    
+    const char delim = KVR_TOKEN_DELIMITER;
+    const char *e1 = expr;
+    const char *e2 = strchr (e1, delim);
+    
+    uint8_t kbuf [256];
+    kvr::mem_ostream kos (kbuf, 256);
+    
+    while (v && e2)
+    {
+        size_t klen = static_cast<size_t>(e2 - e1);
+        char *k = (char *) kos.push (klen + 1);
+        kvr_strncpy (k, kos.size (), e1, klen);
+        
+        v = v->_search_key (k, unshare);
+        
+        e1 = ++e2;
+        e2 = strchr (e1, delim);
+        kos.seek (0);
+    }
+    
+    if (lastparent)
+    {
+        *lastparent = v;
+    }
+    
+    if (lastkey)
+    {
+        *lastkey = e1;
+    }
+    
+    if (v && e1 && (*e1 != 0))
+    {
+        v = v->_search_key (e1, unshare);
+    }
+    
+    return v;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::_search_key (const char *keystr, bool unshare) const
+{
+    KVR_ASSERT (keystr);
+    
+    value *v = NULL;
+    
+    if (unshare)
+    {
+        // only for searches from a non-const value: what is found may be written
+        value *self = const_cast<value *>(this);
+        self->_unshare ();
+        if (self->is_packed ())
+        {
+            self->_unpack ();
+        }
+    }
+    
+    //////////////////////////////////
+    if (this->is_map ())
+        //////////////////////////////////
+    {
+        v = this->find (keystr);
+    }
+    
+    //////////////////////////////////
+    else if (this->is_array ())
+        //////////////////////////////////
+    {
+        char k0 = keystr [0];
+        switch (k0)
+        {
+            case KVR_TOKEN_MAP_GREP: // pattern match in array of maps
+            {
+                const char eq = '=';
+                const char *pattern = &keystr [1];
+                const char *s = strchr (pattern, eq);
+                
+                if (s)
+                {
+                    sz_t sklen = static_cast<sz_t>(s - pattern);
+                    const char *sk = pattern;
+                    const char *sv = s + 1;
+                    
+                    for (sz_t i = 0, c = this->length (), f = 0; (i < c) && !f; ++i)
+                    {
+                        value *m = this->_peek (i);
+                        
+                        if (m && m->is_map ())
+                        {
+                            cursor cur = internal::view::cursor (m);
+                            pair p;
+                            
+                            while (cur.get (&p))
+                            {
+                                key *pk = p.get_key ();
+                                const char *pks = pk->get_string ();
+                                sz_t pkslen = pk->get_length ();
+                                
+                                if (pks && (pkslen == sklen) && (strncmp (pks, sk, sklen) == 0))
+                                {
+                                    // got key (unique), now check value
+                                    value *pv = p.get_value ();
+                                    KVR_ASSERT (pv);
+                                    
+                                    if (pv->is_string ())
+                                    {
+                                        sz_t pvstrlen = 0;
+                                        const char *pvstr = pv->get_string (&pvstrlen);
+                                        if ((strlen (sv) == pvstrlen) && (memcmp (sv, pvstr, pvstrlen) == 0))
+                                        {
+                                            v = m;
+                                            f = 1;
+                                        }
+                                    }
+                                    else if (pv->is_float ())
+                                    {
+                                        double svf = strtod (sv, NULL);
+                                        double pvf = pv->get_float ();
+                                        if (kvr::internal::fp_equal (svf, pvf))
+                                        {
+                                            v = m;
+                                            f = 1;
+                                        }
+                                    }
+                                    else if (pv->is_integer ())
+                                    {
+                                        char *end = NULL;
+                                        int64_t svi = strtoll (sv, &end, 10);
+                                        int64_t pvi = pv->get_integer ();
+                                        if (end && (!*end) && (svi == pvi))
+                                        {
+                                            v = m;
+                                            f = 1;
+                                        }
+                                    }
+                                    else if (pv->is_boolean ())
+                                    {
+                                        int valid = (strcmp (sv, kvr_const_str_false) == 0) ? 0 : (strcmp (sv, kvr_const_str_true) == 0) ? 1 : -1;
+                                        if (valid != -1)
+                                        {
+                                            bool svb = valid ? true : false;
+                                            bool pvb = pv->get_boolean ();
+                                            if (svb == pvb)
+                                            {
+                                                v = m;
+                                                f = 1;
+                                            }
+                                        }
+                                    }
+                                    else if (pv->is_null ())
+                                    {
+                                        bool svnull = (strcmp (sv, kvr_const_str_null) == 0);
+                                        if (svnull)
+                                        {
+                                            v = m;
+                                            f = 1;
+                                        }
+                                    }
+                                    
+                                    break;
+                                }
+                            }
+                        }
+                    }
+                }
+                break;
+            }
+                
+            default:
+            {
+                char *end = NULL;
+                int64_t ki64 = strtoll (keystr, &end, 10);
+                KVR_ASSERT_SAFE ((end && (!*end) && "non-integral array index"), NULL);
+                KVR_ASSERT (ki64 >= 0);
+                KVR_ASSERT ((uint64_t) ki64 <= kvr::SZ_T_MAX);
+                KVR_ASSERT_SAFE (!this->is_packed () && "packed elements have no value, use get_*_at", NULL);
+                sz_t ki = (sz_t) ki64;
+                v = this->_peek (ki);
+                break;
+            }
+        }
+    }
+    
+    return v;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint8_t kvr::value::_type () const
+{
+    uint8_t t = (uint8_t) (m_flags & FLAG_TYPE_MASK);
+    return t;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool kvr::value::_type_equiv (const value *rhs) const
+{
+    KVR_ASSERT (rhs);
+    
+    if ((this->_type () == rhs->_type ()) ||
+        (this->_is_number () && rhs->_is_number ()) ||
+        (this->is_string () && rhs->is_string ()))
+    {
+        return true;
+    }
+    
+    return false;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void kvr::value::_destruct ()
+{
+    if (this->_is_shared ())
+    {
+        // the other values sharing the container keep it
+        --this->_container ()->ref;
+    }
+    else if (this->is_map ())
+    {
+        kvr::ctx *ctx = this->_ctx ();
+        cursor c = internal::view::cursor (this);
+        pair   p;
+        while (c.get (&p))
+        {
+            ctx->_destroy_key (p.m_k);
+            ctx->_destroy_value (FLAG_PARENT_MAP, p.m_v);
+        }
+        m_data.m.deinit (ctx->m_allocator);
+    }
+    else if (this->is_packed ())
+    {
+        m_data.a.deinit_packed (this->_packed_size (), this->_ctx ()->m_allocator);
+    }
+    else if (this->is_array ())
+    {
+        sz_t c = this->length ();
+        while (c)
+        {
+            this->pop ();
+            c = this->length ();
+        }
+        m_data.a.deinit (this->_ctx ()->m_allocator);
+    }
+    else if (this->_is_string_dynamic ())
+    {
+        this->_string_free ();
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void kvr::value::_clear ()
+{
+    // release memory
+    this->_destruct ();
+    
+    // zero data
+    memset (&m_data, 0, sizeof (m_data));
+    m_len = 0;
+    
+    // clear type flag
+    m_flags &= ~(FLAG_TYPE_MASK | FLAG_ARRAY_PACKED | FLAG_STRING_MASK);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void kvr::value::_dump (size_t lpad, const char *key) const
+{
+#if KVR_DEBUG
+    for (size_t t = 0; t < lpad; ++t)
+    {
+        std::fprintf (stderr, "  ");
+    }
+    
+    if (key)
+    {
+        std::fprintf (stderr, "key = %s : ", key);
+    }
+    
+    //////////////////////////////////
+    if (this->is_map ())
+        //////////////////////////////////
+    {
+        std::fprintf (stderr, "value = -> [map]\n");
+        
+        cursor c (this);
+        pair   p;
+        while (c.get (&p))
+        {
+            const char *k = p.get_key ()->get_string ();
+            value *v = p.get_value ();
+            v->_dump (lpad + 1, k);
+        }
+    }
+    
+    //////////////////////////////////
+    else if (this->is_array ())
+        //////////////////////////////////
+    {
+        std::fprintf (stderr, "value = -> [array]%s\n", this->is_packed () ? " (packed)" : "");
+        
+        char k [21];
+        value e (this->_ctx (), FLAG_PARENT_ARRAY);
+        for (sz_t i = 0, c = this->length (); i < c; ++i)
+        {
+            size_t kl = kvr::internal::u64toa (i, k);
+            k [kl] = 0;
+            if (this->is_packed ())
+            {
+                this->_packed_element (i, &e);
+                e._dump (lpad + 1, k);
+            }
+            else
+            {
+                value *v = this->_peek (i);
+                v->_dump (lpad + 1, k);
+            }
+        }
+    }
+    
+    //////////////////////////////////
+    else if (this->is_string ())
+        //////////////////////////////////
+    {
+        sz_t len = 0;
+        const char *str = this->get_string (&len);
+        std::fprintf (stderr, "value = %.*s -> [string]\n", (int) len, str);
+    }
+    
+    //////////////////////////////////
+    else if (this->is_integer ())
+        //////////////////////////////////
+    {
+        int64_t n = this->get_integer ();
+#if 0
+        std::fprintf (stderr, "value = %" PRId64 " -> [int]\n", n);
+#else
+        // PRId64 not supported by travis-ci
+        char ns [22];
+        size_t c = kvr::internal::i64toa (n, ns);
+        ns [c] = 0;
+        fprintf (stderr, "value = %s -> [int]\n", ns);
+#endif
+    }
+    
+    //////////////////////////////////
+    else if (this->is_float ())
+        //////////////////////////////////
+    {
+        double n = this->get_float ();
+        std::fprintf (stderr, "value = %g -> [float]\n", n);
+    }
+    
+    //////////////////////////////////
+    else if (this->is_boolean ())
+        //////////////////////////////////
+    {
+        bool b = this->get_boolean ();
+        std::fprintf (stderr, "value = %s -> [bool]\n", b ? kvr_const_str_true : kvr_const_str_false);
+    }
+    
+    //////////////////////////////////
+    else if (this->is_null ())
+        //////////////////////////////////
+    {
+        std::fprintf (stderr, "value = %s -> [null]\n", kvr_const_str_null);
+    }
+#else
+    KVR_REF_UNUSED (lpad);
+    KVR_REF_UNUSED (key);
+#endif
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void kvr::value::_diff_set_rem (value *set, value *rem, const value *og, const value *md,
+                                const char **path, const sz_t pathsz, sz_t pathcnt)
+{
+    KVR_ASSERT (set);
+    KVR_ASSERT (rem);
+    
+    // find og values in md that need to be updated
+    // if missing, mark for removal
+    // (a subtree shared with its copy hasn't been written since, so there is nothing to find)
+    
+    if (og && !(md && og->_shares (md)))
+    {
+        //////////////////////////////////
+        if (md == NULL)
+        //////////////////////////////////
+        {
+            // at this point og and md cannot be root values. therefore KVR_ASSERT (pathsz > 0)
+            KVR_ASSERT (pathcnt > 0);
+            // add og to rem list
+            kvr::ctx *ctx = this->_ctx ();
+            value *v = rem->push_null ();
+            v->_conv_string ();
+            
+            if (pathcnt == 1)
+            {
+                const char *pk = path [0];
+                v->set_string (pk);
+            }
+            else
+            {
+                sz_t pksz = 0;
+                char *pk = ctx->_create_path_expr (path, pathcnt, &pksz);
+                v->_string_move (pk, pksz);
+            }
+        }
+        
+        //////////////////////////////////
+        else if (!og->_type_equiv (md))
+        //////////////////////////////////
+        {
+            // at this point og and md cannot be root values. therefore KVR_ASSERT (pathsz > 0)
+            KVR_ASSERT (pathcnt > 0);
+            
+            kvr::ctx *ctx = this->_ctx ();
+            key *k = NULL;
+            //if ((pathcnt == 1) && (ctx == og->_ctx ())) // path key must already be in the key store
+            if (pathcnt == 1)
+            {
+                const char *pk = path [0];
+                k = ctx->_create_key (pk);
+            }
+            else
+            {
+                sz_t pksz = 0;
+                char *pk = ctx->_create_path_expr (path, pathcnt, &pksz);
+                KVR_ASSERT (pk && pksz);
+                k = ctx->_create_key_move (pk, pksz - 1);
+                if (k->m_ref > 1) { ctx->_destroy_path_expr (pk, pksz); pk = NULL; }
+            }
+            
+            value *v = ctx->_create_value_null (FLAG_PARENT_MAP);
+            v->copy (md);
+            set->_insert_kv (k, v);
+        }
+        
+        //////////////////////////////////
+        else if (og->is_map ())
+        //////////////////////////////////
+        {
+            KVR_ASSERT (md->is_map ());
+            
+            value::cursor c (og);
+            pair ogp;
+            
+            while (c.get (&ogp))
+            {
+                const char *k = ogp.get_key ()->get_string ();
+                
+                KVR_ASSERT (pathcnt < pathsz);
+                path [pathcnt++] = k;
+                
+                value *mdv = md->_peek (k);
+                value *ogv = ogp.get_value ();
+                
+                this->_diff_set_rem (set, rem, ogv, mdv, path, pathsz, pathcnt);
+                
+                path [--pathcnt] = NULL;
+            }
+        }
+        
+        //////////////////////////////////
+        else if (og->is_array ())
+        //////////////////////////////////
+        {
+            KVR_ASSERT (md->is_array ());
+            
+            char k [21];
+            value mdt (og->_ctx (), FLAG_PARENT_ARRAY), ogt (og->_ctx (), FLAG_PARENT_ARRAY);
+            for (sz_t i = 0, c = og->length (); i < c; ++i)
+            {
+                size_t kl = kvr::internal::u64toa (i, k);
+                k [kl] = 0;
+                
+                KVR_ASSERT (pathcnt < pathsz);
+                path [pathcnt++] = k;
+                
+                value *mdv = md->_peek (i, &mdt);
+                value *ogv = og->_peek (i, &ogt);
+                
+                this->_diff_set_rem (set, rem, ogv, mdv, path, pathsz, pathcnt);
+                
+                path [--pathcnt] = NULL;
+            }
+        }
+        
+        //////////////////////////////////
+        else if (og->is_string ())
+        //////////////////////////////////
+        {
+            KVR_ASSERT (pathcnt > 0);
+            KVR_ASSERT (md->is_string ());
+            
+            sz_t ogstrlen = 0, mdstrlen = 0;
+            const char *ogstr = og->get_string (&ogstrlen);
+            const char *mdstr = md->get_string (&mdstrlen);
+            
+            if ((ogstrlen != mdstrlen) || (memcmp (ogstr, mdstr, ogstrlen) != 0))
+            {
+                kvr::ctx *ctx = this->_ctx ();
+                key *k = NULL;
+                if (pathcnt == 1)
+                {
+                    const char *pk = path [0];
+                    k = ctx->_create_key (pk);
+                }
+                else
+                {
+                    sz_t pksz = 0;
+                    char *pk = ctx->_create_path_expr (path, pathcnt, &pksz);
+                    KVR_ASSERT (pk && pksz);
+                    k = ctx->_create_key_move (pk, pksz - 1);
+                    if (k->m_ref > 1) { ctx->_destroy_path_expr (pk, pksz); pk = NULL; }
+                }
+                
+                value *v = ctx->_create_value_string (FLAG_PARENT_MAP, mdstr, mdstrlen);
+                set->_insert_kv (k, v);
+            }
+        }
+        
+        //////////////////////////////////
+        else if (og->is_integer ())
+        //////////////////////////////////
+        {
+            KVR_ASSERT (pathcnt > 0);
+            KVR_ASSERT (md->_is_number ());
+            
+            if (md->is_integer ())
+            {
+                int64_t ogn = og->get_integer ();
+                int64_t mdn = md->get_integer ();
+                
+                if (ogn != mdn)
+                {
+                    kvr::ctx *ctx = this->_ctx ();
+                    key *k = NULL;
+                    if (pathcnt == 1)
+                    {
+                        const char *pk = path [0];
+                        k = ctx->_create_key (pk);
+                    }
+                    else
+                    {
+                        sz_t pksz = 0;
+                        char *pk = ctx->_create_path_expr (path, pathcnt, &pksz);
+                        KVR_ASSERT (pk && pksz);
+                        k = ctx->_create_key_move (pk, pksz - 1);
+                        if (k->m_ref > 1) { ctx->_destroy_path_expr (pk, pksz); pk = NULL; }
+                    }
+                    
+                    value *v = ctx->_create_value_integer (FLAG_PARENT_MAP, mdn);
+                    set->_insert_kv (k, v);
+                }
+            }
+            else if (md->is_float ())
+            {
+                double ogn = og->get_float ();
+                double mdn = md->get_float ();
+                
+                if (!kvr::internal::fp_equal (ogn, mdn, KVR_CONSTANT_DIFF_FP_EQ_EPSILON))
+                {
+                    kvr::ctx *ctx = this->_ctx ();
+                    key *k = NULL;
+                    if (pathcnt == 1)
+                    {
+                        const char *pk = path [0];
+                        k = ctx->_create_key (pk);
+                    }
+                    else
+                    {
+                        sz_t pksz = 0;
+                        char *pk = ctx->_create_path_expr (path, pathcnt, &pksz);
+                        KVR_ASSERT (pk && pksz);
+                        k = ctx->_create_key_move (pk, pksz - 1);
+                        if (k->m_ref > 1) { ctx->_destroy_path_expr (pk, pksz); pk = NULL; }
+                    }
+                    
+                    value *v = ctx->_create_value_float (FLAG_PARENT_MAP, mdn);
+                    set->_insert_kv (k, v);
+                }
+            }
+        }
+        
+        //////////////////////////////////
+        else if (og->is_float ())
+        //////////////////////////////////
+        {
+            KVR_ASSERT (pathcnt > 0);
+            KVR_ASSERT (md->_is_number ());
+            
+            double ogn = og->get_float ();
+            double mdn = md->get_float ();
+            
+            if (!kvr::internal::fp_equal (ogn, mdn, KVR_CONSTANT_DIFF_FP_EQ_EPSILON))
+            {
+                kvr::ctx *ctx = this->_ctx ();
+                key *k = NULL;
+                if (pathcnt == 1)
+                {
+                    const char *pk = path [0];
+                    k = ctx->_create_key (pk);
+                }
+                else
+                {
+                    sz_t pksz = 0;
+                    char *pk = ctx->_create_path_expr (path, pathcnt, &pksz);
+                    KVR_ASSERT (pk && pksz);
+                    k = ctx->_create_key_move (pk, pksz - 1);
+                    if (k->m_ref > 1) { ctx->_destroy_path_expr (pk, pksz); pk = NULL; }
+                }
+                
+                value *v = ctx->_create_value_float (FLAG_PARENT_MAP, mdn);
+                set->_insert_kv (k, v);
+            }
+        }
+        
+        //////////////////////////////////
+        else if (og->is_boolean ())
+        //////////////////////////////////
+        {
+            KVR_ASSERT (pathcnt > 0);
+            KVR_ASSERT (md->is_boolean ());
+            
+            bool ogb = og->get_boolean ();
+            bool mdb = md->get_boolean ();
+            
+            if (ogb != mdb)
+            {
+                kvr::ctx *ctx = this->_ctx ();
+                key *k = NULL;
+                if (pathcnt == 1)
+                {
+                    const char *pk = path [0];
+                    k = ctx->_create_key (pk);
+                }
+                else
+                {
+                    sz_t pksz = 0;
+                    char *pk = ctx->_create_path_expr (path, pathcnt, &pksz);
+                    KVR_ASSERT (pk && pksz);
+                    k = ctx->_create_key_move (pk, pksz - 1);
+                    if (k->m_ref > 1) { ctx->_destroy_path_expr (pk, pksz); pk = NULL; }
+                }
+                
+                value *v = ctx->_create_value_boolean (FLAG_PARENT_MAP, mdb);
+                set->_insert_kv (k, v);
+            }
+        }
+        
+        //////////////////////////////////
+        else if (og->is_null ())
+        //////////////////////////////////
+        {
+            KVR_ASSERT (md->is_null ());
+            // should already be taken care of in type check
+        }
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void kvr::value::_diff_add (value *add, const value *og, const value *md,
+                            const char **path, const sz_t pathsz, sz_t pathcnt)
+{
+    KVR_ASSERT (add);
+    
+    // go through md and og and look for nodes in md that are not in og
+    
+    if (md && !(og && og->_shares (md)))
+    {
+        //////////////////////////////////
+        if (og == NULL)
+        //////////////////////////////////
+        {
+            // at this point og and md cannot be root values. therefore KVR_ASSERT (pathsz > 0)
+            KVR_ASSERT (pathcnt > 0);
+            // add md to add list
+            
+            kvr::ctx *ctx = this->_ctx ();
+            key *k = NULL;
+            //if ((pathcnt == 1) && (ctx == md->_ctx ()))
+            if (pathcnt == 1)
+            {
+                const char *pk = path [0];
+                k = ctx->_create_key (pk);
+            }
+            else
+            {
+                sz_t pksz = 0;
+                char *pk = ctx->_create_path_expr (path, pathcnt, &pksz);
+                KVR_ASSERT (pk && pksz);
+                k = ctx->_create_key_move (pk, pksz - 1);
+                if (k->m_ref > 1) { ctx->_destroy_path_expr (pk, pksz); pk = NULL; }
+            }
+            
+            value *v = ctx->_create_value_null (FLAG_PARENT_MAP);
+            v->copy (md);
+            add->_insert_kv (k, v);
+        }
+        
+        //////////////////////////////////
+        else if (!og->_type_equiv (md))
+        //////////////////////////////////
+        {
+            // at this point og and md cannot be root values. therefore KVR_ASSERT (pathsz > 0)
+            KVR_ASSERT (pathcnt > 0);
+            // case handled by _diff_set_rem (which must be called before _diff_add)
+        }
+        
+        //////////////////////////////////
+        else if (md->is_map ())
+        //////////////////////////////////
+        {
+            KVR_ASSERT (og->is_map ());
+            
+            value::cursor c (md);
+            pair mdp;
+            
+            while (c.get (&mdp))
+            {
+                const char *k = mdp.get_key ()->get_string ();
+                
+                KVR_ASSERT (pathcnt < pathsz);
+                path [pathcnt++] = k;
+                
+                value *ogv = og->_peek (k);
+                value *mdv = mdp.get_value ();
+                
+                _diff_add (add, ogv, mdv, path, pathsz, pathcnt);
+                
+                path [--pathcnt] = NULL;
+            }
+        }
+        
+        //////////////////////////////////
+        else if (md->is_array ())
+        //////////////////////////////////
+        {
+            KVR_ASSERT (og->is_array ());
+            
+            char k [21];
+            value ogt (md->_ctx (), FLAG_PARENT_ARRAY), mdt (md->_ctx (), FLAG_PARENT_ARRAY);
+            for (sz_t i = 0, c = md->length (); i < c; ++i)
+            {
+                size_t kl = kvr::internal::u64toa (i, k); k [kl] = 0;
+                
+                KVR_ASSERT (pathcnt < pathsz);
+                path [pathcnt++] = k;
+                
+                value *ogv = og->_peek (i, &ogt);
+                value *mdv = md->_peek (i, &mdt);
+                
+                _diff_add (add, ogv, mdv, path, pathsz, pathcnt);
+                
+                path [--pathcnt] = NULL;
+            }
+        }
+    }
+}                   
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void kvr::value::_patch_set (const value *set)
+{
+    KVR_ASSERT (set);
+    
+    kvr::value *tg = this;
+    
+    kvr::value::cursor cursor (set);
+    kvr::pair p;
+    
+    while (cursor.get (&p))
+    {
+        const char *skey = p.get_key ()->get_string ();
+        kvr::value *sval = p.get_value ();
+        kvr::value *tgv  = tg->_search_path_expr (skey, NULL, NULL, true);
+        
+        if (tgv)
+        {
+            tgv->copy (sval);
+        }
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void kvr::value::_patch_add (const value *add)
+{
+    KVR_ASSERT (add);
+    
+    value *tg = this;
+    
+    kvr::value::cursor cursor (add);
+    kvr::pair p;
+    
+    while (cursor.get (&p))
+    {
+        const char *akey = p.get_key ()->get_string ();
+        value *aval = p.get_value ();
+        
+        const char *tgk = NULL;
+        value *tgp = NULL;
+        value *tgv = tg->_search_path_expr (akey, &tgk, &tgp, true);
+        KVR_ASSERT (tgv == NULL); // path shouldn't exist but we're interested in key and parent
+        KVR_REF_UNUSED (tgv);
+        
+        if (tgk && tgp)
+        {
+            KVR_ASSERT (tgp->is_map () || tgp->is_array ());
+            
+            if (tgp->is_map ())
+            {
+                value *v = tgp->insert_null (tgk);
+                KVR_ASSERT (v);
+                v->copy (aval);
+            }
+            else if (tgp->is_array ())
+            {
+#if KVR_DEBUG
+                char *end;
+                int64_t ki64 = strtoll (tgk, &end, 10); KVR_ASSERT (!*end);
+                KVR_ASSERT (ki64 >= 0);
+                KVR_ASSERT ((uint64_t) ki64 <= kvr::SZ_T_MAX);
+                sz_t ki = (sz_t) ki64;
+                sz_t sz = tgp->length ();
+                KVR_ASSERT (ki == sz);
+#endif
+                value *v = tgp->push_null ();
+                v->copy (aval);
+            }
+        }
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void kvr::value::_patch_rem (const value *rem)
+{
+    KVR_ASSERT (rem);
+    
+    value *tg = this;
+    
+    for (sz_t c = rem->length (); c >= 1; --c) // start from bottom (for array pop)
+    {
+        sz_t i = c - 1;
+        
+        value *rval = rem->element (i);
+        KVR_ASSERT (rval);
+        
+        sz_t rlen = 0;
+        const char *rkey = rval->get_string (&rlen);
+        KVR_ASSERT (rkey);
+        
+        // a path borrowed from a const buffer isn't null-terminated
+        char *rterm = NULL;
+        if ((rval->m_flags & FLAG_STRING_MASK) == FLAG_STRING_BORROWED)
+        {
+            rterm = (char *) this->_ctx ()->m_allocator->allocate (rlen + 1); KVR_ASSERT (rterm);
+            memcpy (rterm, rkey, rlen);
+            rterm [rlen] = 0;
+            rkey = rterm;
+        }
+        
+        const char *tgk = NULL;
+        value *tgp = NULL;
+        value *tgv = tg->_search_path_expr (rkey, &tgk, &tgp, true);
+        
+        if (tgp && tgv)
+        {
+            KVR_ASSERT (tgp->is_map () || tgp->is_array ());
+            
+            if (tgp->is_map ())
+            {
+                KVR_ASSERT (tgv == tgp->find (tgk));
+                tgp->remove (tgk);
+            }
+            else if (tgp->is_array ())
+            {
+#if KVR_DEBUG
+                char *end;
+                int64_t ki64 = strtoll (tgk, &end, 10); KVR_ASSERT (!*end);
+                KVR_ASSERT (ki64 >= 0);
+                KVR_ASSERT ((uint64_t) ki64 <= kvr::SZ_T_MAX);
+                sz_t ki = (sz_t) ki64;
+                sz_t sz = tgp->length ();
+                KVR_ASSERT ((ki + 1) == sz);
+#endif
+                tgp->pop ();
+            }
+        }
+        
+        if (rterm)
+        {
+            this->_ctx ()->m_allocator->deallocate (rterm, rlen + 1);
+        }
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void kvr::value::_insert_kv (key *k, value *v)
+{
+    KVR_ASSERT (k);
+    KVR_ASSERT (v);
+    KVR_ASSERT (is_map ());
+    
+    this->_unshare ();
+    map::node *n = NULL;
+    
+#if KVR_DEBUG
+    n = (k->m_ref <= 1) ? NULL : m_data.m.find (k);
+    KVR_ASSERT (n == NULL);
+#endif
+    
+    n = m_data.m.insert (k, v, this->_ctx ()->m_allocator);
+    KVR_ASSERT (n != NULL);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::_splice (key *k, value *root)
+{
+    KVR_ASSERT (k);
+    KVR_ASSERT (k->m_ref > 0);
+    KVR_ASSERT (root);
+    
+#if KVR_FLAG_DISABLE_IMPLICIT_TYPE_CONVERSION
+    KVR_ASSERT (is_map ());
+#else
+    this->_conv_map ();
+#endif
+    this->_unshare ();
+    
+    map::node *n = NULL;
+    
+#if !KVR_FLAG_ALLOW_DUPLICATE_MAP_KEYS
+    n = (k->m_ref <= 1) ? NULL : m_data.m.find (k);
+    if (n)
+    {
+        this->_ctx ()->_destroy_key (k);
+    }
+    else
+#endif
+    {
+        kvr::ctx *ctx = this->_ctx ();
+        n = m_data.m.insert (k, ctx->_create_value_null (FLAG_PARENT_MAP), ctx->m_allocator);
+        KVR_ASSERT (n);
+    }
+    
+    n->v->_adopt (root);
+    return n->v;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void kvr::value::_adopt (value *root)
+{
+    KVR_ASSERT (root && (root != this));
+    KVR_ASSERT (((root->m_flags & FLAG_PARENT_MASK) == FLAG_PARENT_CTX) && "splice needs a root value");
+    
+    kvr::ctx *rctx = root->_ctx ();
+    
+    if (rctx == this->_ctx ())
+    {
+        this->_clear ();
+        root->_relocate (this);
+        rctx->m_vstore.remove (root, rctx->m_allocator);
+    }
+    else
+    {
+        this->copy (root);
+        rctx->destroy_value (root);
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void kvr::value::_relocate (value *dst) const
+{
+    // values hold no pointers to themselves, so a subtree moves with its root's 16 bytes.
+    // dst (holding nothing) keeps its parent, this is released without being destructed
+    KVR_ASSERT (dst && (dst != this));
+    KVR_ASSERT (dst->_ctx () == this->_ctx ());
+    
+    uint32_t flags = (m_flags & ~FLAG_PARENT_MASK) | (dst->m_flags & FLAG_PARENT_MASK);
+    memcpy ((void *) dst, (const void *) this, sizeof (kvr::value));
+    dst->m_flags = flags;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value::header * kvr::value::_container () const
+{
+    return this->is_map () ? m_data.m._hdr () : (this->is_array () ? m_data.a._hdr () : NULL);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool kvr::value::_is_shared () const
+{
+    header *h = this->_container ();
+    return h && (h->ref > 1);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool kvr::value::_shares (const value *other) const
+{
+    KVR_ASSERT (other);
+    
+    header *h = this->_container ();
+    return h && (h == other->_container ());
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void kvr::value::_share (value *dst) const
+{
+    // dst (holding nothing) takes on this value. maps and arrays are shared, not copied
+    KVR_ASSERT (dst && (dst != this));
+    KVR_ASSERT (dst->_ctx () == this->_ctx ());
+    
+    header *h = this->_container ();
+    
+    if (h && (h->ref >= SHARE_MAX))
+    {
+        dst->copy (this);
+        return;
+    }
+    
+    this->_relocate (dst);
+    
+    if (h)
+    {
+        ++h->ref;
+    }
+    else if (this->_is_string_dynamic ())
+    {
+        if ((m_flags & FLAG_STRING_MASK) == FLAG_STRING_INTERNED)
+        {
+            m_data.s.m_key->_retain ();
+        }
+        else if (m_data.s.m_dyn)
+        {
+            // heap strings (owned or borrowed) aren't counted: copy
+            char *dyn = (char *) this->_ctx ()->m_allocator->allocate (m_len + 1); KVR_ASSERT (dyn);
+            memcpy (dyn, m_data.s.m_dyn, m_len);
+            dyn [m_len] = 0;
+            dst->m_data.s.m_dyn = dyn;
+            dst->m_flags &= ~FLAG_STRING_MASK;
+        }
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void kvr::value::_unshare ()
+{
+    // a shared map or array gets its own container before it is written. only this
+    // level is copied, the members go on sharing theirs until they are written too
+    if (!this->_is_shared ())
+    {
+        return;
+    }
+    
+    kvr::ctx *ctx = this->_ctx ();
+    allocator *a = ctx->m_allocator;
+    header *h = this->_container ();
+    
+    if (this->is_map ())
+    {
+        size_t asz = map::_alloc_size (h->cap);
+        uint8_t *base = (uint8_t *) a->allocate (asz); KVR_ASSERT (base);
+        memcpy (base, h, asz);
+        
+        map m;
+        m.m_ptr = reinterpret_cast<map::node *>(base + HEADER_SZ);
+        m._hdr ()->ref = 1;
+        
+        for (sz_t i = 0, len = h->len; i < len; ++i)
+        {
+            map::node *n = &m.m_ptr [i];
+            if (n->k)
+            {
+                value *v = ctx->_create_value (FLAG_PARENT_MAP);
+                n->v->_share (v);
+                n->k->_retain ();
+                n->v = v;
+            }
+        }
+        
+        m_data.m = m;
+    }
+    else if (this->is_packed ())
+    {
+        size_t esz = this->_packed_size ();
+        
+        array arr;
+        arr.m_raw = array::_alloc (h->cap, esz, a);
+        memcpy (arr.m_raw, m_data.a.m_raw, esz * h->len);
+        arr._hdr ()->len = h->len;
+        
+        m_data.a = arr;
+    }
+    else
+    {
+        array arr;
+        arr.m_ptr = (value *) array::_alloc (h->cap, sizeof (kvr::value), a);
+        
+        for (sz_t i = 0, len = h->len; i < len; ++i)
+        {
+            value *e = new (&arr.m_ptr [i]) kvr::value (ctx, FLAG_PARENT_ARRAY);
+            m_data.a.m_ptr [i]._share (e);
+        }
+        arr._hdr ()->len = h->len;
+        
+        m_data.a = arr;
+    }
+    
+    --h->ref;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::_peek (const char *key) const
+{
+    // find without unsharing (for reads that don't hand the value out)
+    KVR_ASSERT (key);
+    KVR_ASSERT (is_map ());
+    
+    kvr::key *k = this->_ctx ()->_find_key (key);
+    map::node *n = k ? this->m_data.m.find (k) : NULL;
+    return n ? n->v : NULL;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::_peek (sz_t index) const
+{
+    // element without unsharing or unpacking (packed elements have no value)
+    KVR_ASSERT (is_array ());
+    
+    return this->is_packed () ? NULL : this->m_data.a.elem (index);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::_peek (sz_t index, value *tmp) const
+{
+    // element for reads, packed ones are copied out into tmp
+    KVR_ASSERT (is_array ());
+    KVR_ASSERT (tmp);
+    
+    if (this->is_packed ())
+    {
+        if (index >= this->m_data.a.length ())
+        {
+            return NULL;
+        }
+        
+        this->_packed_element (index, tmp);
+        return tmp;
+    }
+    
+    return this->m_data.a.elem (index);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::_push ()
+{
+    KVR_ASSERT (is_array ());
+    
+    this->_unshare ();
+    
+    if (this->is_packed ())
+    {
+        this->_unpack ();
+    }
+    
+    kvr::ctx *ctx = this->_ctx ();
+    return this->m_data.a.push (ctx, ctx->m_allocator);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t kvr::value::_packed_size () const
+{
+    switch (m_flags & FLAG_ARRAY_PACKED)
+    {
+        case FLAG_ARRAY_PACKED_INTEGER: { return sizeof (int64_t); }
+        case FLAG_ARRAY_PACKED_FLOAT:   { return sizeof (double); }
+        case FLAG_ARRAY_PACKED_BOOLEAN: { return sizeof (bool); }
+        default:                        { return 0; }
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void kvr::value::_packed_element (sz_t index, value *e) const
+{
+    KVR_ASSERT (e);
+    KVR_ASSERT (is_packed ());
+    KVR_ASSERT (index < m_data.a.length ());
+    
+    switch (m_flags & FLAG_ARRAY_PACKED)
+    {
+        case FLAG_ARRAY_PACKED_INTEGER:
+        {
+            e->_conv_integer ();
+            e->m_data.n.i = static_cast<const int64_t *>(m_data.a.m_raw) [index];
+            break;
+        }
+            
+        case FLAG_ARRAY_PACKED_FLOAT:
+        {
+            e->_conv_float ();
+            e->m_data.n.f = static_cast<const double *>(m_data.a.m_raw) [index];
+            break;
+        }
+            
+        default:
+        {
+            e->_conv_boolean ();
+            e->m_data.b = static_cast<const bool *>(m_data.a.m_raw) [index];
+            break;
+        }
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool kvr::value::_push_packed (uint32_t flag, const void *src, sz_t count)
+{
+    KVR_ASSERT (is_array ());
+    KVR_ASSERT (src || (count == 0));
+    
+    this->_unshare ();
+    
+    // an empty array takes on the packed element type, anything else must match it
+    if ((m_flags & FLAG_ARRAY_PACKED) != flag)
+    {
+        if (m_data.a.length () > 0)
+        {
+            return false;
+        }
+        
+        this->_pack (flag, count);
+    }
+    
+    size_t esz = this->_packed_size ();
+    void *dst = m_data.a.push_packed (count, esz, this->_ctx ()->m_allocator);
+    memcpy (dst, src, esz * count);
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void kvr::value::_pack (uint32_t flag, sz_t cap)
+{
+    KVR_ASSERT (!is_array () || (m_data.a.length () == 0));
+    
+    // keep the capacity hint of an empty array (e.g. from as_array)
+    sz_t c = (is_array () && (m_data.a._hdr ()->cap > cap)) ? m_data.a._hdr ()->cap : cap;
+    
+    this->_clear ();
+    m_flags |= (FLAG_TYPE_ARRAY | flag);
+    m_data.a.init_packed (c, this->_packed_size (), this->_ctx ()->m_allocator);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void kvr::value::_unpack ()
+{
+    KVR_ASSERT (is_packed ());
+    
+    kvr::ctx *ctx = this->_ctx ();
+    allocator *a = ctx->m_allocator;
+    sz_t len = m_data.a.length ();
+    
+    array arr;
+    arr.init (len, a);
+    for (sz_t i = 0; i < len; ++i)
+    {
+        value *e = arr.push (ctx, a);
+        this->_packed_element (i, e);
+    }
+    
+    if (this->_is_shared ())
+    {
+        --m_data.a._hdr ()->ref;
+    }
+    else
+    {
+        m_data.a.deinit_packed (this->_packed_size (), a);
+    }
+    m_data.a = arr;
+    m_flags &= ~FLAG_ARRAY_PACKED;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void kvr::value::_conv_map (sz_t cap)
+{
+    if (!is_map ())
+    {
+        this->_clear ();
+        m_flags |= FLAG_TYPE_MAP;
+        m_data.m.init (cap, this->_ctx ()->m_allocator);
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void kvr::value::_conv_array (sz_t cap)
+{
+    if (!is_array ())
+    {
+        this->_clear ();
+        m_flags |= FLAG_TYPE_ARRAY;
+        m_data.a.init (cap, this->_ctx ()->m_allocator);
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void kvr::value::_conv_string ()
+{
+    if (!is_string ())
+    {
+        this->_clear ();
+        m_flags |= FLAG_TYPE_STRING_STATIC;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void kvr::value::_conv_boolean ()
+{
+    if (!is_boolean ())
+    {
+        this->_clear ();
+        m_flags |= FLAG_TYPE_BOOLEAN;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void kvr::value::_conv_integer ()
+{
+    if (!is_integer ())
+    {
+        if (is_float ())
+        {
+            int64_t i = static_cast<int64_t> (m_data.n.f);
+            m_data.n.i = i;
+            m_flags &= ~FLAG_TYPE_MASK;
+        }
+        else
+        {
+            this->_clear ();
+        }
+        
+        m_flags |= FLAG_TYPE_NUMBER_INTEGER;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void kvr::value::_conv_float()
+{
+    if (!is_float ())
+    {
+        if (is_integer ())
+        {
+            double f = static_cast<double> (m_data.n.i);
+            m_data.n.f = f;
+            m_flags &= ~FLAG_TYPE_MASK;
+        }
+        else
+        {
+            this->_clear ();
+        }
+        
+        m_flags |= FLAG_TYPE_NUMBER_FLOAT;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void kvr::value::_conv_null()
+{
+    if (!is_null ())
+    {
+        this->_clear ();
+        m_flags |= FLAG_TYPE_NULL;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// kvr::value::array
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void kvr::value::array::init (sz_t size, allocator *a)
+{
+    KVR_ASSERT (a);
+    
+    // copies of empty arrays ask for 0
+    sz_t allocsz = kvr::internal::align_size ((size > 0) ? size : 1, CAP_INCR);
+    m_ptr = (kvr::value *) _alloc (allocsz, sizeof (kvr::value), a);
+#if KVR_DEBUG  
+    memset ((void *) m_ptr, 0, sizeof (kvr::value) * allocsz); // debug-only
+#endif
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void kvr::value::array::deinit (allocator *a)
+{
+    KVR_ASSERT (m_ptr);
+    KVR_ASSERT (a);
+    KVR_ASSERT (this->length () == 0);
+    
+    _free (m_ptr, sizeof (kvr::value), a);
+    m_ptr = NULL;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::array::push (ctx *c, allocator *a)
+{
+    KVR_ASSERT (c);
+    KVR_ASSERT (a);
+    KVR_ASSERT (m_ptr);
+    
+    header *h = this->_hdr ();
+    
+    if (h->len >= h->cap)
+    {
+        // resize (values hold no pointers to themselves, so they move bitwise)
+#if KVR_INTERNAL_FLAG_REALLOC_TYPE_FIXED
+        KVR_ASSERT ((uint64_t) h->len < (SZ_T_MAX - CAP_INCR));
+        sz_t new_cap = h->cap + CAP_INCR;
+#else
+        KVR_ASSERT ((uint64_t) h->len < (SZ_T_MAX - h->cap));
+        sz_t new_cap = h->cap + h->cap;
+#endif
+        this->reserve (new_cap, sizeof (kvr::value), a);
+        h = this->_hdr ();
+    }
+    
+    value *v = new (&m_ptr [h->len++]) kvr::value (c, FLAG_PARENT_ARRAY);
+    return v;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool kvr::value::array::pop ()
+{
+    header *h = this->_hdr ();
+    if (h->len > 0)
+    {
+        m_ptr [--h->len]._destruct ();
+#if KVR_DEBUG
+        memset ((void *) &m_ptr [h->len], 0, sizeof (kvr::value));
+#endif
+        return true;
+    }
+    
+    return false;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool kvr::value::array::pop (sz_t index)
+{
+    header *h = this->_hdr ();
+    if (index < h->len) // implies len > 0
+    {
+        m_ptr [index]._destruct ();
+        this->remove (index);
+        return true;
+    }
+    
+    return false;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void kvr::value::array::remove (sz_t index)
+{
+    // drops the slot without destructing it (the element was destructed or moved out)
+    KVR_ASSERT (index < this->length ());
+    this->erase (index, index + 1, sizeof (kvr::value));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::array::insert (sz_t index, sz_t count, ctx *c, allocator *a)
+{
+    KVR_ASSERT (c);
+    KVR_ASSERT (a);
+    
+    header *h = this->_hdr ();
+    KVR_ASSERT (index <= h->len);
+    KVR_ASSERT (((uint64_t) h->len + count) <= SZ_T_MAX);
+    
+    sz_t len = h->len + count;
+    if (len > h->cap)
+    {
+#if KVR_INTERNAL_FLAG_REALLOC_TYPE_FIXED
+        sz_t new_cap = h->cap + CAP_INCR;
+#else
+        sz_t new_cap = h->cap + h->cap;
+#endif
+        this->reserve ((new_cap < len) ? len : new_cap, sizeof (kvr::value), a);
+        h = this->_hdr ();
+    }
+    
+    // values hold no pointers to themselves, so they move bitwise
+    memmove ((void *) &m_ptr [index + count], (const void *) &m_ptr [index], sizeof (kvr::value) * (h->len - index));
+    for (sz_t i = index; i < (index + count); ++i)
+    {
+        new (&m_ptr [i]) kvr::value (c, FLAG_PARENT_ARRAY);
+    }
+    h->len = len;
+    
+    return &m_ptr [index];
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void kvr::value::array::reserve (sz_t cap, size_t esz, allocator *a)
+{
+    KVR_ASSERT (m_raw);
+    KVR_ASSERT (a);
+    
+    header *h = this->_hdr ();
+    if (cap > h->cap)
+    {
+        // callers unshare first, so the block is ours to resize (len and ref move with it)
+        KVR_ASSERT (h->ref == 1);
+        sz_t new_cap = kvr::internal::align_size (cap, CAP_INCR);
+        uint8_t *base = (uint8_t *) a->reallocate (h, HEADER_SZ + (esz * h->cap), HEADER_SZ + (esz * new_cap)); KVR_ASSERT (base);
+        h = reinterpret_cast<header *>(base);
+#if KVR_DEBUG
+        memset (base + HEADER_SZ + (esz * h->len), 0, esz * (new_cap - h->len));
+#endif
+        h->cap = new_cap;
+        m_raw = base + HEADER_SZ;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void kvr::value::array::erase (sz_t first, sz_t last, size_t esz)
+{
+    // drops [first, last) without destructing (see remove)
+    header *h = this->_hdr ();
+    KVR_ASSERT ((first <= last) && (last <= h->len));
+    
+    uint8_t *p = static_cast<uint8_t *>(m_raw);
+    memmove (p + (esz * first), p + (esz * last), esz * (h->len - last));
+    h->len -= (last - first);
+#if KVR_DEBUG
+    memset (p + (esz * h->len), 0, esz * (last - first));
+#endif
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void kvr::value::array::swap_remove (sz_t index, size_t esz)
+{
+    // drops the slot without destructing it and moves the last element into it
+    header *h = this->_hdr ();
+    KVR_ASSERT (index < h->len);
+    
+    uint8_t *p = static_cast<uint8_t *>(m_raw);
+    if (index != (h->len - 1))
+    {
+        memcpy (p + (esz * index), p + (esz * (h->len - 1)), esz);
+    }
+    --h->len;
+#if KVR_DEBUG
+    memset (p + (esz * h->len), 0, esz);
+#endif
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value * kvr::value::array::elem (sz_t index) const
+{
+    value *v = (index < this->length ()) ? &m_ptr [index] : NULL;
+    
+    return v;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void kvr::value::array::init_packed (sz_t size, size_t esz, allocator *a)
+{
+    KVR_ASSERT (a);
+    KVR_ASSERT (esz > 0);
+    
+    sz_t allocsz = kvr::internal::align_size ((size > 0) ? size : 1, CAP_INCR);
+    m_raw = _alloc (allocsz, esz, a);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void kvr::value::array::deinit_packed (size_t esz, allocator *a)
+{
+    KVR_ASSERT (m_raw);
+    KVR_ASSERT (a);
+    
+    _free (m_raw, esz, a);
+    m_raw = NULL;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void * kvr::value::array::push_packed (sz_t count, size_t esz, allocator *a)
+{
+    KVR_ASSERT (m_raw);
+    KVR_ASSERT (a);
+    
+    header *h = this->_hdr ();
+    KVR_ASSERT (((uint64_t) h->len + count) <= SZ_T_MAX);
+    
+    sz_t old = h->len;
+    sz_t len = old + count;
+    
+    if (len > h->cap)
+    {
+        // resize
+#if KVR_INTERNAL_FLAG_REALLOC_TYPE_FIXED
+        sz_t new_cap = h->cap + CAP_INCR;
+#else
+        sz_t new_cap = h->cap + h->cap;
+#endif
+        this->reserve ((new_cap < len) ? len : new_cap, esz, a);
+        h = this->_hdr ();
+    }
+    
+    void *p = static_cast<uint8_t *>(m_raw) + (esz * old);
+    h->len = len;
+    return p;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-void kvr::value::_diff_add (value *add, const value *og, const value *md,
-                            const char **path, const sz_t pathsz, sz_t pathcnt)
+bool kvr::value::array::pop_packed (sz_t index, size_t esz)
 {
-    KVR_ASSERT (add);
+    if (index < this->length ()) // implies len > 0
+    {
+        this->erase (index, index + 1, esz);
+        return true;
+    }
     
-    // go through md and og and look for nodes in md that are not in og
+    return false;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::sz_t kvr::value::array::length () const
+{
+    return this->_hdr ()->len;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value::header * kvr::value::array::_hdr () const
+{
+    KVR_ASSERT (m_raw);
+    return reinterpret_cast<header *>(static_cast<uint8_t *>(m_raw) - HEADER_SZ);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void * kvr::value::array::_alloc (sz_t cap, size_t esz, allocator *a)
+{
+    KVR_ASSERT (a);
+    
+    // block layout: header (padded to HEADER_SZ) | elements [cap]
+    uint8_t *base = (uint8_t *) a->allocate (HEADER_SZ + (esz * cap)); KVR_ASSERT (base);
+    header *h = reinterpret_cast<header *>(base);
+    h->len = 0;
+    h->cap = cap;
+    h->ref = 1;
+    return base + HEADER_SZ;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void kvr::value::array::_free (void *p, size_t esz, allocator *a)
+{
+    KVR_ASSERT (p);
+    KVR_ASSERT (a);
+    
+    uint8_t *base = static_cast<uint8_t *>(p) - HEADER_SZ;
+    a->deallocate (base, HEADER_SZ + (esz * reinterpret_cast<header *>(base)->cap));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// kvr::value::map
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void kvr::value::map::init (sz_t size, allocator *a)
+{
+    KVR_ASSERT (m_ptr == NULL);
+    KVR_ASSERT (a);
+    
+    // copies of empty maps ask for 0
+    sz_t allocsz = kvr::internal::align_size ((size > 0) ? size : 1, CAP_INCR);
+    uint8_t *base = (uint8_t *) a->allocate (_alloc_size (allocsz)); KVR_ASSERT (base);
+    memset (base, 0, _alloc_size (allocsz));
+    m_ptr = reinterpret_cast<node *>(base + HEADER_SZ);
+    this->_hdr ()->cap = allocsz;
+    this->_hdr ()->ref = 1;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void kvr::value::map::deinit (allocator *a)
+{
+    KVR_ASSERT (a);
+    
+    a->deallocate (this->_hdr (), _alloc_size (this->_hdr ()->cap));
+    m_ptr = NULL;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+kvr::value::map::node *kvr::value::map::insert (key *k, value *v, allocator *a)
+{
+    KVR_ASSERT (k);
+    KVR_ASSERT (v);
+    KVR_ASSERT (a);
+    KVR_ASSERT (m_ptr);
     
-    if (md)
+    header *h = this->_hdr ();
+    sz_t removed = *this->_removed ();
+    
+    // removed nodes are reclaimed here rather than in remove, so members can be removed
+    // while a cursor walks the map
+    if (removed > 0)
     {
-        //////////////////////////////////
-        if (og == NULL)
-        //////////////////////////////////
+        // shrink once a quarter full (down to twice the live size)
+        sz_t size = h->len - removed;
+        if ((h->cap > CAP_INCR) && ((size * 4) <= h->cap))
         {
-            // at this point og and md cannot be root values. therefore KVR_ASSERT (pathsz > 0)
-            KVR_ASSERT (pathcnt > 0);
-            // add md to add list
-            
-            kvr::ctx *ctx = m_ctx;
-            key *k = NULL;
-            //if ((pathcnt == 1) && (ctx == md->m_ctx))
-            if (pathcnt == 1)
-            {
-                const char *pk = path [0];
-                k = ctx->_create_key (pk);
-            }
-            else
-            {
-                sz_t pksz = 0;
-                char *pk = ctx->_create_path_expr (path, pathcnt, &pksz);
-                KVR_ASSERT (pk && pksz);
-                k = ctx->_create_key (pk, pksz - 1);
-                if (k->m_ref > 1) { ctx->_destroy_path_expr (pk, pksz); pk = NULL; }
-            }
-            
-            value *v = ctx->_create_value_null (FLAG_PARENT_MAP);
-            v->copy (md);
-            add->_insert_kv (k, v);
+            sz_t cap = kvr::internal::align_size (size + size, CAP_INCR);
+            this->_resize ((cap > CAP_INCR) ? cap : CAP_INCR, a);
         }
-        
-        //////////////////////////////////
-        else if (!og->_type_equiv (md))
-        //////////////////////////////////
+        // compact once removed nodes make up half of the used nodes
+        else if ((removed >= CAP_INCR) && ((removed * 2) >= h->len))
         {
-            // at this point og and md cannot be root values. therefore KVR_ASSERT (pathsz > 0)
-            KVR_ASSERT (pathcnt > 0);
-            // case handled by _diff_set_rem (which must be called before _diff_add)
+            this->_compact ();
         }
         
-        //////////////////////////////////
-        else if (md->is_map ())
-        //////////////////////////////////
+        h = this->_hdr ();
+    }
+    
+    if (h->len >= h->cap)
+    {
+        // reclaim removed nodes in place if there are enough of them,
+        // otherwise grow (which also drops removed nodes)
+        if ((*this->_removed () * 4) >= h->cap)
         {
-            KVR_ASSERT (og->is_map ());
-            
-            value::cursor c (md);
-            pair mdp;
-            
-            while (c.get (&mdp))
-            {
-                const char *k = mdp.get_key ()->get_string ();
-                
-                KVR_ASSERT (pathcnt < pathsz);
-                path [pathcnt++] = k;
-                
-                value *ogv = og->find (k);
-                value *mdv = mdp.get_value ();
-                
-                _diff_add (add, ogv, mdv, path, pathsz, pathcnt);
-                
-                path [--pathcnt] = NULL;
-            }
+            this->_compact ();
         }
-        
-        //////////////////////////////////
-        else if (md->is_array ())
-        //////////////////////////////////
+        else
         {
-            KVR_ASSERT (og->is_array ());
-            
-            char k [21];
-            for (sz_t i = 0, c = md->length (); i < c; ++i)
-            {
-                size_t kl = kvr::internal::u64toa (i, k); k [kl] = 0;
-                
-                KVR_ASSERT (pathcnt < pathsz);
-                path [pathcnt++] = k;
-                
-                value *ogv = og->element (i);
-                value *mdv = md->element (i);
-                
-                _diff_add (add, ogv, mdv, path, pathsz, pathcnt);
-                
-                path [--pathcnt] = NULL;
-            }
+#if KVR_INTERNAL_FLAG_REALLOC_TYPE_FIXED
+            KVR_ASSERT ((uint64_t) h->len < (SZ_T_MAX - CAP_INCR));
+            this->_resize (h->cap + CAP_INCR, a);
+#else
+            KVR_ASSERT ((uint64_t) h->len < (SZ_T_MAX - h->cap));
+            this->_resize (h->cap + h->cap, a);
+#endif
         }
+        
+        h = this->_hdr ();
     }
-}                   
+    
+    KVR_ASSERT (h->len < h->cap);
+    
+    sz_t i = h->len++;
+    node *n = &m_ptr [i];
+    n->k = k;
+    n->v = v;
+    
+    this->_index_add (i);
+    
+    return n;
+}
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-void kvr::value::_patch_set (const value *set)
+void kvr::value::map::remove (node *n, allocator *a)
 {
-    KVR_ASSERT (set);
+    KVR_ASSERT (n);
+    KVR_ASSERT (n->k);
+    KVR_ASSERT (n->v);
+    KVR_ASSERT (a);
     
-    kvr::value *tg = this;
+    header *h = this->_hdr ();
+    KVR_ASSERT ((n >= m_ptr) && (n < (m_ptr + h->len)));
     
-    kvr::value::cursor cursor (set);
-    kvr::pair p;
+    sz_t *removed = this->_removed ();
     
-    while (cursor.get (&p))
+    this->_index_remove ((sz_t) (n - m_ptr));
+    n->k = NULL;
+    n->v = NULL;
+    ++(*removed);
+    
+    // drop trailing removed nodes (no live node moves, so cursors stay valid; compacting
+    // waits for the next insert)
+    while ((h->len > 0) && !m_ptr [h->len - 1].k)
     {
-        const char *skey = p.get_key ()->get_string ();
-        kvr::value *sval = p.get_value ();
-        kvr::value *tgv  = tg->_search_path_expr (skey);
-        
-        if (tgv)
-        {
-            tgv->copy (sval);
-        }
+        KVR_ASSERT (*removed > 0);
+        --(*removed);
+        --h->len;
+    }
+    
+    // with no removed nodes left (e.g. cleared, or removed from the back) live nodes are
+    // already in place, so shrinking moves none of them. otherwise insert shrinks
+    if ((*removed == 0) && (h->cap > CAP_INCR) && ((h->len * 4) <= h->cap))
+    {
+        sz_t cap = kvr::internal::align_size (h->len + h->len, CAP_INCR);
+        this->_resize ((cap > CAP_INCR) ? cap : CAP_INCR, a);
     }
 }
 
@@ -3199,175 +6378,137 @@ void kvr::value::_patch_set (const value *set)
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-void kvr::value::_patch_add (const value *add)
+kvr::value::map::node *kvr::value::map::find (const key *k) const
 {
-    KVR_ASSERT (add);
-    
-    value *tg = this;
-    
-    kvr::value::cursor cursor (add);
-    kvr::pair p;
+    KVR_ASSERT (k);
     
-    while (cursor.get (&p))
+    const header *h = this->_hdr ();
+    sz_t isz = _index_size (h->cap);
+    if (isz)
     {
-        const char *akey = p.get_key ()->get_string ();
-        value *aval = p.get_value ();
-        
-        const char *tgk = NULL;
-        value *tgp = NULL;
-        value *tgv = tg->_search_path_expr (akey, &tgk, &tgp);
-        KVR_ASSERT (tgv == NULL); // path shouldn't exist but we're interested in key and parent
-        KVR_REF_UNUSED (tgv);
+        // hashed lookup; duplicate keys resolve to the last inserted node
+        const sz_t *index = this->_index ();
+        const sz_t mask = isz - 1;
+        node *found = NULL;
         
-        if (tgk && tgp)
+        for (sz_t s = (k->m_hash & mask); index [s] != 0; s = ((s + 1) & mask))
         {
-            KVR_ASSERT (tgp->is_map () || tgp->is_array ());
-            
-            if (tgp->is_map ())
-            {
-                value *v = tgp->insert_null (tgk);
-                KVR_ASSERT (v);
-                v->copy (aval);
-            }
-            else if (tgp->is_array ())
+            node *n = &m_ptr [index [s] - 1];
+            if (n->k == k)
             {
-#if KVR_DEBUG
-                char *end;
-                int64_t ki64 = strtoll (tgk, &end, 10); KVR_ASSERT (!*end);
-                KVR_ASSERT (ki64 >= 0);
-                KVR_ASSERT ((uint64_t) ki64 <= kvr::SZ_T_MAX);
-                sz_t ki = (sz_t) ki64;
-                sz_t sz = tgp->length ();
-                KVR_ASSERT (ki == sz);
+                KVR_ASSERT (n->v);
+#if KVR_FLAG_ALLOW_DUPLICATE_MAP_KEYS
+                found = (n > found) ? n : found;
+#else
+                found = n;
+                break;
 #endif
-                value *v = tgp->push_null ();
-                v->copy (aval);
             }
         }
+        
+        return found;
+    }
+    
+#if KVR_FLAG_ALLOW_DUPLICATE_MAP_KEYS
+    for (sz_t c = h->len, i = c - 1; c >= 1; --c, i = c - 1)
+#else
+    for (sz_t i = 0, c = h->len; i < c; ++i)
+#endif
+    {
+        node *n = &m_ptr [i];
+        if (n->k == k)
+        {
+            KVR_ASSERT (n->v);
+            return n;
+        }
     }
+    
+    return NULL;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-void kvr::value::_patch_rem (const value *rem)
+kvr::sz_t kvr::value::map::size () const // size in constant time
 {
-    KVR_ASSERT (rem);
-    
-    value *tg = this;
+    const header *h = this->_hdr ();
+    KVR_ASSERT (h->len >= *this->_removed ());
     
-    for (sz_t c = rem->length (); c >= 1; --c) // start from bottom (for array pop)
-    {
-        sz_t i = c - 1;
-        
-        value *rval = rem->element (i);
-        KVR_ASSERT (rval);
-        
-        const char *rkey = rval->get_string ();
-        KVR_ASSERT (rkey);
-        
-        const char *tgk = NULL;
-        value *tgp = NULL;
-        value *tgv = tg->_search_path_expr (rkey, &tgk, &tgp);
-        
-        if (tgp && tgv)
-        {
-            KVR_ASSERT (tgp->is_map () || tgp->is_array ());
-            
-            if (tgp->is_map ())
-            {
-                KVR_ASSERT (tgv == tgp->find (tgk));
-                tgp->remove (tgk);
-            }
-            else if (tgp->is_array ())
-            {
-#if KVR_DEBUG
-                char *end;
-                int64_t ki64 = strtoll (tgk, &end, 10); KVR_ASSERT (!*end);
-                KVR_ASSERT (ki64 >= 0);
-                KVR_ASSERT ((uint64_t) ki64 <= kvr::SZ_T_MAX);
-                sz_t ki = (sz_t) ki64;
-                sz_t sz = tgp->length ();
-                KVR_ASSERT ((ki + 1) == sz);
-#endif
-                tgp->pop ();
-            }
-        }
-    }
+    sz_t size = h->len - *this->_removed ();
+    return size;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-void kvr::value::_insert_kv (key *k, value *v)
+kvr::sz_t kvr::value::map::_index_size (sz_t cap)
 {
-    KVR_ASSERT (k);
-    KVR_ASSERT (v);
-    KVR_ASSERT (is_map ());
-    
-    map::node *n = NULL;
-    
-#if KVR_DEBUG
-    n = (k->m_ref <= 1) ? NULL : m_data.m.find (k);
-    KVR_ASSERT (n == NULL);
-#endif
-    
-    n = m_data.m.insert (k, v, m_ctx->m_allocator);
-    KVR_ASSERT (n != NULL);
+    // index slots: zero (no index) for small maps, else at most half full
+    sz_t isz = (cap >= KVR_CONSTANT_MAP_INDEX_THRESHOLD) ? kvr::internal::pow2_size (cap + cap) : 0;
+    return isz;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-void kvr::value::_push_v (value *v)
+size_t kvr::value::map::_alloc_size (sz_t cap)
 {
-    KVR_ASSERT (v);
-    KVR_ASSERT (is_array ());
-    
-    this->m_data.a.push (v, m_ctx->m_allocator);
+    // block layout: header (padded to HEADER_SZ) | nodes [cap] | index [_index_size (cap)] | removed node count
+    size_t asz = HEADER_SZ + (sizeof (node) * cap) + (sizeof (sz_t) * (_index_size (cap) + 1));
+    return asz;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-void kvr::value::_conv_map (sz_t cap)
+kvr::value::header *kvr::value::map::_hdr () const
 {
-    if (!is_map ())
-    {
-        this->_clear ();
-        m_flags |= FLAG_TYPE_MAP;
-        m_data.m.init (cap, m_ctx->m_allocator);
-    }
+    KVR_ASSERT (m_ptr);
+    return reinterpret_cast<header *>(reinterpret_cast<uint8_t *>(m_ptr) - HEADER_SZ);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-void kvr::value::_conv_array (sz_t cap)
+kvr::sz_t *kvr::value::map::_index () const
 {
-    if (!is_array ())
-    {
-        this->_clear ();
-        m_flags |= FLAG_TYPE_ARRAY;
-        m_data.a.init (cap, m_ctx->m_allocator);
-    }
+    KVR_ASSERT (m_ptr);
+    return reinterpret_cast<sz_t *>(m_ptr + this->_hdr ()->cap);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-void kvr::value::_conv_string ()
+kvr::sz_t *kvr::value::map::_removed () const
 {
-    if (!is_string ())
+    return this->_index () + _index_size (this->_hdr ()->cap);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void kvr::value::map::_index_build ()
+{
+    const header *h = this->_hdr ();
+    sz_t isz = _index_size (h->cap);
+    if (isz)
     {
-        this->_clear ();
-        m_flags |= FLAG_TYPE_STRING_STATIC;
+        memset (this->_index (), 0, sizeof (sz_t) * isz);
+        
+        for (sz_t i = 0; i < h->len; ++i)
+        {
+            if (m_ptr [i].k)
+            {
+                this->_index_add (i);
+            }
+        }
     }
 }
 
@@ -3375,12 +6516,25 @@ void kvr::value::_conv_string ()
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-void kvr::value::_conv_boolean ()
+void kvr::value::map::_index_add (sz_t i)
 {
-    if (!is_boolean ())
+    KVR_ASSERT (i < this->_hdr ()->len);
+    KVR_ASSERT (m_ptr [i].k);
+    
+    sz_t isz = _index_size (this->_hdr ()->cap);
+    if (isz)
     {
-        this->_clear ();
-        m_flags |= FLAG_TYPE_BOOLEAN;
+        // slots are node index + 1 (0 is empty)
+        sz_t *index = this->_index ();
+        const sz_t mask = isz - 1;
+        sz_t s = (m_ptr [i].k->m_hash & mask);
+        
+        while (index [s] != 0)
+        {
+            s = ((s + 1) & mask);
+        }
+        
+        index [s] = i + 1;
     }
 }
 
@@ -3388,22 +6542,51 @@ void kvr::value::_conv_boolean ()
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-void kvr::value::_conv_integer ()
+void kvr::value::map::_index_remove (sz_t i)
 {
-    if (!is_integer ())
+    KVR_ASSERT (i < this->_hdr ()->len);
+    KVR_ASSERT (m_ptr [i].k);
+    
+    sz_t isz = _index_size (this->_hdr ()->cap);
+    if (isz)
     {
-        if (is_float ())
+        sz_t *index = this->_index ();
+        const sz_t mask = isz - 1;
+        sz_t s = (m_ptr [i].k->m_hash & mask);
+        
+        while (index [s] != (i + 1))
         {
-            int64_t i = static_cast<int64_t> (m_data.n.f);
-            m_data.n.i = i;
-            m_flags &= ~FLAG_TYPE_NUMBER_FLOAT;
+            KVR_ASSERT (index [s] != 0);
+            s = ((s + 1) & mask);
         }
-        else
+        
+        // backward shift deletion: pull later entries of the probe run into the gap
+        sz_t j = s;
+        for (;;)
         {
-            this->_clear ();
+            index [s] = 0;
+            
+            for (;;)
+            {
+                j = ((j + 1) & mask);
+                
+                if (index [j] == 0)
+                {
+                    return;
+                }
+                
+                // entry stays if its home slot h lies cyclically in (s, j]
+                sz_t h = (m_ptr [index [j] - 1].k->m_hash & mask);
+                bool stays = (s <= j) ? ((s < h) && (h <= j)) : ((s < h) || (h <= j));
+                if (!stays)
+                {
+                    break;
+                }
+            }
+            
+            index [s] = index [j];
+            s = j;
         }
-        
-        m_flags |= FLAG_TYPE_NUMBER_INTEGER;
     }
 }
 
@@ -3411,22 +6594,32 @@ void kvr::value::_conv_integer ()
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-void kvr::value::_conv_float()
+void kvr::value::map::_compact ()
 {
-    if (!is_float ())
+    sz_t *removed = this->_removed ();
+    
+    if (*removed > 0)
     {
-        if (is_integer ())
-        {
-            double f = static_cast<double> (m_data.n.i);
-            m_data.n.f = f;
-            m_flags &= ~FLAG_TYPE_NUMBER_INTEGER;
-        }
-        else
+        header *h = this->_hdr ();
+        sz_t ir = 0, iw = 0;
+        while (ir < h->len)
         {
-            this->_clear ();
+            if (m_ptr [ir].k)
+            {
+                m_ptr [iw++] = m_ptr [ir++];
+            }
+            else
+            {
+                ir++;
+            }
         }
         
-        m_flags |= FLAG_TYPE_NUMBER_FLOAT;
+        KVR_ASSERT ((ir - iw) == *removed);
+        memset ((void *) (m_ptr + iw), 0, sizeof (node) * (ir - iw));
+        h->len = iw;
+        *removed = 0;
+        
+        this->_index_build ();
     }
 }
 
@@ -3434,870 +6627,819 @@ void kvr::value::_conv_float()
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-void kvr::value::_conv_null()
+void kvr::value::map::_resize (sz_t cap, allocator *a)
 {
-    if (!is_null ())
+    KVR_ASSERT (a);
+    KVR_ASSERT (cap >= this->size ());
+    
+    // move live nodes to the front first, so the block resizes with them in place
+    header *h = this->_hdr ();
+    sz_t len = 0;
+    for (sz_t i = 0; i < h->len; ++i)
     {
-        this->_clear ();
-        m_flags |= FLAG_TYPE_NULL;
+        if (m_ptr [i].k)
+        {
+            m_ptr [len++] = m_ptr [i];
+        }
     }
+    
+    KVR_ASSERT (len == this->size ());
+    KVR_ASSERT (h->ref == 1);
+    
+    size_t keep = HEADER_SZ + (sizeof (node) * len);
+    uint8_t *base = (uint8_t *) a->reallocate (h, _alloc_size (h->cap), _alloc_size (cap)); KVR_ASSERT (base);
+    memset (base + keep, 0, _alloc_size (cap) - keep);
+    
+    m_ptr = reinterpret_cast<node *>(base + HEADER_SZ);
+    h = this->_hdr ();
+    h->cap = cap;
+    h->len = len;
+    
+    this->_index_build ();
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
-// kvr::value::string
+// kvr::value::cursor
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-const char *kvr::value::string::stt_str::get () const
+kvr::value::cursor::cursor (const value *map) : m_map (map), m_index (0)
 {
-    return m_data;
+    KVR_ASSERT (map);
+    KVR_ASSERT (map->is_map ());
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::sz_t kvr::value::string::stt_str::length () const
+kvr::value::cursor::cursor (value *map) : m_map (map), m_index (0)
 {
-    size_t length = strlen (m_data);
-    return static_cast<sz_t>(length);
+    KVR_ASSERT (map);
+    KVR_ASSERT (map->is_map ());
+    
+    // members may be written: a shared map gets its own members first
+    map->_unshare ();
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-void kvr::value::string::stt_str::set (const char *str, sz_t len)
+bool kvr::value::cursor::get (pair *p)
 {
-    KVR_ASSERT (str);
-    KVR_ASSERT (len < stt_str::CAP);
-    kvr_strncpy (m_data, string::stt_str::CAP, str, len);
+    KVR_ASSERT (p);
+    const map::node *n = this->_get ();
+    if (p && n)
+    {
+        KVR_ASSERT (n->k && n->v);
+        p->m_k = n->k;
+        p->m_v = n->v;
+        return true;
+    }
+    return false;
 }
 
+
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-const char *kvr::value::string::dyn_str::get () const
+const kvr::value::map::node * kvr::value::cursor::_get ()
 {
-    return m_data;
+    const map::node *n = NULL;
+    
+    if (m_map && m_map->is_map ())
+    {
+        const map *m = &m_map->m_data.m;
+        const sz_t len = m->_hdr ()->len;
+        
+        n = (m_index < len) ? &m->m_ptr [m_index++] : NULL;
+        
+        while (n && !n->k)
+        {
+            KVR_ASSERT (!n->v);
+            n = (m_index < len) ? &m->m_ptr [m_index++] : NULL;
+        }
+    }
+    
+    return n;
 }
 
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// kvr::value::mem_ostream
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::sz_t kvr::value::string::dyn_str::length () const
-{
-    return m_len;
-}
+const size_t kvr::mem_ostream::MIN_BUF_SZ = 64u;
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-void kvr::value::string::dyn_str::set (const char *str, sz_t len, allocator *a)
+kvr::mem_ostream::mem_ostream (uint8_t *buf, size_t sz, allocator *alloc) : m_buf (buf), m_sz (sz), m_pos (0), m_btype (BUF_EXTERNAL)
 {
-    KVR_ASSERT (str);
-    KVR_ASSERT (len > 0);
-    KVR_ASSERT (a);
-    
-    sz_t allocsz = ((len + 1) + string::dyn_str::PAD) & ~string::dyn_str::PAD;
-    if (allocsz > m_size)
-    {
-        if (m_data) { a->deallocate (m_data, m_size); }
-        m_data = (char *) a->allocate (allocsz); KVR_ASSERT (m_data);
-        m_size = allocsz;
-    }
+    KVR_ASSERT (m_buf);
+    KVR_ASSERT (m_sz > 0);
     
-    kvr_strncpy (m_data, m_size, str, len);
-    m_len = len;
+    m_alloc = alloc ? alloc : get_default_allocator ();
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-void kvr::value::string::dyn_str::cleanup (allocator *a)
+kvr::mem_ostream::mem_ostream (size_t sz, allocator *alloc) : m_buf (NULL), m_sz (0), m_pos (0), m_btype (BUF_INTERNAL)
 {
-    KVR_ASSERT (a);
-    
-    if (m_data)
-    {
-        a->deallocate (m_data, m_size);
-        m_data = NULL;
-    }
+    m_alloc = alloc ? alloc : get_default_allocator ();
+    m_sz = kvr::internal::max (MIN_BUF_SZ, sz);
+    m_buf = (uint8_t *) m_alloc->allocate (m_sz); KVR_ASSERT (m_buf);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
-// kvr::value::array
+
+kvr::mem_ostream::~mem_ostream ()
+{
+    if (m_btype == BUF_INTERNAL) { m_alloc->deallocate (m_buf, m_sz); }
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-void kvr::value::array::init (sz_t size, allocator *a)
+void kvr::mem_ostream::put (uint8_t byte)
 {
-    KVR_ASSERT (size > 0);
-    KVR_ASSERT (a);
-    
-    sz_t allocsz = kvr::internal::align_size (size, CAP_INCR);
-    m_ptr = (kvr::value **) a->allocate (sizeof (kvr::value *) * allocsz); KVR_ASSERT (m_ptr);
-#if KVR_DEBUG  
-    memset (m_ptr, 0, sizeof (kvr::value *) * allocsz); // debug-only
-#endif
-    m_cap = allocsz;
-    m_len = 0;
+    if (m_pos >= m_sz)
+    {
+        size_t sz = m_sz + m_sz;
+        this->reserve (sz);
+    }
+    m_buf [m_pos++] = byte;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void kvr::mem_ostream::write (uint8_t *bytes, size_t count)
+{  
+    size_t desired_sz = m_pos + count;
+    if (desired_sz > m_sz)
+    {
+        size_t sz = m_sz;
+        do { sz += m_sz; } while (sz < desired_sz);
+        this->reserve (sz);
+    }
+    memcpy (&m_buf [m_pos], bytes, count);
+    m_pos += count;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-void kvr::value::array::deinit (allocator *a)
+uint8_t * kvr::mem_ostream::push (size_t count)
 {
-    KVR_ASSERT (m_ptr);
-    KVR_ASSERT (a);
+    size_t desired_sz = m_pos + count;
+    if (desired_sz > m_sz)
+    {
+        size_t sz = m_sz;
+        do { sz += m_sz; } while (sz < desired_sz);
+        this->reserve (sz);
+    }
     
-    a->deallocate (m_ptr, sizeof (kvr::value *) * m_cap);
-    m_ptr = NULL;
+    uint8_t *ret = &m_buf [m_pos];
+    m_pos += count;
+    return ret;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-void kvr::value::array::push (value *v, allocator *a)
+uint8_t * kvr::mem_ostream::pop (size_t count)
 {
-    KVR_ASSERT (v);
-    KVR_ASSERT (a);
-    
-    if (m_len >= m_cap)
+    if (m_pos >= count)
     {
-        // resize
-#if KVR_INTERNAL_FLAG_REALLOC_TYPE_FIXED
-        KVR_ASSERT ((uint64_t) m_len < (SZ_T_MAX - CAP_INCR));
-        KVR_ASSERT (m_ptr);
-        
-        sz_t new_cap = m_cap + CAP_INCR;
-        value ** new_ptr = (kvr::value **) a->allocate (sizeof (kvr::value *) * new_cap); KVR_ASSERT (new_ptr);
-        memcpy (new_ptr, m_ptr, sizeof (kvr::value *) * m_cap);
-#if KVR_DEBUG
-        memset (new_ptr + m_cap, 0, sizeof (kvr::value *) * CAP_INCR);
-#endif
-        a->deallocate (m_ptr, sizeof (kvr::value *) * m_cap);
-#else
-        KVR_ASSERT ((uint64_t) m_len < (SZ_T_MAX - m_cap));
-        KVR_ASSERT (m_ptr);
-        
-        sz_t new_cap = m_cap + m_cap;
-        value ** new_ptr = (kvr::value **) a->allocate (sizeof (kvr::value *) * new_cap); KVR_ASSERT (new_ptr);
-        memcpy (new_ptr, m_ptr, sizeof (kvr::value *) * m_cap);
-#if KVR_DEBUG
-        memset (new_ptr + m_cap, 0, sizeof (kvr::value *) * m_cap);
-#endif
-        a->deallocate (m_ptr, sizeof (kvr::value *) * m_cap);
-#endif
-        m_ptr = new_ptr;
-        m_cap = new_cap;
+        m_pos -= count;
+        uint8_t *ret = &m_buf [m_pos];
+        return ret;
     }
-    
-    m_ptr [m_len++] = v;
+    return NULL;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::value *kvr::value::array::pop ()
+const uint8_t * kvr::mem_ostream::buffer () const
 {
-#if KVR_DEBUG
-    value *v = NULL;
-    
-    if (m_len > 0)
-    {
-        v = m_ptr [--m_len];
-        m_ptr [m_len] = NULL;
-    }
-#else
-    value *v = (m_len > 0) ? m_ptr [--m_len] : NULL;
-#endif
-    
-    return v;
+    return m_buf;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::value * kvr::value::array::pop (sz_t index)
+size_t kvr::mem_ostream::size () const
 {
-    value *v = NULL;
-    
-    if (index < m_len) // implies m_len > 0
-    {
-        v = m_ptr [index];
-        
-        for (sz_t i = index + 1; i < m_len; ++i)
-        {
-            m_ptr [i - 1] = m_ptr [i];
-        }
-        
-        m_ptr [--m_len] = NULL;
-    }
-    
-    return v;
+    return m_sz;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::value * kvr::value::array::elem (sz_t index) const
+size_t kvr::mem_ostream::tell () const
 {
-    value *v = (index < m_len) ? m_ptr [index] : NULL;
-    
-    return v;
+    return m_pos;
 }
 
-/////////////////////////////////////////////////////////////////////////////////////////////////
-/////////////////////////////////////////////////////////////////////////////////////////////////
-/////////////////////////////////////////////////////////////////////////////////////////////////
-// kvr::value::map
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-void kvr::value::map::init (sz_t size, allocator *a)
+void kvr::mem_ostream::seek (size_t pos)
 {
-    KVR_ASSERT (m_ptr == NULL);
-    KVR_ASSERT (a);
-    KVR_ASSERT (size > 0); //if (size == 0) { size = 1U; }
-    
-    sz_t allocsz = kvr::internal::align_size (size, CAP_INCR);
-    m_ptr = (node *) a->allocate (sizeof (node) * allocsz); KVR_ASSERT (m_ptr);
-    memset (m_ptr, 0, sizeof (node) * allocsz);
-    m_cap = allocsz;
-    m_len = 0;
+    m_pos = pos;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-void kvr::value::map::deinit (allocator *a)
+void kvr::mem_ostream::flush ()
 {
-    KVR_ASSERT (a);
-    
-#if KVR_INTERNAL_FLAG_EXPERIMENTAL_FAST_MAP_SIZE
-    sz_t cap = _cap ();
-#else
-    sz_t cap = m_cap;
-#endif
-    a->deallocate (m_ptr, sizeof (node) * cap);
-    m_ptr = NULL;
+    // EOS == 0
+    KVR_ASSERT_SAFE ((m_pos < m_sz), (void) 0);
+    m_buf [m_pos] = 0;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::value::map::node *kvr::value::map::insert (key *k, value *v, allocator *a)
+void kvr::mem_ostream::reserve (size_t sz)
 {
-    KVR_ASSERT (k);
-    KVR_ASSERT (v);
-    KVR_ASSERT (a);
-    KVR_ASSERT (m_ptr);
-    
-#if KVR_INTERNAL_FLAG_EXPERIMENTAL_FAST_MAP_SIZE
-    
-    sz_t cap = _cap ();
-    // first, see if we can garbage-collect removed nodes
-    if ((m_len >= cap) && ((m_cap % CAP_INCR) != 0))
-    {
-        sz_t ir = 0, iw = 0;
-        while (ir < cap)
-        {
-            if (m_ptr [ir].k)
-            {
-                m_ptr [iw++] = m_ptr [ir++];
-            }
-            else
-            {
-                ir++;
-            }
-        }
-        m_len -= (ir - iw);
-        m_cap += (ir - iw);
-        KVR_ASSERT (m_len < cap);
-    }
-    
-    // check again
-    if (m_len >= cap)
-    {
-        // resize
-        sz_t new_cap = cap + CAP_INCR;
-        node *new_ptr = (node *) a->allocate (sizeof (node) * new_cap); KVR_ASSERT (new_ptr);
-        memcpy (new_ptr, m_ptr, sizeof (node) * cap);
-        memset (new_ptr + cap, 0, (sizeof (node) * CAP_INCR));
-        a->deallocate (m_ptr, sizeof (node) * cap);
-        
-        m_ptr = new_ptr;
-        m_cap += CAP_INCR;
-        KVR_ASSERT (new_cap >= m_cap);
-    }
-#else
-    
-#if KVR_INTERNAL_FLAG_REALLOC_TYPE_FIXED
-    
-    if (m_len >= m_cap)
+    if (sz > m_sz)
     {
-        KVR_ASSERT ((uint64_t) m_len < (SZ_T_MAX - CAP_INCR));
-        KVR_ASSERT (m_ptr);
+        uint8_t *buf = NULL;
         
-        // first, see if we can garbage-collect removed nodes
-        sz_t ir = 0, iw = 0;
-        while (ir < m_cap)
+        if (m_buf && (m_btype == BUF_INTERNAL))
         {
-            if (m_ptr [ir].k)
-            {
-                m_ptr [iw++] = m_ptr [ir++];
-            }
-            else
-            {
-                ir++;
-            }
-        }
-        m_len -= (ir - iw);
-        
-        // now check again and if resize if necessary
-        if (m_len >= m_cap)
-        {
-            // resize
-            sz_t new_cap = m_cap + CAP_INCR;
-            node *new_ptr = (node *) a->allocate (sizeof (node) * new_cap); KVR_ASSERT (new_ptr);
-            // copy over old nodes and set new nodes to null
-            memcpy (new_ptr, m_ptr, sizeof (node) * m_cap);
-            memset (new_ptr + m_cap, 0, (sizeof (node) * CAP_INCR));
-            a->deallocate (m_ptr, sizeof (node) * m_cap);
-            
-            m_ptr = new_ptr;
-            m_cap = new_cap;
+            buf = (uint8_t *) m_alloc->reallocate (m_buf, m_sz, sz); KVR_ASSERT (buf);
         }
-    }
-#else
-    if (m_len >= m_cap)
-    {
-        KVR_ASSERT ((uint64_t) m_len < (SZ_T_MAX - m_cap));
-        KVR_ASSERT (m_ptr);
-        
-        // first, see if we can garbage-collect removed nodes
-        sz_t ir = 0, iw = 0;
-        while (ir < m_cap)
+        else
         {
-            if (m_ptr [ir].k)
-            {
-                m_ptr [iw++] = m_ptr [ir++];
-            }
-            else
-            {
-                ir++;
-            }
+            // external buffers are copied out, never resized
+            buf = (uint8_t *) m_alloc->allocate (sz); KVR_ASSERT (buf);
+            if (m_buf) { memcpy (buf, m_buf, m_sz); }
         }
-        m_len -= (ir - iw);
         
-        // now check again and if resize if necessary
-        if (m_len >= m_cap)
-        {
-            // resize
-            sz_t new_cap = m_cap + m_cap;
-            node *new_ptr = (node *) a->allocate (sizeof (node) * new_cap); KVR_ASSERT (new_ptr);
-            // copy over old nodes and set new nodes to null
-            memcpy (new_ptr, m_ptr, sizeof (node) * m_cap);
-            memset (new_ptr + m_cap, 0, (sizeof (node) * m_cap));
-            a->deallocate (m_ptr, sizeof (node) * m_cap);
-            
-            m_ptr = new_ptr;
-            m_cap = new_cap;
-        }
+        m_buf = buf;
+        m_sz = sz;
+        m_btype = BUF_INTERNAL;
     }
-#endif
-    
-#endif
-    node *n = &m_ptr [m_len++];
-    n->k = k;
-    n->v = v;
-    
-    return n;
 }
 
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// kvr::mem_istream
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-void kvr::value::map::remove (node *n)
+kvr::mem_istream::mem_istream (const uint8_t *buf, size_t sz) : m_buf (buf), m_sz (sz), m_pos (0)
 {
-    KVR_ASSERT (n);
-    KVR_ASSERT (n->k);
-    KVR_ASSERT (n->v);
-    
-    if (m_len > 0)
-    {
-        n->k = NULL;
-        n->v = NULL;
-#if KVR_INTERNAL_FLAG_EXPERIMENTAL_FAST_MAP_SIZE
-        --m_cap;
-#endif
-    }
+    KVR_ASSERT (m_buf);
+    KVR_ASSERT (m_sz > 0);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::value::map::node *kvr::value::map::find (const key *k) const
+const uint8_t * kvr::mem_istream::buffer () const
 {
-  KVR_ASSERT (k);
-
-#if KVR_INTERNAL_FLAG_EXPERIMENTAL_FAST_MAP_SIZE
-    sz_t cap = _cap ();
-#else
-    sz_t cap = m_cap;
-#endif
-    
-    
-#if KVR_FLAG_ALLOW_DUPLICATE_MAP_KEYS
-    for (sz_t c = cap, i = c - 1; c >= 1; --c, i = c - 1)
-#else
-    for (sz_t i = 0, c = cap; i < c; ++i)
-#endif
-    {
-        node *n = &m_ptr [i];
-        if (n->k == k)
-        {
-            KVR_ASSERT (n->v);
-            return n;
-        }
-    }
-    
-    return NULL;
+    return m_buf;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::sz_t kvr::value::map::size_l () const // size in linear time
+size_t kvr::mem_istream::size () const
 {
-    sz_t size = 0;
-    sz_t i = 0;
-    
-    while (i < m_len)
-    {
-        if (m_ptr [i].k)
-        {
-            KVR_ASSERT (m_ptr [i].v);
-            ++size;
-        }
-        ++i;
-    }
-    
-    return size;
+    return m_sz;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::sz_t kvr::value::map::size_c () const // size in constant time
+size_t kvr::mem_istream::tell ()
 {
-    sz_t size = m_cap - (_cap () - m_len);
-    return size;
+    return m_pos;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::sz_t kvr::value::map::_cap () const
+uint8_t kvr::mem_istream::peek ()
 {
-    // for experimental constant time map size calculator
-    // only called if #define KVR_INTERNAL_FLAG_EXPERIMENTAL_FAST_MAP_SIZE is enabled
-    
-    sz_t capa = 0;
-    
-    // (m_cap >= m_len) otherwise (m_cap % CAP_INCR) == 0) might not be correct
-    // i.e might be less than actual capacity e.g. if m_cap is decremented to multiple of CAP_INCR
-    
-    if ((m_cap >= m_len) && ((m_cap % CAP_INCR) == 0))
-    {
-        capa = m_cap;
-    }
-    else if (m_len)
-    {
-        capa = kvr::internal::align_size (m_len, CAP_INCR);
-    }
-    else
-    {
-        capa = m_cap;
-    }
-    
-    return capa;
+    return m_buf [m_pos];
 }
 
-/////////////////////////////////////////////////////////////////////////////////////////////////
-/////////////////////////////////////////////////////////////////////////////////////////////////
-/////////////////////////////////////////////////////////////////////////////////////////////////
-// kvr::value::cursor
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::value::cursor::cursor (const value *map) : m_map (map), m_index (0)
+void kvr::mem_istream::seek (size_t pos)
 {
-    KVR_ASSERT (map);
-    KVR_ASSERT (map->is_map ());
+    m_pos = pos;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-bool kvr::value::cursor::get (pair *p)
+bool kvr::mem_istream::get (uint8_t *byte)
 {
-    KVR_ASSERT (p);
-    const map::node *n = this->_get ();
-    if (p && n)
+    if (m_pos < m_sz)
     {
-        KVR_ASSERT (n->k && n->v);
-        p->m_k = n->k;
-        p->m_v = n->v;
+        *byte = m_buf [m_pos++];
         return true;
     }
     return false;
 }
 
-
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-const kvr::value::map::node * kvr::value::cursor::_get ()
+bool kvr::mem_istream::read (uint8_t *bytes, size_t count)
 {
-    const map::node *n = NULL;
-    
-    if (m_map && m_map->is_map ())
+    if ((m_pos + count) <= m_sz)
     {
-        const map *m = &m_map->m_data.m;
-        
-        n = (m_index < m->m_len) ? &m->m_ptr [m_index++] : NULL;
-        
-        while (n && !n->k)
-        {
-            KVR_ASSERT (!n->v);
-            n = (m_index < m->m_len) ? &m->m_ptr [m_index++] : NULL;
-        }
-    }
-    
-    return n;
+        memcpy (bytes, &m_buf [m_pos], count);
+        m_pos += count;
+        return true;
+    }
+    return false;
 }
 
-/////////////////////////////////////////////////////////////////////////////////////////////////
-/////////////////////////////////////////////////////////////////////////////////////////////////
-/////////////////////////////////////////////////////////////////////////////////////////////////
-// kvr::value::mem_ostream
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-const size_t kvr::mem_ostream::MIN_BUF_SZ = 64u;
+const uint8_t * kvr::mem_istream::push (size_t count)
+{
+    if ((m_pos + count) <= m_sz)
+    {
+        const uint8_t *start = &m_buf [m_pos];
+        m_pos += count;
+        return start;
+    }
+    return NULL;
+}
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::mem_ostream::mem_ostream (uint8_t *buf, size_t sz, allocator *alloc) : m_buf (buf), m_sz (sz), m_pos (0), m_btype (BUF_EXTERNAL)
+const uint8_t * kvr::mem_istream::pop (size_t count)
 {
-    KVR_ASSERT (m_buf);
-    KVR_ASSERT (m_sz > 0);
-    
-    m_alloc = alloc ? alloc : get_default_allocator ();
+    if (m_pos >= count)
+    {
+        m_pos -= count;
+        const uint8_t *ret = &m_buf [m_pos];
+        return ret;
+    }
+    return NULL;
 }
 
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// kvr::frozen_doc
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::mem_ostream::mem_ostream (size_t sz, allocator *alloc) : m_buf (NULL), m_sz (0), m_pos (0), m_btype (BUF_INTERNAL)
+kvr::frozen_doc::frozen_doc (allocator *alloc) : m_block (NULL), m_size (0)
 {
     m_alloc = alloc ? alloc : get_default_allocator ();
-    m_sz = kvr::internal::max (MIN_BUF_SZ, sz);
-    m_buf = (uint8_t *) m_alloc->allocate (m_sz); KVR_ASSERT (m_buf);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::mem_ostream::~mem_ostream ()
+kvr::frozen_doc::~frozen_doc ()
 {
-    if (m_btype == BUF_INTERNAL) { m_alloc->deallocate (m_buf, m_sz); }
+    this->_release ();
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-void kvr::mem_ostream::put (uint8_t byte)
+void kvr::frozen_doc::_release ()
 {
-    if (m_pos >= m_sz)
+    if (m_block)
     {
-        size_t sz = m_sz + m_sz;
-        this->reserve (sz);
+        m_alloc->deallocate (m_block, m_size);
+        m_block = NULL;
+        m_size = 0;
     }
-    m_buf [m_pos++] = byte;
 }
 
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// kvr::frozen_doc::node
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-void kvr::mem_ostream::write (uint8_t *bytes, size_t count)
-{  
-    size_t desired_sz = m_pos + count;
-    if (desired_sz > m_sz)
-    {
-        size_t sz = m_sz;
-        do { sz += m_sz; } while (sz < desired_sz);
-        this->reserve (sz);
-    }
-    memcpy (&m_buf [m_pos], bytes, count);
-    m_pos += count;
+const char * kvr::frozen_doc::node::get_string () const
+{
+    KVR_ASSERT_SAFE (is_string (), NULL);
+    
+    const char *str = (m_len < sizeof (data)) ? m_data.s : (reinterpret_cast<const char *>(this) + m_data.off);
+    return str;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-uint8_t * kvr::mem_ostream::push (size_t count)
+const char * kvr::frozen_doc::node::get_string (sz_t *len) const
 {
-    size_t desired_sz = m_pos + count;
-    if (desired_sz > m_sz)
-    {
-        size_t sz = m_sz;
-        do { sz += m_sz; } while (sz < desired_sz);
-        this->reserve (sz);
-    }
+    KVR_ASSERT_SAFE (len, get_string ());
+    KVR_ASSERT_SAFE (is_string (), NULL);
     
-    uint8_t *ret = &m_buf [m_pos];
-    m_pos += count;
-    return ret;
+    *len = static_cast<sz_t>(m_len);
+    return this->get_string ();
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-uint8_t * kvr::mem_ostream::pop (size_t count)
+int64_t kvr::frozen_doc::node::get_integer () const
 {
-    if (m_pos >= count)
-    {
-        m_pos -= count;
-        uint8_t *ret = &m_buf [m_pos];
-        return ret;
-    }
-    return NULL;
+    KVR_ASSERT_SAFE ((is_integer () || is_float ()), 0);
+    
+    return is_integer () ? m_data.i : static_cast<int64_t>(m_data.f);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-const uint8_t * kvr::mem_ostream::buffer () const
+double kvr::frozen_doc::node::get_float () const
 {
-    return m_buf;
+    KVR_ASSERT_SAFE ((is_integer () || is_float ()), 0.0);
+    
+    return is_float () ? m_data.f : static_cast<double>(m_data.i);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-size_t kvr::mem_ostream::size () const
+bool kvr::frozen_doc::node::get_boolean () const
 {
-    return m_sz;
+    KVR_ASSERT_SAFE (is_boolean (), false);
+    
+    return m_data.b;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-size_t kvr::mem_ostream::tell () const
+const kvr::frozen_doc::node * kvr::frozen_doc::node::element (sz_t index) const
 {
-    return m_pos;
+    KVR_ASSERT_SAFE (is_array (), NULL);
+    
+    const node *elems = reinterpret_cast<const node *>(reinterpret_cast<const uint8_t *>(this) + m_data.off);
+    return (index < m_len) ? &elems [index] : NULL;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-void kvr::mem_ostream::seek (size_t pos)
+kvr::sz_t kvr::frozen_doc::node::length () const
 {
-    m_pos = pos;
+    KVR_ASSERT_SAFE (is_array (), 0);
+    
+    return static_cast<sz_t>(m_len);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-void kvr::mem_ostream::flush ()
+const kvr::frozen_doc::node * kvr::frozen_doc::node::find (const char *key) const
 {
-    // EOS == 0
-    KVR_ASSERT_SAFE ((m_pos < m_sz), (void) 0);
-    m_buf [m_pos] = 0;
+    KVR_ASSERT (key);
+    return this->find (key, (sz_t) strlen (key));
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-void kvr::mem_ostream::reserve (size_t sz)
+const kvr::frozen_doc::node * kvr::frozen_doc::node::find (const char *key, sz_t keylen) const
 {
-    if (sz > m_sz)
+    KVR_ASSERT (key);
+    KVR_ASSERT_SAFE (is_map (), NULL);
+    
+    const char *base = reinterpret_cast<const char *>(this);
+    const mkey *keys = this->_keys ();
+    const uint32_t isz = _index_size (m_len);
+    
+    if (isz == 0)
     {
-        uint8_t *buf = (uint8_t *) m_alloc->allocate (sz); KVR_ASSERT (buf);
-        
-        if (m_buf)
+        for (uint32_t i = 0; i < m_len; ++i)
         {
-            memcpy (buf, m_buf, m_sz);
-            if (m_btype == BUF_INTERNAL) { m_alloc->deallocate (m_buf, m_sz); }
+            if ((keys [i].len == keylen) && (memcmp (base + keys [i].off, key, keylen) == 0))
+            {
+                return &this->_members () [i];
+            }
         }
+    }
+    else
+    {
+        const islot *index = this->_index ();
+        const uint32_t h = kvr::internal::hash (key, keylen);
         
-        m_buf = buf;
-        m_sz = sz;
-        m_btype = BUF_INTERNAL;
+        for (uint32_t s = h & (isz - 1); index [s].idx; s = (s + 1) & (isz - 1))
+        {
+            const mkey &k = keys [index [s].idx - 1];
+            if ((index [s].hash == h) && (k.len == keylen) && (memcmp (base + k.off, key, keylen) == 0))
+            {
+                return &this->_members () [index [s].idx - 1];
+            }
+        }
     }
+    
+    return NULL;
 }
 
-/////////////////////////////////////////////////////////////////////////////////////////////////
-/////////////////////////////////////////////////////////////////////////////////////////////////
-/////////////////////////////////////////////////////////////////////////////////////////////////
-// kvr::mem_istream
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-kvr::mem_istream::mem_istream (const uint8_t *buf, size_t sz) : m_buf (buf), m_sz (sz), m_pos (0)
+kvr::sz_t kvr::frozen_doc::node::size () const
 {
-    KVR_ASSERT (m_buf);
-    KVR_ASSERT (m_sz > 0);
+    KVR_ASSERT_SAFE (is_map (), 0);
+    
+    return static_cast<sz_t>(m_len);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-const uint8_t * kvr::mem_istream::buffer () const
+const kvr::frozen_doc::node * kvr::frozen_doc::node::search (const char *pathexpr) const
 {
-    return m_buf;
+    KVR_ASSERT_SAFE ((is_map () || is_array ()), NULL);
+    KVR_ASSERT_SAFE ((pathexpr && (pathexpr [0] != 0)), NULL);
+    
+    const node *n = this;
+    
+    const char delim = KVR_TOKEN_DELIMITER;
+    const char *e1 = pathexpr;
+    const char *e2 = strchr (e1, delim);
+    
+    while (n && e2)
+    {
+        n = n->_search_key (e1, static_cast<sz_t>(e2 - e1));
+        e1 = ++e2;
+        e2 = strchr (e1, delim);
+    }
+    
+    if (n && (*e1 != 0))
+    {
+        n = n->_search_key (e1, (sz_t) strlen (e1));
+    }
+    
+    return n;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-size_t kvr::mem_istream::size () const
+const kvr::frozen_doc::node * kvr::frozen_doc::node::search (const char **path, sz_t pathsz) const
 {
-    return m_sz;
+    KVR_ASSERT (is_map () || is_array ());
+    KVR_ASSERT_SAFE (path, NULL);
+    
+    const node *n = this;
+    
+    sz_t pc = 0;
+    while (n && (pc < pathsz))
+    {
+        const char *key = path [pc++];
+        n = n->_search_key (key, (sz_t) strlen (key));
+    }
+    
+    return n;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-size_t kvr::mem_istream::tell ()
+uint32_t kvr::frozen_doc::node::_index_size (uint32_t count)
 {
-    return m_pos;
+    // index slots: none for small maps, else at most two thirds full
+    uint32_t isz = 0;
+    if (count >= INDEX_THRESHOLD)
+    {
+        for (isz = INDEX_THRESHOLD; isz < (count + (count >> 1)); isz += isz)
+        {
+        }
+    }
+    return isz;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-uint8_t kvr::mem_istream::peek ()
+const kvr::frozen_doc::node * kvr::frozen_doc::node::_members () const
 {
-    return m_buf [m_pos];
+    return reinterpret_cast<const node *>(reinterpret_cast<const uint8_t *>(this) + m_data.off);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-void kvr::mem_istream::seek (size_t pos)
+const kvr::frozen_doc::node::mkey * kvr::frozen_doc::node::_keys () const
 {
-    m_pos = pos;
+    return reinterpret_cast<const mkey *>(this->_members () + m_len);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-bool kvr::mem_istream::get (uint8_t *byte)
+const kvr::frozen_doc::node::islot * kvr::frozen_doc::node::_index () const
 {
-    if (m_pos < m_sz)
-    {
-        *byte = m_buf [m_pos++];
-        return true;
-    }
-    return false;
+    return reinterpret_cast<const islot *>(this->_keys () + m_len);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-bool kvr::mem_istream::read (uint8_t *bytes, size_t count)
+const kvr::frozen_doc::node * kvr::frozen_doc::node::_search_key (const char *key, sz_t keylen) const
 {
-    if ((m_pos + count) <= m_sz)
+    KVR_ASSERT (key);
+    
+    // same path syntax as value::_search_key
+    
+    //////////////////////////////////
+    if (this->is_map ())
+        //////////////////////////////////
     {
-        memcpy (bytes, &m_buf [m_pos], count);
-        m_pos += count;
-        return true;
+        return this->find (key, keylen);
     }
-    return false;
+    
+    //////////////////////////////////
+    else if (this->is_array ())
+        //////////////////////////////////
+    {
+        uint8_t kbuf [256];
+        kvr::mem_ostream kos (kbuf, 256);
+        char *k = (char *) kos.push (keylen + 1);
+        memcpy (k, key, keylen);
+        k [keylen] = 0;
+        
+        if (k [0] == KVR_TOKEN_MAP_GREP) // pattern match in array of maps
+        {
+            const char *sk = &k [1];
+            const char *s = strchr (sk, '=');
+            if (!s)
+            {
+                return NULL;
+            }
+            
+            sz_t sklen = static_cast<sz_t>(s - sk);
+            const char *sv = s + 1;
+            
+            for (uint32_t i = 0; i < m_len; ++i)
+            {
+                const node *m = this->element (i);
+                const node *pv = m->is_map () ? m->find (sk, sklen) : NULL;
+                
+                if (pv == NULL)
+                {
+                    continue;
+                }
+                
+                if (pv->is_string ())
+                {
+                    if ((strlen (sv) == pv->m_len) && (memcmp (sv, pv->get_string (), pv->m_len) == 0))
+                    {
+                        return m;
+                    }
+                }
+                else if (pv->is_float ())
+                {
+                    if (kvr::internal::fp_equal (strtod (sv, NULL), pv->m_data.f))
+                    {
+                        return m;
+                    }
+                }
+                else if (pv->is_integer ())
+                {
+                    char *end = NULL;
+                    int64_t svi = strtoll (sv, &end, 10);
+                    if (end && (!*end) && (svi == pv->m_data.i))
+                    {
+                        return m;
+                    }
+                }
+                else if (pv->is_boolean ())
+                {
+                    int valid = (strcmp (sv, kvr_const_str_false) == 0) ? 0 : (strcmp (sv, kvr_const_str_true) == 0) ? 1 : -1;
+                    if ((valid != -1) && ((valid == 1) == pv->m_data.b))
+                    {
+                        return m;
+                    }
+                }
+                else if (pv->is_null ())
+                {
+                    if (strcmp (sv, kvr_const_str_null) == 0)
+                    {
+                        return m;
+                    }
+                }
+            }
+            
+            return NULL;
+        }
+        
+        char *end = NULL;
+        int64_t ki64 = strtoll (k, &end, 10);
+        KVR_ASSERT_SAFE ((end && (!*end) && "non-integral array index"), NULL);
+        return ((ki64 >= 0) && ((uint64_t) ki64 < m_len)) ? this->element ((sz_t) ki64) : NULL;
+    }
+    
+    return NULL;
 }
 
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// kvr::frozen_doc::cursor
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-const uint8_t * kvr::mem_istream::push (size_t count)
+kvr::frozen_doc::cursor::cursor (const node *map) : m_map (map), m_index (0)
 {
-    if ((m_pos + count) <= m_sz)
-    {
-        const uint8_t *start = &m_buf [m_pos];
-        m_pos += count;
-        return start;
-    }
-    return NULL;
+    KVR_ASSERT (map);
+    KVR_ASSERT (map->is_map ());
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-const uint8_t * kvr::mem_istream::pop (size_t count)
+bool kvr::frozen_doc::cursor::get (const char **key, const node **val)
 {
-    if (m_pos >= count)
+    KVR_ASSERT (key);
+    KVR_ASSERT (val);
+    
+    // insertion order
+    if (m_map && m_map->is_map () && (m_index < m_map->m_len))
     {
-        m_pos -= count;
-        const uint8_t *ret = &m_buf [m_pos];
-        return ret;
+        sz_t i = m_index++;
+        *key = reinterpret_cast<const char *>(m_map) + m_map->_keys () [i].off;
+        *val = &m_map->_members () [i];
+        return true;
     }
-    return NULL;
+    
+    return false;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
@@ -89,6 +89,18 @@
 #define KVR_CONSTANT_DIFF_FP_EQ_EPSILON                 (1.0e-7)
 // memory (re)allocation element size for map & array
 #define KVR_CONSTANT_COMMON_BLOCK_SZ                    (8u)
+// map capacity at which key lookups switch from linear scan to a hashed index
+#define KVR_CONSTANT_MAP_INDEX_THRESHOLD                (32u)
+// ctx key store load factor below which the key table shrinks (keep below 1/3)
+#define KVR_CONSTANT_KEY_STORE_SHRINK_LOAD              (0.125)
+// block size of the memory region backing an arena ctx (see ctx::create_arena)
+#define KVR_CONSTANT_CTX_REGION_BLOCK_SZ                (64u * 1024u)
+// chunk size pool_allocator carves its size class blocks from
+#define KVR_CONSTANT_POOL_CHUNK_SZ                      (64u * 1024u)
+// block size decoders read custom input streams in (see istream::read_some)
+#define KVR_CONSTANT_ISTREAM_BLOCK_SZ                   (4096u)
+// size of the block encoders stage output to custom streams in (handed over with ostream::write)
+#define KVR_CONSTANT_OSTREAM_BLOCK_SZ                   (4096u)
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////////////////////////
@@ -98,6 +110,10 @@
 #error "#define KVR_CONSTANT_COMMON_BLOCK_SZ must be a power of 2"
 #endif
 
+#if (KVR_CONSTANT_MAP_INDEX_THRESHOLD % KVR_CONSTANT_COMMON_BLOCK_SZ)
+#error "#define KVR_CONSTANT_MAP_INDEX_THRESHOLD must be a multiple of KVR_CONSTANT_COMMON_BLOCK_SZ"
+#endif
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////////////////////////
@@ -131,6 +147,26 @@ namespace kvr
     CODEC_CBOR,
   };
 
+  enum decode_flags_t
+  {
+    // msgpack/cbor buffer decode and json insitu decode: string values point into the
+    // input buffer (which must outlive them and stay unchanged) until modified. strings
+    // borrowed from a const buffer aren't null-terminated (see get_string), those from a
+    // decode_insitu buffer are.
+    DECODE_BORROW_STRINGS = (1 << 0),
+
+    // json buffer decode: locate structure with a simd (avx2/sse2, picked at runtime) or
+    // scalar block index first, then build the tree from it. same result as the default.
+    DECODE_JSON_INDEXED = (1 << 1),
+
+    // with DECODE_JSON_INDEXED: cap the instruction set (testing and benchmarks)
+    DECODE_JSON_INDEX_NO_AVX2 = (1 << 2),
+    DECODE_JSON_INDEX_NO_SIMD = (1 << 3),
+
+    // homogeneous integer, float and boolean arrays are stored packed (see push_n)
+    DECODE_PACK_ARRAYS = (1 << 4),
+  };
+
   /////////////////////////////////////////////////////////////////////////////////////////////////
   /////////////////////////////////////////////////////////////////////////////////////////////////
   /////////////////////////////////////////////////////////////////////////////////////////////////
@@ -141,6 +177,10 @@ namespace kvr
     virtual void * allocate (size_t sz) = 0;
     virtual void   deallocate (void *p, size_t sz) = 0;
 
+    // grows or shrinks p (of old_sz bytes) keeping its contents, like realloc. p is left
+    // as is if NULL is returned. the default allocates, copies and deallocates
+    virtual void * reallocate (void *p, size_t old_sz, size_t new_sz);
+
   protected:
     ~allocator () {}
   };
@@ -149,6 +189,59 @@ namespace kvr
   /////////////////////////////////////////////////////////////////////////////////////////////////
   /////////////////////////////////////////////////////////////////////////////////////////////////
 
+  class pool_allocator : public allocator
+  {
+  public:
+    // size class free lists for blocks up to MAX_SIZE (values, keys, strings, map/array
+    // blocks), larger ones go to 'backing'.
+    // single-threaded: there are no per-thread caches and no locking, so a pool (and every
+    // ctx using it) must not be shared across threads. blocks must also be freed by the
+    // thread that owns the pool. give each thread its own pool instead.
+    explicit pool_allocator (allocator *backing = NULL, size_t chunk_size = KVR_CONSTANT_POOL_CHUNK_SZ);
+    ~pool_allocator ();
+
+    void * allocate (size_t sz);
+    void   deallocate (void *p, size_t sz);
+    void * reallocate (void *p, size_t old_sz, size_t new_sz);
+    size_t get_memory_reserved () const;
+
+    static const size_t MAX_SIZE = 4096;
+
+  private:
+
+    // 16 byte steps up to 256, then 4 steps per power of two
+    static const size_t CLASS_COUNT = 32;
+
+    struct node
+    {
+      node * next;
+    };
+
+    struct chunk
+    {
+      chunk * next;
+      size_t  size;
+    };
+
+    static size_t _class (size_t sz, size_t *csz);
+    void *        _carve (size_t csz);
+
+    pool_allocator (const pool_allocator &);
+    pool_allocator & operator= (const pool_allocator &);
+
+    node *      m_free [CLASS_COUNT];
+    chunk *     m_chunks;
+    uint8_t *   m_ptr;
+    uint8_t *   m_end;
+    size_t      m_chunk_sz;
+    size_t      m_reserved;
+    allocator * m_backing;
+  };
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////
+  /////////////////////////////////////////////////////////////////////////////////////////////////
+  /////////////////////////////////////////////////////////////////////////////////////////////////
+
   class ostream
   {
   public:
@@ -172,6 +265,16 @@ namespace kvr
     virtual size_t  tell () = 0;
     virtual uint8_t peek () = 0;
 
+    // reads up to 'count' (> 0) bytes, returning how many (0 at the end of the stream).
+    // decoders read ahead in blocks through this if the stream also implements unread.
+    // the default returns 0, and decoders then read through get, read and peek instead
+    virtual size_t  read_some (uint8_t *bytes, size_t count);
+
+    // gives back the last 'count' bytes of the latest read_some, so the next read starts
+    // with them (decoders return what they read past the decoded value, and values can be
+    // decoded back to back). unread (0) tells if a stream can; the default returns false
+    virtual bool    unread (size_t count);
+
   protected:
     ~istream () {}
   };
@@ -183,6 +286,16 @@ namespace kvr
   class ctx;
   class obuffer;
   class pair;
+  class frozen_doc;
+
+  namespace internal
+  {
+    struct view;
+    namespace frozen { struct build_ctx; }
+    namespace json { struct read_ctx; }
+    namespace msgpack { struct read_ctx; }
+    namespace cbor { struct read_ctx; }
+  }
 
   /////////////////////////////////////////////////////////////////////////////////////////////////
   /////////////////////////////////////////////////////////////////////////////////////////////////
@@ -194,12 +307,19 @@ namespace kvr
 
     const char *  get_string () const;
     sz_t          get_length () const;
+    bool          is_pinned () const;
 
   private:
+
+    // reference count of pinned keys; a count that would overflow saturates here too
+    static const sz_t REF_PINNED = static_cast<sz_t>(~0u);
+
+    void      _retain ();
+    bool      _release ();
     
     char    * m_str;
-    uint16_t  m_len;
-    uint16_t  m_ref;
+    sz_t      m_len;
+    sz_t      m_ref;
     uint32_t  m_hash;
 
     friend class ctx;
@@ -245,8 +365,9 @@ namespace kvr
     // string variant operations
     void          set_string (const char *str, sz_t len);
     void          set_string (const char *str);
-    const char *  get_string () const;
-    const char *  get_string (sz_t *len) const;
+    const char *  get_string () const;           // NULL for an unterminated borrowed string
+    const char *  get_string (sz_t *len) const;  // not always null-terminated: read len bytes
+    const char *  terminate_string ();           // copies an unterminated borrowed string
 
     // integer variant operations
     void          set_integer (int64_t n);
@@ -260,7 +381,8 @@ namespace kvr
     void          set_boolean (bool b);
     bool          get_boolean () const;
 
-    // array variant operations
+    // array variant operations (elements are stored inline: pointers to elements
+    // are invalidated by a push or pop on the array that holds them)
     value *       push (int32_t n);
     value *       push (int64_t n);
     value *       push (double n);
@@ -271,9 +393,40 @@ namespace kvr
     value *       push_null ();
     bool          pop ();
     bool          pop (sz_t index);
+    value *       element (sz_t index);
     value *       element (sz_t index) const;
     sz_t          length () const;
 
+    // positional array operations (one memmove each. insert_at opens count null elements at
+    // index and returns the first; swap_remove moves the last element into index; erase_range
+    // removes [first, last); resize pops or pushes nulls, or zeros for packed arrays)
+    bool          reserve (sz_t cap);
+    value *       insert_at (sz_t index, sz_t count = 1);
+    bool          swap_remove (sz_t index);
+    bool          erase_range (sz_t first, sz_t last);
+    bool          resize (sz_t len);
+
+    // packed array operations (homogeneous integer, float or boolean arrays built by push_n,
+    // or by decode with DECODE_PACK_ARRAYS, are stored without a value per element: read them
+    // with get_*_at, get_n, which copies out up to count elements, or packed_*. a push of the
+    // element type appends in place and returns the array itself. element () and search through
+    // a const value assert on packed arrays (NULL in release); through a non-const value they,
+    // pushes of another type and insert_at turn the array back into a regular one. get_*_at
+    // read regular arrays too)
+    bool            push_n (const int64_t *n, sz_t count);
+    bool            push_n (const double *n, sz_t count);
+    bool            push_n (const bool *b, sz_t count);
+    sz_t            get_n (int64_t *n, sz_t count) const;
+    sz_t            get_n (double *n, sz_t count) const;
+    sz_t            get_n (bool *b, sz_t count) const;
+    int64_t         get_integer_at (sz_t index) const;
+    double          get_float_at (sz_t index) const;
+    bool            get_boolean_at (sz_t index) const;
+    bool            is_packed () const;
+    const int64_t * packed_integers () const;
+    const double *  packed_floats () const;
+    const bool *    packed_booleans () const;
+
     // map variant operations
     value *       insert (const char *key, int32_t n);
     value *       insert (const char *key, int64_t n);
@@ -283,18 +436,68 @@ namespace kvr
     value *       insert_map (const char *key);
     value *       insert_array (const char *key);
     value *       insert_null (const char *key);
+    value *       find (const char *key);
     value *       find (const char *key) const;
     void          remove (const char *key);
     sz_t          size () const;
 
+    // map variant operations (explicit key length, key need not be null-terminated)
+    value *       insert (const char *key, sz_t keylen, int32_t n);
+    value *       insert (const char *key, sz_t keylen, int64_t n);
+    value *       insert (const char *key, sz_t keylen, double n);
+    value *       insert (const char *key, sz_t keylen, bool b);
+    value *       insert (const char *key, sz_t keylen, const char *str);
+    value *       insert_map (const char *key, sz_t keylen);
+    value *       insert_array (const char *key, sz_t keylen);
+    value *       insert_null (const char *key, sz_t keylen);
+    value *       find (const char *key, sz_t keylen);
+    value *       find (const char *key, sz_t keylen) const;
+    void          remove (const char *key, sz_t keylen);
+
+    // map variant operations (key handle from this ctx, see ctx::intern; skips hashing).
+    // a handle must come from the ctx of the value it is used on: one from another ctx
+    // fails an assert in debug builds (release builds don't check)
+    value *       insert (const key *k, int32_t n);
+    value *       insert (const key *k, int64_t n);
+    value *       insert (const key *k, double n);
+    value *       insert (const key *k, bool b);
+    value *       insert (const key *k, const char *str);
+    value *       insert_map (const key *k);
+    value *       insert_array (const key *k);
+    value *       insert_null (const key *k);
+    value *       find (const key *k);
+    value *       find (const key *k) const;
+    void          remove (const key *k);
+
     // path search (map or array)
+    value *       search (const char *pathexpr);
     value *       search (const char *pathexpr) const;
+    value *       search (const char **path, sz_t pathsz);
     value *       search (const char **path, sz_t pathsz) const;
 
-    // copy/merge
+    // copy/merge (deep)
     value *       copy (const value *rhs);
     value *       merge (const value *rhs);
 
+    // snapshot (a copy that shares maps and arrays with rhs until either side is written, so it
+    // is O(1) within a ctx; across ctxs it is a deep copy). writes unshare what they reach when
+    // it is reached through non-const values: values found in either side before the snapshot,
+    // or through a const value or a cursor on one, must be found again that way before being
+    // written. lookups through const values never unshare (or allocate)
+    value *       snapshot (const value *rhs);
+
+    // move (take detaches a child as a root value; splice attaches a root value, which is
+    // consumed, as a child. both are O(1) in the subtree size within a ctx, a root from
+    // another ctx is copied. a spliced root must not contain this value)
+    value *       take (const char *key);
+    value *       take (const char *key, sz_t keylen);
+    value *       take (const key *k);
+    value *       take (sz_t index);
+    value *       splice (const char *key, value *root);
+    value *       splice (const char *key, sz_t keylen, value *root);
+    value *       splice (const key *k, value *root);
+    value *       splice (value *root);
+
     // diff/patch
     value *       diff (const value *original, const value *modified);
     value *       patch (const value *diff);
@@ -302,13 +505,21 @@ namespace kvr
     // hash code
     uint32_t      hash (uint32_t seed = 0) const;
 
+    // read-only copy packed into one block (see frozen_doc)
+    bool          freeze (frozen_doc *doc) const;
+
     // serialization (buffer)
     bool          encode (codec_t codec, obuffer *obuf);
-    bool          decode (codec_t codec, const uint8_t *data, size_t size);
+    bool          decode (codec_t codec, const uint8_t *data, size_t size, uint32_t flags = 0);
+
+    // serialization (mutable buffer: json strings and keys are unescaped in place, msgpack/cbor
+    // strings borrowed with DECODE_BORROW_STRINGS are null-terminated in place, so 'data' is
+    // overwritten)
+    bool          decode_insitu (codec_t codec, uint8_t *data, size_t size, uint32_t flags = 0);
 
     // serialization (stream)
     bool          encode (codec_t codec, ostream *ostr);
-    bool          decode (codec_t codec, istream &istr);
+    bool          decode (codec_t codec, istream &istr, uint32_t flags = 0);
 
     // serialization (estimate buffer size)
     size_t        encode_bound (codec_t codec) const;
@@ -324,28 +535,9 @@ namespace kvr
 
     union string
     {
-      struct dyn_str
-      {
-        static const sz_t PAD = (KVR_CONSTANT_COMMON_BLOCK_SZ - 1);
-        char *  m_data;
-        sz_t    m_size;
-        sz_t    m_len;
-
-        const char *get () const;
-        sz_t length () const;
-        void set (const char *str, sz_t len, allocator *a);
-        void cleanup (allocator *a);
-      } m_dyn;
-
-      struct stt_str
-      {
-        static const sz_t CAP = ((sizeof (sz_t) * 2) + sizeof (char *)); // sizeof dyn_str
-        char m_data [CAP];
-
-        const char *get () const;
-        sz_t length () const;
-        void set (const char *str, sz_t len);
-      } m_stt;
+      char *  m_dyn;                      // m_len + 1 bytes of heap memory (or m_len borrowed bytes)
+      key *   m_key;                      // shared with equal strings (FLAG_STRING_INTERNED)
+      char    m_stt [sizeof (int64_t)];   // short strings run on into m_len (see _string_static)
     };
 
     ///////////////////////////////////////////
@@ -362,20 +554,51 @@ namespace kvr
     ///////////////////////////////////////////
     ///////////////////////////////////////////
 
+    struct header // length and capacity of a map or array, stored in front of its elements
+    {
+      sz_t    len;
+      sz_t    cap;
+      sz_t    ref;  // values sharing the elements (see copy)
+    };
+
+    static const size_t HEADER_SZ = (sizeof (header) + 7u) & ~((size_t) 7u); // keeps elements 8-byte aligned
+    static const sz_t SHARE_MAX = static_cast<sz_t>(~0u); // further copies are deep
+
+    ///////////////////////////////////////////
+    ///////////////////////////////////////////
+    ///////////////////////////////////////////
+
     struct array
     {
       static const sz_t CAP_INCR = KVR_CONSTANT_COMMON_BLOCK_SZ;
 
       void    init (sz_t size, allocator *a);
       void    deinit (allocator *a);
-      void    push (value *v, allocator *a);
-      value * pop ();
-      value * pop (sz_t index);
+      value * push (ctx *c, allocator *a);
+      bool    pop ();
+      bool    pop (sz_t index);
+      void    remove (sz_t index);
       value * elem (sz_t index) const;
-
-      value **m_ptr;
-      sz_t    m_len;
-      sz_t    m_cap;
+      value * insert (sz_t index, sz_t count, ctx *c, allocator *a);
+      void    reserve (sz_t cap, size_t esz, allocator *a);
+      void    erase (sz_t first, sz_t last, size_t esz);
+      void    swap_remove (sz_t index, size_t esz);
+
+      void    init_packed (sz_t size, size_t esz, allocator *a);
+      void    deinit_packed (size_t esz, allocator *a);
+      void *  push_packed (sz_t count, size_t esz, allocator *a);
+      bool    pop_packed (sz_t index, size_t esz);
+      sz_t    length () const;
+
+      header * _hdr () const;
+      static void * _alloc (sz_t cap, size_t esz, allocator *a);
+      static void   _free (void *p, size_t esz, allocator *a);
+
+      union
+      {
+        value * m_ptr; // elements are stored inline
+        void  * m_raw; // packed elements (see FLAG_ARRAY_PACKED_*)
+      };
     };
 
     ///////////////////////////////////////////
@@ -396,15 +619,22 @@ namespace kvr
       void    init (sz_t size, allocator *a);
       void    deinit (allocator *a);
       node *  insert (key *k, value *v, allocator *a);
-      void    remove (node *n);
+      void    remove (node *n, allocator *a);
       node *  find (const key *k) const;
-      sz_t    size_l () const;
-      sz_t    size_c () const;
-      sz_t    _cap () const; // experimental capacity
+      sz_t    size () const;
+
+      static sz_t   _index_size (sz_t cap);
+      static size_t _alloc_size (sz_t cap);
+      header * _hdr () const;
+      sz_t *  _index () const;
+      sz_t *  _removed () const;
+      void    _index_build ();
+      void    _index_add (sz_t i);
+      void    _index_remove (sz_t i);
+      void    _compact ();
+      void    _resize (sz_t cap, allocator *a);
 
       node *  m_ptr;
-      sz_t    m_len;
-      sz_t    m_cap;
     };
 
   public:
@@ -413,11 +643,14 @@ namespace kvr
     ///////////////////////////////////////////
     ///////////////////////////////////////////
 
+    // walks the members of a map in insertion order. members (the current one included) may
+    // be removed or taken during the walk; inserting into the map invalidates the cursor
     class cursor
     {
     public:
 
       bool get (pair *p);
+      explicit cursor (value *map);
       explicit cursor (const value *map);
 
     private:
@@ -425,6 +658,8 @@ namespace kvr
       const map::node * _get ();
       const value * m_map;
       sz_t          m_index;
+
+      friend class value;
     };
 
   private:
@@ -448,19 +683,36 @@ namespace kvr
 
     enum _flags
     {
-      FLAG_TYPE_NULL            = (1 << 0),
-      FLAG_TYPE_MAP             = (1 << 1),
-      FLAG_TYPE_ARRAY           = (1 << 2),
-      FLAG_TYPE_STRING_DYNAMIC  = (1 << 3),
-      FLAG_TYPE_STRING_STATIC   = (1 << 4),
-      FLAG_TYPE_NUMBER_INTEGER  = (1 << 5),
-      FLAG_TYPE_NUMBER_FLOAT    = (1 << 6),
-      FLAG_TYPE_BOOLEAN         = (1 << 7),
-      FLAG_PARENT_CTX           = (1 << 8),
-      FLAG_PARENT_MAP           = (1 << 9),
-      FLAG_PARENT_ARRAY         = (1 << 10),
+      // type (one of, low 4 bits)
+      FLAG_TYPE_NULL            = 1,
+      FLAG_TYPE_MAP             = 2,
+      FLAG_TYPE_ARRAY           = 3,
+      FLAG_TYPE_STRING_DYNAMIC  = 4,
+      FLAG_TYPE_STRING_STATIC   = 5,
+      FLAG_TYPE_NUMBER_INTEGER  = 6,
+      FLAG_TYPE_NUMBER_FLOAT    = 7,
+      FLAG_TYPE_BOOLEAN         = 8,
+      FLAG_TYPE_MASK            = 0x0f,
+      // owner (one of)
+      FLAG_PARENT_CTX           = (1 << 4),
+      FLAG_PARENT_MAP           = (2 << 4),
+      FLAG_PARENT_ARRAY         = (3 << 4),
+      FLAG_PARENT_MASK          = (3 << 4),
+      // packed array element type (none or one of)
+      FLAG_ARRAY_PACKED_INTEGER = (1 << 6),
+      FLAG_ARRAY_PACKED_FLOAT   = (2 << 6),
+      FLAG_ARRAY_PACKED_BOOLEAN = (3 << 6),
+      FLAG_ARRAY_PACKED         = (3 << 6),
+      // dynamic string storage (none or one of)
+      FLAG_STRING_INTERNED      = (1 << 8),
+      FLAG_STRING_BORROWED      = (2 << 8), // not null-terminated
+      FLAG_STRING_BORROWED_TERM = (3 << 8), // null-terminated (decode_insitu)
+      FLAG_STRING_MASK          = (3 << 8),
     };
 
+    static const uint32_t CTX_SHIFT = 12; // m_flags holds the ctx index above the flags (bits 10-11 are free)
+    static const sz_t STRING_STATIC_CAP = (sz_t) (sizeof (data) + sizeof (sz_t)); // incl. terminator
+
     ///////////////////////////////////////////
     ///////////////////////////////////////////
     ///////////////////////////////////////////
@@ -468,13 +720,18 @@ namespace kvr
     bool    _is_number () const;
     bool    _is_string_dynamic () const;
     bool    _is_string_static () const;
+    char *  _string_static () const;
+    char *  _string_dynamic () const;
+    ctx *   _ctx () const;
 
     void    _string_set (const char *str, sz_t len);
     void    _string_move (char *str, sz_t size);
+    void    _string_borrow (const char *str, sz_t len, bool terminated = false);
+    void    _string_free ();
 
     value * _search_path_expr (const char *expr, const char **lastkey = NULL,
-                               value **lastparent = NULL) const;
-    value * _search_key (const char *key) const;
+                               value **lastparent = NULL, bool unshare = false) const;
+    value * _search_key (const char *key, bool unshare = false) const;
 
     uint8_t _type () const;
     bool    _type_equiv (const value *other) const;
@@ -492,8 +749,33 @@ namespace kvr
     void    _patch_add (const value *add);
     void    _patch_rem (const value *rem);
 
+    value * _insert (key *k, int64_t n);
+    value * _insert (key *k, double n);
+    value * _insert (key *k, bool b);
+    value * _insert (key *k, const char *str);
+    value * _insert_map (key *k);
+    value * _insert_array (key *k);
+    value * _insert_null (key *k);
     void    _insert_kv (key *k, value *v);
-    void    _push_v (value *v);
+    value * _splice (key *k, value *root);
+    void    _adopt (value *root);
+    void    _relocate (value *dst) const;
+
+    header * _container () const;
+    bool    _is_shared () const;
+    bool    _shares (const value *other) const;
+    void    _share (value *dst) const;
+    void    _unshare ();
+    value * _peek (const char *key) const;
+    value * _peek (sz_t index) const;
+    value * _peek (sz_t index, value *tmp) const;
+
+    value * _push ();
+    size_t  _packed_size () const;
+    void    _packed_element (sz_t index, value *e) const;
+    bool    _push_packed (uint32_t flag, const void *src, sz_t count);
+    void    _pack (uint32_t flag, sz_t cap);
+    void    _unpack ();
 
     void    _conv_map (sz_t cap = 8);
     void    _conv_array (sz_t cap = 8);
@@ -515,11 +797,16 @@ namespace kvr
     ///////////////////////////////////////////
     ///////////////////////////////////////////
 
+    // 16 bytes: static strings use m_data and m_len, the ctx is looked up by index (see _ctx)
     data      m_data;
+    sz_t      m_len;    // dynamic string length
     uint32_t  m_flags;
-    ctx     * m_ctx;
 
     friend class ctx;
+    friend struct internal::view;
+    friend struct internal::json::read_ctx;
+    friend struct internal::msgpack::read_ctx;
+    friend struct internal::cbor::read_ctx;
   };
 
   /////////////////////////////////////////////////////////////////////////////////////////////////
@@ -553,11 +840,24 @@ namespace kvr
 
     static ctx * create (size_t ks_min_size, size_t vs_min_size, allocator *allocator = NULL);
     static ctx * create (allocator *allocator = NULL);    
+    // arena ctx: memory comes from blocks of block_size and is only freed by destroy/reset
+    static ctx * create_arena (size_t block_size = KVR_CONSTANT_CTX_REGION_BLOCK_SZ, allocator *allocator = NULL);
     static void  destroy (ctx *ctx);
 
+    // destroy every value and key (interned and pinned too) in one pass
+    void    reset ();
     value * create_value ();
     void    destroy_value (value *v);
     size_t  get_key_count ();
+    // opt-in: strings too long to store inline share one refcounted copy per ctx
+    void    intern_strings (bool enable);
+    size_t  get_string_count ();
+    // key handles belong to this ctx: use them with its values only, and release them here
+    key *   intern (const char *str);
+    key *   intern (const char *str, sz_t len);
+    key *   pin (const char *str);
+    key *   pin (const char *str, sz_t len);
+    void    release (key *k);
     size_t  get_value_count ();
     void    dump (int id = 0) const;
 
@@ -569,39 +869,84 @@ namespace kvr
 
     struct key_store
     {
+      struct slot // hash and length inline so probes rarely touch the key
+      {
+        key *     k;
+        uint32_t  hash;
+        uint32_t  len;
+      };
+
       void    init (size_t cap, uint32_t hfseed, allocator *a);
       void    deinit (allocator *a);
       void    resize (size_t new_sz, allocator *a);
       key *   insert (const char *str, allocator *a);
-      key *   insert (char *str, sz_t len, allocator *a);
+      key *   insert (const char *str, size_t len, allocator *a);
+      key *   insert_move (char *str, sz_t len, allocator *a);
       key *   find (const char *str) const;
+      key *   find (const char *str, size_t len) const;
+      bool    owns (const key *k) const;
       void    erase (key *k, allocator *a);
-      void    erase (const char *str, allocator *a);
       size_t  used () const;
       float   load_factor () const;
       void    dump () const;
 
-      key **    m_keys;
+      size_t  _dist (size_t i) const;
+      size_t  _probe (const char *str, size_t len, uint32_t h) const;
+      key *   _insert (char *str, size_t len, uint32_t h, allocator *a);
+      void    _place (slot s);
+
+      slot *    m_slots;
       size_t    m_size;
       size_t    m_used;
+      size_t    m_min;
       uint32_t  m_seed;
     };
 
     struct val_store
     {
+      union slot // stored in front of each root value
+      {
+        size_t    index;
+        uint64_t  align;
+      };
+
       void    init (size_t cap, allocator *a);
       void    deinit (allocator *a);
-      void    push_back (value *v, allocator *a);
-      void    remove (value *v);
+      void *  push_back (allocator *a);
+      void    remove (value *v, allocator *a);
       size_t  used () const;
       value * at (size_t index);
-      void    clear ();
+      void    clear (allocator *a);
       void    dump () const;
 
       value **  m_data;
       size_t    m_size;
       size_t    m_used;
     };
+
+    struct region : public allocator // bump-pointer memory for arena ctx, freed a block at a time
+    {
+      struct block
+      {
+        block * next;
+        size_t  size;
+      };
+
+      void    init (size_t block_sz, allocator *a);
+      void    deinit ();
+      void    reset ();
+      void *  allocate (size_t sz);
+      void    deallocate (void *p, size_t sz);
+      void *  reallocate (void *p, size_t old_sz, size_t new_sz);
+
+      block * _grow (size_t size, bool current);
+
+      block *     m_head;
+      uint8_t *   m_ptr;
+      uint8_t *   m_end;
+      size_t      m_block_sz;
+      allocator * m_backing;
+    };
     
     ///////////////////////////////////////////
     ///////////////////////////////////////////
@@ -618,13 +963,16 @@ namespace kvr
     bool      _destroy_value (uint32_t parentType, value *v);
 
     key *     _find_key (const char *str);
-    key *     _create_key (const char *str);    
-    key *     _create_key (char *str, sz_t len);    
+    key *     _find_key (const char *str, sz_t len);
+    key *     _create_key (const char *str);
+    key *     _create_key (const char *str, sz_t len);
+    key *     _create_key_move (char *str, sz_t len);
     void      _destroy_key (key *k);
 
     char *    _create_path_expr (const char **path, sz_t pathsz, sz_t *exprsz) const;
     void      _destroy_path_expr (char *expr, sz_t exprsz);
 
+    void      _destroy_values ();
     uint32_t  _get_rand ();
     
     ///////////////////////////////////////////
@@ -633,13 +981,32 @@ namespace kvr
 
   private:
 
-    ctx (size_t ks_size, size_t vs_size, allocator *a);
+    ctx (size_t ks_size, size_t vs_size, allocator *a, size_t region_block_sz = 0);
     ctx (const ctx &);
     ~ctx ();
 
-    allocator * m_allocator;
+    bool      _register ();
+    void      _unregister ();
+
+    allocator * m_allocator; // &m_region in arena mode
     key_store   m_kstore;
+    key_store   m_sstore;    // interned string values (see intern_strings)
     val_store   m_vstore;
+    region      m_region;
+    size_t      m_borrowed;  // live borrowed strings (snapshots copy while there are any)
+    uint32_t    m_id;        // registry slot (see value::_ctx)
+    bool        m_intern;
+
+    // the registry maps value ctx indices to ctx objects. slots live in pages that are allocated
+    // on first use and never moved or freed, so lookups take no lock; registration does
+    static const uint32_t REGISTRY_SLOT_COUNT = (1u << (32 - value::CTX_SHIFT));
+    static const uint32_t REGISTRY_PAGE_SHIFT = 10;
+    static const uint32_t REGISTRY_PAGE_MASK  = ((1u << REGISTRY_PAGE_SHIFT) - 1);
+
+    static ctx **          s_registry [REGISTRY_SLOT_COUNT >> REGISTRY_PAGE_SHIFT];
+    static uint32_t        s_registry_top;  // slots handed out so far
+    static uint32_t        s_registry_free; // first released slot + 1 (0 if none)
+    static void * volatile s_registry_lock;
 
     friend class value;
   };
@@ -744,6 +1111,148 @@ namespace kvr
   /////////////////////////////////////////////////////////////////////////////////////////////////
   /////////////////////////////////////////////////////////////////////////////////////////////////
   /////////////////////////////////////////////////////////////////////////////////////////////////
+
+  // read-only copy of a value tree packed into one block (see value::freeze). scalars and
+  // short strings are stored inline, everything else is found by offset. map keys are looked
+  // up in an open-addressed hash table (scanned in small maps); the cursor keeps insertion order
+  class frozen_doc
+  {
+  public:
+
+    class cursor;
+
+    ///////////////////////////////////////////
+    ///////////////////////////////////////////
+    ///////////////////////////////////////////
+
+    class node
+    {
+    public:
+
+      // type checking
+      bool          is_map () const;
+      bool          is_array () const;
+      bool          is_string () const;
+      bool          is_boolean () const;
+      bool          is_integer () const;
+      bool          is_float () const;
+      bool          is_null () const;
+
+      // variants
+      const char *  get_string () const;
+      const char *  get_string (sz_t *len) const;
+      int64_t       get_integer () const;
+      double        get_float () const;
+      bool          get_boolean () const;
+
+      // array
+      const node *  element (sz_t index) const;
+      sz_t          length () const;
+
+      // map
+      const node *  find (const char *key) const;
+      const node *  find (const char *key, sz_t keylen) const;
+      sz_t          size () const;
+
+      // path search (map or array)
+      const node *  search (const char *pathexpr) const;
+      const node *  search (const char **path, sz_t pathsz) const;
+
+    private:
+
+      enum type_t
+      {
+        TYPE_NULL,
+        TYPE_MAP,
+        TYPE_ARRAY,
+        TYPE_STRING,
+        TYPE_BOOLEAN,
+        TYPE_INTEGER,
+        TYPE_FLOAT,
+      };
+
+      struct mkey
+      {
+        uint32_t off; // from the map node to the (null-terminated) key string
+        uint32_t len;
+      };
+
+      struct islot
+      {
+        uint32_t hash;
+        uint32_t idx;  // member index + 1 (0 is empty)
+      };
+
+      static const uint32_t INDEX_THRESHOLD = 16u; // smaller maps are scanned
+
+      // map block layout: members [m_len] | keys [m_len] | index [_index_size (m_len)]
+      static uint32_t   _index_size (uint32_t count);
+      const node *      _members () const;
+      const mkey *      _keys () const;
+      const islot *     _index () const;
+      const node *      _search_key (const char *key, sz_t keylen) const;
+
+      union data
+      {
+        int64_t   i;
+        double    f;
+        bool      b;
+        uint32_t  off;                // from this node to its elements, members or string
+        char      s [sizeof (int64_t)]; // strings shorter than this (incl. terminator)
+      };
+
+      data      m_data;
+      uint32_t  m_len;  // string length, array length or map size
+      uint32_t  m_type;
+
+      friend class cursor;
+      friend struct internal::frozen::build_ctx;
+    };
+
+    ///////////////////////////////////////////
+    ///////////////////////////////////////////
+    ///////////////////////////////////////////
+
+    class cursor
+    {
+    public:
+
+      bool get (const char **key, const node **val);
+      explicit cursor (const node *map);
+
+    private:
+
+      const node *  m_map;
+      sz_t          m_index;
+    };
+
+    ///////////////////////////////////////////
+    ///////////////////////////////////////////
+    ///////////////////////////////////////////
+
+    frozen_doc (allocator *alloc = NULL);
+    ~frozen_doc ();
+
+    const node *  root () const;      // NULL until a value is frozen into it
+    size_t        get_size () const;  // block size in bytes
+
+  private:
+
+    frozen_doc (const frozen_doc &);
+    frozen_doc &operator=(const frozen_doc &);
+
+    void        _release ();
+
+    uint8_t *   m_block;
+    size_t      m_size;
+    allocator * m_alloc;
+
+    friend struct internal::frozen::build_ctx;
+  };
+
+  /////////////////////////////////////////////////////////////////////////////////////////////////
+  /////////////////////////////////////////////////////////////////////////////////////////////////
+  /////////////////////////////////////////////////////////////////////////////////////////////////
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
@@ -44,7 +44,37 @@ namespace kvr
     /////////////////////////////////////////////////////////////////////////////////////////////////
     /////////////////////////////////////////////////////////////////////////////////////////////////
     
-    inline kvr::value::value (kvr::ctx *ctx, uint32_t flags) : m_flags (flags), m_ctx (ctx)
+    inline bool key::is_pinned () const
+    {
+        return m_ref == REF_PINNED;
+    }
+    
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    
+    inline void key::_retain ()
+    {
+        if (m_ref != REF_PINNED)
+        {
+            ++m_ref;
+        }
+    }
+    
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    
+    inline bool key::_release ()
+    {
+        return (m_ref != REF_PINNED) && ((--m_ref) == 0);
+    }
+    
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    
+    inline kvr::value::value (kvr::ctx *ctx, uint32_t flags) : m_len (0), m_flags (flags | (ctx->m_id << CTX_SHIFT))
     {
     }
     
@@ -54,7 +84,7 @@ namespace kvr
     
     inline bool value::is_null () const
     {
-        return (m_flags & FLAG_TYPE_NULL) != 0;
+        return (m_flags & FLAG_TYPE_MASK) == FLAG_TYPE_NULL;
     }
     
     /////////////////////////////////////////////////////////////////////////////////////////////////
@@ -63,7 +93,7 @@ namespace kvr
     
     inline bool value::is_map () const
     {
-        return (m_flags & FLAG_TYPE_MAP) != 0;
+        return (m_flags & FLAG_TYPE_MASK) == FLAG_TYPE_MAP;
     }
     
     /////////////////////////////////////////////////////////////////////////////////////////////////
@@ -72,7 +102,7 @@ namespace kvr
     
     inline bool value::is_array () const
     {
-        return (m_flags & FLAG_TYPE_ARRAY) != 0;
+        return (m_flags & FLAG_TYPE_MASK) == FLAG_TYPE_ARRAY;
     }
     
     /////////////////////////////////////////////////////////////////////////////////////////////////
@@ -81,7 +111,7 @@ namespace kvr
     
     inline bool value::is_string () const
     {
-        return (m_flags & (FLAG_TYPE_STRING_DYNAMIC | FLAG_TYPE_STRING_STATIC)) != 0;
+        return this->_is_string_dynamic () || this->_is_string_static ();
     }
     
     /////////////////////////////////////////////////////////////////////////////////////////////////
@@ -90,7 +120,7 @@ namespace kvr
     
     inline bool value::is_boolean () const
     {
-        return (m_flags & FLAG_TYPE_BOOLEAN) != 0;
+        return (m_flags & FLAG_TYPE_MASK) == FLAG_TYPE_BOOLEAN;
     }
     
     /////////////////////////////////////////////////////////////////////////////////////////////////
@@ -99,7 +129,7 @@ namespace kvr
     
     inline bool value::is_integer () const
     {
-        return (m_flags & FLAG_TYPE_NUMBER_INTEGER) != 0;
+        return (m_flags & FLAG_TYPE_MASK) == FLAG_TYPE_NUMBER_INTEGER;
     }
     
     /////////////////////////////////////////////////////////////////////////////////////////////////
@@ -108,7 +138,43 @@ namespace kvr
     
     inline bool value::is_float () const
     {
-        return (m_flags & FLAG_TYPE_NUMBER_FLOAT) != 0;
+        return (m_flags & FLAG_TYPE_MASK) == FLAG_TYPE_NUMBER_FLOAT;
+    }
+    
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    
+    inline bool value::is_packed () const
+    {
+        return (m_flags & FLAG_ARRAY_PACKED) != 0;
+    }
+    
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    
+    inline const int64_t * value::packed_integers () const
+    {
+        return ((m_flags & FLAG_ARRAY_PACKED) == FLAG_ARRAY_PACKED_INTEGER) ? static_cast<const int64_t *>(m_data.a.m_raw) : NULL;
+    }
+    
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    
+    inline const double * value::packed_floats () const
+    {
+        return ((m_flags & FLAG_ARRAY_PACKED) == FLAG_ARRAY_PACKED_FLOAT) ? static_cast<const double *>(m_data.a.m_raw) : NULL;
+    }
+    
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    
+    inline const bool * value::packed_booleans () const
+    {
+        return ((m_flags & FLAG_ARRAY_PACKED) == FLAG_ARRAY_PACKED_BOOLEAN) ? static_cast<const bool *>(m_data.a.m_raw) : NULL;
     }
     
     /////////////////////////////////////////////////////////////////////////////////////////////////
@@ -117,7 +183,7 @@ namespace kvr
     
     inline bool value::_is_string_dynamic () const
     {
-        return (m_flags & FLAG_TYPE_STRING_DYNAMIC) != 0;
+        return (m_flags & FLAG_TYPE_MASK) == FLAG_TYPE_STRING_DYNAMIC;
     }
     
     /////////////////////////////////////////////////////////////////////////////////////////////////
@@ -126,7 +192,7 @@ namespace kvr
     
     inline bool value::_is_string_static () const
     {
-        return (m_flags & FLAG_TYPE_STRING_STATIC) != 0;
+        return (m_flags & FLAG_TYPE_MASK) == FLAG_TYPE_STRING_STATIC;
     }
     
     /////////////////////////////////////////////////////////////////////////////////////////////////
@@ -135,7 +201,36 @@ namespace kvr
     
     inline bool value::_is_number () const
     {
-        return (m_flags & (FLAG_TYPE_NUMBER_INTEGER | FLAG_TYPE_NUMBER_FLOAT)) != 0;
+        return this->is_integer () || this->is_float ();
+    }
+    
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    
+    inline char * value::_string_static () const
+    {
+        // m_data is at offset 0 and m_len follows it: STRING_STATIC_CAP bytes from the value start
+        return reinterpret_cast<char *>(const_cast<value *>(this));
+    }
+    
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    
+    inline char * value::_string_dynamic () const
+    {
+        return ((m_flags & FLAG_STRING_MASK) == FLAG_STRING_INTERNED) ? m_data.s.m_key->m_str : m_data.s.m_dyn;
+    }
+    
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    
+    inline ctx * value::_ctx () const
+    {
+        uint32_t id = m_flags >> CTX_SHIFT;
+        return ctx::s_registry [id >> ctx::REGISTRY_PAGE_SHIFT][id & ctx::REGISTRY_PAGE_MASK];
     }
     
     /////////////////////////////////////////////////////////////////////////////////////////////////
@@ -201,6 +296,87 @@ namespace kvr
     /////////////////////////////////////////////////////////////////////////////////////////////////
     /////////////////////////////////////////////////////////////////////////////////////////////////
     /////////////////////////////////////////////////////////////////////////////////////////////////
+    
+    inline bool frozen_doc::node::is_map () const
+    {
+        return m_type == TYPE_MAP;
+    }
+    
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    
+    inline bool frozen_doc::node::is_array () const
+    {
+        return m_type == TYPE_ARRAY;
+    }
+    
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    
+    inline bool frozen_doc::node::is_string () const
+    {
+        return m_type == TYPE_STRING;
+    }
+    
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    
+    inline bool frozen_doc::node::is_boolean () const
+    {
+        return m_type == TYPE_BOOLEAN;
+    }
+    
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    
+    inline bool frozen_doc::node::is_integer () const
+    {
+        return m_type == TYPE_INTEGER;
+    }
+    
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    
+    inline bool frozen_doc::node::is_float () const
+    {
+        return m_type == TYPE_FLOAT;
+    }
+    
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    
+    inline bool frozen_doc::node::is_null () const
+    {
+        return m_type == TYPE_NULL;
+    }
+    
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    
+    inline const frozen_doc::node * frozen_doc::root () const
+    {
+        return reinterpret_cast<const node *>(m_block);
+    }
+    
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    
+    inline size_t frozen_doc::get_size () const
+    {
+        return m_size;
+    }
+    
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    /////////////////////////////////////////////////////////////////////////////////////////////////
+    /////////////////////////////////////////////////////////////////////////////////////////////////
 }
 
 #endif
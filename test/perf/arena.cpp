@@ -0,0 +1,118 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Copyright (c) 2015 Ubaka Onyechi
+ *
+ * kvr is free software distributed under the MIT license.
+ * See https://raw.githubusercontent.com/uonyx/kvr/master/LICENSE file for details.
+ */
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "common.h"
+#include "../../example/allocators.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+// decode/teardown cost of a large json document per ctx memory mode:
+// default allocator, example arena_allocator (deallocation is a no-op but
+// teardown still walks the tree), and the built-in arena ctx torn down by
+// ctx::destroy or recycled by ctx::reset.
+
+static const int RECORD_COUNT = 20000;
+static const int REPS = 8;
+
+static arena_allocator<64u * 1024u * 1024u> example_arena;
+
+enum { MODE_DEFAULT, MODE_EXAMPLE_ARENA, MODE_ARENA_DESTROY, MODE_ARENA_RESET, MODE_COUNT };
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+int main () //int argc, char* argv [])
+{
+  const char *names [MODE_COUNT] = { "default", "example arena", "arena/destroy", "arena/reset" };
+  int errors = 0;
+
+  kvr::ctx *src = kvr::ctx::create ();
+  kvr::value *doc = src->create_value ();
+  make_records (doc, RECORD_COUNT);
+
+  kvr::obuffer obuf (doc->encode_bound (kvr::CODEC_JSON));
+  if (!doc->encode (kvr::CODEC_JSON, &obuf))
+  {
+    return 1;
+  }
+
+  printf ("json document: %zu bytes, %d records\n", obuf.get_size (), RECORD_COUNT);
+  printf ("%14s %12s %12s\n", "mode", "decode (ms)", "free (ms)");
+
+  kvr::ctx *recycled = kvr::ctx::create_arena ();
+
+  for (int m = 0; m < MODE_COUNT; ++m)
+  {
+    clock_t decode = 0, teardown = 0;
+
+    for (int r = 0; r < REPS; ++r)
+    {
+      clock_t t0 = clock ();
+
+      kvr::ctx *ctx = NULL;
+      switch (m)
+      {
+        case MODE_DEFAULT:        { ctx = kvr::ctx::create (); break; }
+        case MODE_EXAMPLE_ARENA:  { ctx = kvr::ctx::create (&example_arena); break; }
+        case MODE_ARENA_DESTROY:  { ctx = kvr::ctx::create_arena (); break; }
+        default:                  { ctx = recycled; break; }
+      }
+
+      kvr::value *val = ctx->create_value ();
+      errors += !val->decode (kvr::CODEC_JSON, obuf.get_data (), obuf.get_size ());
+
+      clock_t t1 = clock ();
+
+      errors += (val->find ("records")->length () != (kvr::sz_t) RECORD_COUNT);
+
+      clock_t t2 = clock ();
+
+      if (m == MODE_ARENA_RESET)
+      {
+        ctx->reset ();
+      }
+      else
+      {
+        kvr::ctx::destroy (ctx);
+      }
+
+      if (m == MODE_EXAMPLE_ARENA)
+      {
+        example_arena.purge_memory ();
+      }
+
+      clock_t t3 = clock ();
+
+      decode += (t1 - t0);
+      teardown += (t3 - t2);
+    }
+
+    printf ("%14s %12.2f %12.2f\n", names [m], elapsed_ms (0, decode, REPS), elapsed_ms (0, teardown, REPS));
+  }
+
+  kvr::ctx::destroy (recycled);
+
+  src->destroy_value (doc);
+  kvr::ctx::destroy (src);
+
+  return (errors == 0) ? 0 : 1;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,136 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Copyright (c) 2015 Ubaka Onyechi
+ *
+ * kvr is free software distributed under the MIT license.
+ * See https://raw.githubusercontent.com/uonyx/kvr/master/LICENSE file for details.
+ */
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "common.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+// decode, iteration and encode cost per element of a 1M element array of
+// integers, floats and short strings, for json and msgpack.
+
+static const int ELEMENT_COUNT = 1 << 20;
+static const int REPS = 4;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void make_array (kvr::value *arr)
+{
+  arr->as_array ();
+  for (int i = 0; i < ELEMENT_COUNT; ++i)
+  {
+    switch (i % 3)
+    {
+      case 0:   { arr->push ((int64_t) i); break; }
+      case 1:   { arr->push (i * 0.25); break; }
+      default:  { arr->push ("element"); break; }
+    }
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+static double iterate (const kvr::value *arr)
+{
+  double sum = 0.0;
+  for (kvr::sz_t i = 0, c = arr->length (); i < c; ++i)
+  {
+    kvr::value *v = arr->element (i);
+    if (v->is_integer ())
+    {
+      sum += (double) v->get_integer ();
+    }
+    else if (v->is_float ())
+    {
+      sum += v->get_float ();
+    }
+  }
+  return sum;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+int main () //int argc, char* argv [])
+{
+  const kvr::codec_t codecs [2] = { kvr::CODEC_JSON, kvr::CODEC_MSGPACK };
+  const char *names [2] = { "json", "msgpack" };
+  int errors = 0;
+
+  kvr::ctx *ctx = kvr::ctx::create ();
+  kvr::value *src = ctx->create_value ();
+  make_array (src);
+  const double expected = iterate (src);
+
+  printf ("%d elements\n", ELEMENT_COUNT);
+  printf ("%8s %12s %12s %12s\n", "codec", "decode (ns)", "iterate (ns)", "encode (ns)");
+
+  for (int c = 0; c < 2; ++c)
+  {
+    kvr::obuffer obuf (src->encode_bound (codecs [c]));
+    if (!src->encode (codecs [c], &obuf))
+    {
+      return 1;
+    }
+
+    clock_t decode = 0, iteration = 0, encode = 0;
+
+    for (int r = 0; r < REPS; ++r)
+    {
+      kvr::obuffer out (src->encode_bound (codecs [c]));
+
+      clock_t t0 = clock ();
+
+      kvr::value *arr = ctx->create_value ();
+      errors += !arr->decode (codecs [c], obuf.get_data (), obuf.get_size ());
+
+      clock_t t1 = clock ();
+
+      errors += (iterate (arr) != expected);
+
+      clock_t t2 = clock ();
+
+      errors += !arr->encode (codecs [c], &out);
+
+      clock_t t3 = clock ();
+
+      errors += (out.get_size () != obuf.get_size ());
+      ctx->destroy_value (arr);
+
+      decode += (t1 - t0);
+      iteration += (t2 - t1);
+      encode += (t3 - t2);
+    }
+
+    const size_t ops = (size_t) ELEMENT_COUNT * REPS;
+    printf ("%8s %12.1f %12.1f %12.1f\n", names [c], elapsed_ns (0, decode, ops),
+            elapsed_ns (0, iteration, ops), elapsed_ns (0, encode, ops));
+  }
+
+  ctx->destroy_value (src);
+  kvr::ctx::destroy (ctx);
+
+  return (errors == 0) ? 0 : 1;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
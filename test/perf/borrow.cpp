@@ -0,0 +1,97 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Copyright (c) 2015 Ubaka Onyechi
+ *
+ * kvr is free software distributed under the MIT license.
+ * See https://raw.githubusercontent.com/uonyx/kvr/master/LICENSE file for details.
+ */
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "common.h"
+#include "../../example/allocators.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+// allocations, memory use and decode cost of a string-heavy msgpack/cbor buffer
+// with strings copied (default) and borrowed from the buffer (DECODE_BORROW_STRINGS).
+
+static const int RECORD_COUNT = 100000;
+static const int REPS = 4;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+int main () //int argc, char* argv [])
+{
+  const kvr::codec_t codecs [2] = { kvr::CODEC_MSGPACK, kvr::CODEC_CBOR };
+  const char *names [2] = { "msgpack", "cbor" };
+  const char *modes [2] = { "copied", "borrowed" };
+  const uint32_t flags [2] = { 0, kvr::DECODE_BORROW_STRINGS };
+  int errors = 0;
+
+  kvr::ctx *src = kvr::ctx::create ();
+  kvr::value *doc = src->create_value ();
+  make_records (doc, RECORD_COUNT);
+  const uint32_t expected = doc->hash ();
+
+  printf ("%8s %9s %14s %14s %12s\n", "codec", "strings", "allocations", "memory (B)", "decode (ms)");
+
+  for (int c = 0; c < 2; ++c)
+  {
+    kvr::obuffer obuf (doc->encode_bound (codecs [c]));
+    if (!doc->encode (codecs [c], &obuf))
+    {
+      return 1;
+    }
+
+    for (int m = 0; m < 2; ++m)
+    {
+      size_t allocs = 0;
+      int64_t usage = 0;
+      clock_t decode = 0;
+
+      for (int r = 0; r < REPS; ++r)
+      {
+        memtrack_allocator mem;
+        kvr::ctx *ctx = kvr::ctx::create (&mem);
+        size_t base = mem.get_allocation_count ();
+        int64_t basemem = mem.get_memory_usage ();
+
+        clock_t t0 = clock ();
+
+        kvr::value *val = ctx->create_value ();
+        errors += !val->decode (codecs [c], obuf.get_data (), obuf.get_size (), flags [m]);
+
+        clock_t t1 = clock ();
+
+        allocs = mem.get_allocation_count () - base;
+        usage = mem.get_memory_usage () - basemem;
+        errors += (val->hash () != expected);
+        kvr::ctx::destroy (ctx);
+
+        decode += (t1 - t0);
+      }
+
+      printf ("%8s %9s %14zu %14lld %12.2f\n", names [c], modes [m], allocs, (long long) usage,
+              elapsed_ms (0, decode, REPS));
+    }
+  }
+
+  src->destroy_value (doc);
+  kvr::ctx::destroy (src);
+
+  return (errors == 0) ? 0 : 1;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
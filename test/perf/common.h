@@ -0,0 +1,278 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Copyright (c) 2015 Ubaka Onyechi
+ *
+ * kvr is free software distributed under the MIT license.
+ * See https://raw.githubusercontent.com/uonyx/kvr/master/LICENSE file for details.
+ */
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef KVR_PERF_COMMON
+#define KVR_PERF_COMMON
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "kvr.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+// timings, test documents and the json decode throughput run shared by the perf tests
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+inline double elapsed_ns (clock_t start, clock_t end, size_t ops = 1)
+{
+  double sec = (double) (end - start) / (double) CLOCKS_PER_SEC;
+  return (sec * 1.0e9) / (double) ops;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+inline double elapsed_us (clock_t start, clock_t end, size_t ops = 1)
+{
+  double sec = (double) (end - start) / (double) CLOCKS_PER_SEC;
+  return (sec * 1.0e6) / (double) ops;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+inline double elapsed_ms (clock_t start, clock_t end, size_t ops = 1)
+{
+  double sec = (double) (end - start) / (double) CLOCKS_PER_SEC;
+  return (sec * 1.0e3) / (double) ops;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+inline double mb_per_sec (clock_t start, clock_t end, size_t bytes)
+{
+  double sec = (double) (end - start) / (double) CLOCKS_PER_SEC;
+  return (sec > 0.0) ? (((double) bytes / (1024.0 * 1024.0)) / sec) : 0.0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+inline char * load_arn (size_t *size)
+{
+  // example/data/ARN-x.json, when run from the repository root or a build directory under
+  // it (NULL otherwise). the caller delete []s it
+  const char *paths [] = { "example/data/ARN-x.json", "../example/data/ARN-x.json", "../../example/data/ARN-x.json" };
+
+  for (size_t i = 0; i < (sizeof (paths) / sizeof (paths [0])); ++i)
+  {
+    FILE *fp = fopen (paths [i], "rb");
+    if (fp)
+    {
+      fseek (fp, 0, SEEK_END);
+      long sz = ftell (fp);
+      fseek (fp, 0, SEEK_SET);
+      char *buf = new char [sz];
+      *size = fread (buf, 1, (size_t) sz, fp);
+      fclose (fp);
+      return buf;
+    }
+  }
+  return NULL;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+inline void make_log (kvr::value *doc, int count)
+{
+  // an "events" array of small records: integers, floats, booleans, strings that repeat
+  // (status, host, region) and unique ones up to about 120 bytes, some with quotes and
+  // tabs to escape
+  const char *statuses [] = { "200 request completed", "503 service unavailable", "429 too many requests" };
+  const char *regions [] = { "eu-west-1.compute", "us-east-1.compute", "ap-southeast-2.compute" };
+  char str [160];
+
+  kvr::value *events = doc->insert_array ("events");
+  for (int i = 0; i < count; ++i)
+  {
+    kvr::value *e = events->push_map ();
+    e->insert ("ts", (int64_t) 1500000000 + i);
+    e->insert ("status", statuses [i % 3]);
+    sprintf (str, "host-%04d.internal.example", i % 64);
+    e->insert ("host", str);
+    e->insert ("region", regions [(i / 64) % 3]);
+    sprintf (str, "GET /api/v1/items/%d?expand=\"owner\"\tclient=%d", i, i % 1000);
+    e->insert ("request", str);
+    sprintf (str, "Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/%d.0.%d.0 Safari/537.36", 60 + (i % 40), i % 5000);
+    e->insert ("agent", str);
+    e->insert ("latency", i * 0.001);
+    e->insert ("cached", (i & 1) != 0);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+inline size_t make_records (kvr::value *doc, int count)
+{
+  // a "records" array of maps of scalars, strings too long to be stored inline, and an
+  // array and a map of 0 to 11 and 0 to 9 elements. returns the number of values made
+  char str [48];
+  size_t values = 1;
+
+  kvr::value *recs = doc->insert_array ("records");
+  for (int i = 0; i < count; ++i)
+  {
+    kvr::value *r = recs->push_map ();
+    r->insert ("id", (int64_t) i);
+    sprintf (str, "user-%06d@mail.example.com", i);
+    r->insert ("email", str);
+    r->insert ("name", "a name too long to be stored inline");
+    r->insert ("score", i * 0.5);
+    r->insert ("active", (i & 1) == 0);
+    r->insert_null ("parent");
+    kvr::value *tags = r->insert_array ("tags");
+    for (int t = 0; t < (i % 12); ++t)
+    {
+      tags->push ((int64_t) t);
+    }
+    kvr::value *attrs = r->insert_map ("attrs");
+    for (int a = 0; a < (i % 10); ++a)
+    {
+      sprintf (str, "attr%d", a);
+      attrs->insert (str, (a & 1) == 0);
+    }
+    values += 9 + (size_t) (i % 12) + (size_t) (i % 10);
+  }
+
+  return values;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+// a json decode mode: decodes size bytes of json from work (a fresh copy of the input, so
+// decoders may write into it) into val
+typedef bool (*json_decode_fn) (kvr::value *val, int mode, uint8_t *work, size_t size);
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+inline int measure_json_decode (const char *name, const char *json, size_t size, const char **modes, int mode_count, json_decode_fn decode)
+{
+  const size_t MIN_BYTES = 64u << 20; // decoded per measurement
+  int errors = 0;
+  int reps = (int) ((MIN_BYTES / size) + 1);
+  uint32_t hash = 0;
+
+  uint8_t *work = new uint8_t [size];
+  kvr::ctx *ctx = kvr::ctx::create ();
+
+  for (int m = 0; m < mode_count; ++m)
+  {
+    clock_t total = 0;
+
+    for (int r = 0; r < reps; ++r)
+    {
+      memcpy (work, json, size); // not timed
+      kvr::value *val = ctx->create_value ();
+
+      clock_t t0 = clock ();
+      bool ok = decode (val, m, work, size);
+      clock_t t1 = clock ();
+      total += (t1 - t0);
+
+      errors += !ok;
+      if (r == 0)
+      {
+        uint32_t h = val->hash ();
+        errors += (m > 0) && (h != hash);
+        hash = h;
+      }
+      ctx->destroy_value (val);
+    }
+
+    printf ("%10s %10zu %8s %12.1f\n", name, size, modes [m], mb_per_sec (0, total, size * reps));
+  }
+
+  kvr::ctx::destroy (ctx);
+  delete [] work;
+
+  return errors;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+inline int run_json_decode (const char **modes, int mode_count, json_decode_fn decode)
+{
+  // inputs: ARN-x.json, that document 64 times over as one array, and a large event log.
+  // returns the error count
+  int errors = 0;
+
+  printf ("%10s %10s %8s %12s\n", "input", "bytes", "mode", "MB/s");
+
+  size_t arn_size = 0;
+  char *arn = load_arn (&arn_size);
+  if (arn)
+  {
+    errors += measure_json_decode ("ARN-x", arn, arn_size, modes, mode_count, decode);
+
+    kvr::ctx *src = kvr::ctx::create ();
+    kvr::value *one = src->create_value ();
+    errors += !one->decode (kvr::CODEC_JSON, (const uint8_t *) arn, arn_size);
+    kvr::value *many = src->create_value ()->as_array ();
+    for (int i = 0; i < 64; ++i)
+    {
+      many->push_null ()->copy (one);
+    }
+    kvr::obuffer obuf (many->encode_bound (kvr::CODEC_JSON));
+    errors += !many->encode (kvr::CODEC_JSON, &obuf);
+    errors += measure_json_decode ("ARN-x*64", (const char *) obuf.get_data (), obuf.get_size (), modes, mode_count, decode);
+    kvr::ctx::destroy (src);
+    delete [] arn;
+  }
+  else
+  {
+    printf ("%10s (not found, run from the repository root)\n", "ARN-x");
+  }
+
+  kvr::ctx *src = kvr::ctx::create ();
+  kvr::value *log = src->create_value ();
+  make_log (log, 200000);
+  kvr::obuffer obuf (log->encode_bound (kvr::CODEC_JSON));
+  errors += !log->encode (kvr::CODEC_JSON, &obuf);
+  errors += measure_json_decode ("log", (const char *) obuf.get_data (), obuf.get_size (), modes, mode_count, decode);
+  kvr::ctx::destroy (src);
+
+  return errors;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif
@@ -0,0 +1,164 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Copyright (c) 2015 Ubaka Onyechi
+ *
+ * kvr is free software distributed under the MIT license.
+ * See https://raw.githubusercontent.com/uonyx/kvr/master/LICENSE file for details.
+ */
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "common.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+// json encode throughput (MB of output per second) into an obuffer sized by encode_bound,
+// an obuffer grown from 256 bytes and a custom ostream, for a string-heavy event log
+// (long strings, some with quotes and tabs to escape) and a number-heavy document
+// (integer and float records, and packed arrays).
+
+static const int EVENT_COUNT = 100000;
+static const int RECORD_COUNT = 100000;
+static const size_t MIN_BYTES = 256u << 20; // encoded per measurement
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+// counts and checksums the output, as a socket or file writer would consume it
+class sum_ostream : public kvr::ostream
+{
+public:
+
+  sum_ostream () : m_size (0), m_sum (0) {}
+
+  void put (uint8_t byte) { m_sum += byte; ++m_size; }
+  void write (uint8_t *bytes, size_t count) { for (size_t i = 0; i < count; i += 64) { m_sum += bytes [i]; } m_size += count; }
+  void flush () {}
+
+  size_t    m_size;
+  uint32_t  m_sum;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void make_numbers (kvr::value *doc)
+{
+  kvr::value *records = doc->insert_array ("records");
+  for (int i = 0; i < RECORD_COUNT; ++i)
+  {
+    kvr::value *r = records->push_map ();
+    r->insert ("id", (int64_t) i * 7919);
+    r->insert ("x", i * 0.125);
+    r->insert ("y", i * -3.3e-3);
+    r->insert ("n", (int64_t) i - (RECORD_COUNT / 2));
+  }
+
+  kvr::value *ints = doc->insert_array ("ints");
+  kvr::value *floats = doc->insert_array ("floats");
+  for (int i = 0; i < RECORD_COUNT; ++i)
+  {
+    ints->push ((int64_t) i * 1000003);
+    floats->push (i / 7.0);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int measure (const char *name, kvr::value *doc)
+{
+  const char *modes [3] = { "bound", "grown", "ostream" };
+  int errors = 0;
+
+  const size_t bound = doc->encode_bound (kvr::CODEC_JSON);
+  kvr::obuffer ref (bound);
+  errors += !doc->encode (kvr::CODEC_JSON, &ref);
+  const size_t size = ref.get_size ();
+  const int reps = (int) ((MIN_BYTES / size) + 1);
+
+  for (int m = 0; m < 3; ++m)
+  {
+    size_t out = 0;
+
+    clock_t t0 = clock ();
+
+    for (int r = 0; r < reps; ++r)
+    {
+      switch (m)
+      {
+        case 0:
+        {
+          kvr::obuffer obuf (bound);
+          errors += !doc->encode (kvr::CODEC_JSON, &obuf);
+          out = obuf.get_size ();
+          break;
+        }
+
+        case 1:
+        {
+          kvr::obuffer obuf;
+          errors += !doc->encode (kvr::CODEC_JSON, &obuf);
+          out = obuf.get_size ();
+          break;
+        }
+
+        default:
+        {
+          sum_ostream os;
+          errors += !doc->encode (kvr::CODEC_JSON, &os);
+          out = os.m_size;
+          break;
+        }
+      }
+    }
+
+    clock_t t1 = clock ();
+
+    errors += (out != size);
+    printf ("%8s %10zu %8s %12.1f\n", name, size, modes [m], mb_per_sec (t0, t1, size * reps));
+  }
+
+  return errors;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+int main () //int argc, char* argv [])
+{
+  int errors = 0;
+
+  printf ("%8s %10s %8s %12s\n", "input", "bytes", "output", "MB/s");
+
+  kvr::ctx *ctx = kvr::ctx::create ();
+
+  kvr::value *log = ctx->create_value ()->as_map ();
+  make_log (log, EVENT_COUNT);
+  errors += measure ("strings", log);
+  ctx->destroy_value (log);
+
+  kvr::value *nums = ctx->create_value ()->as_map ();
+  make_numbers (nums);
+  errors += measure ("numbers", nums);
+  ctx->destroy_value (nums);
+
+  kvr::ctx::destroy (ctx);
+
+  return (errors == 0) ? 0 : 1;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,95 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Copyright (c) 2015 Ubaka Onyechi
+ *
+ * kvr is free software distributed under the MIT license.
+ * See https://raw.githubusercontent.com/uonyx/kvr/master/LICENSE file for details.
+ */
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "common.h"
+#include "../../example/allocators.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+// memory footprint of a large tree of small values (bytes per value) and the
+// traversal cost (copy, hash, json/msgpack encode) per value over it.
+
+static const int RECORD_COUNT = 100000;
+static const int REPS = 4;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+int main () //int argc, char* argv [])
+{
+  int errors = 0;
+
+  memtrack_allocator mem;
+  kvr::ctx *ctx = kvr::ctx::create (&mem);
+
+  int64_t base = mem.get_memory_usage ();
+  kvr::value *doc = ctx->create_value ();
+  const size_t values = make_records (doc, RECORD_COUNT);
+  int64_t usage = mem.get_memory_usage () - base;
+
+  printf ("sizeof (kvr::value): %zu bytes\n", sizeof (kvr::value));
+  printf ("%zu values: %lld bytes (%.1f bytes per value)\n", values, (long long) usage, (double) usage / (double) values);
+  printf ("%12s %12s %12s %12s\n", "copy (ns)", "hash (ns)", "json (ns)", "msgpack (ns)");
+
+  const uint32_t expected = doc->hash ();
+  clock_t copy = 0, hash = 0, json = 0, msgpack = 0;
+
+  for (int r = 0; r < REPS; ++r)
+  {
+    kvr::obuffer jbuf (doc->encode_bound (kvr::CODEC_JSON));
+    kvr::obuffer mbuf (doc->encode_bound (kvr::CODEC_MSGPACK));
+
+    clock_t t0 = clock ();
+
+    kvr::value *cpy = ctx->create_value ()->copy (doc);
+
+    clock_t t1 = clock ();
+
+    errors += (cpy->hash () != expected);
+
+    clock_t t2 = clock ();
+
+    errors += !cpy->encode (kvr::CODEC_JSON, &jbuf);
+
+    clock_t t3 = clock ();
+
+    errors += !cpy->encode (kvr::CODEC_MSGPACK, &mbuf);
+
+    clock_t t4 = clock ();
+
+    ctx->destroy_value (cpy);
+
+    copy += (t1 - t0);
+    hash += (t2 - t1);
+    json += (t3 - t2);
+    msgpack += (t4 - t3);
+  }
+
+  const size_t ops = values * REPS;
+  printf ("%12.1f %12.1f %12.1f %12.1f\n", elapsed_ns (0, copy, ops), elapsed_ns (0, hash, ops),
+          elapsed_ns (0, json, ops), elapsed_ns (0, msgpack, ops));
+
+  ctx->destroy_value (doc);
+  kvr::ctx::destroy (ctx);
+
+  return (errors == 0) ? 0 : 1;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,141 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Copyright (c) 2015 Ubaka Onyechi
+ *
+ * kvr is free software distributed under the MIT license.
+ * See https://raw.githubusercontent.com/uonyx/kvr/master/LICENSE file for details.
+ */
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "common.h"
+#include "../../example/allocators.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+// memory use and lookup cost of a decoded config tree, live and frozen (value::freeze).
+// lookups are two-level finds and path searches over random sections and settings.
+
+static const int SECTION_COUNT = 2000;
+static const int SETTING_COUNT = 20;
+static const int LOOKUP_COUNT = 1 << 20;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void make_config (kvr::value *doc)
+{
+  char key [32];
+  for (int s = 0; s < SECTION_COUNT; ++s)
+  {
+    sprintf (key, "section-%d", s);
+    kvr::value *sec = doc->insert_map (key);
+    for (int i = 0; i < SETTING_COUNT; ++i)
+    {
+      sprintf (key, "setting-%d", i);
+      switch (i % 4)
+      {
+        case 0:   { sec->insert (key, (int64_t) (s + i)); break; }
+        case 1:   { sec->insert (key, i * 0.5); break; }
+        case 2:   { sec->insert (key, "a setting value too long to be inline"); break; }
+        default:  { sec->insert (key, (i & 4) != 0); break; }
+      }
+    }
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+int main () //int argc, char* argv [])
+{
+  int errors = 0;
+
+  // lookup keys: random (section, setting of type integer) pairs
+  static char skeys [256][32], ikeys [256][32], paths [256][64];
+  for (int i = 0; i < 256; ++i)
+  {
+    int s = rand () % SECTION_COUNT, k = (rand () % (SETTING_COUNT / 4)) * 4;
+    sprintf (skeys [i], "section-%d", s);
+    sprintf (ikeys [i], "setting-%d", k);
+    sprintf (paths [i], "section-%d/setting-%d", s, k);
+  }
+
+  kvr::ctx *src = kvr::ctx::create ();
+  kvr::value *cfg = src->create_value ()->as_map ();
+  make_config (cfg);
+  kvr::obuffer obuf (cfg->encode_bound (kvr::CODEC_JSON));
+  errors += !cfg->encode (kvr::CODEC_JSON, &obuf);
+
+  // live tree (decoded, as a config would be)
+  memtrack_allocator mem;
+  kvr::ctx *ctx = kvr::ctx::create (&mem);
+  int64_t base = mem.get_memory_usage ();
+  kvr::value *doc = ctx->create_value ();
+  errors += !doc->decode (kvr::CODEC_JSON, obuf.get_data (), obuf.get_size ());
+  int64_t live = mem.get_memory_usage () - base;
+
+  clock_t t0 = clock ();
+
+  kvr::frozen_doc fd;
+  errors += !doc->freeze (&fd);
+
+  clock_t t1 = clock ();
+
+  printf ("%d sections of %d settings, freeze: %.2f ms\n", SECTION_COUNT, SETTING_COUNT,
+          elapsed_ns (t0, t1, 1) * 1.0e-6);
+  printf ("%8s %14s %12s %12s\n", "tree", "memory (B)", "find (ns)", "search (ns)");
+
+  int64_t sum [4] = { 0, 0, 0, 0 };
+
+  clock_t l0 = clock ();
+  for (int i = 0; i < LOOKUP_COUNT; ++i)
+  {
+    sum [0] += doc->find (skeys [i & 255])->find (ikeys [i & 255])->get_integer ();
+  }
+  clock_t l1 = clock ();
+  for (int i = 0; i < LOOKUP_COUNT; ++i)
+  {
+    sum [1] += doc->search (paths [i & 255])->get_integer ();
+  }
+  clock_t l2 = clock ();
+  printf ("%8s %14lld %12.1f %12.1f\n", "live", (long long) live, elapsed_ns (l0, l1, LOOKUP_COUNT),
+          elapsed_ns (l1, l2, LOOKUP_COUNT));
+
+  const kvr::frozen_doc::node *r = fd.root ();
+  clock_t f0 = clock ();
+  for (int i = 0; i < LOOKUP_COUNT; ++i)
+  {
+    sum [2] += r->find (skeys [i & 255])->find (ikeys [i & 255])->get_integer ();
+  }
+  clock_t f1 = clock ();
+  for (int i = 0; i < LOOKUP_COUNT; ++i)
+  {
+    sum [3] += r->search (paths [i & 255])->get_integer ();
+  }
+  clock_t f2 = clock ();
+  printf ("%8s %14zu %12.1f %12.1f\n", "frozen", fd.get_size (), elapsed_ns (f0, f1, LOOKUP_COUNT),
+          elapsed_ns (f1, f2, LOOKUP_COUNT));
+
+  errors += (sum [0] != sum [1]) || (sum [0] != sum [2]) || (sum [0] != sum [3]);
+
+  ctx->destroy_value (doc);
+  kvr::ctx::destroy (ctx);
+  src->destroy_value (cfg);
+  kvr::ctx::destroy (src);
+
+  return (errors == 0) ? 0 : 1;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
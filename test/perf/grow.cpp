@@ -0,0 +1,131 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Copyright (c) 2015 Ubaka Onyechi
+ *
+ * kvr is free software distributed under the MIT license.
+ * See https://raw.githubusercontent.com/uonyx/kvr/master/LICENSE file for details.
+ */
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "common.h"
+#include "../../example/allocators.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+// cost and peak memory of growing a large array one push at a time, a large map one insert
+// at a time and a json encode buffer from 256 bytes, with blocks grown by realloc
+// (allocator::reallocate) and by allocate, copy and deallocate (the fallback).
+
+static const int ELEMENT_COUNT = 1 << 22;
+static const int MEMBER_COUNT = 1 << 18;
+static const int REPS = 4;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+class copying_allocator : public memtrack_allocator
+{
+public:
+  void *reallocate (void *p, size_t old_sz, size_t new_sz)
+  {
+    return kvr::allocator::reallocate (p, old_sz, new_sz);
+  }
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+int main () //int argc, char* argv [])
+{
+  const char *modes [2] = { "realloc", "copy" };
+  const char *ops [3] = { "array push", "map insert", "json encode" };
+  int errors = 0;
+
+  printf ("%d elements, %d members\n", ELEMENT_COUNT, MEMBER_COUNT);
+  printf ("%12s %8s %12s %14s\n", "op", "growth", "time (ms)", "peak (B)");
+
+  for (int op = 0; op < 3; ++op)
+  {
+    for (int m = 0; m < 2; ++m)
+    {
+      clock_t total = 0;
+      int64_t peak = 0;
+
+      for (int r = 0; r < REPS; ++r)
+      {
+        memtrack_allocator realloc_mem;
+        copying_allocator copy_mem;
+        memtrack_allocator *mem = (m == 0) ? &realloc_mem : &copy_mem;
+        kvr::ctx *ctx = kvr::ctx::create (mem);
+        kvr::value *doc = ctx->create_value ();
+
+        if (op == 2)
+        {
+          // the doc is built first, only the encode is measured
+          kvr::value *arr = doc->as_array ();
+          arr->reserve (ELEMENT_COUNT / 4);
+          for (int i = 0; i < (ELEMENT_COUNT / 4); ++i)
+          {
+            arr->push ("element");
+          }
+        }
+
+        mem->reset_memory_peak ();
+        int64_t base = mem->get_memory_usage ();
+        clock_t t0 = clock ();
+
+        if (op == 0)
+        {
+          kvr::value *arr = doc->as_array ();
+          for (int i = 0; i < ELEMENT_COUNT; ++i)
+          {
+            arr->push_null ();
+          }
+          errors += (arr->length () != (kvr::sz_t) ELEMENT_COUNT);
+        }
+        else if (op == 1)
+        {
+          char key [32];
+          kvr::value *map = doc->as_map ();
+          for (int i = 0; i < MEMBER_COUNT; ++i)
+          {
+            sprintf (key, "k%d", i);
+            map->insert (key, (int64_t) i);
+          }
+          errors += (map->size () != (kvr::sz_t) MEMBER_COUNT);
+        }
+        else
+        {
+          kvr::obuffer obuf (256u, mem);
+          errors += !doc->encode (kvr::CODEC_JSON, &obuf);
+          errors += (obuf.get_size () < (size_t) ELEMENT_COUNT);
+        }
+
+        clock_t t1 = clock ();
+        peak = mem->get_memory_peak () - base;
+        total += (t1 - t0);
+
+        ctx->destroy_value (doc);
+        kvr::ctx::destroy (ctx);
+      }
+
+      printf ("%12s %8s %12.2f %14lld\n", ops [op], modes [m], elapsed_ms (0, total, REPS), (long long) peak);
+    }
+  }
+
+  return (errors == 0) ? 0 : 1;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
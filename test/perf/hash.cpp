@@ -0,0 +1,100 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Copyright (c) 2015 Ubaka Onyechi
+ *
+ * kvr is free software distributed under the MIT license.
+ * See https://raw.githubusercontent.com/uonyx/kvr/master/LICENSE file for details.
+ */
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "common.h"
+#include "internal/kvr_hash.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+// key hashing cost per key: djb (char at a time, nul-terminated)
+// against the length-aware word at a time hash, across key lengths.
+
+static const int KEY_COUNT = 256;
+static const int MAX_KEY_LEN = 128;
+
+static char keys [KEY_COUNT][MAX_KEY_LEN + 1];
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+int main () //int argc, char* argv [])
+{
+  const size_t lengths [] = { 4, 8, 12, 16, 24, 32, 64, 128 };
+  const int count = sizeof (lengths) / sizeof (lengths [0]);
+  const int reps = 512;
+
+  // deterministic pseudo-random key bytes (printable)
+  uint32_t x = 2463534242u;
+  for (int i = 0; i < KEY_COUNT; ++i)
+  {
+    for (int j = 0; j < MAX_KEY_LEN; ++j)
+    {
+      x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+      keys [i][j] = (char) ('!' + (x % 94));
+    }
+  }
+
+  printf ("%6s %12s %12s\n", "length", "djb (ns)", "hash (ns)");
+
+  uint32_t sink = 0;
+
+  for (int l = 0; l < count; ++l)
+  {
+    const size_t len = lengths [l];
+    for (int i = 0; i < KEY_COUNT; ++i)
+    {
+      keys [i][len] = 0;
+    }
+
+    clock_t t0 = clock ();
+    for (int r = 0; r < reps; ++r)
+    {
+      for (int i = 0; i < KEY_COUNT; ++i)
+      {
+        sink += kvr::internal::djb_hash (keys [i], (uint32_t) r);
+      }
+    }
+
+    clock_t t1 = clock ();
+    for (int r = 0; r < reps; ++r)
+    {
+      for (int i = 0; i < KEY_COUNT; ++i)
+      {
+        sink += kvr::internal::hash (keys [i], len, (uint32_t) r);
+      }
+    }
+
+    clock_t t2 = clock ();
+    size_t ops = (size_t) reps * KEY_COUNT;
+    printf ("%6zu %12.2f %12.2f\n", len, elapsed_ns (t0, t1, ops), elapsed_ns (t1, t2, ops));
+
+    for (int i = 0; i < KEY_COUNT; ++i)
+    {
+      keys [i][len] = '!';
+    }
+  }
+
+  // keep the hashing from being optimized away
+  printf ("(%08x)\n", sink);
+
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
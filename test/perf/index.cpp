@@ -0,0 +1,56 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Copyright (c) 2015 Ubaka Onyechi
+ *
+ * kvr is free software distributed under the MIT license.
+ * See https://raw.githubusercontent.com/uonyx/kvr/master/LICENSE file for details.
+ */
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "common.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+// json decode throughput from a memory buffer: the rapidjson reader (default) and the
+// structural index reader (DECODE_JSON_INDEXED) with its block classifier capped at
+// scalar, sse2 and avx2 (capped at what the cpu has). inputs are example/data/ARN-x.json
+// (when run from the repository root or a build directory under it), that document
+// repeated and a large event log.
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+static bool decode (kvr::value *val, int mode, uint8_t *work, size_t size)
+{
+  const uint32_t flags [4] = { 0,
+                               kvr::DECODE_JSON_INDEXED | kvr::DECODE_JSON_INDEX_NO_SIMD,
+                               kvr::DECODE_JSON_INDEXED | kvr::DECODE_JSON_INDEX_NO_AVX2,
+                               kvr::DECODE_JSON_INDEXED };
+
+  return val->decode (kvr::CODEC_JSON, work, size, flags [mode]);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+int main () //int argc, char* argv [])
+{
+  const char *modes [4] = { "default", "scalar", "sse2", "avx2" };
+  int errors = run_json_decode (modes, 4, decode);
+
+  return (errors == 0) ? 0 : 1;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
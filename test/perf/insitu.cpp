@@ -0,0 +1,56 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Copyright (c) 2015 Ubaka Onyechi
+ *
+ * kvr is free software distributed under the MIT license.
+ * See https://raw.githubusercontent.com/uonyx/kvr/master/LICENSE file for details.
+ */
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "common.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+// json decode throughput from a memory buffer: decode (strings copied out of the parser
+// stack), decode_insitu (strings unescaped in place, then copied) and decode_insitu with
+// DECODE_BORROW_STRINGS (strings left in place). inputs are example/data/ARN-x.json (when
+// run from the repository root or a build directory under it), that document repeated
+// and a large event log.
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+static bool decode (kvr::value *val, int mode, uint8_t *work, size_t size)
+{
+  switch (mode)
+  {
+    case 0:   { return val->decode (kvr::CODEC_JSON, work, size); }
+    case 1:   { return val->decode_insitu (kvr::CODEC_JSON, work, size); }
+    default:  { return val->decode_insitu (kvr::CODEC_JSON, work, size, kvr::DECODE_BORROW_STRINGS); }
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+int main () //int argc, char* argv [])
+{
+  const char *modes [3] = { "decode", "insitu", "borrow" };
+  int errors = run_json_decode (modes, 3, decode);
+
+  return (errors == 0) ? 0 : 1;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,103 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Copyright (c) 2015 Ubaka Onyechi
+ *
+ * kvr is free software distributed under the MIT license.
+ * See https://raw.githubusercontent.com/uonyx/kvr/master/LICENSE file for details.
+ */
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "common.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+// map lookup cost per operation: string keys (hash + key store probe + map find)
+// against interned key handles (map find only), across map sizes.
+
+static const int KEY_COUNT = 1024;
+
+static char keys [KEY_COUNT][32];
+static kvr::key *handles [KEY_COUNT];
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+int main () //int argc, char* argv [])
+{
+  const int sizes [] = { 8, 32, 256, 1024 };
+  const int count = sizeof (sizes) / sizeof (sizes [0]);
+  const int total = 1 << 18; // lookups per size
+  int errors = 0;
+
+  kvr::ctx *ctx = kvr::ctx::create ();
+
+  for (int i = 0; i < KEY_COUNT; ++i)
+  {
+    sprintf (keys [i], "some.longer/record_field_%d", i);
+    handles [i] = ctx->intern (keys [i]);
+  }
+
+  printf ("%6s %14s %14s\n", "size", "string (ns)", "handle (ns)");
+
+  for (int s = 0; s < count; ++s)
+  {
+    const int size = sizes [s];
+    const int reps = total / size;
+    int64_t sum [2] = { 0, 0 };
+
+    kvr::value *map = ctx->create_value ()->as_map ();
+    for (int i = 0; i < size; ++i)
+    {
+      map->insert (handles [i], (int64_t) i);
+    }
+
+    clock_t t0 = clock ();
+    for (int r = 0; r < reps; ++r)
+    {
+      for (int i = 0; i < size; ++i)
+      {
+        sum [0] += map->find (keys [i])->get_integer ();
+      }
+    }
+
+    clock_t t1 = clock ();
+    for (int r = 0; r < reps; ++r)
+    {
+      for (int i = 0; i < size; ++i)
+      {
+        sum [1] += map->find (handles [i])->get_integer ();
+      }
+    }
+
+    clock_t t2 = clock ();
+    size_t ops = (size_t) reps * (size_t) size;
+    printf ("%6d %14.1f %14.1f\n", size, elapsed_ns (t0, t1, ops), elapsed_ns (t1, t2, ops));
+
+    errors += (sum [0] != sum [1]);
+    ctx->destroy_value (map);
+  }
+
+  for (int i = 0; i < KEY_COUNT; ++i)
+  {
+    ctx->release (handles [i]);
+  }
+
+  errors += (ctx->get_key_count () != 0);
+
+  kvr::ctx::destroy (ctx);
+
+  return (errors == 0) ? 0 : 1;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,97 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Copyright (c) 2015 Ubaka Onyechi
+ *
+ * kvr is free software distributed under the MIT license.
+ * See https://raw.githubusercontent.com/uonyx/kvr/master/LICENSE file for details.
+ */
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "common.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+// ctx key store probe cost under key churn.
+// each round inserts a fresh batch of keys and removes the previous one,
+// then times lookups of live keys (hits) and of removed keys (misses).
+// with real deletion, probe lengths (and so lookup cost) stay flat across rounds.
+
+static const int KEY_COUNT = 4096;
+static const int ROUNDS = 8;
+
+static char keys [2][KEY_COUNT][24];
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+int main () //int argc, char* argv [])
+{
+  const int lookups = 16;
+  int errors = 0;
+
+  kvr::ctx *ctx = kvr::ctx::create ();
+  kvr::value *map = ctx->create_value ()->as_map ();
+
+  printf ("%6s %8s %12s %12s\n", "round", "keys", "hit (ns)", "miss (ns)");
+
+  for (int r = 0; r < ROUNDS; ++r)
+  {
+    char (*curr) [24] = keys [r & 1];
+    char (*prev) [24] = keys [(r + 1) & 1];
+
+    for (int i = 0; i < KEY_COUNT; ++i)
+    {
+      sprintf (curr [i], "round%d/key%d", r, i);
+      map->insert (curr [i], (int64_t) i);
+    }
+
+    if (r > 0)
+    {
+      for (int i = 0; i < KEY_COUNT; ++i)
+      {
+        map->remove (prev [i]);
+      }
+    }
+
+    clock_t t0 = clock ();
+    for (int l = 0; l < lookups; ++l)
+    {
+      for (int i = 0; i < KEY_COUNT; ++i)
+      {
+        errors += (map->find (curr [i]) == NULL);
+      }
+    }
+
+    clock_t t1 = clock ();
+    for (int l = 0; l < lookups; ++l)
+    {
+      for (int i = 0; (r > 0) && (i < KEY_COUNT); ++i)
+      {
+        errors += (map->find (prev [i]) != NULL);
+      }
+    }
+
+    clock_t t2 = clock ();
+    size_t ops = (size_t) lookups * KEY_COUNT;
+    printf ("%6d %8zu %12.1f %12.1f\n", r, ctx->get_key_count (), elapsed_ns (t0, t1, ops), elapsed_ns (t1, t2, ops));
+  }
+
+  ctx->destroy_value (map);
+
+  kvr::ctx::destroy (ctx);
+
+  return (errors == 0) ? 0 : 1;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
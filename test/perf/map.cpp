@@ -0,0 +1,95 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Copyright (c) 2015 Ubaka Onyechi
+ *
+ * kvr is free software distributed under the MIT license.
+ * See https://raw.githubusercontent.com/uonyx/kvr/master/LICENSE file for details.
+ */
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "common.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+// map insert/find cost per operation against map size.
+// with the hashed index, cost should stay flat as size grows.
+
+static char keys [4096][16];
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+int main () //int argc, char* argv [])
+{
+  const int sizes [] = { 8, 16, 64, 256, 1024, 4096 };
+  const int total = 1 << 16; // keys touched per size
+  const int count = sizeof (sizes) / sizeof (sizes [0]);
+
+  kvr::ctx *ctx = kvr::ctx::create ();
+
+  for (int i = 0; i < sizes [count - 1]; ++i)
+  {
+    sprintf (keys [i], "key%d", i);
+  }
+
+  printf ("%8s %14s %14s\n", "size", "insert (ns)", "find (ns)");
+
+  for (int s = 0; s < count; ++s)
+  {
+    const int size = sizes [s];
+    const int reps = (total / size) > 0 ? (total / size) : 1;
+    int64_t sum = 0;
+
+    clock_t t0 = clock ();
+    kvr::value **maps = new kvr::value * [reps];
+    for (int r = 0; r < reps; ++r)
+    {
+      maps [r] = ctx->create_value ()->as_map ();
+      for (int i = 0; i < size; ++i)
+      {
+        maps [r]->insert (keys [i], (int64_t) i);
+      }
+    }
+
+    clock_t t1 = clock ();
+    for (int r = 0; r < reps; ++r)
+    {
+      for (int i = 0; i < size; ++i)
+      {
+        sum += maps [r]->find (keys [i])->get_integer ();
+      }
+    }
+
+    clock_t t2 = clock ();
+    for (int r = 0; r < reps; ++r)
+    {
+      ctx->destroy_value (maps [r]);
+    }
+    delete [] maps;
+
+    size_t ops = (size_t) reps * (size_t) size;
+    printf ("%8d %14.1f %14.1f\n", size, elapsed_ns (t0, t1, ops), elapsed_ns (t1, t2, ops));
+
+    if (sum != ((int64_t) reps * ((int64_t) size * (size - 1) / 2)))
+    {
+      return 1;
+    }
+  }
+
+  kvr::ctx::destroy (ctx);
+
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
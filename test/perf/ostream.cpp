@@ -0,0 +1,144 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Copyright (c) 2015 Ubaka Onyechi
+ *
+ * kvr is free software distributed under the MIT license.
+ * See https://raw.githubusercontent.com/uonyx/kvr/master/LICENSE file for details.
+ */
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "common.h"
+#include "../../example/streams.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+// encode throughput (MB of output per second) of each codec into an obuffer sized by
+// encode_bound, and into the custom streams of example/streams.h: a buffered file stream
+// and (built with openssl) a sha1 hash stream. input is an event log of small records
+// (integers, floats, booleans and strings). best of a few rounds.
+
+static const int EVENT_COUNT = 50000;
+static const size_t MIN_BYTES = 32u << 20; // encoded per round
+static const int ROUND_COUNT = 5; // best of
+static const char *FILENAME = "perf_test_ostream.out";
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int measure (const char *name, kvr::codec_t codec, kvr::value *doc)
+{
+  const char *modes [3] = { "memory", "file", "sha1" };
+  int errors = 0;
+
+  const size_t bound = doc->encode_bound (codec);
+  kvr::obuffer ref (bound);
+  errors += !doc->encode (codec, &ref);
+  const size_t size = ref.get_size ();
+  const int reps = (int) ((MIN_BYTES / size) + 1);
+
+  for (int m = 0; m < 3; ++m)
+  {
+#ifndef KVR_EXAMPLE_HAVE_OPENSSL
+    if (m == 2)
+    {
+      break;
+    }
+#endif
+    double best = 0.0;
+
+    for (int round = 0; round < ROUND_COUNT; ++round)
+    {
+      clock_t t0 = clock ();
+
+      for (int r = 0; r < reps; ++r)
+      {
+        switch (m)
+        {
+          case 0:
+          {
+            kvr::obuffer obuf (bound);
+            errors += !doc->encode (codec, &obuf);
+            break;
+          }
+
+          case 1:
+          {
+            buffered_file_ostream<BUFSIZ> os (FILENAME);
+            errors += !doc->encode (codec, &os);
+            break;
+          }
+
+          default:
+          {
+#ifdef KVR_EXAMPLE_HAVE_OPENSSL
+            sha1_ostream os;
+            errors += !doc->encode (codec, &os);
+            errors += (os.length () != 40);
+#endif
+            break;
+          }
+        }
+      }
+
+      clock_t t1 = clock ();
+
+      double mbs = mb_per_sec (t0, t1, size * reps);
+      best = (mbs > best) ? mbs : best;
+    }
+
+    printf ("%8s %10zu %8s %12.1f\n", name, size, modes [m], best);
+  }
+
+  // the file holds the last encoding
+  FILE *fp = fopen (FILENAME, "rb");
+  if (fp)
+  {
+    fseek (fp, 0, SEEK_END);
+    errors += ((size_t) ftell (fp) != size);
+    fclose (fp);
+  }
+  else
+  {
+    ++errors;
+  }
+
+  return errors;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+int main () //int argc, char* argv [])
+{
+  int errors = 0;
+
+  printf ("%8s %10s %8s %12s\n", "codec", "bytes", "output", "MB/s");
+
+  kvr::ctx *ctx = kvr::ctx::create ();
+
+  kvr::value *log = ctx->create_value ()->as_map ();
+  make_log (log, EVENT_COUNT);
+  errors += measure ("msgpack", kvr::CODEC_MSGPACK, log);
+  errors += measure ("cbor", kvr::CODEC_CBOR, log);
+  errors += measure ("json", kvr::CODEC_JSON, log);
+  ctx->destroy_value (log);
+
+  kvr::ctx::destroy (ctx);
+  remove (FILENAME);
+
+  return (errors == 0) ? 0 : 1;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,98 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Copyright (c) 2015 Ubaka Onyechi
+ *
+ * kvr is free software distributed under the MIT license.
+ * See https://raw.githubusercontent.com/uonyx/kvr/master/LICENSE file for details.
+ */
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "common.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+// allocation heavy workloads (msgpack decode, deep copy, teardown) on the
+// default allocator against kvr::pool_allocator. the pool is reused across
+// reps, as a long-lived per-thread pool would be.
+
+static const int RECORD_COUNT = 20000;
+static const int REPS = 8;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+int main () //int argc, char* argv [])
+{
+  const char *names [2] = { "default", "pool" };
+  int errors = 0;
+
+  kvr::ctx *src = kvr::ctx::create ();
+  kvr::value *doc = src->create_value ();
+  make_records (doc, RECORD_COUNT);
+
+  kvr::obuffer obuf (doc->encode_bound (kvr::CODEC_MSGPACK));
+  if (!doc->encode (kvr::CODEC_MSGPACK, &obuf))
+  {
+    return 1;
+  }
+
+  kvr::pool_allocator pool;
+
+  printf ("msgpack document: %zu bytes, %d records\n", obuf.get_size (), RECORD_COUNT);
+  printf ("%8s %12s %12s %12s\n", "alloc", "decode (ms)", "copy (ms)", "free (ms)");
+
+  for (int m = 0; m < 2; ++m)
+  {
+    clock_t decode = 0, copy = 0, teardown = 0;
+
+    for (int r = 0; r < REPS; ++r)
+    {
+      clock_t t0 = clock ();
+
+      kvr::ctx *ctx = kvr::ctx::create ((m == 0) ? NULL : &pool);
+      kvr::value *val = ctx->create_value ();
+      errors += !val->decode (kvr::CODEC_MSGPACK, obuf.get_data (), obuf.get_size ());
+
+      clock_t t1 = clock ();
+
+      kvr::value *cpy = ctx->create_value ()->copy (val);
+
+      clock_t t2 = clock ();
+
+      errors += (cpy->find ("records")->length () != (kvr::sz_t) RECORD_COUNT);
+
+      clock_t t3 = clock ();
+
+      kvr::ctx::destroy (ctx);
+
+      clock_t t4 = clock ();
+
+      decode += (t1 - t0);
+      copy += (t2 - t1);
+      teardown += (t4 - t3);
+    }
+
+    printf ("%8s %12.2f %12.2f %12.2f\n", names [m], elapsed_ms (0, decode, REPS),
+            elapsed_ms (0, copy, REPS), elapsed_ms (0, teardown, REPS));
+  }
+
+  printf ("pool reserved: %zu bytes\n", pool.get_memory_reserved ());
+
+  src->destroy_value (doc);
+  kvr::ctx::destroy (src);
+
+  return (errors == 0) ? 0 : 1;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,143 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Copyright (c) 2015 Ubaka Onyechi
+ *
+ * kvr is free software distributed under the MIT license.
+ * See https://raw.githubusercontent.com/uonyx/kvr/master/LICENSE file for details.
+ */
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "common.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+// queue-like use of an array: draining a work list from the front one item at a time
+// (pop (0)) against in batches (erase_range) and in any order (swap_remove), and
+// building a list front-first with push + rebuild against insert_at.
+
+static const int ITEM_COUNT = 20000;
+static const int BATCH = 64;
+static const int FRONT_COUNT = 2000;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+static kvr::value * make_items (kvr::ctx *ctx)
+{
+  kvr::value *arr = ctx->create_value ()->as_array ();
+  arr->reserve (ITEM_COUNT);
+  for (int i = 0; i < ITEM_COUNT; ++i)
+  {
+    kvr::value *item = arr->push_map ();
+    item->insert ("id", (int64_t) i);
+    item->insert ("task", "a task name too long to be inline");
+  }
+  return arr;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+int main () //int argc, char* argv [])
+{
+  int errors = 0;
+  int64_t sum [3] = { 0, 0, 0 };
+  kvr::ctx *ctx = kvr::ctx::create ();
+
+  printf ("drain %d items\n", ITEM_COUNT);
+  printf ("%14s %12s\n", "op", "time (ms)");
+
+  // pop (0)
+  kvr::value *arr = make_items (ctx);
+  clock_t t0 = clock ();
+  while (arr->length () > 0)
+  {
+    sum [0] += arr->element (0)->find ("id")->get_integer ();
+    arr->pop (0);
+  }
+  clock_t t1 = clock ();
+  printf ("%14s %12.2f\n", "pop (0)", elapsed_ms (t0, t1));
+  ctx->destroy_value (arr);
+
+  // erase_range, a batch at a time
+  arr = make_items (ctx);
+  t0 = clock ();
+  while (arr->length () > 0)
+  {
+    kvr::sz_t n = (arr->length () < BATCH) ? arr->length () : BATCH;
+    for (kvr::sz_t i = 0; i < n; ++i)
+    {
+      sum [1] += arr->element (i)->find ("id")->get_integer ();
+    }
+    arr->erase_range (0, n);
+  }
+  t1 = clock ();
+  printf ("%14s %12.2f\n", "erase_range", elapsed_ms (t0, t1));
+  ctx->destroy_value (arr);
+
+  // swap_remove (order not kept)
+  arr = make_items (ctx);
+  t0 = clock ();
+  while (arr->length () > 0)
+  {
+    sum [2] += arr->element (0)->find ("id")->get_integer ();
+    arr->swap_remove (0);
+  }
+  t1 = clock ();
+  printf ("%14s %12.2f\n", "swap_remove", elapsed_ms (t0, t1));
+  ctx->destroy_value (arr);
+
+  errors += (sum [0] != sum [1]) || (sum [0] != sum [2]);
+
+  printf ("\nprepend %d items\n", FRONT_COUNT);
+  printf ("%14s %12s\n", "op", "time (ms)");
+
+  // push + rebuild (copy the new item and the old list into a fresh array)
+  arr = ctx->create_value ()->as_array ();
+  t0 = clock ();
+  for (int i = 0; i < FRONT_COUNT; ++i)
+  {
+    kvr::value *next = ctx->create_value ()->as_array ();
+    next->push ((int64_t) i);
+    for (kvr::sz_t j = 0; j < arr->length (); ++j)
+    {
+      next->push (arr->element (j)->get_integer ());
+    }
+    ctx->destroy_value (arr);
+    arr = next;
+  }
+  t1 = clock ();
+  printf ("%14s %12.2f\n", "push+rebuild", elapsed_ms (t0, t1));
+  int64_t first = arr->element (0)->get_integer ();
+  ctx->destroy_value (arr);
+
+  // insert_at (0)
+  arr = ctx->create_value ()->as_array ();
+  t0 = clock ();
+  for (int i = 0; i < FRONT_COUNT; ++i)
+  {
+    arr->insert_at (0)->set_integer ((int64_t) i);
+  }
+  t1 = clock ();
+  printf ("%14s %12.2f\n", "insert_at", elapsed_ms (t0, t1));
+  errors += (arr->element (0)->get_integer () != first);
+  ctx->destroy_value (arr);
+
+  kvr::ctx::destroy (ctx);
+
+  return (errors == 0) ? 0 : 1;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,125 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Copyright (c) 2015 Ubaka Onyechi
+ *
+ * kvr is free software distributed under the MIT license.
+ * See https://raw.githubusercontent.com/uonyx/kvr/master/LICENSE file for details.
+ */
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "common.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+// build/teardown cost per record for arrays of records sharing field names,
+// well past 65,535 references per key, with string keys, interned and pinned handles.
+// every record must stay intact and every key must be freed exactly once.
+
+static const char *fields [] = { "id", "score" };
+static const int FIELD_COUNT = sizeof (fields) / sizeof (fields [0]);
+
+enum { MODE_STRING, MODE_INTERN, MODE_PIN, MODE_COUNT };
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int run (int mode, int count, double *build_ns, double *free_ns)
+{
+  int errors = 0;
+  kvr::ctx *ctx = kvr::ctx::create ();
+  kvr::key *handles [FIELD_COUNT];
+
+  for (int f = 0; f < FIELD_COUNT; ++f)
+  {
+    handles [f] = (mode == MODE_PIN) ? ctx->pin (fields [f]) : ctx->intern (fields [f]);
+  }
+
+  clock_t t0 = clock ();
+  kvr::value *recs = ctx->create_value ()->as_array ();
+  for (int i = 0; i < count; ++i)
+  {
+    kvr::value *r = recs->push_map ();
+    for (int f = 0; f < FIELD_COUNT; ++f)
+    {
+      if (mode == MODE_STRING)
+      {
+        r->insert (fields [f], (int64_t) i);
+      }
+      else
+      {
+        r->insert (handles [f], (int64_t) i);
+      }
+    }
+  }
+
+  clock_t t1 = clock ();
+  errors += (ctx->get_key_count () != (size_t) FIELD_COUNT);
+
+  // keep the first record: a wrapped reference count would have freed its keys
+  for (int i = 1; i < count; ++i)
+  {
+    recs->pop ();
+  }
+
+  clock_t t2 = clock ();
+  kvr::value *first = recs->element (0);
+  for (int f = 0; f < FIELD_COUNT; ++f)
+  {
+    kvr::value *v = first->find (fields [f]);
+    errors += ((v == NULL) || (v->get_integer () != 0));
+  }
+
+  ctx->destroy_value (recs);
+  for (int f = 0; f < FIELD_COUNT; ++f)
+  {
+    ctx->release (handles [f]);
+  }
+
+  errors += (ctx->get_key_count () != ((mode == MODE_PIN) ? (size_t) FIELD_COUNT : 0));
+
+  kvr::ctx::destroy (ctx);
+
+  *build_ns = elapsed_ns (t0, t1, (size_t) count);
+  *free_ns = elapsed_ns (t1, t2, (size_t) count);
+
+  return errors;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+int main () //int argc, char* argv [])
+{
+  const int counts [] = { 1 << 16, 1 << 18, 1 << 20, 1 << 21 };
+  const int count = sizeof (counts) / sizeof (counts [0]);
+  const char *names [MODE_COUNT] = { "string", "intern", "pin" };
+  int errors = 0;
+
+  printf ("%8s %8s %12s %12s\n", "records", "keys", "build (ns)", "free (ns)");
+
+  for (int c = 0; c < count; ++c)
+  {
+    for (int m = 0; m < MODE_COUNT; ++m)
+    {
+      double build_ns = 0.0, free_ns = 0.0;
+      errors += run (m, counts [c], &build_ns, &free_ns);
+      printf ("%8d %8s %12.1f %12.1f\n", counts [c], names [m], build_ns, free_ns);
+    }
+  }
+
+  return (errors == 0) ? 0 : 1;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,125 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Copyright (c) 2015 Ubaka Onyechi
+ *
+ * kvr is free software distributed under the MIT license.
+ * See https://raw.githubusercontent.com/uonyx/kvr/master/LICENSE file for details.
+ */
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "common.h"
+#include "../../example/allocators.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+// cost of taking a snapshot of a config tree and then changing one setting in it, with
+// the snapshot in the same ctx (copy-on-write) and in another ctx (deep copy). also the
+// memory each snapshot adds and the cost of diffing it against the original.
+
+static const int SECTION_COUNT = 100;
+static const int SETTING_COUNT = 100;
+static const int REPS = 20;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void make_config (kvr::value *doc)
+{
+  char key [32];
+  for (int s = 0; s < SECTION_COUNT; ++s)
+  {
+    sprintf (key, "section-%d", s);
+    kvr::value *sec = doc->insert_map (key);
+    for (int i = 0; i < SETTING_COUNT; ++i)
+    {
+      sprintf (key, "setting-%d", i);
+      switch (i % 4)
+      {
+        case 0:   { sec->insert (key, (int64_t) i); break; }
+        case 1:   { sec->insert (key, i * 0.5); break; }
+        case 2:   { sec->insert (key, "a setting value too long to be inline"); break; }
+        default:  { kvr::value *a = sec->insert_array (key); a->push (i); a->push ("v"); break; }
+      }
+    }
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+int main () //int argc, char* argv [])
+{
+  const char *modes [2] = { "shared", "deep" };
+  int errors = 0;
+
+  memtrack_allocator mem0, mem1;
+  kvr::ctx *ctx = kvr::ctx::create (&mem0);
+  kvr::ctx *other = kvr::ctx::create (&mem1);
+  memtrack_allocator *mems [2] = { &mem0, &mem1 };
+  kvr::ctx *ctxs [2] = { ctx, other };
+
+  kvr::value *doc = ctx->create_value ()->as_map ();
+  make_config (doc);
+  const uint32_t expected = doc->hash ();
+
+  printf ("%d sections of %d settings\n", SECTION_COUNT, SETTING_COUNT);
+  printf ("%8s %12s %12s %12s %14s\n", "snapshot", "copy (us)", "write (us)", "diff (us)", "memory (B)");
+
+  for (int m = 0; m < 2; ++m)
+  {
+    clock_t copy = 0, write = 0, diff = 0;
+    int64_t usage = 0;
+
+    for (int r = 0; r < REPS; ++r)
+    {
+      int64_t base = mems [m]->get_memory_usage ();
+
+      clock_t t0 = clock ();
+
+      kvr::value *snap = ctxs [m]->create_value ()->snapshot (doc);
+
+      clock_t t1 = clock ();
+
+      snap->find ("section-42")->insert ("setting-0", (int64_t) r);
+
+      clock_t t2 = clock ();
+
+      kvr::value *d = ctxs [m]->create_value ()->diff (doc, snap);
+
+      clock_t t3 = clock ();
+
+      usage = mems [m]->get_memory_usage () - base;
+      snap->find ("section-42")->insert ("setting-0", (int64_t) 0);
+      errors += (snap->hash () != expected);
+      ctxs [m]->destroy_value (d);
+      ctxs [m]->destroy_value (snap);
+
+      copy += (t1 - t0);
+      write += (t2 - t1);
+      diff += (t3 - t2);
+    }
+
+    printf ("%8s %12.1f %12.1f %12.1f %14lld\n", modes [m], elapsed_us (0, copy, REPS),
+            elapsed_us (0, write, REPS), elapsed_us (0, diff, REPS), (long long) usage);
+  }
+
+  ctx->destroy_value (doc);
+  kvr::ctx::destroy (other);
+  kvr::ctx::destroy (ctx);
+
+  return (errors == 0) ? 0 : 1;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
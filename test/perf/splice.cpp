@@ -0,0 +1,112 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Copyright (c) 2015 Ubaka Onyechi
+ *
+ * kvr is free software distributed under the MIT license.
+ * See https://raw.githubusercontent.com/uonyx/kvr/master/LICENSE file for details.
+ */
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "common.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+// cost per moved subtree of gathering the "records" member of many decoded documents
+// into one aggregate array, by copy then destroy versus take/splice, for growing
+// subtree sizes.
+
+static const int DOC_COUNT = 1000;
+static const int REPS = 4;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+int main () //int argc, char* argv [])
+{
+  const int sizes [3] = { 10, 50, 250 };
+  int errors = 0;
+
+  kvr::ctx *ctx = kvr::ctx::create ();
+
+  printf ("%8s %12s %12s\n", "records", "copy (ns)", "splice (ns)");
+
+  for (int s = 0; s < 3; ++s)
+  {
+    kvr::value *tmpl = ctx->create_value ()->as_map ();
+    tmpl->insert ("page", (int64_t) 1);
+    make_records (tmpl, sizes [s]);
+    kvr::obuffer obuf (tmpl->encode_bound (kvr::CODEC_MSGPACK));
+    if (!tmpl->encode (kvr::CODEC_MSGPACK, &obuf))
+    {
+      return 1;
+    }
+    const uint32_t expected = tmpl->find ("records")->hash ();
+
+    clock_t copy = 0, splice = 0;
+
+    for (int r = 0; r < REPS; ++r)
+    {
+      for (int m = 0; m < 2; ++m)
+      {
+        kvr::value *docs [DOC_COUNT];
+        for (int d = 0; d < DOC_COUNT; ++d)
+        {
+          docs [d] = ctx->create_value ();
+          errors += !docs [d]->decode (kvr::CODEC_MSGPACK, obuf.get_data (), obuf.get_size ());
+        }
+
+        kvr::value *agg = ctx->create_value ()->as_array (DOC_COUNT);
+
+        clock_t t0 = clock ();
+
+        for (int d = 0; d < DOC_COUNT; ++d)
+        {
+          if (m == 0)
+          {
+            agg->push_null ()->copy (docs [d]->find ("records"));
+            docs [d]->remove ("records");
+          }
+          else
+          {
+            agg->splice (docs [d]->take ("records"));
+          }
+        }
+
+        clock_t t1 = clock ();
+
+        errors += (agg->element (DOC_COUNT - 1)->hash () != expected);
+        errors += (docs [0]->size () != 1);
+
+        for (int d = 0; d < DOC_COUNT; ++d)
+        {
+          ctx->destroy_value (docs [d]);
+        }
+        ctx->destroy_value (agg);
+
+        if (m == 0) { copy += (t1 - t0); } else { splice += (t1 - t0); }
+      }
+    }
+
+    const size_t ops = (size_t) DOC_COUNT * REPS;
+    printf ("%8d %12.1f %12.1f\n", sizes [s], elapsed_ns (0, copy, ops), elapsed_ns (0, splice, ops));
+
+    ctx->destroy_value (tmpl);
+  }
+
+  kvr::ctx::destroy (ctx);
+
+  return (errors == 0) ? 0 : 1;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,174 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Copyright (c) 2015 Ubaka Onyechi
+ *
+ * kvr is free software distributed under the MIT license.
+ * See https://raw.githubusercontent.com/uonyx/kvr/master/LICENSE file for details.
+ */
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "common.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+// decode throughput (MB of input per second) of each codec from a memory buffer, and from
+// custom istreams over the same bytes: one that reads in bulk (read_some, as a file or socket
+// stream would) and one with only the per-byte interface. input is an event log of small
+// records (integers, floats, booleans and strings up to about 120 bytes). best of a few rounds.
+
+static const int EVENT_COUNT = 100000;
+static const size_t MIN_BYTES = 16u << 20; // decoded per round
+static const int ROUND_COUNT = 5; // best of
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+// memory backed custom istream, optionally with bulk reads
+class source_istream : public kvr::istream
+{
+public:
+
+  source_istream (const uint8_t *buf, size_t sz, bool bulk) : m_buf (buf), m_sz (sz), m_pos (0), m_bulk (bulk) {}
+
+  bool get (uint8_t *byte)
+  {
+    if (m_pos < m_sz)
+    {
+      *byte = m_buf [m_pos++];
+      return true;
+    }
+    return false;
+  }
+
+  bool read (uint8_t *bytes, size_t count)
+  {
+    if (count > (m_sz - m_pos))
+    {
+      return false;
+    }
+    memcpy (bytes, m_buf + m_pos, count);
+    m_pos += count;
+    return true;
+  }
+
+  size_t tell () { return m_pos; }
+  uint8_t peek () { return (m_pos < m_sz) ? m_buf [m_pos] : 0u; }
+
+  size_t read_some (uint8_t *bytes, size_t count)
+  {
+    if (!m_bulk)
+    {
+      return kvr::istream::read_some (bytes, count);
+    }
+    size_t n = ((m_sz - m_pos) < count) ? (m_sz - m_pos) : count;
+    memcpy (bytes, m_buf + m_pos, n);
+    m_pos += n;
+    return n;
+  }
+
+  bool unread (size_t count)
+  {
+    if (!m_bulk || (count > m_pos))
+    {
+      return kvr::istream::unread (count);
+    }
+    m_pos -= count;
+    return true;
+  }
+
+private:
+
+  const uint8_t * m_buf;
+  size_t          m_sz;
+  size_t          m_pos;
+  bool            m_bulk;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int measure (const char *name, kvr::codec_t codec, kvr::ctx *ctx, kvr::value *doc)
+{
+  const char *modes [3] = { "memory", "bulk", "bytes" };
+  int errors = 0;
+
+  kvr::obuffer obuf (doc->encode_bound (codec));
+  errors += !doc->encode (codec, &obuf);
+  const uint8_t *data = obuf.get_data ();
+  const size_t size = obuf.get_size ();
+  const int reps = (int) ((MIN_BYTES / size) + 1);
+  const uint32_t hash = doc->hash ();
+
+  for (int m = 0; m < 3; ++m)
+  {
+    double best = 0.0;
+
+    for (int round = 0; round < ROUND_COUNT; ++round)
+    {
+      clock_t t0 = clock ();
+
+      for (int r = 0; r < reps; ++r)
+      {
+        kvr::value *dec = ctx->create_value ();
+        if (m == 0)
+        {
+          errors += !dec->decode (codec, data, size);
+        }
+        else
+        {
+          source_istream is (data, size, (m == 1));
+          errors += !dec->decode (codec, is);
+        }
+        errors += (r == 0) && (dec->hash () != hash);
+        ctx->destroy_value (dec);
+      }
+
+      clock_t t1 = clock ();
+
+      double mbs = mb_per_sec (t0, t1, size * reps);
+      best = (mbs > best) ? mbs : best;
+    }
+
+    printf ("%8s %10zu %8s %12.1f\n", name, size, modes [m], best);
+  }
+
+  return errors;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+int main () //int argc, char* argv [])
+{
+  int errors = 0;
+
+  printf ("%8s %10s %8s %12s\n", "codec", "bytes", "input", "MB/s");
+
+  kvr::ctx *ctx = kvr::ctx::create ();
+
+  kvr::value *log = ctx->create_value ()->as_map ();
+  make_log (log, EVENT_COUNT);
+  errors += measure ("msgpack", kvr::CODEC_MSGPACK, ctx, log);
+  errors += measure ("cbor", kvr::CODEC_CBOR, ctx, log);
+  errors += measure ("json", kvr::CODEC_JSON, ctx, log);
+  ctx->destroy_value (log);
+
+  kvr::ctx::destroy (ctx);
+
+  return (errors == 0) ? 0 : 1;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
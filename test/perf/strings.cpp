@@ -0,0 +1,131 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Copyright (c) 2015 Ubaka Onyechi
+ *
+ * kvr is free software distributed under the MIT license.
+ * See https://raw.githubusercontent.com/uonyx/kvr/master/LICENSE file for details.
+ */
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "common.h"
+#include "../../example/allocators.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+// memory use and json decode cost with and without ctx::intern_strings, for a
+// card set shaped like example/data/ARN-x.json and for a large event log whose
+// status, host and region strings repeat.
+
+static const int CARD_COUNT = 20000;
+static const int EVENT_COUNT = 200000;
+static const int REPS = 4;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void make_cards (kvr::value *doc)
+{
+  const char *types [] = { "Creature — Human", "Creature — Human Rogue", "Enchantment", "Instant", "Land" };
+  const char *rarities [] = { "Uncommon", "Common", "Rare", "Special" };
+  const char *artists [] = { "Ken Meyer, Jr.", "Julie Baroh", "Mark Poole", "Douglas Shuler", "Christopher Rush" };
+  char str [64];
+
+  doc->insert ("name", "Arabian Nights");
+  kvr::value *cards = doc->insert_array ("cards");
+  for (int i = 0; i < CARD_COUNT; ++i)
+  {
+    kvr::value *c = cards->push_map ();
+    c->insert ("layout", "normal");
+    c->insert ("type", types [i % 5]);
+    c->insert ("multiverseid", (int64_t) i);
+    sprintf (str, "Card name number %d", i);
+    c->insert ("name", str);
+    c->insert ("rarity", rarities [i % 4]);
+    c->insert ("artist", artists [i % 5]);
+    sprintf (str, "When this card %d dies, destroy all creatures blocking it.", i);
+    c->insert ("text", str);
+    kvr::value *legal = c->insert_map ("legalities");
+    legal->insert ("Legacy", "Legal");
+    legal->insert ("Vintage", "Legal");
+    legal->insert ("Commander", "Legal");
+    kvr::value *printings = c->insert_array ("printings");
+    printings->push ("Arabian Nights");
+    printings->push ("Chronicles");
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+int main () //int argc, char* argv [])
+{
+  const char *docs [2] = { "cards", "log" };
+  const char *modes [2] = { "copied", "interned" };
+  int errors = 0;
+
+  printf ("%6s %9s %14s %12s %12s\n", "doc", "strings", "memory (B)", "strings (#)", "decode (ms)");
+
+  for (int d = 0; d < 2; ++d)
+  {
+    kvr::ctx *src = kvr::ctx::create ();
+    kvr::value *doc = src->create_value ();
+    if (d == 0) { make_cards (doc); } else { make_log (doc, EVENT_COUNT); }
+
+    kvr::obuffer obuf (doc->encode_bound (kvr::CODEC_JSON));
+    if (!doc->encode (kvr::CODEC_JSON, &obuf))
+    {
+      return 1;
+    }
+
+    for (int m = 0; m < 2; ++m)
+    {
+      int64_t usage = 0;
+      size_t count = 0;
+      clock_t decode = 0;
+
+      for (int r = 0; r < REPS; ++r)
+      {
+        memtrack_allocator mem;
+        kvr::ctx *ctx = kvr::ctx::create (&mem);
+        ctx->intern_strings (m == 1);
+        int64_t base = mem.get_memory_usage ();
+
+        clock_t t0 = clock ();
+
+        kvr::value *val = ctx->create_value ();
+        errors += !val->decode (kvr::CODEC_JSON, obuf.get_data (), obuf.get_size ());
+
+        clock_t t1 = clock ();
+
+        errors += (val->hash () != doc->hash ());
+        usage = mem.get_memory_usage () - base;
+        count = ctx->get_string_count ();
+        kvr::ctx::destroy (ctx);
+
+        decode += (t1 - t0);
+      }
+
+      printf ("%6s %9s %14lld %12zu %12.2f\n", docs [d], modes [m], (long long) usage, count,
+              elapsed_ms (0, decode, REPS));
+    }
+
+    src->destroy_value (doc);
+    kvr::ctx::destroy (src);
+  }
+
+  return (errors == 0) ? 0 : 1;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,139 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Copyright (c) 2015 Ubaka Onyechi
+ *
+ * kvr is free software distributed under the MIT license.
+ * See https://raw.githubusercontent.com/uonyx/kvr/master/LICENSE file for details.
+ */
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "common.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+// decode, bulk read (get_n) and encode cost per element of 1M element
+// integer and float arrays, decoded as packed arrays (DECODE_PACK_ARRAYS), for each codec.
+
+static const int ELEMENT_COUNT = 1 << 20;
+static const int REPS = 4;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+static double sum (const kvr::value *arr, int64_t *ibuf, double *fbuf)
+{
+  double s = 0.0;
+  kvr::sz_t len = arr->length ();
+
+  if (arr->get_n (ibuf, len) == len)
+  {
+    for (kvr::sz_t i = 0; i < len; ++i) { s += (double) ibuf [i]; }
+  }
+  else if (arr->get_n (fbuf, len) == len)
+  {
+    for (kvr::sz_t i = 0; i < len; ++i) { s += fbuf [i]; }
+  }
+
+  return s;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+int main () //int argc, char* argv [])
+{
+  const kvr::codec_t codecs [3] = { kvr::CODEC_JSON, kvr::CODEC_MSGPACK, kvr::CODEC_CBOR };
+  const char *names [3] = { "json", "msgpack", "cbor" };
+  const char *types [2] = { "integer", "float" };
+  int errors = 0;
+
+  int64_t *ibuf = new int64_t [ELEMENT_COUNT];
+  double *fbuf = new double [ELEMENT_COUNT];
+
+  kvr::ctx *ctx = kvr::ctx::create ();
+  kvr::value *src [2];
+
+  for (int i = 0; i < ELEMENT_COUNT; ++i)
+  {
+    ibuf [i] = (int64_t) i * 1237;
+    fbuf [i] = i * 0.25;
+  }
+
+  src [0] = ctx->create_value ()->as_array ();
+  src [0]->push_n (ibuf, ELEMENT_COUNT);
+  src [1] = ctx->create_value ()->as_array ();
+  src [1]->push_n (fbuf, ELEMENT_COUNT);
+
+  printf ("%d elements\n", ELEMENT_COUNT);
+  printf ("%8s %8s %12s %12s %12s %12s\n", "codec", "type", "bytes", "decode (ns)", "read (ns)", "encode (ns)");
+
+  for (int c = 0; c < 3; ++c)
+  {
+    for (int t = 0; t < 2; ++t)
+    {
+      const double expected = sum (src [t], ibuf, fbuf);
+
+      kvr::obuffer obuf (src [t]->encode_bound (codecs [c]));
+      if (!src [t]->encode (codecs [c], &obuf))
+      {
+        return 1;
+      }
+
+      clock_t decode = 0, read = 0, encode = 0;
+
+      for (int r = 0; r < REPS; ++r)
+      {
+        kvr::obuffer out (src [t]->encode_bound (codecs [c]));
+
+        clock_t t0 = clock ();
+
+        kvr::value *arr = ctx->create_value ();
+        errors += !arr->decode (codecs [c], obuf.get_data (), obuf.get_size (), kvr::DECODE_PACK_ARRAYS);
+
+        clock_t t1 = clock ();
+
+        errors += (sum (arr, ibuf, fbuf) != expected);
+
+        clock_t t2 = clock ();
+
+        errors += !arr->encode (codecs [c], &out);
+
+        clock_t t3 = clock ();
+
+        errors += (out.get_size () != obuf.get_size ());
+        ctx->destroy_value (arr);
+
+        decode += (t1 - t0);
+        read += (t2 - t1);
+        encode += (t3 - t2);
+      }
+
+      const size_t ops = (size_t) ELEMENT_COUNT * REPS;
+      printf ("%8s %8s %12zu %12.1f %12.1f %12.1f\n", names [c], types [t], obuf.get_size (),
+              elapsed_ns (0, decode, ops), elapsed_ns (0, read, ops), elapsed_ns (0, encode, ops));
+    }
+  }
+
+  ctx->destroy_value (src [0]);
+  ctx->destroy_value (src [1]);
+  kvr::ctx::destroy (ctx);
+
+  delete [] ibuf;
+  delete [] fbuf;
+
+  return (errors == 0) ? 0 : 1;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
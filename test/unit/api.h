@@ -15,12 +15,32 @@
 
 #include <cxxtest/TestSuite.h>
 #include <stdlib.h>
+#include <math.h>
 #include "../src/kvr.h"
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
+class kvrTestAllocator : public kvr::allocator // tracks live bytes
+{
+public:
+  kvrTestAllocator () : m_live (0) {}
+  void * allocate (size_t sz)            { m_live += sz; return malloc (sz); }
+  void   deallocate (void *p, size_t sz) { m_live -= sz; free (p); }
+  void * reallocate (void *p, size_t old_sz, size_t new_sz)
+  {
+    void *np = realloc (p, new_sz);
+    if (np) { m_live = m_live - old_sz + new_sz; }
+    return np;
+  }
+  size_t m_live;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
 class kvrTestSuiteAPI : public CxxTest::TestSuite
 {
   kvr::ctx * m_ctx;
@@ -148,6 +168,20 @@ public:
     TS_ASSERT (val1->is_array ());
     TS_ASSERT_EQUALS (val0->hash (), val1->hash ());
 
+    ///////////////////////////////
+    // empty containers
+    ///////////////////////////////
+
+    val0->as_null ()->as_array ();
+    val1->copy (val0);
+    TS_ASSERT (val1->is_array ());
+    TS_ASSERT_EQUALS (val1->length (), 0);
+
+    val0->as_null ()->as_map ();
+    val1->copy (val0);
+    TS_ASSERT (val1->is_map ());
+    TS_ASSERT_EQUALS (val1->size (), 0);
+
     ///////////////////////////////
     // null
     ///////////////////////////////
@@ -352,7 +386,7 @@ public:
         scores->push (30.5);
         scores->push (50.0);
         scores->push (100);
-        scores->push (900000000LL);
+        scores->push ((int64_t) 900000000);
       }
       kvr::value *collection = map->insert_array ("collection");
       {
@@ -428,7 +462,7 @@ public:
 
     // inserts
     {
-      kvr::value *vi = map->insert ("int", 16LL);
+      kvr::value *vi = map->insert ("int", (int64_t) 16);
       kvr::value *vf = map->insert ("float", 3.14);
       kvr::value *vs = map->insert ("string", "hello world");
       kvr::value *vb = map->insert ("boolean", true);
@@ -511,6 +545,7 @@ public:
         sprintf (str, "%d", i);
 #endif
         val [i] = map->insert (str, i);
+        TS_ASSERT (val [i]);
         int r = std::rand () % 4;
         if (r == 1)
         {
@@ -519,10 +554,660 @@ public:
       }
     }
 
+    // explicit key length (key need not be null-terminated)
+    {
+      const char *keys = "alphabetagamma";
+      kvr::value *ka = map->insert (keys, 5, (int64_t) 1);
+      kvr::value *kb = map->insert_map (keys + 5, 4);
+      kvr::value *kc = map->insert (keys + 9, 5, "gamma");
+
+      TS_ASSERT_EQUALS (map->find ("alpha"), ka);
+      TS_ASSERT_EQUALS (map->find ("beta"), kb);
+      TS_ASSERT_EQUALS (map->find (keys + 9, 5), kc);
+      TS_ASSERT_EQUALS (map->find (keys, 4), null_val);
+      TS_ASSERT_EQUALS (map->insert (keys, 5, 2.0), ka);
+
+      map->remove (keys, 5);
+      map->remove ("beta", 4);
+      map->remove ("gamma");
+      TS_ASSERT_EQUALS (map->find ("alpha"), null_val);
+      TS_ASSERT_EQUALS (map->find ("beta"), null_val);
+      TS_ASSERT_EQUALS (map->find ("gamma"), null_val);
+    }
+
+    // large (hashed index)
+    {
+      char str [16];
+      kvr::value *large = m_ctx->create_value ()->as_map ();
+      for (int i = 0; i < 1024; ++i)
+      {
+        sprintf (str, "k%d", i);
+        large->insert (str, i);
+        if ((i % 3) == 0)
+        {
+          large->remove (str);
+        }
+      }
+
+      for (int i = 0; i < 1024; ++i)
+      {
+        sprintf (str, "k%d", i);
+        kvr::value *v = large->find (str);
+        if ((i % 3) == 0)
+        {
+          TS_ASSERT_EQUALS (v, null_val);
+        }
+        else
+        {
+          TS_ASSERT_DIFFERS (v, null_val);
+          TS_ASSERT_EQUALS (v->get_integer (), i);
+        }
+      }
+
+      // insertion order is preserved
+      int64_t prev = -1;
+      kvr::value::cursor cur (large);
+      kvr::pair p;
+      while (cur.get (&p))
+      {
+        int64_t n = p.get_value ()->get_integer ();
+        TS_ASSERT_LESS_THAN (prev, n);
+        prev = n;
+      }
+
+      TS_ASSERT_EQUALS (large->size (), 682);
+      m_ctx->destroy_value (large);
+    }
+
+    // churn (size tracking, compaction and shrinking)
+    {
+      char str [16];
+      bool live [512] = { false };
+      kvr::sz_t count = 0;
+      size_t keys = m_ctx->get_key_count ();
+      kvr::value *churn = m_ctx->create_value ()->as_map ();
+      for (int i = 0; i < 8192; ++i)
+      {
+        int r = std::rand () % 512;
+        sprintf (str, "c%d", r);
+        if (live [r] && ((std::rand () % 3) != 0))
+        {
+          churn->remove (str);
+          live [r] = false;
+          --count;
+        }
+        else if (!live [r])
+        {
+          churn->insert (str, r);
+          live [r] = true;
+          ++count;
+        }
+        TS_ASSERT_EQUALS (churn->size (), count);
+      }
+
+      for (int r = 0; r < 512; ++r)
+      {
+        sprintf (str, "c%d", r);
+        kvr::value *v = churn->find (str);
+        TS_ASSERT_EQUALS ((v != NULL), live [r]);
+        if (live [r])
+        {
+          TS_ASSERT_EQUALS (v->get_integer (), r);
+          churn->remove (str);
+        }
+      }
+
+      TS_ASSERT_EQUALS (churn->size (), 0);
+      TS_ASSERT_EQUALS (m_ctx->get_key_count (), keys);
+      m_ctx->destroy_value (churn);
+    }
+
+    // removal while iterating (current and later members; the cursor sees every live member once)
+    {
+      char str [16];
+      const int count = 300;
+      kvr::value *walk = m_ctx->create_value ()->as_map ();
+      for (int i = 0; i < count; ++i)
+      {
+        sprintf (str, "w%d", i);
+        walk->insert (str, i);
+      }
+
+      int seen [count] = { 0 };
+      kvr::value::cursor cur (walk);
+      kvr::pair p;
+      while (cur.get (&p))
+      {
+        int i = (int) p.get_value ()->get_integer ();
+        ++seen [i];
+        if ((i % 3) != 0)
+        {
+          walk->remove (p.get_key ()); // the current member
+        }
+        if ((i % 3) == 0)
+        {
+          sprintf (str, "w%d", i + 1);
+          walk->remove (str); // a later one, never seen
+        }
+      }
+
+      for (int i = 0; i < count; ++i)
+      {
+        sprintf (str, "w%d", i);
+        TS_ASSERT_EQUALS (seen [i], ((i % 3) == 1) ? 0 : 1);
+        TS_ASSERT_EQUALS ((walk->find (str) != NULL), ((i % 3) == 0));
+      }
+      TS_ASSERT_EQUALS (walk->size (), (kvr::sz_t) (count / 3));
+
+      // removed nodes are reclaimed on insert
+      walk->insert ("w", -1);
+      TS_ASSERT_EQUALS (walk->size (), (kvr::sz_t) ((count / 3) + 1));
+      for (int i = 0; i < count; i += 3)
+      {
+        sprintf (str, "w%d", i);
+        TS_ASSERT_EQUALS (walk->find (str)->get_integer (), i);
+      }
+      TS_ASSERT_EQUALS (walk->find ("w")->get_integer (), -1);
+      m_ctx->destroy_value (walk);
+    }
+
+    // clearing a map (or removing from its back) gives its memory back
+    {
+      char str [16];
+      const int count = 20000;
+      kvrTestAllocator alloc;
+      kvr::ctx *ctx = kvr::ctx::create (&alloc);
+      kvr::value *big = ctx->create_value ()->as_map ();
+      size_t empty = alloc.m_live;
+      for (int i = 0; i < count; ++i)
+      {
+        sprintf (str, "b%d", i);
+        big->insert (str, i);
+      }
+      size_t full = alloc.m_live;
+      for (int i = count - 1; i >= (count / 8); --i)
+      {
+        sprintf (str, "b%d", i);
+        big->remove (str);
+      }
+      TS_ASSERT_LESS_THAN (alloc.m_live, empty + ((full - empty) / 3));
+      for (int i = (count / 8) - 1; i >= 0; --i)
+      {
+        sprintf (str, "b%d", i);
+        big->remove (str);
+      }
+      big->insert ("b", 1);
+      TS_ASSERT_EQUALS (big->size (), 1);
+      TS_ASSERT_LESS_THAN (alloc.m_live, empty + 1024);
+      kvr::ctx::destroy (ctx);
+      TS_ASSERT_EQUALS (alloc.m_live, 0u);
+    }
+
+    // interned keys (handles)
+    {
+      size_t keys = m_ctx->get_key_count ();
+      kvr::key *kx = m_ctx->intern ("x");
+      kvr::key *ky = m_ctx->intern ("yy", 1);
+      TS_ASSERT_EQUALS (kx, m_ctx->intern ("x"));
+      m_ctx->release (kx);
+      TS_ASSERT (strcmp (ky->get_string (), "y") == 0);
+      TS_ASSERT_EQUALS (m_ctx->get_key_count (), keys + 2);
+
+      kvr::value *a = m_ctx->create_value ()->as_map ();
+      kvr::value *b = m_ctx->create_value ()->as_map ();
+      kvr::value *ax = a->insert (kx, (int64_t) 1);
+      kvr::value *bx = b->insert (kx, "one");
+      TS_ASSERT_EQUALS (a->insert (kx, 2.5), ax);
+      TS_ASSERT_EQUALS (ax->get_float (), 2.5);
+      TS_ASSERT_EQUALS (a->find (kx), ax);
+      TS_ASSERT_EQUALS (a->find ("x"), ax);
+      TS_ASSERT_EQUALS (b->find (kx), bx);
+      TS_ASSERT_EQUALS (a->find (ky), null_val);
+
+      kvr::value *ay = a->insert ("y", true);
+      TS_ASSERT_EQUALS (a->find (ky), ay);
+      TS_ASSERT_EQUALS (a->insert_null (ky), ay);
+      TS_ASSERT (ay->is_null ());
+      TS_ASSERT_EQUALS (a->size (), 2);
+
+      // pair keys are handles too
+      kvr::value::cursor cur (a);
+      kvr::pair p;
+      while (cur.get (&p))
+      {
+        kvr::value *bv = b->insert_map (p.get_key ());
+        TS_ASSERT_EQUALS (b->find (p.get_key ()), bv);
+      }
+      TS_ASSERT_EQUALS (b->size (), 2);
+      TS_ASSERT (bx->is_map ());
+
+      // released handles stay valid while maps reference them
+      m_ctx->release (kx);
+      m_ctx->release (ky);
+      TS_ASSERT_EQUALS (m_ctx->get_key_count (), keys + 2);
+
+      a->remove (kx);
+      b->remove ("x");
+      TS_ASSERT_EQUALS (a->find ("x"), null_val);
+      TS_ASSERT_EQUALS (m_ctx->get_key_count (), keys + 1);
+
+      m_ctx->destroy_value (a);
+      m_ctx->destroy_value (b);
+      TS_ASSERT_EQUALS (m_ctx->get_key_count (), keys);
+    }
+
+    // key handles belong to their ctx
+    {
+      kvr::ctx *other = kvr::ctx::create ();
+      size_t keys = m_ctx->get_key_count ();
+      kvr::key *kh = m_ctx->intern ("handle");
+      kvr::key *ko = other->intern ("handle");
+      TS_ASSERT_DIFFERS (kh, ko);
+
+      kvr::value *a = m_ctx->create_value ()->as_map ();
+      kvr::value *b = other->create_value ()->as_map ();
+      TS_ASSERT (a->insert (kh, 1));
+      TS_ASSERT (b->insert (ko, 2));
+      TS_ASSERT_EQUALS (a->find (ko), null_val);
+#if !KVR_DEBUG
+      // rejected by release (an assert in debug builds). inserts and splices only check
+      // in debug builds
+      other->release (kh);
+      TS_ASSERT_EQUALS (a->size (), 1);
+      TS_ASSERT_EQUALS (a->find (kh)->get_integer (), 1);
+#endif
+      m_ctx->destroy_value (a);
+      other->destroy_value (b);
+      m_ctx->release (kh);
+      other->release (ko);
+      TS_ASSERT_EQUALS (m_ctx->get_key_count (), keys);
+      TS_ASSERT_EQUALS (other->get_key_count (), 0);
+      kvr::ctx::destroy (other);
+    }
+
+    // shared keys (reference counts past 16 bits) and pinned keys
+    {
+      const int count = 70000;
+      size_t keys = m_ctx->get_key_count ();
+      kvr::key *kp = m_ctx->pin ("pinned");
+      TS_ASSERT (kp->is_pinned ());
+
+      kvr::value *recs = m_ctx->create_value ()->as_array ();
+      for (int i = 0; i < count; ++i)
+      {
+        kvr::value *r = recs->push_map ();
+        r->insert ("shared", i);
+        r->insert (kp, i);
+      }
+      TS_ASSERT_EQUALS (m_ctx->get_key_count (), keys + 2);
+
+      for (int i = 1; i < count; ++i)
+      {
+        recs->pop ();
+      }
+
+      kvr::value *r0 = recs->element (0);
+      TS_ASSERT_EQUALS (r0->find ("shared")->get_integer (), 0);
+      TS_ASSERT_EQUALS (r0->find ("pinned")->get_integer (), 0);
+      TS_ASSERT_EQUALS (m_ctx->get_key_count (), keys + 2);
+
+      // pinned keys outlive their last use and ignore release
+      m_ctx->destroy_value (recs);
+      m_ctx->release (kp);
+      TS_ASSERT_EQUALS (m_ctx->get_key_count (), keys + 1);
+      TS_ASSERT_EQUALS (m_ctx->intern ("pinned"), kp);
+      TS_ASSERT (kp->is_pinned ());
+    }
+
     m_ctx->destroy_value (map);
   }
 
 
+  ///////////////////////////////////////////////////////////////
+  ///////////////////////////////////////////////////////////////
+  ///////////////////////////////////////////////////////////////
+
+  void testRootValues ()
+  {
+    const int count = 1024;
+    kvr::value *vals [count];
+
+    size_t base = m_ctx->get_value_count ();
+
+    for (int i = 0; i < count; ++i)
+    {
+      vals [i] = m_ctx->create_value ()->as_map ();
+      vals [i]->insert ("id", i);
+    }
+    TS_ASSERT_EQUALS (m_ctx->get_value_count (), base + count);
+
+    // destroy every other value, out of creation order
+    for (int i = count - 2; i >= 0; i -= 2)
+    {
+      m_ctx->destroy_value (vals [i]);
+    }
+    TS_ASSERT_EQUALS (m_ctx->get_value_count (), base + (count / 2));
+
+    for (int i = 1; i < count; i += 2)
+    {
+      TS_ASSERT_EQUALS (vals [i]->find ("id")->get_integer (), i);
+    }
+
+    // left-over values are cleaned up by the ctx
+    for (int i = 1; i < count / 2; i += 2)
+    {
+      m_ctx->destroy_value (vals [i]);
+    }
+    TS_ASSERT_EQUALS (m_ctx->get_value_count (), base + (count / 4));
+  }
+
+  ///////////////////////////////////////////////////////////////
+  ///////////////////////////////////////////////////////////////
+  ///////////////////////////////////////////////////////////////
+
+  void testArena ()
+  {
+    // small blocks so values, keys and strings span several
+    kvr::ctx *ctx = kvr::ctx::create_arena (1024);
+    TS_ASSERT (ctx);
+
+    const char *json = "{\"name\":\"a string long enough not to fit inline\",\"list\":[1,2.5,true,null,{\"k\":\"v\"}]}";
+    char big [4096];
+    memset (big, 'x', sizeof (big) - 1);
+    big [sizeof (big) - 1] = 0;
+
+    for (int round = 0; round < 3; ++round)
+    {
+      kvr::value *doc = ctx->create_value ();
+      TS_ASSERT (doc->decode (kvr::CODEC_JSON, (const uint8_t *) json, strlen (json)));
+      TS_ASSERT_EQUALS (doc->find ("list")->element (4)->find ("k")->get_string ()[0], 'v');
+
+      kvr::value *map = ctx->create_value ()->as_map ();
+      for (int i = 0; i < 256; ++i)
+      {
+        char str [16];
+        sprintf (str, "key%d", i);
+        map->insert (str, i);
+      }
+      map->insert ("big", big); // larger than a block
+      TS_ASSERT_EQUALS (map->size (), 257);
+      TS_ASSERT_EQUALS (map->find ("key255")->get_integer (), 255);
+      TS_ASSERT_EQUALS (strlen (map->find ("big")->get_string ()), sizeof (big) - 1);
+
+      // destruction is a no-op for memory but keeps counts straight
+      map->remove ("key0");
+      ctx->destroy_value (doc);
+      TS_ASSERT_EQUALS (ctx->get_value_count (), 1);
+
+      ctx->pin ("pinned");
+      ctx->reset ();
+      TS_ASSERT_EQUALS (ctx->get_value_count (), 0);
+      TS_ASSERT_EQUALS (ctx->get_key_count (), 0);
+    }
+
+    // borrowed strings go with a reset, so snapshots share again
+    {
+      kvr::value *src = ctx->create_value ()->as_map ();
+      src->insert ("name", "a string long enough not to fit inline");
+      kvr::obuffer obuf (src->encode_bound (kvr::CODEC_MSGPACK));
+      TS_ASSERT (src->encode (kvr::CODEC_MSGPACK, &obuf));
+      kvr::value *dec = ctx->create_value ();
+      TS_ASSERT (dec->decode (kvr::CODEC_MSGPACK, obuf.get_data (), obuf.get_size (), kvr::DECODE_BORROW_STRINGS));
+      ctx->reset ();
+
+      kvr::value *doc = ctx->create_value ()->as_map ();
+      doc->insert_array ("list")->push ((int64_t) 1);
+      const kvr::value *snap = ctx->create_value ()->snapshot (doc);
+      TS_ASSERT_EQUALS (snap->find ("list"), ((const kvr::value *) doc)->find ("list"));
+      ctx->reset ();
+    }
+
+    // destroy with live values
+    ctx->create_value ()->as_map ()->insert ("live", true);
+    kvr::ctx::destroy (ctx);
+
+    // reset on a regular ctx
+    m_ctx->create_value ()->as_array ()->push ("one");
+    m_ctx->intern ("interned");
+    m_ctx->reset ();
+    TS_ASSERT_EQUALS (m_ctx->get_value_count (), 0);
+    TS_ASSERT_EQUALS (m_ctx->get_key_count (), 0);
+  }
+
+  ///////////////////////////////////////////////////////////////
+  ///////////////////////////////////////////////////////////////
+  ///////////////////////////////////////////////////////////////
+
+  void testValueLayout ()
+  {
+#if KVR_64
+    TS_ASSERT_EQUALS (sizeof (kvr::value), 16u);
+#endif
+
+    // strings of up to 11 chars live in the value, longer ones on the heap
+    const char *strs [] = { "", "a", "0123456789", "0123456789a", "0123456789ab", "0123456789abc",
+                            "a string long enough not to fit inline" };
+    kvr::value *val = m_ctx->create_value ();
+    for (size_t i = 0; i < (sizeof (strs) / sizeof (strs [0])); ++i)
+    {
+      // grow and shrink across the boundary in both directions
+      for (size_t j = 0; j < (sizeof (strs) / sizeof (strs [0])); ++j)
+      {
+        val->as_string ();
+        val->set_string (strs [i]);
+        val->set_string (strs [j]);
+        kvr::sz_t len = 0;
+        TS_ASSERT_EQUALS (strcmp (val->get_string (&len), strs [j]), 0);
+        TS_ASSERT_EQUALS (len, strlen (strs [j]));
+        kvr::value *cpy = m_ctx->create_value ()->copy (val);
+        TS_ASSERT_EQUALS (cpy->hash (), val->hash ());
+        m_ctx->destroy_value (cpy);
+      }
+    }
+
+    // containers keep length and capacity out of the value
+    kvr::value *arr = val->as_array ();
+    TS_ASSERT_EQUALS (arr->length (), 0u);
+    for (int i = 0; i < 100; ++i)
+    {
+      arr->push ("0123456789ab");
+      arr->push ((int64_t) i);
+    }
+    TS_ASSERT_EQUALS (arr->length (), 200u);
+    TS_ASSERT_EQUALS (arr->element (199)->get_integer (), 99);
+    m_ctx->destroy_value (val);
+
+    // values find their ctx through a registry slot, which is recycled once free
+    kvr::ctx *ctxs [64];
+    for (int i = 0; i < 64; ++i)
+    {
+      ctxs [i] = kvr::ctx::create ();
+      ctxs [i]->create_value ()->as_map ()->insert ("id", i);
+    }
+    for (int i = 0; i < 64; i += 2)
+    {
+      kvr::ctx::destroy (ctxs [i]);
+    }
+    for (int i = 0; i < 64; i += 2)
+    {
+      ctxs [i] = kvr::ctx::create_arena ();
+      kvr::value *map = ctxs [i]->create_value ()->as_map ();
+      map->insert ("id", i);
+      TS_ASSERT_EQUALS (ctxs [i]->create_value ()->copy (map)->find ("id")->get_integer (), i);
+    }
+    for (int i = 0; i < 64; ++i)
+    {
+      kvr::ctx::destroy (ctxs [i]);
+    }
+
+    // the registry grows past a page (and any fixed table size) while ctx objects are live
+    const int many = 5000;
+    kvr::ctx **live = new kvr::ctx * [many];
+    for (int i = 0; i < many; ++i)
+    {
+      live [i] = kvr::ctx::create_arena (1024);
+      TS_ASSERT (live [i]);
+      live [i]->create_value ()->set_string ("a string long enough not to fit inline");
+    }
+    for (int i = 0; i < many; i += 1000)
+    {
+      kvr::value *v = live [i]->create_value ()->as_array ();
+      v->push ((int64_t) i);
+      v->push ("a string long enough not to fit inline");
+      TS_ASSERT_EQUALS (v->element (0)->get_integer (), i);
+    }
+    for (int i = 0; i < many; ++i)
+    {
+      kvr::ctx::destroy (live [i]);
+    }
+    delete [] live;
+  }
+
+  ///////////////////////////////////////////////////////////////
+  ///////////////////////////////////////////////////////////////
+  ///////////////////////////////////////////////////////////////
+
+  void testStringInterning ()
+  {
+    const char *status = "status: service unavailable";
+    const char *host = "host-0001.eu-west-1.internal";
+
+    // off by default
+    kvr::value *a = m_ctx->create_value ()->as_array ();
+    a->push (status);
+    a->push (status);
+    TS_ASSERT_EQUALS (m_ctx->get_string_count (), 0u);
+    TS_ASSERT (a->element (0)->get_string () != a->element (1)->get_string ());
+
+    m_ctx->intern_strings (true);
+
+    kvr::value *b = m_ctx->create_value ()->as_array ();
+    for (int i = 0; i < 100; ++i)
+    {
+      b->push (status);
+      b->push (host);
+      b->push ("short");
+    }
+    TS_ASSERT_EQUALS (m_ctx->get_string_count (), 2u);
+    TS_ASSERT_EQUALS (b->element (0)->get_string (), b->element (198)->get_string ());
+    TS_ASSERT_EQUALS (strcmp (b->element (1)->get_string (), host), 0);
+
+    // setting one value leaves the others alone, including self-assignment
+    kvr::value *e = b->element (3);
+    e->set_string (e->get_string ());
+    e->set_string ("a different status string");
+    TS_ASSERT_EQUALS (strcmp (b->element (0)->get_string (), status), 0);
+    TS_ASSERT_EQUALS (m_ctx->get_string_count (), 3u);
+    e->set_string (status);
+    TS_ASSERT_EQUALS (m_ctx->get_string_count (), 2u);
+
+    // copies, merges and decodes share too; equal trees hash the same either way
+    kvr::value *c = m_ctx->create_value ()->copy (a);
+    TS_ASSERT_EQUALS (c->hash (), a->hash ());
+    TS_ASSERT_EQUALS (m_ctx->get_string_count (), 2u);
+
+    kvr::value *s = m_ctx->create_value ();
+    s->set_string ("status: ");
+    kvr::value *t = m_ctx->create_value ();
+    t->set_string ("service unavailable");
+    s->merge (t);
+    TS_ASSERT_EQUALS (s->get_string (), b->element (0)->get_string ());
+
+    const char *json = "[\"host-0001.eu-west-1.internal\",\"host-0001.eu-west-1.internal\"]";
+    kvr::value *d = m_ctx->create_value ();
+    TS_ASSERT (d->decode (kvr::CODEC_JSON, (const uint8_t *) json, strlen (json)));
+    TS_ASSERT_EQUALS (d->element (0)->get_string (), b->element (1)->get_string ());
+    TS_ASSERT_EQUALS (m_ctx->get_string_count (), 3u); // + "service unavailable"
+
+    // turning it off keeps existing values interned until they change
+    m_ctx->intern_strings (false);
+    e->set_string (host);
+    TS_ASSERT (e->get_string () != b->element (1)->get_string ());
+
+    // strings are released with their last value
+    m_ctx->destroy_value (t);
+    TS_ASSERT_EQUALS (m_ctx->get_string_count (), 2u);
+    m_ctx->destroy_value (b);
+    m_ctx->destroy_value (c);
+    m_ctx->destroy_value (s);
+    TS_ASSERT_EQUALS (m_ctx->get_string_count (), 1u);
+    m_ctx->destroy_value (d);
+    TS_ASSERT_EQUALS (m_ctx->get_string_count (), 0u);
+    m_ctx->destroy_value (a);
+
+    // arena ctx, reset and destroy with live interned strings
+    kvr::ctx *ctx = kvr::ctx::create_arena (1024);
+    ctx->intern_strings (true);
+    ctx->create_value ()->as_array ()->push (status);
+    ctx->reset ();
+    TS_ASSERT_EQUALS (ctx->get_string_count (), 0u);
+    ctx->create_value ()->as_array ()->push (host);
+    kvr::ctx::destroy (ctx);
+
+    m_ctx->intern_strings (true);
+    m_ctx->create_value ()->as_map ()->insert ("live", status);
+  }
+
+  ///////////////////////////////////////////////////////////////
+  ///////////////////////////////////////////////////////////////
+  ///////////////////////////////////////////////////////////////
+
+  void testPoolAllocator ()
+  {
+    kvr::pool_allocator pool;
+
+    // every pooled size gets an aligned block that is recycled by its size class
+    const size_t maxsz = kvr::pool_allocator::MAX_SIZE;
+    for (size_t sz = 1; sz <= maxsz; ++sz)
+    {
+      uint8_t *p = (uint8_t *) pool.allocate (sz);
+      TS_ASSERT (p);
+      TS_ASSERT_EQUALS (((uintptr_t) p) & 7, 0u);
+      memset (p, 0xab, sz);
+      pool.deallocate (p, sz);
+      TS_ASSERT_EQUALS (pool.allocate (sz), (void *) p);
+      pool.deallocate (p, sz);
+    }
+
+    void *large = pool.allocate (maxsz + 1);
+    TS_ASSERT (large);
+    pool.deallocate (large, maxsz + 1);
+
+    // reallocate keeps the block within a size class and the contents across classes
+    uint8_t *r = (uint8_t *) pool.reallocate (NULL, 0, 20);
+    TS_ASSERT (r);
+    memset (r, 0xcd, 20);
+    TS_ASSERT_EQUALS (pool.reallocate (r, 20, 32), (void *) r);
+    r = (uint8_t *) pool.reallocate (r, 32, 200);
+    r = (uint8_t *) pool.reallocate (r, 200, maxsz * 4);
+    TS_ASSERT (r && (r [0] == 0xcd) && (r [19] == 0xcd));
+    r [maxsz * 4 - 1] = 0xef;
+    r = (uint8_t *) pool.reallocate (r, maxsz * 4, maxsz * 8);
+    TS_ASSERT (r && (r [19] == 0xcd) && (r [maxsz * 4 - 1] == 0xef));
+    r = (uint8_t *) pool.reallocate (r, maxsz * 8, 16);
+    TS_ASSERT (r && (r [0] == 0xcd) && (r [15] == 0xcd));
+    pool.deallocate (r, 16);
+
+    // ctx on a pool: memory reserved by the first document is reused by the next
+    const char *json = "{\"a\":[1,2,3,{\"b\":\"a string long enough not to fit inline\"}],\"c\":{\"d\":null}}";
+    size_t reserved = 0;
+    for (int round = 0; round < 4; ++round)
+    {
+      kvr::ctx *ctx = kvr::ctx::create (&pool);
+      kvr::value *val = ctx->create_value ();
+      TS_ASSERT (val->decode (kvr::CODEC_JSON, (const uint8_t *) json, strlen (json)));
+      kvr::value *cpy = ctx->create_value ()->copy (val);
+      TS_ASSERT_EQUALS (cpy->hash (), val->hash ());
+      kvr::ctx::destroy (ctx);
+
+      if (round > 0)
+      {
+        TS_ASSERT_EQUALS (pool.get_memory_reserved (), reserved);
+      }
+      reserved = pool.get_memory_reserved ();
+    }
+  }
+
   ///////////////////////////////////////////////////////////////
   ///////////////////////////////////////////////////////////////
   ///////////////////////////////////////////////////////////////
@@ -601,8 +1286,567 @@ public:
       }
     }
 
+    // inline storage (containers and strings survive growth and removal)
+    {
+      kvr::value *grow = m_ctx->create_value ()->as_array (1);
+      const kvr::sz_t count = 100;
+      char str [64];
+
+      for (kvr::sz_t i = 0; i < count; ++i)
+      {
+        kvr::value *m = grow->push_map ();
+        m->insert ("id", (int64_t) i);
+        sprintf (str, "a string too long to be stored inline %u", (unsigned) i);
+        m->insert ("name", str);
+        grow->push_array ()->push ((int64_t) i);
+      }
+
+      TS_ASSERT_EQUALS (grow->length (), count * 2);
+      TS_ASSERT (grow->pop (0));
+      TS_ASSERT (grow->pop (0));
+      TS_ASSERT (grow->pop ());
+      TS_ASSERT_EQUALS (grow->length (), (count - 1) * 2 - 1);
+
+      for (kvr::sz_t i = 0, c = grow->length (); i < c; ++i)
+      {
+        kvr::value *v = grow->element (i);
+        int64_t id = (int64_t) (i / 2) + 1;
+        if ((i & 1) == 0)
+        {
+          TS_ASSERT (v->is_map ());
+          TS_ASSERT_EQUALS (v->find ("id")->get_integer (), id);
+          sprintf (str, "a string too long to be stored inline %u", (unsigned) id);
+          TS_ASSERT_EQUALS (strcmp (v->find ("name")->get_string (), str), 0);
+        }
+        else
+        {
+          TS_ASSERT (v->is_array ());
+          TS_ASSERT_EQUALS (v->element (0)->get_integer (), id);
+        }
+      }
+
+      TS_ASSERT (grow->element (grow->length ()) == NULL);
+
+      kvr::value *cpy = m_ctx->create_value ()->copy (grow);
+      TS_ASSERT_EQUALS (cpy->length (), grow->length ());
+      TS_ASSERT_EQUALS (cpy->element (1)->element (0)->get_integer (), 1);
+
+      m_ctx->destroy_value (cpy);
+      m_ctx->destroy_value (grow);
+    }
+
+    // packed storage
+    {
+      const int64_t ints [5] = { 1, -2, 300, -40000, 5000000000LL };
+      const double floats [3] = { 0.5, -1.25, 1.0e10 };
+      const bool bools [4] = { true, false, false, true };
+
+      kvr::value *pi = m_ctx->create_value ()->as_array ();
+      TS_ASSERT (pi->push_n (ints, 5));
+      TS_ASSERT (pi->push_n (ints, 2));
+      TS_ASSERT (pi->is_packed ());
+      TS_ASSERT_EQUALS (pi->length (), 7u);
+      TS_ASSERT (pi->packed_integers () != NULL);
+      TS_ASSERT (pi->packed_floats () == NULL);
+      TS_ASSERT_EQUALS (pi->packed_integers () [4], 5000000000LL);
+      TS_ASSERT_EQUALS (pi->packed_integers () [6], -2);
+
+      int64_t iout [8];
+      double fout [8];
+      bool bout [8];
+      TS_ASSERT_EQUALS (pi->get_n (iout, 8), 7u);
+      TS_ASSERT_EQUALS (iout [3], -40000);
+      TS_ASSERT_EQUALS (pi->get_n (fout, 8), 0u);
+
+      TS_ASSERT (pi->pop (0));
+      TS_ASSERT (pi->pop ());
+      TS_ASSERT (pi->is_packed ());
+      TS_ASSERT_EQUALS (pi->length (), 5u);
+      TS_ASSERT_EQUALS (pi->packed_integers () [0], -2);
+
+      kvr::value *pf = m_ctx->create_value ()->as_array ();
+      pf->push_n (floats, 3);
+      kvr::value *pb = m_ctx->create_value ()->as_array ();
+      pb->push_n (bools, 4);
+      TS_ASSERT (pf->packed_floats () != NULL);
+      TS_ASSERT (pb->packed_booleans () != NULL);
+      TS_ASSERT_EQUALS (pf->get_n (fout, 2), 2u);
+      TS_ASSERT_EQUALS (fout [1], -1.25);
+      TS_ASSERT_EQUALS (pb->get_n (bout, 8), 4u);
+      TS_ASSERT (bout [0] && !bout [1] && bout [3]);
+
+      // a packed array is equal to the regular array with the same elements
+      kvr::value *ri = m_ctx->create_value ()->as_array ();
+      for (kvr::sz_t i = 1; i < 5; ++i) { ri->push (ints [i]); }
+      ri->push (ints [0]);
+      TS_ASSERT (!ri->is_packed ());
+      TS_ASSERT_EQUALS (ri->hash (), pi->hash ());
+      TS_ASSERT_EQUALS (ri->get_n (iout, 8), 5u);
+
+      kvr::value *cpy = m_ctx->create_value ()->copy (pi);
+      TS_ASSERT (cpy->is_packed ());
+      TS_ASSERT_EQUALS (cpy->hash (), pi->hash ());
+
+      cpy->merge (pi);
+      TS_ASSERT (cpy->is_packed ());
+      TS_ASSERT_EQUALS (cpy->length (), 10u);
+      cpy->merge (pf);
+      TS_ASSERT (!cpy->is_packed ());
+      TS_ASSERT_EQUALS (cpy->length (), 13u);
+      TS_ASSERT_EQUALS (cpy->element (11)->get_float (), -1.25);
+
+      // reads through const values leave packed storage (and pointers into it) alone
+      const kvr::value *cpb = pb;
+      const bool *raw = pb->packed_booleans ();
+      TS_ASSERT (!cpb->get_boolean_at (1) && cpb->get_boolean_at (3));
+      TS_ASSERT_EQUALS (pi->get_integer_at (3), 5000000000LL);
+      TS_ASSERT_EQUALS (pi->get_float_at (0), -2.0);
+      TS_ASSERT_EQUALS (pf->get_integer_at (2), 10000000000LL);
+      TS_ASSERT_EQUALS (ri->get_integer_at (4), 1);
+#if !KVR_DEBUG
+      // packed elements have no value to point at (asserts in debug)
+      TS_ASSERT (cpb->element (1) == NULL);
+      TS_ASSERT (cpb->search ("1") == NULL);
+      TS_ASSERT_EQUALS (cpb->get_integer_at (0), 0);
+#endif
+      TS_ASSERT_EQUALS (pb->packed_booleans (), raw);
+
+      // pushes of the element type append in place
+      TS_ASSERT_EQUALS (pi->push (7), pi);
+      TS_ASSERT_EQUALS (pi->push (static_cast<int64_t>(8)), pi);
+      TS_ASSERT (pi->is_packed ());
+      TS_ASSERT_EQUALS (pi->length (), 7u);
+      TS_ASSERT_EQUALS (pi->get_integer_at (6), 8);
+      TS_ASSERT (pi->pop () && pi->pop ());
+
+      // diff reads packed elements in place, patch writes into a regular copy
+      const int64_t mod [5] = { -2, 300, 7, 5000000000LL, 1 };
+      kvr::value *pj = m_ctx->create_value ()->as_array ();
+      pj->push_n (mod, 5);
+      kvr::value *d = m_ctx->create_value ()->diff (pi, pj);
+      TS_ASSERT (pi->is_packed ());
+      TS_ASSERT (pj->is_packed ());
+      kvr::value *pk = m_ctx->create_value ()->copy (pi);
+      pk->patch (d);
+      TS_ASSERT_EQUALS (pk->hash (), pj->hash ());
+      m_ctx->destroy_value (pk);
+      m_ctx->destroy_value (d);
+      m_ctx->destroy_value (pj);
+
+#if !KVR_DEBUG
+      // invalid floats are rejected as by push (double), with nothing pushed (asserts in debug)
+      const double bad [2] = { 2.0, HUGE_VAL };
+      TS_ASSERT (!pf->push_n (bad, 2));
+      TS_ASSERT_EQUALS (pf->length (), 3u);
+#endif
+
+      // mixed pushes and element access turn packed arrays into regular arrays
+      pf->push ("str");
+      TS_ASSERT (!pf->is_packed ());
+      TS_ASSERT_EQUALS (pf->length (), 4u);
+      TS_ASSERT_EQUALS (pf->element (2)->get_float (), 1.0e10);
+      TS_ASSERT_EQUALS (pf->get_n (fout, 8), 3u);
+
+      TS_ASSERT (pb->element (1)->is_boolean ());
+      TS_ASSERT (!pb->is_packed ());
+      TS_ASSERT (pb->push_n (bools, 4));
+      TS_ASSERT_EQUALS (pb->length (), 8u);
+      TS_ASSERT (pb->element (4)->get_boolean ());
+
+      m_ctx->destroy_value (cpy);
+      m_ctx->destroy_value (ri);
+      m_ctx->destroy_value (pb);
+      m_ctx->destroy_value (pf);
+      m_ctx->destroy_value (pi);
+    }
+
     m_ctx->destroy_value (array);
   }
+
+  ///////////////////////////////////////////////////////////////
+  ///////////////////////////////////////////////////////////////
+  ///////////////////////////////////////////////////////////////
+
+  void testTakeSplice ()
+  {
+    const char *note = "a string too long to be stored inline";
+    const size_t roots = m_ctx->get_value_count ();
+
+    kvr::value *src = m_ctx->create_value ()->as_map ();
+    kvr::value *sub = src->insert_map ("sub");
+    sub->insert ("note", note);
+    sub->insert_array ("list")->push (1);
+    kvr::value *arr = src->insert_array ("arr");
+    arr->push (note);
+    arr->push_map ()->insert ("id", 7);
+    arr->push (3.5);
+
+    kvr::value *dst = m_ctx->create_value ()->as_map ();
+    kvr::value *expected = m_ctx->create_value ()->copy (sub);
+
+    // map to map, under another key
+    kvr::value *t = src->take ("sub");
+    TS_ASSERT (t);
+    TS_ASSERT (src->find ("sub") == NULL);
+    TS_ASSERT_EQUALS (src->size (), 1u);
+    TS_ASSERT_EQUALS (t->hash (), expected->hash ());
+    TS_ASSERT_EQUALS (m_ctx->get_value_count (), roots + 4);
+    kvr::value *moved = dst->splice ("moved", t);
+    TS_ASSERT_EQUALS (m_ctx->get_value_count (), roots + 3);
+    TS_ASSERT_EQUALS (moved->hash (), expected->hash ());
+    TS_ASSERT_EQUALS (strcmp (moved->find ("note")->get_string (), note), 0);
+    TS_ASSERT (src->take ("sub") == NULL);
+
+    // array to map and map to array
+    kvr::value *e = arr->take (1);
+    TS_ASSERT_EQUALS (arr->length (), 2u);
+    TS_ASSERT_EQUALS (arr->element (1)->get_float (), 3.5);
+    TS_ASSERT (arr->take (2) == NULL);
+    dst->splice ("elem", e);
+    TS_ASSERT_EQUALS (dst->find ("elem")->find ("id")->get_integer (), 7);
+
+    kvr::value *a = dst->splice ("arr", src->take ("arr"));
+    a->splice (dst->take ("moved"));
+    TS_ASSERT_EQUALS (a->length (), 3u);
+    TS_ASSERT_EQUALS (a->element (2)->hash (), expected->hash ());
+    TS_ASSERT_EQUALS (strcmp (a->element (0)->get_string (), note), 0);
+    TS_ASSERT_EQUALS (src->size (), 0u);
+
+    // an existing key is replaced, key handles are used as is
+    kvr::key *k = m_ctx->pin ("elem");
+    kvr::value *n = m_ctx->create_value ();
+    n->set_string (note);
+    dst->splice (k, n);
+    TS_ASSERT_EQUALS (dst->size (), 2u);
+    TS_ASSERT_EQUALS (strcmp (dst->find (k)->get_string (), note), 0);
+    m_ctx->release (k);
+
+    // packed elements come out as values, the rest stays packed
+    const int64_t ints [3] = { 10, 20, 30 };
+    kvr::value *p = dst->insert_array ("packed");
+    p->push_n (ints, 3);
+    kvr::value *pe = p->take (1);
+    TS_ASSERT_EQUALS (pe->get_integer (), 20);
+    TS_ASSERT (p->is_packed ());
+    TS_ASSERT_EQUALS (p->length (), 2u);
+    TS_ASSERT_EQUALS (p->packed_integers () [1], 30);
+    m_ctx->destroy_value (pe);
+
+    // a root from another ctx is copied, then destroyed
+    kvr::ctx *other = kvr::ctx::create ();
+    kvr::value *o = other->create_value ()->copy (expected);
+    dst->splice ("other", o);
+    TS_ASSERT_EQUALS (other->get_value_count (), 0u);
+    TS_ASSERT_EQUALS (dst->find ("other")->hash (), expected->hash ());
+    kvr::ctx::destroy (other);
+
+    m_ctx->destroy_value (expected);
+    m_ctx->destroy_value (dst);
+    m_ctx->destroy_value (src);
+    TS_ASSERT_EQUALS (m_ctx->get_value_count (), roots);
+  }
+
+  ///////////////////////////////////////////////////////////////
+  ///////////////////////////////////////////////////////////////
+  ///////////////////////////////////////////////////////////////
+
+  void testCopyOnWrite ()
+  {
+    const char *note = "a string too long to be stored inline";
+    const int64_t ints [3] = { 1, 2, 3 };
+    const size_t roots = m_ctx->get_value_count ();
+
+    kvr::value *doc = m_ctx->create_value ()->as_map ();
+    kvr::value *cfg = doc->insert_map ("cfg");
+    cfg->insert ("name", note);
+    cfg->insert_map ("net")->insert ("port", 80);
+    kvr::value *list = doc->insert_array ("list");
+    list->push (note);
+    list->push_map ()->insert ("id", 7);
+    doc->insert_array ("packed")->push_n (ints, 3);
+    doc->insert ("x", 1);
+
+    // copies are deep: values found in the original before the copy are its own
+    kvr::value *x = doc->find ("x");
+    kvr::value *port = doc->find ("cfg")->find ("net")->find ("port");
+    kvr::value *deep = m_ctx->create_value ()->copy (doc);
+    x->set_integer (42);
+    port->set_integer (81);
+    TS_ASSERT_EQUALS (deep->find ("x")->get_integer (), 1);
+    TS_ASSERT_EQUALS (deep->find ("cfg")->find ("net")->find ("port")->get_integer (), 80);
+    m_ctx->destroy_value (deep);
+    x->set_integer (1);
+    port->set_integer (80);
+
+    const uint32_t h0 = doc->hash ();
+    kvr::value *cpy = m_ctx->create_value ()->snapshot (doc);
+    TS_ASSERT_EQUALS (cpy->hash (), h0);
+
+    // lookups through const values leave a snapshot shared
+    const kvr::value *cdoc = doc;
+    const kvr::value *ccpy = cpy;
+    const size_t shared = m_ctx->get_value_count ();
+    TS_ASSERT_EQUALS (ccpy->find ("cfg"), cdoc->find ("cfg"));
+    TS_ASSERT_EQUALS (ccpy->search ("list/1/id"), cdoc->search ("list/1/id"));
+    TS_ASSERT_EQUALS (ccpy->find ("list")->element (0), cdoc->find ("list")->element (0));
+    kvr::value::cursor cc (ccpy);
+    kvr::pair cp;
+    while (cc.get (&cp)) { TS_ASSERT_EQUALS (cp.get_value (), cdoc->find (cp.get_key ()->get_string ())); }
+    TS_ASSERT_EQUALS (m_ctx->get_value_count (), shared);
+
+    // writes through found values (paths are cloned level by level)
+    cpy->find ("cfg")->find ("net")->insert ("port", 8080);
+    TS_ASSERT_EQUALS (doc->find ("cfg")->find ("net")->find ("port")->get_integer (), 80);
+    TS_ASSERT_EQUALS (cpy->find ("cfg")->find ("net")->find ("port")->get_integer (), 8080);
+    TS_ASSERT_EQUALS (strcmp (cpy->find ("cfg")->find ("name")->get_string (), note), 0);
+
+    // the original is written too, through elements and cursors
+    doc->find ("list")->element (1)->insert ("id", 8);
+    TS_ASSERT_EQUALS (cpy->find ("list")->element (1)->find ("id")->get_integer (), 7);
+    kvr::value::cursor c (doc->find ("cfg"));
+    kvr::pair p;
+    while (c.get (&p))
+    {
+      if (p.get_value ()->is_string ()) { p.get_value ()->set_string ("x"); }
+    }
+    TS_ASSERT_EQUALS (strcmp (cpy->find ("cfg")->find ("name")->get_string (), note), 0);
+
+    // push, pop, remove and packed arrays
+    cpy->find ("list")->push (true);
+    doc->find ("list")->pop (0);
+    doc->remove ("cfg");
+    cpy->find ("packed")->push_n (ints, 3);
+    TS_ASSERT_EQUALS (doc->find ("list")->length (), 1u);
+    TS_ASSERT_EQUALS (cpy->find ("list")->length (), 3u);
+    TS_ASSERT_EQUALS (doc->find ("packed")->length (), 3u);
+    TS_ASSERT_EQUALS (cpy->find ("packed")->length (), 6u);
+    TS_ASSERT (cpy->find ("packed")->is_packed ());
+    TS_ASSERT (cpy->find ("cfg") != NULL);
+
+    // either side can go first
+    kvr::value *a = m_ctx->create_value ()->snapshot (cpy);
+    kvr::value *b = m_ctx->create_value ()->snapshot (cpy);
+    const uint32_t h1 = cpy->hash ();
+    m_ctx->destroy_value (cpy);
+    TS_ASSERT_EQUALS (a->hash (), h1);
+    TS_ASSERT_EQUALS (b->hash (), h1);
+
+    // diff skips shared subtrees, patch applies what was written
+    b->find ("cfg")->insert ("name", "y");
+    b->find ("list")->push (2.5);
+    kvr::value *diff = m_ctx->create_value ()->diff (a, b);
+    a->patch (diff);
+    TS_ASSERT_EQUALS (a->hash (), b->hash ());
+    m_ctx->destroy_value (diff);
+
+    // snapshots across ctxs are deep
+    kvr::ctx *other = kvr::ctx::create ();
+    kvr::value *o = other->create_value ()->snapshot (a);
+    TS_ASSERT_EQUALS (o->hash (), a->hash ());
+    m_ctx->destroy_value (a);
+    TS_ASSERT_EQUALS (o->hash (), b->hash ());
+    kvr::ctx::destroy (other);
+
+    m_ctx->destroy_value (b);
+    m_ctx->destroy_value (doc);
+    TS_ASSERT_EQUALS (m_ctx->get_value_count (), roots);
+  }
+
+  ///////////////////////////////////////////////////////////////
+  ///////////////////////////////////////////////////////////////
+  ///////////////////////////////////////////////////////////////
+
+  void testFreeze ()
+  {
+    const char *note = "a string too long to be stored inline";
+    const double floats [3] = { 0.5, 1.5, 2.5 };
+    char key [32];
+
+    kvr::value *doc = m_ctx->create_value ()->as_map ();
+    doc->insert ("name", "cfg");
+    doc->insert ("note", note);
+    doc->insert ("port", 8080);
+    doc->insert ("ratio", 0.25);
+    doc->insert ("on", true);
+    doc->insert_null ("none");
+    kvr::value *users = doc->insert_array ("users");
+    users->push_map ()->insert ("id", 1);
+    kvr::value *u = users->push_map ();
+    u->insert ("id", 2);
+    u->insert ("name", note);
+    doc->insert_array ("floats")->push_n (floats, 3);
+    kvr::value *big = doc->insert_map ("big");
+    for (int i = 0; i < 1000; ++i)
+    {
+      sprintf (key, "k%d", i * 7);
+      big->insert (key, i);
+    }
+
+    kvr::frozen_doc fd;
+    TS_ASSERT (fd.root () == NULL);
+    TS_ASSERT (doc->freeze (&fd));
+    TS_ASSERT (fd.get_size () > 0);
+
+    // the frozen copy doesn't refer back to the tree (or its keys)
+    m_ctx->destroy_value (doc);
+
+    const kvr::frozen_doc::node *r = fd.root ();
+    TS_ASSERT (r->is_map ());
+    TS_ASSERT_EQUALS (r->size (), 9u);
+    TS_ASSERT_EQUALS (strcmp (r->find ("name")->get_string (), "cfg"), 0);
+    kvr::sz_t len = 0;
+    TS_ASSERT_EQUALS (strcmp (r->find ("note")->get_string (&len), note), 0);
+    TS_ASSERT_EQUALS (len, (kvr::sz_t) strlen (note));
+    TS_ASSERT_EQUALS (r->find ("port")->get_integer (), 8080);
+    TS_ASSERT_EQUALS (r->find ("port")->get_float (), 8080.0);
+    TS_ASSERT_EQUALS (r->find ("ratio")->get_float (), 0.25);
+    TS_ASSERT (r->find ("on")->get_boolean ());
+    TS_ASSERT (r->find ("none")->is_null ());
+    TS_ASSERT (r->find ("nothere") == NULL);
+    TS_ASSERT (r->find ("portx", 4) == r->find ("port"));
+
+    // arrays (packed ones too)
+    const kvr::frozen_doc::node *fl = r->find ("floats");
+    TS_ASSERT (fl->is_array ());
+    TS_ASSERT_EQUALS (fl->length (), 3u);
+    TS_ASSERT_EQUALS (fl->element (2)->get_float (), 2.5);
+    TS_ASSERT (fl->element (3) == NULL);
+
+    // every key of a large map, and the ones in between
+    const kvr::frozen_doc::node *b = r->find ("big");
+    for (int i = 0; i < 7000; ++i)
+    {
+      sprintf (key, "k%d", i);
+      const kvr::frozen_doc::node *n = b->find (key);
+      TS_ASSERT_EQUALS ((n != NULL), ((i % 7) == 0));
+      if (n) { TS_ASSERT_EQUALS (n->get_integer (), i / 7); }
+    }
+
+    // path search, same syntax as value::search
+    TS_ASSERT_EQUALS (r->search ("users/1/id")->get_integer (), 2);
+    TS_ASSERT_EQUALS (strcmp (r->search ("users/@id=2/name")->get_string (), note), 0);
+    TS_ASSERT (r->search ("users/@id=3") == NULL);
+    const char *path [3] = { "users", "0", "id" };
+    TS_ASSERT_EQUALS (r->search (path, 3)->get_integer (), 1);
+    TS_ASSERT_EQUALS (r->search ("big/k21")->get_integer (), 3);
+
+    // cursor keeps insertion order
+    kvr::frozen_doc::cursor c (r);
+    const char *k = NULL;
+    const kvr::frozen_doc::node *v = NULL;
+    const char *order [9] = { "name", "note", "port", "ratio", "on", "none", "users", "floats", "big" };
+    int i = 0;
+    while (c.get (&k, &v))
+    {
+      TS_ASSERT_EQUALS (strcmp (k, order [i]), 0);
+      TS_ASSERT (v == r->find (k));
+      ++i;
+    }
+    TS_ASSERT_EQUALS (i, 9);
+
+    // freezing again replaces the block
+    kvr::value *s = m_ctx->create_value ();
+    s->set_string (note);
+    TS_ASSERT (s->freeze (&fd));
+    TS_ASSERT (fd.root ()->is_string ());
+    TS_ASSERT_EQUALS (strcmp (fd.root ()->get_string (), note), 0);
+
+    m_ctx->destroy_value (s);
+  }
+
+  ///////////////////////////////////////////////////////////////
+  ///////////////////////////////////////////////////////////////
+  ///////////////////////////////////////////////////////////////
+
+  void testArrayRange ()
+  {
+    const char *note = "a string too long to be stored inline";
+    const int64_t ints [6] = { 0, 1, 2, 3, 4, 5 };
+    const size_t roots = m_ctx->get_value_count ();
+
+    kvr::value *arr = m_ctx->create_value ()->as_array ();
+    TS_ASSERT (arr->reserve (100));
+    for (int i = 0; i < 6; ++i)
+    {
+      arr->push (i);
+    }
+
+    // insert_at opens null slots, at the front, middle and end
+    kvr::value *v = arr->insert_at (0);
+    TS_ASSERT (v && v->is_null ());
+    v->set_string (note);
+    v = arr->insert_at (3, 2);
+    TS_ASSERT (v && v->is_null () && (v + 1)->is_null ());
+    v->as_map ()->insert ("id", note);
+    (v + 1)->as_array ()->push (note);
+    TS_ASSERT (arr->insert_at (arr->length ())->is_null ());
+    TS_ASSERT (arr->insert_at (arr->length () + 1) == NULL);
+    TS_ASSERT (arr->insert_at (0, 0) == NULL);
+    TS_ASSERT_EQUALS (arr->length (), 10u);
+    TS_ASSERT_EQUALS (strcmp (arr->element (0)->get_string (), note), 0);
+    TS_ASSERT_EQUALS (arr->element (2)->get_integer (), 1);
+    TS_ASSERT (arr->element (3)->is_map ());
+    TS_ASSERT_EQUALS (arr->element (5)->get_integer (), 2);
+
+    // erase_range destructs what it drops
+    TS_ASSERT (arr->erase_range (2, 5));
+    TS_ASSERT_EQUALS (arr->length (), 7u);
+    TS_ASSERT_EQUALS (arr->element (1)->get_integer (), 0);
+    TS_ASSERT_EQUALS (arr->element (2)->get_integer (), 2);
+    TS_ASSERT (arr->erase_range (3, 3));
+    TS_ASSERT (!arr->erase_range (4, 3));
+    TS_ASSERT (!arr->erase_range (0, 8));
+
+    // swap_remove moves the last element in
+    TS_ASSERT (arr->swap_remove (0));
+    TS_ASSERT (arr->element (0)->is_null ());
+    TS_ASSERT (arr->swap_remove (arr->length () - 1));
+    TS_ASSERT (!arr->swap_remove (arr->length ()));
+    TS_ASSERT_EQUALS (arr->length (), 5u);
+    TS_ASSERT_EQUALS (arr->element (4)->get_integer (), 4);
+
+    // resize
+    TS_ASSERT (arr->resize (2));
+    TS_ASSERT_EQUALS (arr->length (), 2u);
+    TS_ASSERT (arr->resize (40));
+    TS_ASSERT_EQUALS (arr->length (), 40u);
+    TS_ASSERT (arr->element (39)->is_null ());
+    TS_ASSERT (arr->resize (0));
+    TS_ASSERT_EQUALS (arr->length (), 0u);
+
+    // packed arrays stay packed, except for insert_at
+    kvr::value *pk = m_ctx->create_value ()->as_array ();
+    pk->push_n (ints, 6);
+    TS_ASSERT (pk->reserve (64));
+    TS_ASSERT (pk->erase_range (1, 3));
+    TS_ASSERT (pk->swap_remove (0));
+    TS_ASSERT (pk->resize (5));
+    TS_ASSERT (pk->is_packed ());
+    const int64_t *pi = pk->packed_integers ();
+    TS_ASSERT (pi);
+    TS_ASSERT_EQUALS (pi [0], 5);
+    TS_ASSERT_EQUALS (pi [1], 3);
+    TS_ASSERT_EQUALS (pi [2], 4);
+    TS_ASSERT_EQUALS (pi [4], 0);
+    TS_ASSERT (pk->insert_at (1)->is_null ());
+    TS_ASSERT (!pk->is_packed ());
+    TS_ASSERT_EQUALS (pk->length (), 6u);
+    TS_ASSERT_EQUALS (pk->element (2)->get_integer (), 3);
+
+    // shared copies are unshared first
+    kvr::value *cpy = m_ctx->create_value ()->copy (pk);
+    cpy->erase_range (0, 3);
+    cpy->insert_at (0)->set_string (note);
+    TS_ASSERT_EQUALS (pk->length (), 6u);
+    TS_ASSERT_EQUALS (pk->element (0)->get_integer (), 5);
+    TS_ASSERT_EQUALS (cpy->length (), 4u);
+    TS_ASSERT_EQUALS (cpy->element (1)->get_integer (), 4);
+
+    m_ctx->destroy_value (cpy);
+    m_ctx->destroy_value (pk);
+    m_ctx->destroy_value (arr);
+    TS_ASSERT_EQUALS (m_ctx->get_value_count (), roots);
+  }
 };
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
@@ -331,6 +331,831 @@ public:
   ///////////////////////////////////////////////////////////////
   ///////////////////////////////////////////////////////////////
 
+  void testDecodeEdgeCases ()
+  {
+    ///////////////////////////////
+    // set up
+    ///////////////////////////////
+
+    char key [16];
+    kvr::value *val = m_ctx->create_value ()->as_map ();
+    {
+      // nested containers, 16-23 element containers (one byte cbor header) and wide integers
+      kvr::value *a20 = val->insert_map ("l0")->insert_map ("l1")->insert_array ("a20");
+      for (int i = 0; i < 20; ++i) { a20->push_array ()->push (i); }
+      kvr::value *m20 = val->insert_map ("m20");
+      for (int i = 0; i < 20; ++i) { sprintf (key, "k%d", i); m20->insert (key, i); }
+      val->insert ("u33", (int64_t) 4294967296LL);
+      val->insert ("i63", (int64_t) 9000000000000000000LL);
+      val->insert ("after", "last");
+    }
+
+    ///////////////////////////////
+    // round trips
+    ///////////////////////////////
+
+    const kvr::codec_t codecs [3] = { kvr::CODEC_JSON, kvr::CODEC_CBOR, kvr::CODEC_MSGPACK };
+
+    for (int c = 0; c < 3; ++c)
+    {
+      size_t obufsz = val->encode_bound (codecs [c]);
+      kvr::obuffer obuf (obufsz);
+      TS_ASSERT (val->encode (codecs [c], &obuf));
+
+      kvr::value *dec = m_ctx->create_value ();
+      TS_ASSERT (dec->decode (codecs [c], obuf.get_data (), obuf.get_size ()));
+      TS_ASSERT_EQUALS (dec->search ("l0/l1/a20")->length (), 20u);
+      TS_ASSERT_EQUALS (dec->find ("m20")->size (), 20u);
+      TS_ASSERT_EQUALS (dec->find ("u33")->get_integer (), 4294967296LL);
+      TS_ASSERT_EQUALS (strcmp (dec->find ("after")->get_string (), "last"), 0);
+      TS_ASSERT_EQUALS (dec->hash (), val->hash ());
+      m_ctx->destroy_value (dec);
+    }
+
+    ///////////////////////////////
+    // cbor one byte header lengths
+    ///////////////////////////////
+    {
+      uint8_t cbor [1 + 20];
+      cbor [0] = 0x94; // array of 20
+      for (uint8_t i = 0; i < 20; ++i) { cbor [1 + i] = i; }
+
+      kvr::value *dec = m_ctx->create_value ();
+      TS_ASSERT (dec->decode (kvr::CODEC_CBOR, cbor, sizeof (cbor)));
+      TS_ASSERT_EQUALS (dec->length (), 20u);
+      TS_ASSERT_EQUALS (dec->element (19)->get_integer (), 19);
+      m_ctx->destroy_value (dec);
+    }
+
+    ///////////////////////////////
+    // clean up
+    ///////////////////////////////
+
+    m_ctx->destroy_value (val);
+  }
+
+  ///////////////////////////////////////////////////////////////
+  ///////////////////////////////////////////////////////////////
+  ///////////////////////////////////////////////////////////////
+
+  void testPackedArrays ()
+  {
+    ///////////////////////////////
+    // set up
+    ///////////////////////////////
+
+    const int64_t ints [6] = { 0, 23, -24, 70000, -5000000000LL, 9000000000000000000LL };
+    const double floats [4] = { 0.5, -1.25, 3.1416, 2.5e9 };
+    const bool bools [3] = { true, false, true };
+
+    kvr::value *val = m_ctx->create_value ()->as_map ();
+    {
+      val->insert_array ("i")->push_n (ints, 6);
+      val->insert_array ("f")->push_n (floats, 4);
+      val->insert_array ("b")->push_n (bools, 3);
+      kvr::value *a = val->insert_array ("a");
+      a->push_array ()->push_n (ints, 2);
+      a->push_array ()->push_n (floats, 2);
+    }
+
+    ///////////////////////////////
+    // encode/decode
+    ///////////////////////////////
+
+    const kvr::codec_t codecs [3] = { kvr::CODEC_JSON, kvr::CODEC_CBOR, kvr::CODEC_MSGPACK };
+
+    for (int c = 0; c < 3; ++c)
+    {
+      size_t obufsz = val->encode_bound (codecs [c]);
+      kvr::obuffer obuf (obufsz);
+
+      bool ok = val->encode (codecs [c], &obuf);
+      TS_ASSERT (ok);
+      TS_ASSERT_LESS_THAN_EQUALS (obuf.get_size (), obufsz);
+
+      // homogeneous arrays are decoded packed when asked to
+      kvr::value *dec = m_ctx->create_value ();
+      ok = dec->decode (codecs [c], obuf.get_data (), obuf.get_size ());
+      TS_ASSERT (ok);
+      TS_ASSERT (!dec->find ("i")->is_packed ());
+      TS_ASSERT (!dec->find ("f")->is_packed ());
+      TS_ASSERT_EQUALS (dec->find ("i")->element (5)->get_integer (), 9000000000000000000LL);
+      TS_ASSERT_EQUALS (val->hash (), dec->hash ());
+
+      ok = dec->decode (codecs [c], obuf.get_data (), obuf.get_size (), kvr::DECODE_PACK_ARRAYS);
+      TS_ASSERT (ok);
+      TS_ASSERT (dec->find ("i")->packed_integers () != NULL);
+      TS_ASSERT (dec->find ("b")->packed_booleans () != NULL);
+      TS_ASSERT_EQUALS (dec->find ("i")->packed_integers () [5], 9000000000000000000LL);
+      TS_ASSERT_EQUALS (dec->find ("a")->length (), 2u);
+      TS_ASSERT (dec->find ("f")->packed_floats () != NULL);
+      TS_ASSERT_EQUALS (val->hash (), dec->hash ());
+
+      m_ctx->destroy_value (dec);
+    }
+
+    ///////////////////////////////
+    // cbor typed arrays (rfc 8746) in other layouts
+    ///////////////////////////////
+    {
+      const uint8_t cbor [] =
+      {
+        0x83,
+        0xd8, 0x45, 0x44, 0x01, 0x00, 0xff, 0xff,   // uint16 little endian [1, 65535]
+        0xd8, 0x50, 0x44, 0x3c, 0x00, 0xc0, 0x00,   // float16 big endian [1.0, -2.0]
+        0xd8, 0x48, 0x42, 0xff, 0x7f,               // sint8 [-1, 127]
+      };
+
+      kvr::value *dec = m_ctx->create_value ();
+      TS_ASSERT (dec->decode (kvr::CODEC_CBOR, cbor, sizeof (cbor)));
+      TS_ASSERT_EQUALS (dec->length (), 3u);
+
+      int64_t i [2] = { 0, 0 };
+      double f [2] = { 0.0, 0.0 };
+      TS_ASSERT_EQUALS (dec->element (0)->get_n (i, 2), 2u);
+      TS_ASSERT (i [0] == 1 && i [1] == 65535);
+      TS_ASSERT_EQUALS (dec->element (1)->get_n (f, 2), 2u);
+      TS_ASSERT (f [0] == 1.0 && f [1] == -2.0);
+      TS_ASSERT_EQUALS (dec->element (2)->get_n (i, 2), 2u);
+      TS_ASSERT (i [0] == -1 && i [1] == 127);
+
+      m_ctx->destroy_value (dec);
+    }
+
+    ///////////////////////////////
+    // clean up
+    ///////////////////////////////
+
+    m_ctx->destroy_value (val);
+  }
+
+  ///////////////////////////////////////////////////////////////
+  ///////////////////////////////////////////////////////////////
+  ///////////////////////////////////////////////////////////////
+
+  void testBorrowedStrings ()
+  {
+    ///////////////////////////////
+    // set up
+    ///////////////////////////////
+
+    const char *host = "host-0001.eu-west-1.internal";
+    const char *text = "when this card dies, destroy all creatures blocking it";
+
+    kvr::value *val = m_ctx->create_value ()->as_map ();
+    {
+      val->insert ("host", host);
+      val->insert ("id", "x1");
+      kvr::value *a = val->insert_array ("a");
+      a->push (text);
+      a->push (host);
+    }
+
+    const kvr::codec_t codecs [2] = { kvr::CODEC_CBOR, kvr::CODEC_MSGPACK };
+
+    for (int c = 0; c < 2; ++c)
+    {
+      kvr::obuffer obuf (val->encode_bound (codecs [c]));
+      TS_ASSERT (val->encode (codecs [c], &obuf));
+
+      // copy the input so it can be changed after decoding
+      size_t size = obuf.get_size ();
+      uint8_t *data = new uint8_t [size];
+      memcpy (data, obuf.get_data (), size);
+
+      kvr::value *dec = m_ctx->create_value ();
+      TS_ASSERT (dec->decode (codecs [c], data, size, kvr::DECODE_BORROW_STRINGS));
+      TS_ASSERT_EQUALS (val->hash (), dec->hash ());
+
+      ///////////////////////////////
+      // long strings point into the input, short ones are inline
+      ///////////////////////////////
+
+      kvr::sz_t len = 0;
+      const char *str = dec->find ("host")->get_string (&len);
+      TS_ASSERT (((const uint8_t *) str >= data) && ((const uint8_t *) str < (data + size)));
+      TS_ASSERT_EQUALS (len, (kvr::sz_t) strlen (host));
+      str = dec->find ("id")->get_string (&len);
+      TS_ASSERT (((const uint8_t *) str < data) || ((const uint8_t *) str >= (data + size)));
+
+      ///////////////////////////////
+      // copies, merges, diffs and re-encodes
+      ///////////////////////////////
+
+      kvr::value *cpy = m_ctx->create_value ()->copy (dec);
+      TS_ASSERT_EQUALS (cpy->hash (), val->hash ());
+
+      kvr::value *diff = m_ctx->create_value ()->diff (val, dec);
+      kvr::value *pat = m_ctx->create_value ()->copy (val)->patch (diff);
+      TS_ASSERT_EQUALS (pat->hash (), dec->hash ());
+      m_ctx->destroy_value (pat);
+      m_ctx->destroy_value (diff);
+
+      kvr::obuffer out (dec->encode_bound (codecs [c]));
+      TS_ASSERT (dec->encode (codecs [c], &out));
+      TS_ASSERT_EQUALS (out.get_size (), size);
+      TS_ASSERT_EQUALS (memcmp (out.get_data (), data, size), 0);
+
+      kvr::value *e = dec->find ("a")->element (0);
+      e->merge (dec->find ("host"));
+      TS_ASSERT_EQUALS (e->get_string (&len) [strlen (text)], 'h');
+      TS_ASSERT_EQUALS (len, (kvr::sz_t) (strlen (text) + strlen (host)));
+
+      ///////////////////////////////
+      // insitu decodes terminate borrowed strings in the buffer
+      ///////////////////////////////
+      {
+        uint8_t *work = new uint8_t [size];
+        memcpy (work, data, size);
+        kvr::value *ins = m_ctx->create_value ();
+        TS_ASSERT (ins->decode_insitu (codecs [c], work, size, kvr::DECODE_BORROW_STRINGS));
+        TS_ASSERT_EQUALS (ins->hash (), val->hash ());
+        str = ins->find ("a")->element (0)->get_string ();
+        TS_ASSERT (((const uint8_t *) str >= work) && ((const uint8_t *) str < (work + size)));
+        TS_ASSERT_EQUALS (strcmp (str, text), 0);
+        TS_ASSERT_EQUALS (strcmp (ins->find ("host")->get_string (), host), 0);
+        m_ctx->destroy_value (ins);
+        delete [] work;
+      }
+
+      ///////////////////////////////
+      // null-terminated access is explicit, mutation copies
+      ///////////////////////////////
+
+      kvr::value *h = dec->find ("host");
+#if !KVR_DEBUG
+      TS_ASSERT (h->get_string () == NULL);
+#endif
+      str = h->get_string (&len);
+      TS_ASSERT (((const uint8_t *) str >= data) && ((const uint8_t *) str < (data + size)));
+      str = h->terminate_string ();
+      TS_ASSERT (((const uint8_t *) str < data) || ((const uint8_t *) str >= (data + size)));
+      TS_ASSERT_EQUALS (strcmp (str, host), 0);
+      TS_ASSERT_EQUALS (h->get_string (), str);
+
+      kvr::value *a1 = dec->find ("a")->element (1);
+      a1->set_string ("host-0002.eu-west-1.internal");
+
+      memset (data, 0, size);
+      delete [] data;
+
+      TS_ASSERT_EQUALS (strcmp (h->get_string (), host), 0);
+      TS_ASSERT_EQUALS (strcmp (a1->get_string (), "host-0002.eu-west-1.internal"), 0);
+      TS_ASSERT_EQUALS (cpy->find ("a")->element (0)->get_string (&len), cpy->find ("a")->element (0)->get_string ());
+      TS_ASSERT_EQUALS (strcmp (cpy->find ("a")->element (0)->get_string (), text), 0);
+
+      m_ctx->destroy_value (cpy);
+      m_ctx->destroy_value (dec);
+    }
+
+    ///////////////////////////////
+    // patches with borrowed (unterminated) paths
+    ///////////////////////////////
+    {
+      kvr::value *og = m_ctx->create_value ()->copy (val);
+      og->insert ("a key long enough to be borrowed", "x");
+      kvr::value *diff = m_ctx->create_value ()->diff (og, val);
+      kvr::obuffer obuf (diff->encode_bound (kvr::CODEC_MSGPACK));
+      TS_ASSERT (diff->encode (kvr::CODEC_MSGPACK, &obuf));
+      kvr::value *dec = m_ctx->create_value ();
+      TS_ASSERT (dec->decode (kvr::CODEC_MSGPACK, obuf.get_data (), obuf.get_size (), kvr::DECODE_BORROW_STRINGS));
+      TS_ASSERT_EQUALS (og->patch (dec)->hash (), val->hash ());
+      m_ctx->destroy_value (dec);
+      m_ctx->destroy_value (diff);
+      m_ctx->destroy_value (og);
+    }
+
+    ///////////////////////////////
+    // json strings are copied unless decoded insitu (see testJSONInsitu)
+    ///////////////////////////////
+    {
+      const char *json = "[\"host-0001.eu-west-1.internal\"]";
+      kvr::value *dec = m_ctx->create_value ();
+      TS_ASSERT (dec->decode (kvr::CODEC_JSON, (const uint8_t *) json, strlen (json), kvr::DECODE_BORROW_STRINGS));
+      const char *str = dec->element (0)->get_string ();
+      TS_ASSERT ((str < json) || (str >= (json + strlen (json))));
+      TS_ASSERT_EQUALS (strcmp (str, host), 0);
+      m_ctx->destroy_value (dec);
+    }
+
+    ///////////////////////////////
+    // clean up
+    ///////////////////////////////
+
+    m_ctx->destroy_value (val);
+  }
+
+  ///////////////////////////////////////////////////////////////
+  ///////////////////////////////////////////////////////////////
+  ///////////////////////////////////////////////////////////////
+
+  void testJSONInsitu ()
+  {
+    const char *json = "{\"host\":\"host-0001.eu-west-1.internal\",\"esc\":\"tab\\there \\\"quoted\\\" \\u00e9t\\u00e9\","
+                       "\"k\\n\":[1,\"a string long enough not to fit inline\",{\"x\":null}],\"id\":\"x1\"}";
+    const size_t size = strlen (json);
+
+    kvr::value *ref = m_ctx->create_value ();
+    TS_ASSERT (ref->decode (kvr::CODEC_JSON, (const uint8_t *) json, size));
+    TS_ASSERT_EQUALS (strcmp (ref->find ("esc")->get_string (), "tab\there \"quoted\" \xc3\xa9t\xc3\xa9"), 0);
+    TS_ASSERT (ref->find ("k\n") != NULL);
+
+    ///////////////////////////////
+    // buffers are read up to their size only (no terminator)
+    ///////////////////////////////
+    {
+      uint8_t *data = new uint8_t [size];
+      memcpy (data, json, size);
+      kvr::value *dec = m_ctx->create_value ();
+      TS_ASSERT (dec->decode (kvr::CODEC_JSON, data, size));
+      TS_ASSERT_EQUALS (dec->hash (), ref->hash ());
+
+      // a slice of a larger buffer, and one cut short
+      const char *msgs = "[1,2][3,4,5]";
+      TS_ASSERT (dec->decode (kvr::CODEC_JSON, (const uint8_t *) msgs + 5, 7));
+      TS_ASSERT_EQUALS (dec->length (), 3u);
+      TS_ASSERT (!dec->decode (kvr::CODEC_JSON, (const uint8_t *) msgs + 5, 6));
+      TS_ASSERT (!dec->decode (kvr::CODEC_JSON, data, size - 1));
+
+      m_ctx->destroy_value (dec);
+      delete [] data;
+    }
+
+    ///////////////////////////////
+    // insitu, with strings copied and borrowed
+    ///////////////////////////////
+    for (int borrow = 0; borrow < 2; ++borrow)
+    {
+      uint8_t *data = new uint8_t [size];
+      memcpy (data, json, size);
+      kvr::value *dec = m_ctx->create_value ();
+      TS_ASSERT (dec->decode_insitu (kvr::CODEC_JSON, data, size, borrow ? kvr::DECODE_BORROW_STRINGS : 0));
+      TS_ASSERT_EQUALS (dec->hash (), ref->hash ());
+
+      kvr::sz_t len = 0;
+      const char *str = dec->find ("esc")->get_string (&len);
+      bool inbuf = ((const uint8_t *) str >= data) && ((const uint8_t *) str < (data + size));
+      TS_ASSERT_EQUALS (inbuf, (borrow == 1));
+      TS_ASSERT_EQUALS (len, (kvr::sz_t) strlen (ref->find ("esc")->get_string ()));
+      TS_ASSERT_EQUALS (memcmp (str, ref->find ("esc")->get_string (), len), 0);
+
+      // a copy is deep while strings are borrowed, and outlives the buffer
+      kvr::value *cpy = m_ctx->create_value ()->copy (dec);
+      m_ctx->destroy_value (dec);
+      memset (data, 0, size);
+      delete [] data;
+      TS_ASSERT_EQUALS (cpy->hash (), ref->hash ());
+      m_ctx->destroy_value (cpy);
+    }
+
+    ///////////////////////////////
+    // errors and other codecs
+    ///////////////////////////////
+    {
+      char bad [] = "{\"a\":\"unterminated";
+      kvr::value *dec = m_ctx->create_value ();
+      TS_ASSERT (!dec->decode_insitu (kvr::CODEC_JSON, (uint8_t *) bad, strlen (bad)));
+
+      kvr::obuffer obuf (ref->encode_bound (kvr::CODEC_MSGPACK));
+      TS_ASSERT (ref->encode (kvr::CODEC_MSGPACK, &obuf));
+      uint8_t *data = new uint8_t [obuf.get_size ()];
+      memcpy (data, obuf.get_data (), obuf.get_size ());
+      TS_ASSERT (dec->decode_insitu (kvr::CODEC_MSGPACK, data, obuf.get_size ()));
+      TS_ASSERT_EQUALS (dec->hash (), ref->hash ());
+      m_ctx->destroy_value (dec);
+      delete [] data;
+    }
+
+    m_ctx->destroy_value (ref);
+  }
+
+  ///////////////////////////////////////////////////////////////
+  ///////////////////////////////////////////////////////////////
+  ///////////////////////////////////////////////////////////////
+
+  void testJSONIndexed ()
+  {
+    const uint32_t modes [3] = { kvr::DECODE_JSON_INDEXED | kvr::DECODE_JSON_INDEX_NO_SIMD,
+                                 kvr::DECODE_JSON_INDEXED | kvr::DECODE_JSON_INDEX_NO_AVX2,
+                                 kvr::DECODE_JSON_INDEXED };
+
+    // escape runs and quotes at every offset around the 64 byte block boundaries,
+    // and enough of them to span several index windows
+    kvr::value *gen = m_ctx->create_value ()->as_map ();
+    char key [32], str [256];
+    for (int i = 0; i < 200; ++i)
+    {
+      int n = 0;
+      for (int j = 0; j < (i % 70); ++j) { str [n++] = 'x'; }
+      for (int j = 0; j < (i % 5) + 1; ++j) { str [n++] = (j & 1) ? '"' : '\\'; }
+      str [n++] = (i & 1) ? '\n' : 'y';
+      str [n] = 0;
+      sprintf (key, "k%d%s", i, (i % 3) ? "" : "\\");
+      kvr::value *arr = gen->insert_array (key);
+      arr->push ((int32_t) i);
+      arr->push ((int64_t) i * -1000000007);
+      arr->push (i * 0.25);
+      arr->push (str);
+      arr->push_map ()->insert (key, (i & 1) != 0);
+    }
+    kvr::obuffer obuf (gen->encode_bound (kvr::CODEC_JSON));
+    TS_ASSERT (gen->encode (kvr::CODEC_JSON, &obuf));
+    TS_ASSERT (obuf.get_size () > (3 * 4096));
+
+    const char *docs [] =
+    {
+      "{}",
+      " [ ] ",
+      "{\"a\":1,\"b\":[true,false,null,-0,0,12,-123456789012345678,1234567890123456789,-9223372036854775808],\"c\":{}}",
+      "[1.5,-2.25e-3,1E10,0.1,\"\",\"\\u0000\",\"\\ud83d\\ude00\",\"\xc3\xa9t\xc3\xa9\",[[[[]]]],{\"\":\"\"}]",
+      "\r\n\t{ \"a\" : [ 1 , 2 ,\n3 ] , \"b\" :\t\"\\\\\\\\\" ,\"c\":null } trailing data is ignored",
+      "[\"a\\\\\",\"b\\\\\\\"c\",\"\\/\\b\\f\\n\\r\\t\"]",
+    };
+
+    const char *bad [] =
+    {
+      "   ",
+      "{\"a\":1,}",
+      "[1,2",
+      "[1 2]",
+      "{\"a\" 1}",
+      "{\"a\":\"unterminated}",
+      "[\"raw\ttab\"]",
+      "[tru]",
+      "[nulll]",
+      "[01]",
+      "[1.]",
+      "[-]",
+      "[\"bad \\x escape\"]",
+      "{1:2}",
+      "{\"a\":[}",
+    };
+
+    for (size_t d = 0; d < (sizeof (docs) / sizeof (docs [0])); ++d)
+    {
+      const uint8_t *data = (const uint8_t *) docs [d];
+      size_t size = strlen (docs [d]);
+
+      kvr::value *ref = m_ctx->create_value ();
+      TS_ASSERT (ref->decode (kvr::CODEC_JSON, data, size));
+
+      for (int m = 0; m < 3; ++m)
+      {
+        kvr::value *dec = m_ctx->create_value ();
+        TS_ASSERT (dec->decode (kvr::CODEC_JSON, data, size, modes [m]));
+        TS_ASSERT_EQUALS (dec->hash (), ref->hash ());
+        m_ctx->destroy_value (dec);
+      }
+
+      m_ctx->destroy_value (ref);
+    }
+
+    for (size_t d = 0; d < (sizeof (bad) / sizeof (bad [0])); ++d)
+    {
+      const uint8_t *data = (const uint8_t *) bad [d];
+      size_t size = strlen (bad [d]);
+
+      kvr::value *dec = m_ctx->create_value ();
+      TS_ASSERT (!dec->decode (kvr::CODEC_JSON, data, size));
+      for (int m = 0; m < 3; ++m)
+      {
+        TS_ASSERT (!dec->decode (kvr::CODEC_JSON, data, size, modes [m]));
+      }
+      m_ctx->destroy_value (dec);
+    }
+
+    ///////////////////////////////
+    // the generated document, whole and cut short
+    ///////////////////////////////
+    {
+      const uint32_t expected = gen->hash ();
+      kvr::value *dec = m_ctx->create_value ();
+      for (int m = 0; m < 3; ++m)
+      {
+        TS_ASSERT (dec->decode (kvr::CODEC_JSON, obuf.get_data (), obuf.get_size (), modes [m]));
+        TS_ASSERT_EQUALS (dec->hash (), expected);
+        TS_ASSERT (!dec->decode (kvr::CODEC_JSON, obuf.get_data (), obuf.get_size () - 1, modes [m]));
+      }
+      m_ctx->destroy_value (dec);
+    }
+
+    m_ctx->destroy_value (gen);
+  }
+
+  ///////////////////////////////////////////////////////////////
+  ///////////////////////////////////////////////////////////////
+  ///////////////////////////////////////////////////////////////
+
+  void testJSONWriter ()
+  {
+    class string_ostream : public kvr::ostream
+    {
+    public:
+      string_ostream () : m_size (0), m_writes (0), m_flushes (0) {}
+      virtual ~string_ostream () {}
+      void put (uint8_t byte) { m_data [m_size++] = (char) byte; }
+      void write (uint8_t *bytes, size_t count) { memcpy (m_data + m_size, bytes, count); m_size += count; ++m_writes; }
+      void flush () { ++m_flushes; }
+      char    m_data [1 << 16];
+      size_t  m_size;
+      int     m_writes;
+      int     m_flushes;
+    };
+
+    ///////////////////////////////
+    // exact output
+    ///////////////////////////////
+    {
+      const char raw [] = "q\"b\\s/\b\f\n\r\t\x01\x1f\x7f\xc3\xa9 and a clean run longer than sixteen bytes";
+      kvr::value *doc = m_ctx->create_value ()->as_map ();
+      doc->insert ("s", "")->set_string (raw, (kvr::sz_t) (sizeof (raw) - 1));
+      doc->insert ("i", (int64_t) -9007199254740993);
+      doc->insert ("f", 0.1);
+      doc->insert ("b", false);
+      doc->insert_null ("n");
+      doc->insert_array ("e");
+      kvr::value *p = doc->insert_array ("p");
+      p->push (1.5);
+      p->push (-2.0);
+
+      const char *expected = "{\"s\":\"q\\\"b\\\\s/\\b\\f\\n\\r\\t\\u0001\\u001F\x7f\xc3\xa9 and a clean run longer than sixteen bytes\","
+                             "\"i\":-9007199254740993,\"f\":0.1,\"b\":false,\"n\":null,\"e\":[],\"p\":[1.5,-2.0]}";
+      const size_t len = strlen (expected);
+
+      kvr::obuffer obuf (8);
+      TS_ASSERT (doc->encode (kvr::CODEC_JSON, &obuf));
+      TS_ASSERT_EQUALS (obuf.get_size (), len);
+      TS_ASSERT_EQUALS (memcmp (obuf.get_data (), expected, len), 0);
+      TS_ASSERT_EQUALS (obuf.get_data () [len], 0); // terminated on flush
+
+      string_ostream *os = new string_ostream ();
+      TS_ASSERT (doc->encode (kvr::CODEC_JSON, os));
+      TS_ASSERT_EQUALS (os->m_size, len);
+      TS_ASSERT_EQUALS (memcmp (os->m_data, expected, len), 0);
+      TS_ASSERT_EQUALS (os->m_writes, 1);
+      TS_ASSERT_EQUALS (os->m_flushes, 1);
+      delete os;
+
+      m_ctx->destroy_value (doc);
+    }
+
+    ///////////////////////////////
+    // output larger than a staging block, and escapes past the estimate of encode_bound
+    ///////////////////////////////
+    {
+      char str [1000];
+      memset (str, '\n', sizeof (str));
+      kvr::value *doc = m_ctx->create_value ()->as_array ();
+      for (int i = 0; i < 8; ++i)
+      {
+        doc->push ("")->set_string (str, (kvr::sz_t) sizeof (str));
+        doc->push (i * 0.5);
+      }
+
+      kvr::obuffer obuf (doc->encode_bound (kvr::CODEC_JSON));
+      TS_ASSERT (doc->encode (kvr::CODEC_JSON, &obuf));
+      TS_ASSERT_EQUALS (obuf.get_data () [obuf.get_size ()], 0);
+
+      string_ostream *os = new string_ostream ();
+      TS_ASSERT (doc->encode (kvr::CODEC_JSON, os));
+      TS_ASSERT_EQUALS (os->m_size, obuf.get_size ());
+      TS_ASSERT_EQUALS (memcmp (os->m_data, obuf.get_data (), os->m_size), 0);
+      TS_ASSERT (os->m_writes > 1);
+      delete os;
+
+      kvr::value *dec = m_ctx->create_value ();
+      TS_ASSERT (dec->decode (kvr::CODEC_JSON, obuf.get_data (), obuf.get_size ()));
+      TS_ASSERT_EQUALS (dec->hash (), doc->hash ());
+      m_ctx->destroy_value (dec);
+      m_ctx->destroy_value (doc);
+    }
+  }
+
+  ///////////////////////////////////////////////////////////////
+  ///////////////////////////////////////////////////////////////
+  ///////////////////////////////////////////////////////////////
+
+  void testStreamDecode ()
+  {
+    class chunk_istream : public kvr::istream
+    {
+    public:
+      chunk_istream (const uint8_t *buf, size_t sz, size_t chunk, bool unread = true) : m_buf (buf), m_sz (sz), m_pos (0), m_chunk (chunk), m_calls (0), m_unread (unread) {}
+      virtual ~chunk_istream () {}
+      bool get (uint8_t *byte) { ++m_calls; if (m_pos < m_sz) { *byte = m_buf [m_pos++]; return true; } return false; }
+      bool read (uint8_t *bytes, size_t count) { ++m_calls; if (count > (m_sz - m_pos)) { return false; } memcpy (bytes, m_buf + m_pos, count); m_pos += count; return true; }
+      size_t tell () { return m_pos; }
+      uint8_t peek () { ++m_calls; return (m_pos < m_sz) ? m_buf [m_pos] : 0u; }
+      size_t read_some (uint8_t *bytes, size_t count)
+      {
+        if (m_chunk == 0)
+        {
+          return kvr::istream::read_some (bytes, count); // default: one byte through get
+        }
+        ++m_calls;
+        size_t n = count;
+        n = (n > m_chunk) ? m_chunk : n;
+        n = (n > (m_sz - m_pos)) ? (m_sz - m_pos) : n;
+        memcpy (bytes, m_buf + m_pos, n);
+        m_pos += n;
+        return n;
+      }
+      bool unread (size_t count)
+      {
+        if (!m_unread || (count > m_pos))
+        {
+          return kvr::istream::unread (count); // default: no read ahead
+        }
+        m_pos -= count;
+        return true;
+      }
+      const uint8_t * m_buf;
+      size_t          m_sz;
+      size_t          m_pos;
+      size_t          m_chunk;
+      size_t          m_calls;
+      bool            m_unread;
+    };
+
+    // strings shorter than, straddling and longer than a read block
+    static char str [3 * KVR_CONSTANT_ISTREAM_BLOCK_SZ];
+    memset (str, 'x', sizeof (str));
+
+    kvr::value *doc = m_ctx->create_value ()->as_map ();
+    kvr::value *arr = doc->insert_array ("a");
+    for (int i = 0; i < 500; ++i)
+    {
+      arr->push ((int64_t) i * 1000003);
+      arr->push (i * 0.25);
+      arr->push ("")->set_string (str, (kvr::sz_t) (i * 13 + 1));
+    }
+    doc->insert ("long", "")->set_string (str, (kvr::sz_t) sizeof (str));
+    doc->insert ("edge", "")->set_string (str, (kvr::sz_t) KVR_CONSTANT_ISTREAM_BLOCK_SZ);
+    doc->insert ("t", true);
+    doc->insert_null ("n");
+
+    const kvr::codec_t codecs [] = { kvr::CODEC_MSGPACK, kvr::CODEC_CBOR, kvr::CODEC_JSON };
+    const size_t chunks [] = { 0, 1, 7, KVR_CONSTANT_ISTREAM_BLOCK_SZ };
+
+    for (size_t c = 0; c < (sizeof (codecs) / sizeof (codecs [0])); ++c)
+    {
+      kvr::obuffer obuf (doc->encode_bound (codecs [c]));
+      TS_ASSERT (doc->encode (codecs [c], &obuf));
+      const uint8_t *data = obuf.get_data ();
+      size_t size = obuf.get_size ();
+
+      for (size_t k = 0; k < (sizeof (chunks) / sizeof (chunks [0])); ++k)
+      {
+        chunk_istream is (data, size, chunks [k]);
+        kvr::value *dec = m_ctx->create_value ();
+        TS_ASSERT (dec->decode (codecs [c], is));
+        TS_ASSERT_EQUALS (dec->hash (), doc->hash ());
+        if (chunks [k] == KVR_CONSTANT_ISTREAM_BLOCK_SZ)
+        {
+          TS_ASSERT (is.m_calls < ((size / KVR_CONSTANT_ISTREAM_BLOCK_SZ) + 8)); // block reads only
+        }
+        m_ctx->destroy_value (dec);
+      }
+
+      // back to back values (the stream is left at the end of each, read ahead or not)
+      if (codecs [c] != kvr::CODEC_JSON)
+      {
+        kvr::value *small = m_ctx->create_value ()->as_map ();
+        small->insert ("k", (int64_t) 1);
+        kvr::obuffer sbuf (small->encode_bound (codecs [c]));
+        TS_ASSERT (small->encode (codecs [c], &sbuf));
+        size_t both = size + sbuf.get_size () + size;
+        uint8_t *seq = new uint8_t [both];
+        memcpy (seq, data, size);
+        memcpy (seq + size, sbuf.get_data (), sbuf.get_size ());
+        memcpy (seq + size + sbuf.get_size (), data, size);
+
+        for (size_t k = 0; k < (sizeof (chunks) / sizeof (chunks [0])); ++k)
+        {
+          for (int u = 0; u < 2; ++u)
+          {
+            chunk_istream is (seq, both, chunks [k], (u == 0));
+            kvr::value *dec = m_ctx->create_value ();
+            TS_ASSERT (dec->decode (codecs [c], is));
+            TS_ASSERT_EQUALS (dec->hash (), doc->hash ());
+            TS_ASSERT_EQUALS (is.m_pos, size);
+            TS_ASSERT (dec->decode (codecs [c], is));
+            TS_ASSERT_EQUALS (dec->hash (), small->hash ());
+            TS_ASSERT (dec->decode (codecs [c], is));
+            TS_ASSERT_EQUALS (dec->hash (), doc->hash ());
+            TS_ASSERT_EQUALS (is.m_pos, both);
+            m_ctx->destroy_value (dec);
+          }
+        }
+
+        delete [] seq;
+        m_ctx->destroy_value (small);
+      }
+
+      // truncated
+      const size_t cuts [] = { 1, size / 2, size - 1 };
+      for (size_t t = 0; t < (sizeof (cuts) / sizeof (cuts [0])); ++t)
+      {
+        chunk_istream is (data, cuts [t], KVR_CONSTANT_ISTREAM_BLOCK_SZ);
+        kvr::value *dec = m_ctx->create_value ();
+        TS_ASSERT (!dec->decode (codecs [c], is));
+        m_ctx->destroy_value (dec);
+      }
+    }
+
+    m_ctx->destroy_value (doc);
+  }
+
+  ///////////////////////////////////////////////////////////////
+  ///////////////////////////////////////////////////////////////
+  ///////////////////////////////////////////////////////////////
+
+  void testStreamEncode ()
+  {
+    class count_ostream : public kvr::ostream
+    {
+    public:
+      count_ostream () : m_size (0), m_puts (0), m_writes (0), m_flushes (0) {}
+      virtual ~count_ostream () {}
+      void put (uint8_t byte) { m_data [m_size++] = byte; ++m_puts; }
+      void write (uint8_t *bytes, size_t count) { memcpy (m_data + m_size, bytes, count); m_size += count; ++m_writes; }
+      void flush () { ++m_flushes; }
+      uint8_t m_data [1 << 20];
+      size_t  m_size;
+      int     m_puts;
+      int     m_writes;
+      int     m_flushes;
+    };
+
+    const kvr::codec_t codecs [] = { kvr::CODEC_MSGPACK, kvr::CODEC_CBOR, kvr::CODEC_JSON };
+
+    ///////////////////////////////
+    // output within a block: one write
+    ///////////////////////////////
+    {
+      kvr::value *doc = m_ctx->create_value ()->as_map ();
+      doc->insert ("i", (int64_t) -70000);
+      doc->insert ("f", 2.5);
+      doc->insert ("s", "string");
+      doc->insert_null ("n");
+      doc->insert_array ("a")->push (true);
+
+      for (size_t c = 0; c < (sizeof (codecs) / sizeof (codecs [0])); ++c)
+      {
+        kvr::obuffer obuf;
+        TS_ASSERT (doc->encode (codecs [c], &obuf));
+
+        count_ostream *os = new count_ostream ();
+        TS_ASSERT (doc->encode (codecs [c], os));
+        TS_ASSERT_EQUALS (os->m_size, obuf.get_size ());
+        TS_ASSERT_EQUALS (memcmp (os->m_data, obuf.get_data (), os->m_size), 0);
+        TS_ASSERT_EQUALS (os->m_puts, 0);
+        TS_ASSERT_EQUALS (os->m_writes, 1);
+        TS_ASSERT_EQUALS (os->m_flushes, 1);
+        delete os;
+      }
+
+      m_ctx->destroy_value (doc);
+    }
+
+    ///////////////////////////////
+    // output over many blocks, with strings longer than a block
+    ///////////////////////////////
+    {
+      static char str [2 * KVR_CONSTANT_OSTREAM_BLOCK_SZ];
+      memset (str, 'y', sizeof (str));
+
+      kvr::value *doc = m_ctx->create_value ()->as_array ();
+      for (int i = 0; i < 200; ++i)
+      {
+        doc->push ((int64_t) i * 65599);
+        doc->push ("")->set_string (str, (kvr::sz_t) ((i * 37) % sizeof (str)));
+      }
+
+      for (size_t c = 0; c < (sizeof (codecs) / sizeof (codecs [0])); ++c)
+      {
+        kvr::obuffer obuf;
+        TS_ASSERT (doc->encode (codecs [c], &obuf));
+        TS_ASSERT (obuf.get_size () <= sizeof (count_ostream::m_data));
+
+        count_ostream *os = new count_ostream ();
+        TS_ASSERT (doc->encode (codecs [c], os));
+        TS_ASSERT_EQUALS (os->m_size, obuf.get_size ());
+        TS_ASSERT_EQUALS (memcmp (os->m_data, obuf.get_data (), os->m_size), 0);
+        TS_ASSERT_EQUALS (os->m_puts, 0);
+        TS_ASSERT ((size_t) os->m_writes < ((os->m_size / (KVR_CONSTANT_OSTREAM_BLOCK_SZ / 2)) + 401)); // long strings: 2 writes
+        TS_ASSERT_EQUALS (os->m_flushes, 1);
+        delete os;
+      }
+
+      m_ctx->destroy_value (doc);
+    }
+  }
+
+  ///////////////////////////////////////////////////////////////
+  ///////////////////////////////////////////////////////////////
+  ///////////////////////////////////////////////////////////////
+
   void testSampleStream ()
   {
     ///////////////////////////////
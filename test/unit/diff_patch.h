@@ -79,7 +79,7 @@ public:
     kvr::value *mm = map1->insert_map ("zoro");
     mm->insert ("sword", 0);
     mm->insert ("mask", 1);
-    map1->find ("bill")->set_integer (9000LL);
+    map1->find ("bill")->set_integer ((int64_t) 9000);
     kvr::value *v1m = map1->find ("mapping");
     v1m->remove ("a");
     v1m->find ("b")->set_string ("thirteen");